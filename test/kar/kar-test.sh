@@ -217,6 +217,58 @@ test_extract ()
     rm -rf $DIR
 }
 
+# parallel copy must produce the same archive and the same files
+test_threads ()
+{
+    echo "Testing threads: -e mode..."
+
+    mkdir $RESULT
+
+    $KAR -f -c $ARCHIVE -d $INPUT
+    cp $ARCHIVE $RESULT/sequential.kar
+
+    if ! $KAR -e 4 --md5 -f -c $ARCHIVE -d $INPUT
+    then
+        echo "KAR threaded create operation failed"
+        cleanup
+        exit 1
+    fi
+
+    if ! cmp -s $ARCHIVE $RESULT/sequential.kar
+    then
+        echo "      threaded archive differs from sequential...test failed"
+        cleanup
+        exit 1
+    fi
+
+    if [ "$UNAME" = "Linux" ] && ! md5sum -c $ARCHIVE.md5 > /dev/null
+    then
+        echo "md5sum check of threaded archive failed"
+        cleanup
+        exit 1
+    fi
+
+    $KAR -x $ARCHIVE -d $RESULT/s_extracted
+    if ! $KAR --threads 4 -x $ARCHIVE -d $RESULT/p_extracted
+    then
+        echo "KAR threaded extraction failed"
+        chmod -R +w $RESULT
+        cleanup
+        exit 1
+    fi
+
+    if ! diff -q -r $RESULT/s_extracted $RESULT/p_extracted > $RESULT/diff.txt 2>&1
+    then
+        echo "      threaded extraction differs from sequential...test failed"
+        cat $RESULT/diff.txt
+        chmod -R +w $RESULT
+        cleanup
+        exit 1
+    fi
+
+    chmod -R +w $RESULT
+    cleanup
+}
 
 # create archive with new tool
 # test and extract with legacy
@@ -375,6 +427,7 @@ run_basic ()
     test_list
     test_list_options
     test_extract
+    test_threads
 }
 
 run_compare ()
@@ -104,6 +104,21 @@ def kget_download_full( url, acc ):
     except:
         return None
 
+'''---------------------------------------------------------------------
+    calls "kget URL --threads 4"
+---------------------------------------------------------------------'''
+def kget_download_threaded( url, acc ):
+    try:
+        os.remove( acc )
+    except:
+        pass
+    cmd = "kget %s --threads 4"%( url )
+    try:
+        subprocess.check_output( cmd, shell = True )
+        return md5( acc )
+    except:
+        return None
+
 
 '''---------------------------------------------------------------------
     the expected values
@@ -159,6 +174,19 @@ if remote_md5 != EXP_MD5 :
 else :
     print "full donwload ok in %d ms"%( t_full.microseconds )
 
+t_start = datetime.datetime.now()
+remote_md5 = kget_download_threaded( URL, ACC )
+t_threaded = datetime.datetime.now() - t_start;
+if remote_md5 == None :
+    print "error downloading '%s'"%( URL )
+    sys.exit( -1 )
+
+if remote_md5 != EXP_MD5 :
+    print "md5 diff: expected (%s) vs remote (%s)"%( EXP_MD5, remote_md5 )
+    sys.exit( -1 )
+else :
+    print "threaded donwload ok in %d ms"%( t_threaded.microseconds )
+
 '''---------------------------------------------------------------------
 if t_full >= t_partial :
     print "timing problem: full download should be faster than partial download"
@@ -107,6 +107,59 @@ FIXTURE_TEST_CASE ( SingleReference_Slice, NGSPileupFixture )
     REQUIRE_EQ ( expected, Run () );
 }
 
+FIXTURE_TEST_CASE ( SingleReference_MultipleSlices, NGSPileupFixture )
+{   // overlapping slices of the same reference, out of order: merged into one
+    ps . AddInput ( "ERR247027" ); 
+    ps . AddReferenceSlice ( "AL844509.2", 1212493, 2 );  
+    ps . AddReferenceSlice ( "Pf3D7_13", 1212492, 2 );  
+    string expected = 
+        "AL844509.2\t1212494\t1\n"
+        "AL844509.2\t1212495\t1\n";
+    REQUIRE_EQ ( expected, Run () );
+}
+
+FIXTURE_TEST_CASE ( SingleReference_SliceToTheEnd, NGSPileupFixture )
+{
+    ps . AddInput ( "ERR247027" ); 
+    ps . AddReferenceSlice ( "AL844509.2", 1212492, 0 );  
+    string expectedStart = "AL844509.2\t1212494\t1\n";
+    REQUIRE_EQ ( expectedStart, Run () . substr ( 0, expectedStart . length () ) );
+}
+
+FIXTURE_TEST_CASE ( SingleReference_Region, NGSPileupFixture )
+{   // no reference is named "AL844509.2:1212493-1212495": the range is split off
+    ps . AddInput ( "ERR247027" ); 
+    ps . AddReferenceSlice ( "AL844509.2:1212493-1212495", "AL844509.2", 1212492, 3 );  
+    string expected = 
+        "AL844509.2\t1212494\t1\n"
+        "AL844509.2\t1212495\t1\n";
+    REQUIRE_EQ ( expected, Run () );
+}
+
+FIXTURE_TEST_CASE ( UnknownReference, NGSPileupFixture )
+{
+    ps . AddInput ( "ERR247027" ); 
+    ps . AddReference ( "AL844509.2" );  
+    ps . AddReference ( "blah" );  
+    REQUIRE_THROW ( Run() );
+    REQUIRE_EQ ( string(), m_str . str() );
+}
+
+FIXTURE_TEST_CASE ( Threads_SameAsSerial, NGSPileupFixture )
+{   // the reference is cut into several windows, processed concurrently
+    ps . AddInput ( "ERR247027" ); 
+    ps . AddReference ( "AL844509.2" );  
+    string serial = Run ();
+    
+    ostringstream threaded;
+    ps . output = & threaded;
+    ps . threads = 4;
+    NGS_Pileup ( ps ) . Run ();
+    
+    REQUIRE ( ! serial . empty () );
+    REQUIRE_EQ ( serial, threaded . str () );
+}
+
 #if 0
 FIXTURE_TEST_CASE ( MultipleReferences, NGSPileupFixture )
 {   
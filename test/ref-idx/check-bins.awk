@@ -0,0 +1,49 @@
+# ===========================================================================
+#
+#                            PUBLIC DOMAIN NOTICE
+#               National Center for Biotechnology Information
+#
+#  This software/database is a "United States Government Work" under the
+#  terms of the United States Copyright Act.  It was written as part of
+#  the author's official duties as a United States Government employee and
+#  thus cannot be copyrighted.  This software/database is freely available
+#  to the public for use. The National Library of Medicine and the U.S.
+#  Government have not placed any restriction on its use or reproduction.
+#
+#  Although all reasonable efforts have been taken to ensure the accuracy
+#  and reliability of the software and data, the NLM and the U.S.
+#  Government do not and cannot warrant the performance or results that
+#  may be obtained by using this software or data. The NLM and the U.S.
+#  Government disclaim all warranties, express or implied, including
+#  warranties of performance, merchantability or fitness for any particular
+#  purpose.
+#
+#  Please cite the author in any work or product based on this material.
+#
+# ===========================================================================
+#
+# Checks the bins of 'ref-idx -f 6' against the per-base coverage of
+# 'ref-idx -f 3' over the same slice.
+#
+# usage: awk -f check-bins.awk f3-output f6-output
+
+BEGIN { FS = "\t"; bad = 0 }
+
+NR == FNR { cov[ $1 ] = $2; next }
+
+{
+    min = -1; max = 0; sum = 0
+    for ( pos = $2; pos < $2 + $3; ++pos ) {
+        c = cov[ pos ] + 0
+        if ( min < 0 || c < min ) min = c
+        if ( c > max ) max = c
+        sum += c
+    }
+    line = sprintf( "%s\t%d\t%d\t%d\t%d\t%.2f", $1, $2, $3, min, max, sum / $3 )
+    if ( line != $0 ) {
+        print "check-bins: '" $0 "' instead of '" line "'"
+        bad = 1
+    }
+}
+
+END { exit bad }
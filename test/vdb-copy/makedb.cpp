@@ -0,0 +1,126 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/**
+* Create a test database for vdb-copy
+*/
+
+#include <string>
+#include <cstdio>
+
+#include <vdb/manager.h>
+#include <vdb/schema.h>
+#include <vdb/database.h>
+#include <vdb/table.h>
+#include <vdb/cursor.h>
+
+using namespace std;
+
+#define CHECK_RC(call) { rc_t rc = call; if ( rc != 0 ) return rc; }
+
+rc_t
+FillTable ( VDatabase * p_db, const char * p_name, uint64_t p_rows )
+{
+    VTable *tab;
+    CHECK_RC ( VDatabaseCreateTable ( p_db, & tab, p_name, kcmInit + kcmMD5, "%s", p_name ) );
+    VCursor *curs;
+    CHECK_RC ( VTableCreateCursorWrite ( tab, & curs, kcmInsert ) ) ;
+    uint32_t idx_num, idx_txt;
+    CHECK_RC ( VCursorAddColumn ( curs, & idx_num, "NUM" ) );
+    CHECK_RC ( VCursorAddColumn ( curs, & idx_txt, "TXT" ) );
+    CHECK_RC ( VCursorOpen ( curs ) );
+    for ( uint64_t row = 1; row <= p_rows; ++row )
+    {
+        uint32_t const num = ( uint32_t ) ( row * 7 );
+        char txt [ 32 ];
+        int const len = sprintf ( txt, "%s-%lu", p_name, ( unsigned long ) row );
+        CHECK_RC ( VCursorOpenRow ( curs ) );
+        CHECK_RC ( VCursorWrite ( curs, idx_num, 32, & num, 0, 1 ) );
+        CHECK_RC ( VCursorWrite ( curs, idx_txt, 8, txt, 0, len ) );
+        CHECK_RC ( VCursorCommitRow ( curs ) );
+        CHECK_RC ( VCursorCloseRow ( curs ) );
+    }
+    CHECK_RC ( VCursorCommit ( curs ) );
+    CHECK_RC ( VCursorRelease ( curs ) );
+    CHECK_RC ( VTableRelease ( tab ) );
+    return 0;
+}
+
+rc_t
+CopyDatabase()
+{   // 2 tables, to be copied sequentially and on worker threads
+    const string SchemaText =
+        "table copy_tbl #1.0.0 { column U32 NUM; column ascii TXT; };\n"
+        "database copy_db #1 { table copy_tbl #1 TAB1; table copy_tbl #1 TAB2; };\n";
+
+    VDBManager* mgr;
+    CHECK_RC ( VDBManagerMakeUpdate ( & mgr, NULL ) );
+    VSchema* schema;
+    CHECK_RC ( VDBManagerMakeSchema ( mgr, & schema ) );
+    CHECK_RC ( VSchemaParseText ( schema, NULL, SchemaText.c_str(), SchemaText.size() ) );
+
+    VDatabase* db;
+    CHECK_RC ( VDBManagerCreateDB ( mgr, & db, schema, "copy_db", kcmInit + kcmMD5, "./data/CopyDatabase" ) );
+    CHECK_RC ( FillTable ( db, "TAB1", 20000 ) );
+    CHECK_RC ( FillTable ( db, "TAB2", 500 ) );
+
+    CHECK_RC ( VDatabaseRelease ( db ) );
+    CHECK_RC ( VSchemaRelease ( schema ) );
+    CHECK_RC ( VDBManagerRelease ( mgr ) );
+    return 0;
+}
+
+//////////////////////////////////////////// Main
+extern "C"
+{
+
+#include <kapp/args.h>
+#include <kfg/config.h>
+
+ver_t CC KAppVersion ( void )
+{
+    return 0x1000000;
+}
+rc_t CC UsageSummary (const char * progname)
+{
+    return 0;
+}
+
+rc_t CC Usage ( const Args * args )
+{
+    return 0;
+}
+
+const char UsageDefaultName[] = "makedb";
+
+rc_t CC KMain ( int argc, char *argv [] )
+{
+    KConfigDisableUserSettings();
+
+    return CopyDatabase();
+}
+
+}
@@ -0,0 +1,131 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/**
+* Create test tables for vdb-diff
+*/
+
+#include <string>
+
+#include <vdb/manager.h>
+#include <vdb/schema.h>
+#include <vdb/table.h>
+#include <vdb/cursor.h>
+
+using namespace std;
+
+#define CHECK_RC(call) { rc_t rc = call; if ( rc != 0 ) return rc; }
+
+rc_t
+DiffTable( const char * p_path, bool p_changed )
+{   // 3 windows of the parallel diff, the changed table differs at the borders of them
+    const string SchemaText =
+        "table diff_tbl #1.0.0\n"
+        "{\n"
+        " column U32 NUM_A;\n"
+        " column U32 NUM_B;\n"
+        " column U32 NUM_C;\n"
+        "};\n";
+    const uint64_t Rows = 140000;
+
+    VDBManager* mgr;
+    CHECK_RC ( VDBManagerMakeUpdate ( & mgr, NULL ) );
+    VSchema* schema;
+    CHECK_RC ( VDBManagerMakeSchema ( mgr, & schema ) );
+    CHECK_RC ( VSchemaParseText ( schema, NULL, SchemaText.c_str(), SchemaText.size() ) );
+
+    VTable *tab;
+    CHECK_RC ( VDBManagerCreateTable ( mgr, & tab, schema, "diff_tbl", kcmInit + kcmMD5, "%s", p_path ) );
+    VCursor *curs;
+    CHECK_RC ( VTableCreateCursorWrite ( tab, & curs, kcmInsert ) ) ;
+    uint32_t idx_a, idx_b, idx_c;
+    CHECK_RC ( VCursorAddColumn ( curs, & idx_a, "NUM_A" ) );
+    CHECK_RC ( VCursorAddColumn ( curs, & idx_b, "NUM_B" ) );
+    CHECK_RC ( VCursorAddColumn ( curs, & idx_c, "NUM_C" ) );
+    CHECK_RC ( VCursorOpen ( curs ) );
+    for ( uint64_t row = 1; row <= Rows; ++row )
+    {
+        uint32_t a[ 2 ] = { ( uint32_t ) row, 0 };
+        uint32_t b[ 2 ] = { ( uint32_t ) row * 2, 0 };
+        uint32_t c[ 2 ] = { ( uint32_t ) row * 3, 0 };
+        uint32_t b_len = 1;
+        if ( p_changed )
+        {
+            if ( row == 10 || row == 65536 || row == 65537 )
+                a[ 0 ] ++;
+            if ( row == 65537 || row == 131073 )
+                c[ 0 ] ++;
+            if ( row == 70000 )
+                b_len = 2;
+        }
+        CHECK_RC ( VCursorOpenRow ( curs ) );
+        CHECK_RC ( VCursorWrite ( curs, idx_a, 32, a, 0, 1 ) );
+        CHECK_RC ( VCursorWrite ( curs, idx_b, 32, b, 0, b_len ) );
+        CHECK_RC ( VCursorWrite ( curs, idx_c, 32, c, 0, 1 ) );
+        CHECK_RC ( VCursorCommitRow ( curs ) );
+        CHECK_RC ( VCursorCloseRow ( curs ) );
+    }
+    CHECK_RC ( VCursorCommit ( curs ) );
+    CHECK_RC ( VCursorRelease ( curs ) );
+    CHECK_RC ( VTableRelease ( tab ) );
+
+    CHECK_RC ( VSchemaRelease ( schema ) );
+    CHECK_RC ( VDBManagerRelease ( mgr ) );
+    return 0;
+}
+
+//////////////////////////////////////////// Main
+extern "C"
+{
+
+#include <kapp/args.h>
+#include <kfg/config.h>
+
+ver_t CC KAppVersion ( void )
+{
+    return 0x1000000;
+}
+rc_t CC UsageSummary (const char * progname)
+{
+    return 0;
+}
+
+rc_t CC Usage ( const Args * args )
+{
+    return 0;
+}
+
+const char UsageDefaultName[] = "makedb";
+
+rc_t CC KMain ( int argc, char *argv [] )
+{
+    KConfigDisableUserSettings();
+
+    CHECK_RC ( DiffTable( "./data/TabA", false ) );
+    return DiffTable( "./data/TabB", true );
+}
+
+}
@@ -0,0 +1,165 @@
+#!/usr/bin/env python
+# ===========================================================================
+#
+#                            PUBLIC DOMAIN NOTICE
+#               National Center for Biotechnology Information
+#
+#  This software/database is a "United States Government Work" under the
+#  terms of the United States Copyright Act.  It was written as part of
+#  the author's official duties as a United States Government employee and
+#  thus cannot be copyrighted.  This software/database is freely available
+#  to the public for use. The National Library of Medicine and the U.S.
+#  Government have not placed any restriction on its use or reproduction.
+#
+#  Although all reasonable efforts have been taken to ensure the accuracy
+#  and reliability of the software and data, the NLM and the U.S.
+#  Government do not and cannot warrant the performance or results that
+#  may be obtained by using this software or data. The NLM and the U.S.
+#  Government disclaim all warranties, express or implied, including
+#  warranties of performance, merchantability or fitness for any particular
+#  purpose.
+#
+#  Please cite the author in any work or product based on this material.
+#
+# ===========================================================================
+#
+# Reads the Arrow IPC stream written by 'vdb-dump --format arrow' without
+# pyarrow, checks that the validity bitmap of every column covers the rows
+# of its batch and agrees with the null_count of the field-node, and prints
+# per batch and column the rows and the null rows.
+#
+# usage: check-arrow.py file.arrow
+
+import sys
+import struct
+
+HEADER_SCHEMA = 1
+HEADER_BATCH = 3
+TYPE_UTF8 = 5
+TYPE_LIST = 12
+
+
+def fail(message):
+    sys.stderr.write("check-arrow: " + message + "\n")
+    sys.exit(1)
+
+
+class Table:
+    """ a flatbuffer table at pos within buf """
+    def __init__(self, buf, pos):
+        self.buf = buf
+        self.pos = pos
+        vt = pos - struct.unpack_from("<i", buf, pos)[0]
+        vt_len = struct.unpack_from("<H", buf, vt)[0]
+        self.slots = [struct.unpack_from("<H", buf, vt + 4 + 2 * i)[0]
+                      for i in range((vt_len - 4) // 2)]
+
+    def field(self, i):
+        if i < len(self.slots) and self.slots[i] != 0:
+            return self.pos + self.slots[i]
+        return None
+
+    def scalar(self, i, fmt, default=0):
+        at = self.field(i)
+        return default if at is None else struct.unpack_from(fmt, self.buf, at)[0]
+
+    def ref(self, i):
+        at = self.field(i)
+        return None if at is None else at + struct.unpack_from("<I", self.buf, at)[0]
+
+    def table(self, i):
+        at = self.ref(i)
+        return None if at is None else Table(self.buf, at)
+
+    def string(self, i):
+        at = self.ref(i)
+        n = struct.unpack_from("<I", self.buf, at)[0]
+        return self.buf[at + 4:at + 4 + n].decode("utf-8")
+
+    def tables(self, i):
+        at = self.ref(i)
+        n = struct.unpack_from("<I", self.buf, at)[0]
+        res = []
+        for j in range(n):
+            e = at + 4 + 4 * j
+            res.append(Table(self.buf, e + struct.unpack_from("<I", self.buf, e)[0]))
+        return res
+
+    def structs(self, i):
+        at = self.ref(i)
+        n = struct.unpack_from("<I", self.buf, at)[0]
+        return [struct.unpack_from("<qq", self.buf, at + 4 + 16 * j) for j in range(n)]
+
+
+def read_messages(data):
+    pos = 0
+    while pos < len(data):
+        marker, length = struct.unpack_from("<II", data, pos)
+        if marker != 0xFFFFFFFF:
+            fail("bad continuation marker at %d" % pos)
+        pos += 8
+        if length == 0:
+            return
+        meta = data[pos:pos + length]
+        pos += length
+        msg = Table(meta, struct.unpack_from("<I", meta, 0)[0])
+        body_len = msg.scalar(3, "<q")
+        yield msg.scalar(1, "<B"), msg.table(2), data[pos:pos + body_len]
+        pos += body_len
+    fail("no end-of-stream marker")
+
+
+def buffers_of(field):
+    """ number of field-nodes and buffers of a top-level field """
+    kind = field.scalar(2, "<B")
+    if kind == TYPE_LIST:
+        return 2, 4
+    if kind == TYPE_UTF8:
+        return 1, 3
+    return 1, 2
+
+
+def main():
+    if len(sys.argv) != 2:
+        fail("usage: check-arrow.py file.arrow")
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+
+    fields = None
+    first_row = 1
+    batch = 0
+    for header_type, header, body in read_messages(data):
+        if header_type == HEADER_SCHEMA:
+            fields = header.tables(1)
+            print("schema " + " ".join(f.string(0) for f in fields))
+            continue
+        if header_type != HEADER_BATCH or fields is None:
+            fail("unexpected message")
+        rows = header.scalar(0, "<q")
+        nodes = header.structs(1)
+        buffers = header.structs(2)
+        ni = bi = 0
+        for f in fields:
+            node_count, buf_count = buffers_of(f)
+            length, null_count = nodes[ni]
+            offset, size = buffers[bi]
+            if length != rows:
+                fail("batch %d column %s has %d rows instead of %d" % (batch, f.string(0), length, rows))
+            nulls = []
+            if size > 0:
+                if size < (rows + 7) // 8:
+                    fail("batch %d column %s: bitmap of %d bytes for %d rows" % (batch, f.string(0), size, rows))
+                bitmap = bytearray(body[offset:offset + size])
+                nulls = [first_row + r for r in range(rows) if not bitmap[r >> 3] & (1 << (r & 7))]
+            elif null_count != 0:
+                fail("batch %d column %s: null_count %d without a bitmap" % (batch, f.string(0), null_count))
+            if len(nulls) != null_count:
+                fail("batch %d column %s: null_count %d, but %d nulls in the bitmap" % (batch, f.string(0), null_count, len(nulls)))
+            print("batch %d %s rows %d nulls %s" % (batch, f.string(0), rows, " ".join(str(n) for n in nulls)))
+            ni += node_count
+            bi += buf_count
+        first_row += rows
+        batch += 1
+
+
+main()
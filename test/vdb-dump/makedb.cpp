@@ -196,6 +196,150 @@ NestedDatabase()
     return 0;
 }
 
+rc_t
+ArrowTable()
+{   // 2 record-batches for --format arrow, with empty cells ( nulls ) at the ends of both
+    const string SchemaText = "table arrow_tbl #1.0.0 { column U32 NUM; };\n";
+    const uint64_t Rows = 70000;
+
+    VDBManager* mgr;
+    CHECK_RC ( VDBManagerMakeUpdate ( & mgr, NULL ) );
+    VSchema* schema;
+    CHECK_RC ( VDBManagerMakeSchema ( mgr, & schema ) );
+    CHECK_RC ( VSchemaParseText ( schema, NULL, SchemaText.c_str(), SchemaText.size() ) );
+
+    VTable *tab;
+    CHECK_RC ( VDBManagerCreateTable ( mgr, & tab, schema, "arrow_tbl", kcmInit + kcmMD5, "./data/ArrowTable" ) );
+    VCursor *curs;
+    CHECK_RC ( VTableCreateCursorWrite ( tab, & curs, kcmInsert ) ) ;
+    uint32_t idx;
+    CHECK_RC ( VCursorAddColumn ( curs, & idx, "NUM" ) );
+    CHECK_RC ( VCursorOpen ( curs ) );
+    for ( uint64_t row = 1; row <= Rows; ++row )
+    {
+        bool const empty = row == 3 || ( row >= 65530 && row <= 65537 ) || row > Rows - 5;
+        uint32_t const value = ( uint32_t ) row;
+        CHECK_RC ( VCursorOpenRow ( curs ) );
+        CHECK_RC ( VCursorWrite ( curs, idx, 32, & value, 0, empty ? 0 : 1 ) );
+        CHECK_RC ( VCursorCommitRow ( curs ) );
+        CHECK_RC ( VCursorCloseRow ( curs ) );
+    }
+    CHECK_RC ( VCursorCommit ( curs ) );
+    CHECK_RC ( VCursorRelease ( curs ) );
+    CHECK_RC ( VTableRelease ( tab ) );
+
+    CHECK_RC ( VSchemaRelease ( schema ) );
+    CHECK_RC ( VDBManagerRelease ( mgr ) );
+    return 0;
+}
+
+template < typename T >
+rc_t
+WriteCell ( VCursor* p_curs, uint32_t p_colIdx, const T* p_values, uint64_t p_count )
+{
+    return VCursorWrite ( p_curs, p_colIdx, 8 * sizeof ( T ), p_values, 0, p_count );
+}
+
+rc_t
+FormatTable()
+{   // every integer type at its limits, and text, for the cell formatters
+    const string SchemaText =
+        "table format_tbl #1.0.0\n"
+        "{\n"
+        " column I8 C_I8; column U8 C_U8;\n"
+        " column I16 C_I16; column U16 C_U16;\n"
+        " column I32 C_I32; column U32 C_U32;\n"
+        " column I64 C_I64; column U64 C_U64;\n"
+        " column ascii TXT;\n"
+        "};\n";
+
+    const int8_t   i8  [] = { -128, -1, 0, 1, 127 };
+    const uint8_t  u8  [] = { 0, 1, 255 };
+    const int16_t  i16 [] = { -32768, -10, 0, 9, 32767 };
+    const uint16_t u16 [] = { 0, 65535 };
+    const int32_t  i32 [] = { -2147483647 - 1, -100, 0, 99, 2147483647 };
+    const uint32_t u32 [] = { 0, 4294967295u };
+    const int64_t  i64 [] = { -9223372036854775807LL - 1, -1000, 0, 999, 9223372036854775807LL };
+    const uint64_t u64 [] = { 0, 18446744073709551615ULL };
+    const string   txt    = "hello, world";
+
+    const int8_t   i8_1  = -5;
+    const uint8_t  u8_1  = 10;
+    const int16_t  i16_1 = -300;
+    const uint16_t u16_1 = 1000;
+    const int32_t  i32_1 = 123456;
+    const uint32_t u32_1 = 100000;
+    const int64_t  i64_1 = -12345678901LL;
+    const uint64_t u64_1 = 10000000000ULL;
+    const string   txt_1 = "x";
+
+    VDBManager* mgr;
+    CHECK_RC ( VDBManagerMakeUpdate ( & mgr, NULL ) );
+    VSchema* schema;
+    CHECK_RC ( VDBManagerMakeSchema ( mgr, & schema ) );
+    CHECK_RC ( VSchemaParseText ( schema, NULL, SchemaText.c_str(), SchemaText.size() ) );
+
+    VTable *tab;
+    CHECK_RC ( VDBManagerCreateTable ( mgr, & tab, schema, "format_tbl", kcmInit + kcmMD5, "./data/FormatTable" ) );
+    VCursor *curs;
+    CHECK_RC ( VTableCreateCursorWrite ( tab, & curs, kcmInsert ) ) ;
+    const char * names [] = { "C_I8", "C_U8", "C_I16", "C_U16", "C_I32", "C_U32", "C_I64", "C_U64", "TXT" };
+    uint32_t idx [ 9 ];
+    for ( int i = 0; i < 9; ++i )
+        CHECK_RC ( VCursorAddColumn ( curs, & idx [ i ], names [ i ] ) );
+    CHECK_RC ( VCursorOpen ( curs ) );
+
+    // row 1: several values
+    CHECK_RC ( VCursorOpenRow ( curs ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 0 ], i8, 5 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 1 ], u8, 3 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 2 ], i16, 5 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 3 ], u16, 2 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 4 ], i32, 5 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 5 ], u32, 2 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 6 ], i64, 5 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 7 ], u64, 2 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 8 ], txt.c_str(), txt.size() ) );
+    CHECK_RC ( VCursorCommitRow ( curs ) );
+    CHECK_RC ( VCursorCloseRow ( curs ) );
+
+    // row 2: one value
+    CHECK_RC ( VCursorOpenRow ( curs ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 0 ], & i8_1, 1 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 1 ], & u8_1, 1 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 2 ], & i16_1, 1 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 3 ], & u16_1, 1 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 4 ], & i32_1, 1 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 5 ], & u32_1, 1 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 6 ], & i64_1, 1 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 7 ], & u64_1, 1 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 8 ], txt_1.c_str(), txt_1.size() ) );
+    CHECK_RC ( VCursorCommitRow ( curs ) );
+    CHECK_RC ( VCursorCloseRow ( curs ) );
+
+    // row 3: empty cells
+    CHECK_RC ( VCursorOpenRow ( curs ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 0 ], i8, 0 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 1 ], u8, 0 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 2 ], i16, 0 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 3 ], u16, 0 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 4 ], i32, 0 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 5 ], u32, 0 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 6 ], i64, 0 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 7 ], u64, 0 ) );
+    CHECK_RC ( WriteCell ( curs, idx [ 8 ], txt.c_str(), 0 ) );
+    CHECK_RC ( VCursorCommitRow ( curs ) );
+    CHECK_RC ( VCursorCloseRow ( curs ) );
+
+    CHECK_RC ( VCursorCommit ( curs ) );
+    CHECK_RC ( VCursorRelease ( curs ) );
+    CHECK_RC ( VTableRelease ( tab ) );
+
+    CHECK_RC ( VSchemaRelease ( schema ) );
+    CHECK_RC ( VDBManagerRelease ( mgr ) );
+    return 0;
+}
+
 //////////////////////////////////////////// Main
 extern "C"
 {
@@ -223,7 +367,9 @@ rc_t CC KMain ( int argc, char *argv [] )
 {
     KConfigDisableUserSettings();
 
-    return NestedDatabase();
+    CHECK_RC ( NestedDatabase() );
+    CHECK_RC ( ArrowTable() );
+    return FormatTable();
 }
 
 }
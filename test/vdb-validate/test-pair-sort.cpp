@@ -0,0 +1,167 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/**
+* tests for the sort of the key pairs of the referential-integrity checks
+*/
+
+#include <ktst/unit_test.hpp>
+
+#include <sysalloc.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "../../tools/vdb-validate/pair-sort.h"
+}
+
+using namespace std;
+
+TEST_SUITE(PairSortTestSuite);
+
+/* xorshift: the same pairs on every run */
+static uint64_t s_random = 88172645463325252ull;
+static uint64_t Random ()
+{
+    s_random ^= s_random << 13;
+    s_random ^= s_random >> 7;
+    s_random ^= s_random << 17;
+    return s_random;
+}
+
+extern "C" int CC ComparePairs ( const void * a, const void * b )
+{
+    const id_pair_t * x = ( const id_pair_t * ) a;
+    const id_pair_t * y = ( const id_pair_t * ) b;
+    if ( x -> first != y -> first )
+        return x -> first < y -> first ? -1 : 1;
+    if ( x -> second != y -> second )
+        return x -> second < y -> second ? -1 : 1;
+    return 0;
+}
+
+/* sorts the pairs with each number of threads, the result has to be the one of qsort */
+static bool SameAsQsort ( const vector < id_pair_t > & pairs )
+{
+    vector < id_pair_t > expected ( pairs );
+    if ( ! expected . empty () )
+        qsort ( & expected [ 0 ], expected . size (), sizeof ( id_pair_t ), ComparePairs );
+    for ( unsigned threads = 1; threads <= 8; threads *= 2 )
+    {
+        vector < id_pair_t > actual ( pairs );
+        if ( ! actual . empty () )
+            sort_key_pairs ( actual . size (), & actual [ 0 ], threads );
+        if ( ! actual . empty () && 
+             memcmp ( & actual [ 0 ], & expected [ 0 ], actual . size () * sizeof ( id_pair_t ) ) != 0 )
+            return false;
+    }
+    return true;
+}
+
+/* sizes around the cutoff to the insertion sort and above the one to the threads */
+static const size_t Sizes [] = { 0, 1, 2, 63, 64, 65, 1000, 100000 };
+
+TEST_CASE ( Random_Keys )
+{
+    for ( size_t s = 0; s < sizeof Sizes / sizeof Sizes [ 0 ]; ++s )
+    {
+        vector < id_pair_t > pairs ( Sizes [ s ] );
+        for ( size_t i = 0; i < pairs . size (); ++i )
+        {
+            pairs [ i ] . first = ( int64_t ) Random ();
+            pairs [ i ] . second = ( int64_t ) Random ();
+        }
+        REQUIRE ( SameAsQsort ( pairs ) );
+    }
+}
+
+TEST_CASE ( Duplicated_Keys )
+{   // a few distinct keys, negative ones too
+    for ( size_t s = 0; s < sizeof Sizes / sizeof Sizes [ 0 ]; ++s )
+    {
+        vector < id_pair_t > pairs ( Sizes [ s ] );
+        for ( size_t i = 0; i < pairs . size (); ++i )
+        {
+            pairs [ i ] . first = ( int64_t ) ( Random () % 5 ) - 2;
+            pairs [ i ] . second = ( int64_t ) ( Random () % 3 ) - 1;
+        }
+        REQUIRE ( SameAsQsort ( pairs ) );
+    }
+}
+
+TEST_CASE ( Equal_First )
+{   // only the second key differs, in the highest bits
+    vector < id_pair_t > pairs ( 100000 );
+    for ( size_t i = 0; i < pairs . size (); ++i )
+    {
+        pairs [ i ] . first = 7;
+        pairs [ i ] . second = ( int64_t ) ( Random () & 0xC000000000000001ull );
+    }
+    REQUIRE ( SameAsQsort ( pairs ) );
+}
+
+TEST_CASE ( All_Equal )
+{
+    vector < id_pair_t > pairs ( 100000 );
+    for ( size_t i = 0; i < pairs . size (); ++i )
+    {
+        pairs [ i ] . first = 42;
+        pairs [ i ] . second = -42;
+    }
+    REQUIRE ( SameAsQsort ( pairs ) );
+}
+
+//////////////////////////////////////////// Main
+extern "C"
+{
+
+#include <kapp/args.h>
+
+ver_t CC KAppVersion ( void )
+{
+    return 0x1000000;
+}
+rc_t CC UsageSummary (const char * progname)
+{
+    return 0;
+}
+
+rc_t CC Usage ( const Args * args )
+{
+    return 0;
+}
+
+const char UsageDefaultName[] = "test-pair-sort";
+
+rc_t CC KMain ( int argc, char *argv [] )
+{
+    rc_t rc=PairSortTestSuite(argc, argv);
+    return rc;
+}
+
+}
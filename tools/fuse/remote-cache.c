@@ -30,6 +30,8 @@
 #include <klib/rc.h>
 #include <klib/container.h>
 #include <klib/refcount.h>
+#include <klib/checksum.h>
+#include <klib/time.h>
 #include <kns/manager.h>
 #include <kns/http.h>
 #include <kns/stream.h>
@@ -37,9 +39,12 @@
 #include <kfs/file.h>
 #include <kfs/cacheteefile.h>
 #include <kproc/lock.h>
+#include <kproc/cond.h>
+#include <kproc/thread.h>
 #include <vfs/path.h>
 #include <vfs/manager.h>
 #include <kapp/main.h>
+#include <strtol.h>
 
 #include <os-native.h>
 
@@ -243,6 +248,7 @@ IsLocalPath ( const char * Path )
 /*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*_*/
 
 struct RCacheEntry;
+struct _LruEnt;
 
 struct _CnEnt {
     struct _CnEnt * prev;
@@ -267,6 +273,12 @@ struct RCacheEntry {
     KRefcount refcount;
     KLock * mutabor;
 
+        /*) Serializes reads of remote ( cache tee ) file, which could
+         |  not be read concurrently. Taken after mutabor, and mutabor
+         |  is released before reading from network
+         (*/
+    KLock * reading;
+
     char * Name;
     char * Url;
     char * Path;
@@ -277,8 +289,28 @@ struct RCacheEntry {
     uint64_t actual_size;
 
     const struct KFile * file;
+        /*) Read-ahead has its own connection and cache tee over same
+         |  cache file, so it does not wait for foreground reads. Opened
+         |  by read-ahead thread, guarded by mutabor, could be NULL
+         (*/
+    const struct KFile * ra_file;
 
     struct _CnEnt * cn_entry;
+
+        /*) Read-ahead access pattern tracking, guarded by mutabor
+         (*/
+    uint64_t ra_last_end;       /* where previous read stopped */
+    uint64_t ra_requested;      /* read-ahead requested up to here */
+    uint32_t ra_seq_qty;        /* sequential reads in a row */
+    uint32_t ra_window;         /* current window in blocks */
+
+        /*) Persistent cache record, guarded by mutabor, could be NULL
+         (*/
+    struct _LruEnt * lru_entry;
+        /*) Size of incomplete cache file accounted in _LruPartial,
+         |  guarded by mutabor
+         (*/
+    uint64_t lru_partial;
 };
 
 // static const size_t _sConPoolMaxQty = 1024;
@@ -596,6 +628,17 @@ static size_t _CacheEntryNo = 0;
 static uint32_t _HttpBlockSize = 0;
 static bool _DisklessMode = false;
 
+static rc_t CC _RaStart ();
+static rc_t CC _RaStop ();
+
+static rc_t CC _LruInit ();
+static rc_t CC _LruWhack ();
+static rc_t CC _LruEvict ();
+static void CC _RCacheEntryLruTouch ( struct RCacheEntry * self );
+static void CC _RCacheEntryLruForget ( struct RCacheEntry * self );
+static void CC _RCacheEntryLruPartial ( struct RCacheEntry * self );
+static void CC _RCacheEntryLruClosed ( struct RCacheEntry * self );
+
 /*))
  //  Some extremely useful methods
 ((*/
@@ -797,6 +840,47 @@ RemoteCacheSetHttpBlockSize ( uint32_t HttpBlockSize )
     return RetVal;
 }   /* RemoteCacheSetHttpBlockSize () */
 
+/*
+ *  Lyrics: This method will set maximal read-ahead window in blocks
+ *  and return previous value. Zero disables read-ahead.
+ *  Same as above, set it once before cache is created
+ */
+static uint32_t _RaMaxWindow = 32;
+
+uint32_t CC
+RemoteCacheSetReadAhead ( uint32_t MaxWindow )
+{
+    uint32_t RetVal = _RaMaxWindow;
+
+    _RaMaxWindow = MaxWindow;
+
+    return RetVal;
+}   /* RemoteCacheSetReadAhead () */
+
+/*
+ *  Lyrics: This method will set the byte budget of persistent cache
+ *  and return previous value. Zero means that cache is valid only
+ *  for a session, as it was before.
+ *  Same as above, set it once before cache is created
+ */
+static uint64_t _CacheLimit = 0;
+
+uint64_t CC
+RemoteCacheSetLimit ( uint64_t Limit )
+{
+    uint64_t RetVal = _CacheLimit;
+
+    _CacheLimit = Limit;
+
+    return RetVal;
+}   /* RemoteCacheSetLimit () */
+
+bool CC
+RemoteCacheIsPersistent ()
+{
+    return _CacheLimit != 0 && ! RemoteCacheIsDisklessMode ();
+}   /* RemoteCacheIsPersistent () */
+
 /*
  * Lyrics: Cache initialising: keeping in memory cache path 
  *         cache path could be a NULL, and in that case no cacheing
@@ -952,7 +1036,19 @@ RemoteCacheCreate ()
 
         /* Checking if CacheRoot directory exists and creating if not */
     RCt = _CheckCreateDirectory ( _PCacheRoot );
-    if ( RCt == 0 ) {
+    if ( RCt == 0 && RemoteCacheIsPersistent () ) {
+            /* Persistent cache : keeping what was validated, and
+             * dropping everything else
+             */
+        RCt = _EGetCachePath ( _PCacheRoot, Buffer, sizeof ( Buffer ) );
+        if ( RCt == 0 ) {
+            RCt = _CheckCreateDirectory ( Buffer );
+            if ( RCt == 0 ) {
+                RCt = _LruInit ();
+            }
+        }
+    }
+    else if ( RCt == 0 ) {
             /* Here we are moving old cache path
              */
         RCt = _CheckRemoveOldCacheDirectory ( _PCacheRoot );
@@ -981,6 +1077,9 @@ RemoteCacheCreate ()
 /*
 RmOutMsg ( "[KLockMake] [%p] [ %d]\n", ( void * ) _CacheLock, __LINE__ );
 */
+            if ( RCt == 0 ) {
+                RCt = _RaStart ();
+            }
         }
     }
 
@@ -1031,7 +1130,18 @@ RemoteCacheDispose ()
         return 0;
     }
 
-    RCt = _CheckRemoveOldCacheDirectory ( _CacheRoot );
+        /*) Read-ahead threads are holding references to entries
+         (*/
+    _RaStop ();
+
+    if ( RemoteCacheIsPersistent () ) {
+            /*) Storing index, and keeping content for next session
+             (*/
+        RCt = _LruWhack ();
+    }
+    else {
+        RCt = _CheckRemoveOldCacheDirectory ( _CacheRoot );
+    }
     if ( RCt == 0 ) {
         * _CacheRoot = 0;
         _PCacheRoot = NULL;
@@ -1066,8 +1176,65 @@ RmOutMsg ( "[KLockRelease] [%p] [ %d]\n", ( void * ) _CacheLock, __LINE__ );
 /*))
  //  Generates effective name and path for file
 ((*/
+/*))
+ //  Name is MD5 of Url, Size and MTime, so the same remote file will
+ \\  have the same name in the next session, and changed one will not
+((*/
+static
+rc_t CC
+_RCacheEntryHashName (
+                    const char * Url,
+                    uint64_t Size,
+                    KTime_t MTime,
+                    char * Buffer,
+                    size_t BufferSize
+)
+{
+    rc_t RCt;
+    MD5State Md5;
+    uint8_t Digest [ 16 ];
+    char Key [ 64 ];
+    size_t NumWritten, llp;
+
+    RCt = 0;
+    NumWritten = 0;
+
+    RCt = string_printf (
+                        Key,
+                        sizeof ( Key ),
+                        & NumWritten,
+                        "|%lu|%ld",
+                        Size,
+                        ( int64_t ) MTime
+                        );
+    if ( RCt == 0 ) {
+        MD5StateInit ( & Md5 );
+        MD5StateAppend ( & Md5, Url, string_size ( Url ) );
+        MD5StateAppend ( & Md5, Key, NumWritten );
+        MD5StateFinish ( & Md5, Digest );
+
+        for ( llp = 0; RCt == 0 && llp < sizeof ( Digest ); llp ++ ) {
+            RCt = string_printf (
+                                Buffer + llp * 2,
+                                BufferSize - llp * 2,
+                                & NumWritten,
+                                "%02x",
+                                Digest [ llp ]
+                                );
+        }
+    }
+
+    return RCt;
+}   /* _RCacheEntryHashName () */
+
 rc_t CC
-_RCacheEntryGenerateNameAndPath ( char ** Name, char ** Path )
+_RCacheEntryGenerateNameAndPath (
+                            const char * Url,
+                            uint64_t Size,
+                            KTime_t MTime,
+                            char ** Name,
+                            char ** Path
+)
 {
     rc_t RCt;
     char Buffer [ 4096 ];
@@ -1090,13 +1257,13 @@ _RCacheEntryGenerateNameAndPath ( char ** Name, char ** Path )
         return RC ( rcExe, rcFile, rcInitializing, rcParam, rcNull );
     }
 
-    RCt = string_printf (
-                        Buffer,
-                        sizeof ( Buffer ),
-                        & NumWritten,
-                        "etwas.%d",
-                        _CacheEntryNo + 1
-                        );
+    RCt = _RCacheEntryHashName (
+                            Url,
+                            Size,
+                            MTime,
+                            Buffer,
+                            sizeof ( Buffer )
+                            );
     if ( RCt == 0 ) {
         TheName = string_dup_measure ( Buffer, NULL );
         if ( TheName == NULL ) {
@@ -1157,6 +1324,10 @@ RmOutMsg ( "++++++DL DESTROY [0x%p] entry\n", self );
         _CnPoolDrop ( self );
         _CnEntDispose ( self );
 
+            /*) Persistent cache record stays, but not entry
+             (*/
+        _RCacheEntryLruForget ( self );
+
         /*)) Reverse order. I suppose it will be destoryed only
          //  in particualr cases, so no locking :|
         ((*/
@@ -1168,6 +1339,10 @@ KOutMsg ( "[GGU] [DestroyEnty] [%s]\n", self -> Name );
 */
             ReleaseComplain ( KFileRelease, self -> file );
             self -> file = 0;
+        }
+        if ( self -> ra_file != NULL ) {
+            ReleaseComplain ( KFileRelease, self -> ra_file );
+            self -> ra_file = NULL;
         }
             /*) Url
              (*/
@@ -1195,6 +1370,12 @@ RmOutMsg ( "[KLockRelease] [%p] [ %d]\n", ( void * ) self -> mutabor, __LINE__ )
 */
             ReleaseComplain ( KLockRelease, self -> mutabor );
             self -> mutabor = NULL;
+        }
+            /*) reading
+             (*/
+        if ( self -> reading != NULL ) {
+            ReleaseComplain ( KLockRelease, self -> reading );
+            self -> reading = NULL;
         }
             /*) refcount 
              (*/
@@ -1216,6 +1397,8 @@ RmOutMsg ( "[KLockRelease] [%p] [ %d]\n", ( void * ) self -> mutabor, __LINE__ )
 rc_t CC
 _RCacheEntryMake (
             const char * Url,
+            uint64_t Size,
+            KTime_t MTime,
             struct RCacheEntry ** RetEntry
 )
 {
@@ -1249,6 +1432,9 @@ _RCacheEntryMake (
                 /*)  It is better do it here, before any allocation
                  (*/
             RCt = _RCacheEntryGenerateNameAndPath (
+                                                Url,
+                                                Size,
+                                                MTime,
                                                 & ( Entry -> Name ),
                                                 & ( Entry -> Path )
                                                 );
@@ -1270,6 +1456,11 @@ _RCacheEntryMake (
 /*
 RmOutMsg ( "[KLockMake] [%p] [ %d]\n", ( void * ) Entry -> mutabor, __LINE__ );
 */
+            if ( RCt == 0 ) {
+                    /*) reading
+                     (*/
+                RCt = KLockMake ( & ( Entry -> reading ) );
+            }
     
             if ( RCt == 0 ) {
                     /*) Url
@@ -1354,6 +1545,8 @@ _RcNoDeCmP ( const BSTNode * node1, const BSTNode * node2 )
 rc_t CC
 RemoteCacheFindOrCreateEntry (
                             const char * Url,
+                            uint64_t Size,
+                            KTime_t MTime,
                             struct RCacheEntry ** Entry
 )
 {
@@ -1371,7 +1564,7 @@ RemoteCacheFindOrCreateEntry (
         /*)  Diskless mode
          (*/
     if ( RemoteCacheIsDisklessMode () ) {
-        RCt = _RCacheEntryMake ( Url, & RetEntry );
+        RCt = _RCacheEntryMake ( Url, Size, MTime, & RetEntry );
         if ( RCt == 0 ) {
 /*
 RmOutMsg ( "++++++DL CREATE [0x%p][%s] entry\n", RetEntry, Url );
@@ -1399,7 +1592,7 @@ RmOutMsg ( "[KLockAcquire] [%p] [ %d]\n", ( void * ) _CacheLock, __LINE__ );
 RmOutMsg ( "++++++ %s entry\n", RetEntry == NULL ? "Creating" : "Loading" );
 */
         if ( RetEntry == NULL ) {
-            RCt = _RCacheEntryMake ( Url, & RetEntry );
+            RCt = _RCacheEntryMake ( Url, Size, MTime, & RetEntry );
             if ( RCt == 0 ) {
                 RCt = BSTreeInsert (
                                 & _Cache,
@@ -1481,6 +1674,13 @@ RmOutMsg ( "|||<-- Releasing [%s][%s]\n", self -> Name, self -> Url );
 */
         ReleaseComplain ( KFileRelease, self -> file );
         self -> file = NULL;
+
+        _RCacheEntryLruClosed ( self );
+    }
+
+    if ( self -> ra_file != NULL ) {
+        ReleaseComplain ( KFileRelease, self -> ra_file );
+        self -> ra_file = NULL;
     }
 
     return 0;
@@ -1553,150 +1753,1014 @@ RmOutMsg ( "[KLockUnlock] [%p] [ %d]\n", ( void * ) self -> mutabor, __LINE__ );
     return RCt;
 }   /* RCacheEntryRelease () */
 
+/*)))
+ ///  Persistent cache
+(((*/
+/* Lyrics:
+ * If cache limit is set, complete cache files are kept between
+ * sessions. The index file in cache directory keeps name, size and
+ * time of last access of each complete file, most recently used
+ * first. Name of file is derived from Url, size and timestamp of
+ * remote file, so changed remote file will be downloaded again, and
+ * stale one will be evicted eventually. Index is rewritten each time
+ * file is completed or evicted, so it survives crash. On start files
+ * which are not in index ( incomplete downloads ) or have wrong size
+ * are removed. Incomplete files of current session are accounted with
+ * size of remote file, and files are evicted in least recently used
+ * order once the sum of sizes of complete and incomplete files exceeds
+ * limit. Eviction runs only when that sum could grow, or when file
+ * which was kept because it was open is closed. Files which are open
+ * are never evicted.
+ */
+struct _LruEnt {
+    struct _LruEnt * prev;
+    struct _LruEnt * next;
+
+    char * Name;
+    uint64_t size;
+    KTime_t atime;
+
+        /*) not referenced, NULL if not used in that session
+         (*/
+    struct RCacheEntry * entry;
+
+        /*) file is being removed, entry is out of LRU list and in
+         |  _LruEvicting list, it's next pointer links that list
+         (*/
+    bool evicting;
+};
+
+static const char * _sLruIndexName = "lru.index";
+
+static struct KLock * _LruLock = NULL;
+static struct _LruEnt * _LruHead = NULL;
+static struct _LruEnt * _LruTail = NULL;
+static size_t _LruQty = 0;
+static uint64_t _LruUsed = 0;
+static uint64_t _LruPartial = 0;
+    /*) There is something to evict, guarded by _LruLock
+     (*/
+static bool _LruChanged = false;
+    /*) Files which are being removed, and condition signaled each
+     |  time one is removed or put back, guarded by _LruLock
+     (*/
+static struct _LruEnt * _LruEvicting = NULL;
+static struct KCondition * _LruEvictCond = NULL;
+
+static
 rc_t CC
-_RCacheEntryOpenFileReadRemote ( struct RCacheEntry * self )
+_LruEntMake (
+            const char * Name,
+            uint64_t Size,
+            KTime_t ATime,
+            struct _LruEnt ** RetEnt
+)
 {
-    rc_t RCt;
-    struct KDirectory * Directory;
-    const struct KFile * HttpFile, * TeeFile;
+    struct _LruEnt * Ent = NULL;
 
-    RCt = 0;
-    Directory = NULL;
-    HttpFile = TeeFile = NULL;
+    * RetEnt = NULL;
 
-    if ( self == NULL ) {
-        return RC ( rcExe, rcFile, rcOpening, rcParam, rcNull );
+    Ent = calloc ( 1, sizeof ( struct _LruEnt ) );
+    if ( Ent == NULL ) {
+        return RC ( rcExe, rcData, rcAllocating, rcMemory, rcExhausted );
     }
 
-/*
-KOutMsg ( "[GGU] [OpenReadRemote] [%s]\n", self -> Name );
-*/
-
-    if ( ( ! RemoteCacheIsDisklessMode () ) && self -> Path == NULL ) {
-        return RC ( rcExe, rcFile, rcOpening, rcParam, rcNull );
+    Ent -> Name = string_dup_measure ( Name, NULL );
+    if ( Ent -> Name == NULL ) {
+        free ( Ent );
+        return RC ( rcExe, rcData, rcAllocating, rcMemory, rcExhausted );
     }
 
-/*
-RmOutMsg ( "|||<-- Opening [R] [%s][%s]\n", self -> Name, self -> Url );
-RmOutMsg ( "  |<-- Cache Entry [%s]\n", self -> Path );
-*/
+    Ent -> size = Size;
+    Ent -> atime = ATime;
 
-    RCt = KNSManagerMakeHttpFile (
-                                _ManagerOfKNS,
-                                & HttpFile,
-                                NULL, /* no open connections */
-                                0x01010000,
-                                "%s",
-                                self -> Url
-                                );
-    if ( RCt == 0 ) {
-        if ( RemoteCacheIsDisklessMode () ) {
-            self -> file = ( KFile * ) HttpFile;
-        }
-        else {
-            RCt = KDirectoryNativeDir ( & Directory );
-            if ( RCt == 0 ) {
-                RCt = KDirectoryMakeCacheTeePromote (
-                                    Directory,
-                                    & TeeFile,
-                                    HttpFile,
-                                    _HttpBlockSize, /* blocksize */
-                                    self -> Path
-                                    );
-                if ( RCt == 0 ) {
-                    self -> file = ( KFile * ) TeeFile;
+    * RetEnt = Ent;
 
-                        /*  We should create connection entry for pool
-                         */
-                    RCt = _CnEntMake ( self );
-                }
+    return 0;
+}   /* _LruEntMake () */
 
-                ReleaseComplain ( KDirectoryRelease, Directory );
-            }
-            ReleaseComplain ( KFileRelease, HttpFile );
+static
+void CC
+_LruEntDispose ( struct _LruEnt * Ent )
+{
+    if ( Ent != NULL ) {
+        if ( Ent -> Name != NULL ) {
+            free ( Ent -> Name );
+            Ent -> Name = NULL;
         }
-    }
 
-    if ( RCt != 0 ) {
-        if ( self -> file != NULL ) {
-            ReleaseComplain ( KFileRelease, self -> file );
-            self -> file = NULL;
-        }
+        Ent -> entry = NULL;
+        Ent -> prev = Ent -> next = NULL;
 
-        _CnEntDispose ( self );
+        free ( Ent );
     }
+}   /* _LruEntDispose () */
 
-    if ( RCt == 0 ) {
-        if ( self -> actual_size == 0 ) {
-            RCt = KFileSize ( self -> file, & ( self -> actual_size ) );
-        }
+static
+void CC
+_LruDrop_NoLock ( struct _LruEnt * Ent )
+{
+    if ( Ent -> prev != NULL ) {
+        Ent -> prev -> next = Ent -> next;
+    }
+    else {
+        _LruHead = Ent -> next;
     }
 
-    return RCt;
-}   /* _RCacneEntryOpenFileReadRemote () */
+    if ( Ent -> next != NULL ) {
+        Ent -> next -> prev = Ent -> prev;
+    }
+    else {
+        _LruTail = Ent -> prev;
+    }
 
-rc_t CC
-_RCacheEntryOpenFileReadLocal ( struct RCacheEntry * self )
+    Ent -> prev = Ent -> next = NULL;
+
+    _LruQty --;
+    _LruUsed -= Ent -> size;
+}   /* _LruDrop_NoLock () */
+
+static
+void CC
+_LruToFront_NoLock ( struct _LruEnt * Ent )
 {
-    rc_t RCt;
-    const struct KFile * File;
-    struct KDirectory * Directory;
+    Ent -> prev = NULL;
+    Ent -> next = _LruHead;
+    if ( _LruHead != NULL ) {
+        _LruHead -> prev = Ent;
+    }
+    else {
+        _LruTail = Ent;
+    }
+    _LruHead = Ent;
 
-    RCt = 0;
-    File = NULL;
-    Directory = NULL;
+    _LruQty ++;
+    _LruUsed += Ent -> size;
+}   /* _LruToFront_NoLock () */
 
-    if ( self == NULL ) {
-        return RC ( rcExe, rcFile, rcOpening, rcParam, rcNull );
+static
+void CC
+_LruToBack_NoLock ( struct _LruEnt * Ent )
+{
+    Ent -> next = NULL;
+    Ent -> prev = _LruTail;
+    if ( _LruTail != NULL ) {
+        _LruTail -> next = Ent;
+    }
+    else {
+        _LruHead = Ent;
     }
+    _LruTail = Ent;
 
-    if ( self -> Path == NULL ) {
-        return RC ( rcExe, rcFile, rcOpening, rcParam, rcNull );
+    _LruQty ++;
+    _LruUsed += Ent -> size;
+}   /* _LruToBack_NoLock () */
+
+static
+struct _LruEnt * CC
+_LruFind_NoLock ( const char * Name )
+{
+    struct _LruEnt * Ent = _LruHead;
+
+    while ( Ent != NULL ) {
+        if ( strcmp ( Ent -> Name, Name ) == 0 ) {
+            break;
+        }
+        Ent = Ent -> next;
     }
 
-/*
-KOutMsg ( "[GGU] [OpenReadLocal] [%s]\n", self -> Name );
-*/
-/*
-RmOutMsg ( "|||<-- Opening [L] [%s][%s]\n", self -> Name, self -> Url );
-RmOutMsg ( "  |<-- Cache Entry [%s]\n", self -> Path );
-*/
+    return Ent;
+}   /* _LruFind_NoLock () */
 
-    RCt = KDirectoryNativeDir ( & Directory );
-    if ( RCt == 0 ) {
-        RCt = KDirectoryOpenFileRead ( Directory, & File, self -> Path );
-        if ( RCt == 0 ) {
-            self -> file = File;
+static
+void CC
+_LruEvictingAdd_NoLock ( struct _LruEnt * Ent )
+{
+    Ent -> evicting = true;
+    Ent -> prev = NULL;
+    Ent -> next = _LruEvicting;
+    _LruEvicting = Ent;
+}   /* _LruEvictingAdd_NoLock () */
+
+static
+void CC
+_LruEvictingDrop_NoLock ( struct _LruEnt * Ent )
+{
+    struct _LruEnt ** Link = & _LruEvicting;
+
+    while ( * Link != NULL ) {
+        if ( * Link == Ent ) {
+            * Link = Ent -> next;
+            break;
         }
+        Link = & ( ( * Link ) -> next );
+    }
 
-        ReleaseComplain ( KDirectoryRelease, Directory );
+    Ent -> evicting = false;
+    Ent -> prev = Ent -> next = NULL;
+
+    if ( _LruEvictCond != NULL ) {
+        KConditionBroadcast ( _LruEvictCond );
     }
+}   /* _LruEvictingDrop_NoLock () */
 
-    if ( RCt == 0 ) {
-        if ( self -> actual_size == 0 ) {
-            RCt = KFileSize ( self -> file, & ( self -> actual_size ) );
+static
+struct _LruEnt * CC
+_LruEvictingFind_NoLock ( const char * Name )
+{
+    struct _LruEnt * Ent = _LruEvicting;
+
+    while ( Ent != NULL ) {
+        if ( strcmp ( Ent -> Name, Name ) == 0 ) {
+            break;
         }
+        Ent = Ent -> next;
     }
 
-    return RCt;
-}   /* _RCacneEntryOpenFileReadLocal () */
+    return Ent;
+}   /* _LruEvictingFind_NoLock () */
 
+static
 rc_t CC
-_RCacheEntryGetAndCheckFile (
-                        struct RCacheEntry * self,
-                        const struct KFile ** File,
-                        bool * Synchronized
-)
+_LruIndexPath ( char * Buffer, size_t BufferSize )
 {
     rc_t RCt;
-    struct KDirectory * NatDir;
-    bool OpenLocal;
-    bool OpenRemote;
-    bool CloseFile;
-    bool IsComplete;
+    char CachePath [ 4096 ];
+    size_t NumWrit;
 
-    RCt = 0;
-    NatDir = NULL;
+    RCt = _GetCachePath ( CachePath, sizeof ( CachePath ) );
+    if ( RCt == 0 ) {
+        RCt = string_printf (
+                            Buffer,
+                            BufferSize,
+                            & NumWrit,
+                            "%s/%s",
+                            CachePath,
+                            _sLruIndexName
+                            );
+    }
+
+    return RCt;
+}   /* _LruIndexPath () */
+
+/*))
+ //  Index is a text file, one line per complete cache file :
+ \\      name size atime
+ //  most recently used first
+((*/
+static
+rc_t CC
+_LruLoad ( struct KDirectory * NativeDir, const char * CachePath )
+{
+    rc_t RCt;
+    char Path [ 4096 ];
+    char * Buf, * Line, * End, * Next;
+    uint64_t BufSize, Size, RealSize;
+    int64_t ATime;
+    struct _LruEnt * Ent;
+
+    RCt = 0;
+    Buf = NULL;
+    BufSize = 0;
+
+    RCt = _LruIndexPath ( Path, sizeof ( Path ) );
+    if ( RCt != 0 ) {
+        return RCt;
+    }
+
+    if ( KDirectoryPathType ( NativeDir, Path ) != kptFile ) {
+            /*) No index : nothing to load
+             (*/
+        return 0;
+    }
+
+    RCt = ReadLocalFileToMemory ( Path, & Buf, & BufSize );
+    if ( RCt != 0 ) {
+            /*) Broken or empty index : cold start
+             (*/
+        return 0;
+    }
+
+    for ( Line = Buf; RCt == 0 && Line < Buf + BufSize; Line = Next ) {
+        End = strchr ( Line, '\n' );
+        Next = End == NULL ? Buf + BufSize : End + 1;
+        if ( End != NULL ) {
+            * End = 0;
+        }
+
+        End = strchr ( Line, ' ' );
+        if ( End == NULL ) {
+            continue;
+        }
+        * End = 0;
+
+        Size = strtou64 ( End + 1, & End, 10 );
+        ATime = strtoi64 ( End, NULL, 10 );
+
+            /*) File should exist and be complete
+             (*/
+        RealSize = 0;
+        if ( KDirectoryFileSize (
+                            NativeDir,
+                            & RealSize,
+                            "%s/%s",
+                            CachePath,
+                            Line
+                            ) != 0
+            || RealSize != Size
+        ) {
+            continue;
+        }
+
+        if ( _LruFind_NoLock ( Line ) != NULL ) {
+            continue;
+        }
+
+        RCt = _LruEntMake ( Line, Size, ( KTime_t ) ATime, & Ent );
+        if ( RCt == 0 ) {
+            _LruToBack_NoLock ( Ent );
+        }
+    }
+
+    free ( Buf );
+
+    return RCt;
+}   /* _LruLoad () */
+
+/*))
+ //  Should be called with _LruLock held. Index is written aside and
+ \\  renamed, so broken index will never replace good one
+((*/
+static
+rc_t CC
+_LruSave_NoLock ()
+{
+    rc_t RCt;
+    struct KDirectory * NativeDir;
+    struct KFile * File;
+    struct _LruEnt * Ent;
+    char Path [ 4096 ];
+    char TmpPath [ 4096 ];
+    char Line [ 256 ];
+    size_t NumWrit;
+    uint64_t Pos;
+
+    RCt = 0;
+    NativeDir = NULL;
+    File = NULL;
+    Pos = 0;
+
+    RCt = _LruIndexPath ( Path, sizeof ( Path ) );
+    if ( RCt == 0 ) {
+        RCt = string_printf (
+                            TmpPath,
+                            sizeof ( TmpPath ),
+                            & NumWrit,
+                            "%s.tmp",
+                            Path
+                            );
+    }
+    if ( RCt == 0 ) {
+        RCt = KDirectoryNativeDir ( & NativeDir );
+        if ( RCt == 0 ) {
+            RCt = KDirectoryCreateFile (
+                                    NativeDir,
+                                    & File,
+                                    false,
+                                    0664,
+                                    kcmInit,
+                                    TmpPath
+                                    );
+            if ( RCt == 0 ) {
+                for ( Ent = _LruHead; RCt == 0 && Ent != NULL; Ent = Ent -> next ) {
+                    RCt = string_printf (
+                                        Line,
+                                        sizeof ( Line ),
+                                        & NumWrit,
+                                        "%s %lu %ld\n",
+                                        Ent -> Name,
+                                        Ent -> size,
+                                        ( int64_t ) Ent -> atime
+                                        );
+                    if ( RCt == 0 ) {
+                        RCt = KFileWriteAll (
+                                            File,
+                                            Pos,
+                                            Line,
+                                            NumWrit,
+                                            & NumWrit
+                                            );
+                        Pos += NumWrit;
+                    }
+                }
+
+                ReleaseComplain ( KFileRelease, File );
+
+                if ( RCt == 0 ) {
+                    RCt = KDirectoryRename (
+                                            NativeDir,
+                                            true,
+                                            TmpPath,
+                                            Path
+                                            );
+                }
+            }
+
+            ReleaseComplain ( KDirectoryRelease, NativeDir );
+        }
+    }
+
+    if ( RCt != 0 ) {
+        LOGERR ( klogErr, RCt, "[RemoteCache] can not store cache index" );
+    }
+
+    return RCt;
+}   /* _LruSave_NoLock () */
+
+/*))
+ //  Removes from cache directory everything what is not in index
+((*/
+static
+rc_t CC
+_LruCleanVisitor (
+                const struct KDirectory * Dir,
+                uint32_t Type,
+                const char * Name,
+                void * Data
+)
+{
+    if ( strcmp ( Name, _sLruIndexName ) == 0 ) {
+        return 0;
+    }
+
+    if ( Type == kptFile && _LruFind_NoLock ( Name ) != NULL ) {
+        return 0;
+    }
+
+    RmOutMsg ( "Removing stale cache file '%s'\n", Name );
+    KDirectoryRemove ( ( struct KDirectory * ) Dir, true, "%s/%s", ( const char * ) Data, Name );
+
+    return 0;
+}   /* _LruCleanVisitor () */
+
+rc_t CC
+_LruInit ()
+{
+    rc_t RCt;
+    struct KDirectory * NativeDir;
+    char CachePath [ 4096 ];
+
+    RCt = 0;
+    NativeDir = NULL;
+
+    _LruHead = _LruTail = NULL;
+    _LruQty = 0;
+    _LruUsed = 0;
+    _LruPartial = 0;
+    _LruChanged = true;
+
+    RCt = _GetCachePath ( CachePath, sizeof ( CachePath ) );
+    if ( RCt == 0 ) {
+        RCt = KLockMake ( & _LruLock );
+        if ( RCt == 0 ) {
+            RCt = KConditionMake ( & _LruEvictCond );
+        }
+        if ( RCt == 0 ) {
+            RCt = KDirectoryNativeDir ( & NativeDir );
+            if ( RCt == 0 ) {
+                RCt = _LruLoad ( NativeDir, CachePath );
+                if ( RCt == 0 ) {
+                    RCt = KDirectoryVisit (
+                                        NativeDir,
+                                        false,
+                                        _LruCleanVisitor,
+                                        CachePath,
+                                        "%s",
+                                        CachePath
+                                        );
+                }
+
+                ReleaseComplain ( KDirectoryRelease, NativeDir );
+            }
+        }
+    }
+
+    if ( RCt == 0 ) {
+        PLOGMSG ( klogInfo, ( klogInfo, "[RemoteCache] $(q) cached files, $(s) bytes", PLOG_2(PLOG_U64(q),PLOG_U64(s)), ( uint64_t ) _LruQty, _LruUsed ) );
+
+        RCt = _LruEvict ();
+    }
+
+    return RCt;
+}   /* _LruInit () */
+
+rc_t CC
+_LruWhack ()
+{
+    rc_t RCt;
+    struct _LruEnt * Ent;
+
+    RCt = 0;
+
+    if ( _LruLock == NULL ) {
+        return 0;
+    }
+
+    RCt = _LruSave_NoLock ();
+
+    while ( _LruHead != NULL ) {
+        Ent = _LruHead;
+        _LruDrop_NoLock ( Ent );
+        if ( Ent -> entry != NULL ) {
+            Ent -> entry -> lru_entry = NULL;
+        }
+        _LruEntDispose ( Ent );
+    }
+
+    if ( _LruEvictCond != NULL ) {
+        ReleaseComplain ( KConditionRelease, _LruEvictCond );
+        _LruEvictCond = NULL;
+    }
+
+    ReleaseComplain ( KLockRelease, _LruLock );
+    _LruLock = NULL;
+
+    return RCt;
+}   /* _LruWhack () */
+
+/*))
+ //  Entry is complete and it is open locally. Entry should be locked
+ \\  by caller, order of locks : entry, then _LruLock
+((*/
+void CC
+_RCacheEntryLruTouch ( struct RCacheEntry * self )
+{
+    struct _LruEnt * Ent;
+    bool Completed;
+
+    if ( _LruLock == NULL || self -> Name == NULL ) {
+        return;
+    }
+
+    if ( KLockAcquire ( _LruLock ) == 0 ) {
+        Completed = false;
+
+        Ent = self -> lru_entry;
+        if ( Ent != NULL && Ent -> evicting ) {
+                /*) Evictor will see that file is open and put it back
+                 (*/
+            Ent -> atime = KTimeStamp ();
+            _LruPartial -= self -> lru_partial;
+            self -> lru_partial = 0;
+
+            KLockUnlock ( _LruLock );
+            return;
+        }
+        if ( Ent == NULL ) {
+            Ent = _LruFind_NoLock ( self -> Name );
+            if ( Ent == NULL ) {
+                    /*) Just completed
+                     (*/
+                if ( _LruEntMake (
+                                self -> Name,
+                                self -> actual_size,
+                                0,
+                                & Ent
+                                ) != 0 ) {
+                    Ent = NULL;
+                }
+                Completed = Ent != NULL;
+            }
+            else {
+                _LruDrop_NoLock ( Ent );
+            }
+        }
+        else {
+            _LruDrop_NoLock ( Ent );
+        }
+
+            /*) Not partial anymore
+             (*/
+        _LruPartial -= self -> lru_partial;
+        self -> lru_partial = 0;
+
+        if ( Ent != NULL ) {
+            Ent -> atime = KTimeStamp ();
+            Ent -> entry = self;
+            self -> lru_entry = Ent;
+            _LruToFront_NoLock ( Ent );
+        }
+
+        if ( Completed ) {
+            _LruChanged = true;
+            _LruSave_NoLock ();
+        }
+
+        KLockUnlock ( _LruLock );
+    }
+}   /* _RCacheEntryLruTouch () */
+
+void CC
+_RCacheEntryLruForget ( struct RCacheEntry * self )
+{
+    if ( _LruLock == NULL ) {
+        return;
+    }
+
+    if ( self -> lru_entry == NULL && self -> lru_partial == 0 ) {
+        return;
+    }
+
+    if ( KLockAcquire ( _LruLock ) == 0 ) {
+        if ( self -> lru_entry != NULL ) {
+            self -> lru_entry -> entry = NULL;
+            self -> lru_entry = NULL;
+        }
+
+        _LruPartial -= self -> lru_partial;
+        self -> lru_partial = 0;
+
+        KLockUnlock ( _LruLock );
+    }
+}   /* _RCacheEntryLruForget () */
+
+/*))
+ //  Waits while cache file with the same name is being removed.
+ //  If that file belongs to that entry, evictor locks entry itself,
+ \\  so there is nothing to wait for. Entry should be locked by caller
+((*/
+void CC
+_RCacheEntryLruWaitEvicted ( struct RCacheEntry * self )
+{
+    struct _LruEnt * Ent;
+
+    if ( _LruLock == NULL || _LruEvictCond == NULL || self -> Name == NULL ) {
+        return;
+    }
+
+    if ( KLockAcquire ( _LruLock ) == 0 ) {
+        while ( true ) {
+            Ent = _LruEvictingFind_NoLock ( self -> Name );
+            if ( Ent == NULL || Ent -> entry == self ) {
+                break;
+            }
+
+            if ( KConditionWait ( _LruEvictCond, _LruLock ) != 0 ) {
+                break;
+            }
+        }
+
+        KLockUnlock ( _LruLock );
+    }
+}   /* _RCacheEntryLruWaitEvicted () */
+
+/*))
+ //  Incomplete cache file is opened, it will take size of remote file
+ \\  Entry should be locked by caller
+((*/
+void CC
+_RCacheEntryLruPartial ( struct RCacheEntry * self )
+{
+    if ( _LruLock == NULL || self -> lru_partial != 0 ) {
+        return;
+    }
+
+    if ( KLockAcquire ( _LruLock ) == 0 ) {
+        self -> lru_partial = self -> actual_size;
+        _LruPartial += self -> lru_partial;
+        _LruChanged = true;
+
+        KLockUnlock ( _LruLock );
+    }
+}   /* _RCacheEntryLruPartial () */
+
+/*))
+ //  Complete file is closed, and could be evicted now.
+ \\  Entry should be locked by caller
+((*/
+void CC
+_RCacheEntryLruClosed ( struct RCacheEntry * self )
+{
+    if ( _LruLock == NULL || self -> lru_entry == NULL ) {
+        return;
+    }
+
+    if ( KLockAcquire ( _LruLock ) == 0 ) {
+        if ( _CacheLimit < _LruUsed + _LruPartial ) {
+            _LruChanged = true;
+        }
+
+        KLockUnlock ( _LruLock );
+    }
+}   /* _RCacheEntryLruClosed () */
+
+/*))
+ //  Evicts least recently used files until cache fits into limit.
+ \\  Does nothing if nothing changed since last time.
+ //  Should be called without any locks held
+((*/
+rc_t CC
+_LruEvict ()
+{
+    rc_t RCt;
+    struct _LruEnt * Ent;
+    struct RCacheEntry * Entry;
+    struct KDirectory * NativeDir;
+    char CachePath [ 4096 ];
+    size_t Attempts;
+    size_t Evicted;
+    bool InUse;
+    bool Locked;
+
+    RCt = 0;
+    NativeDir = NULL;
+    Attempts = 0;
+    Evicted = 0;
+
+    if ( _LruLock == NULL ) {
+        return 0;
+    }
+
+    RCt = KLockAcquire ( _LruLock );
+    if ( RCt != 0 ) {
+        return RCt;
+    }
+    if ( _LruChanged ) {
+        _LruChanged = false;
+
+            /*) Each file could be checked once : they could all be in use
+             (*/
+        Attempts = _LruQty;
+    }
+    KLockUnlock ( _LruLock );
+
+    if ( Attempts == 0 ) {
+        return 0;
+    }
+
+    RCt = _GetCachePath ( CachePath, sizeof ( CachePath ) );
+    if ( RCt != 0 ) {
+        return RCt;
+    }
+
+    for ( ; 0 < Attempts; Attempts -- ) {
+        Ent = NULL;
+        Entry = NULL;
+
+            /*) Entry is taken while list is locked : it could be
+             |  forgotten and destroyed as soon as lock is released
+             (*/
+        RCt = KLockAcquire ( _LruLock );
+        if ( RCt != 0 ) {
+            break;
+        }
+        if ( _CacheLimit < _LruUsed + _LruPartial && _LruTail != NULL ) {
+            Ent = _LruTail;
+            _LruDrop_NoLock ( Ent );
+            _LruEvictingAdd_NoLock ( Ent );
+
+            Entry = Ent -> entry;
+            if ( Entry != NULL && RCacheEntryAddRef ( Entry ) != 0 ) {
+                Entry = NULL;
+            }
+        }
+        KLockUnlock ( _LruLock );
+
+        if ( Ent == NULL ) {
+            break;
+        }
+
+            /*) Entry stays locked until file is removed, so it could
+             |  not be opened and written meanwhile. Others wait for
+             |  Ent to leave _LruEvicting list
+             (*/
+        InUse = false;
+        Locked = false;
+        if ( Entry != NULL ) {
+            if ( KLockAcquire ( Entry -> mutabor ) == 0 ) {
+                Locked = true;
+                if ( Entry -> file != NULL ) {
+                    InUse = true;
+                }
+                else {
+                    Entry -> is_complete = false;
+                    Entry -> is_local = false;
+                }
+            }
+            else {
+                InUse = true;
+            }
+        }
+
+        if ( ! InUse ) {
+            RmOutMsg ( "Evicting cache file '%s' ( %lu bytes )\n", Ent -> Name, Ent -> size );
+
+            if ( KDirectoryNativeDir ( & NativeDir ) == 0 ) {
+                KDirectoryRemove (
+                                NativeDir,
+                                true,
+                                "%s/%s",
+                                CachePath,
+                                Ent -> Name
+                                );
+                ReleaseComplain ( KDirectoryRelease, NativeDir );
+            }
+        }
+
+        if ( KLockAcquire ( _LruLock ) == 0 ) {
+            _LruEvictingDrop_NoLock ( Ent );
+            if ( InUse ) {
+                    /*) Will be retried when file is closed
+                     (*/
+                _LruToFront_NoLock ( Ent );
+                Ent = NULL;
+            }
+            else if ( Entry != NULL && Entry -> lru_entry == Ent ) {
+                Entry -> lru_entry = NULL;
+            }
+            KLockUnlock ( _LruLock );
+        }
+        else {
+                /*) Could not take it out of _LruEvicting list
+                 (*/
+            Ent = NULL;
+        }
+
+        if ( Locked ) {
+            KLockUnlock ( Entry -> mutabor );
+        }
+
+        if ( Entry != NULL ) {
+            RCacheEntryRelease ( Entry );
+        }
+
+        if ( Ent == NULL ) {
+            continue;
+        }
+
+        _LruEntDispose ( Ent );
+
+        Evicted ++;
+    }
+
+    if ( Evicted != 0 ) {
+        if ( KLockAcquire ( _LruLock ) == 0 ) {
+            _LruSave_NoLock ();
+            KLockUnlock ( _LruLock );
+        }
+    }
+
+    return RCt;
+}   /* _LruEvict () */
+
+rc_t CC
+_RCacheEntryOpenFileReadRemote ( struct RCacheEntry * self )
+{
+    rc_t RCt;
+    struct KDirectory * Directory;
+    const struct KFile * HttpFile, * TeeFile;
+
+    RCt = 0;
+    Directory = NULL;
+    HttpFile = TeeFile = NULL;
+
+    if ( self == NULL ) {
+        return RC ( rcExe, rcFile, rcOpening, rcParam, rcNull );
+    }
+
+/*
+KOutMsg ( "[GGU] [OpenReadRemote] [%s]\n", self -> Name );
+*/
+
+    if ( ( ! RemoteCacheIsDisklessMode () ) && self -> Path == NULL ) {
+        return RC ( rcExe, rcFile, rcOpening, rcParam, rcNull );
+    }
+
+/*
+RmOutMsg ( "|||<-- Opening [R] [%s][%s]\n", self -> Name, self -> Url );
+RmOutMsg ( "  |<-- Cache Entry [%s]\n", self -> Path );
+*/
+
+    RCt = KNSManagerMakeHttpFile (
+                                _ManagerOfKNS,
+                                & HttpFile,
+                                NULL, /* no open connections */
+                                0x01010000,
+                                "%s",
+                                self -> Url
+                                );
+    if ( RCt == 0 ) {
+        if ( RemoteCacheIsDisklessMode () ) {
+            self -> file = ( KFile * ) HttpFile;
+        }
+        else {
+            RCt = KDirectoryNativeDir ( & Directory );
+            if ( RCt == 0 ) {
+                RCt = KDirectoryMakeCacheTeePromote (
+                                    Directory,
+                                    & TeeFile,
+                                    HttpFile,
+                                    _HttpBlockSize, /* blocksize */
+                                    self -> Path
+                                    );
+                if ( RCt == 0 ) {
+                    self -> file = ( KFile * ) TeeFile;
+
+                        /*  We should create connection entry for pool
+                         */
+                    RCt = _CnEntMake ( self );
+                }
+
+                ReleaseComplain ( KDirectoryRelease, Directory );
+            }
+            ReleaseComplain ( KFileRelease, HttpFile );
+        }
+    }
+
+    if ( RCt != 0 ) {
+        if ( self -> file != NULL ) {
+            ReleaseComplain ( KFileRelease, self -> file );
+            self -> file = NULL;
+        }
+
+        _CnEntDispose ( self );
+    }
+
+    if ( RCt == 0 ) {
+        if ( self -> actual_size == 0 ) {
+            RCt = KFileSize ( self -> file, & ( self -> actual_size ) );
+        }
+    }
+
+    if ( RCt == 0 && ! RemoteCacheIsDisklessMode () ) {
+        _RCacheEntryLruPartial ( self );
+    }
+
+    return RCt;
+}   /* _RCacneEntryOpenFileReadRemote () */
+
+rc_t CC
+_RCacheEntryOpenFileReadLocal ( struct RCacheEntry * self )
+{
+    rc_t RCt;
+    const struct KFile * File;
+    struct KDirectory * Directory;
+
+    RCt = 0;
+    File = NULL;
+    Directory = NULL;
+
+    if ( self == NULL ) {
+        return RC ( rcExe, rcFile, rcOpening, rcParam, rcNull );
+    }
+
+    if ( self -> Path == NULL ) {
+        return RC ( rcExe, rcFile, rcOpening, rcParam, rcNull );
+    }
+
+/*
+KOutMsg ( "[GGU] [OpenReadLocal] [%s]\n", self -> Name );
+*/
+/*
+RmOutMsg ( "|||<-- Opening [L] [%s][%s]\n", self -> Name, self -> Url );
+RmOutMsg ( "  |<-- Cache Entry [%s]\n", self -> Path );
+*/
+
+    RCt = KDirectoryNativeDir ( & Directory );
+    if ( RCt == 0 ) {
+        RCt = KDirectoryOpenFileRead ( Directory, & File, self -> Path );
+        if ( RCt == 0 ) {
+            self -> file = File;
+        }
+
+        ReleaseComplain ( KDirectoryRelease, Directory );
+    }
+
+    if ( RCt == 0 ) {
+        if ( self -> actual_size == 0 ) {
+            RCt = KFileSize ( self -> file, & ( self -> actual_size ) );
+        }
+    }
+
+    return RCt;
+}   /* _RCacneEntryOpenFileReadLocal () */
+
+rc_t CC
+_RCacheEntryGetAndCheckFile (
+                        struct RCacheEntry * self,
+                        const struct KFile ** File,
+                        bool * Synchronized
+)
+{
+    rc_t RCt;
+    struct KDirectory * NatDir;
+    bool OpenLocal;
+    bool OpenRemote;
+    bool CloseFile;
+    bool IsComplete;
+
+    RCt = 0;
+    NatDir = NULL;
     OpenLocal = false;
     OpenRemote = false;
     CloseFile = false;
@@ -1756,6 +2820,10 @@ _RCacheEntryGetAndCheckFile (
         /*) Normal mode
          (*/
     if ( self -> file == NULL ) {
+            /*) File could be in the middle of eviction
+             (*/
+        _RCacheEntryLruWaitEvicted ( self );
+
             /* Checking if it is known that file complete */
         if ( self -> is_complete ) {
             OpenLocal = true;
@@ -1822,6 +2890,9 @@ RmOutMsg ( "|||<-- Close file [%s][%s] [A=%d]\n", self -> Name, self -> Path, RC
 
 
             RCt = _RCacheEntryOpenFileReadLocal ( self );
+            if ( RCt == 0 ) {
+                _RCacheEntryLruTouch ( self );
+            }
 /*
 RmOutMsg ( "|||<-- Open LOCAL file [%s][%s] [A=%d]\n", self -> Name, self -> Path, RCt );
 */
@@ -1889,45 +2960,48 @@ _RCacheEntryDoRead (
         */
     }
 
-        /*)  Here we are locking
+        /*)  Here we are locking. The file could be closed, reopened
+         |   or replaced only while both mutabor and reading are held.
+         |   Remote file is read holding only reading, so tracking
+         |   does not wait for network
          (*/
 /*
 RmOutMsg ( "[KLockAcquire] [%p] [ %d]\n", ( void * ) self -> mutabor, __LINE__ );
 */
     RCt = KLockAcquire ( self -> mutabor );
     if ( RCt == 0 ) {
-        RCt = _RCacheEntryGetAndCheckFile (
-                                        self,
-                                        & File,
-                                        & Synchronized
-                                        );
+        RCt = KLockAcquire ( self -> reading );
         if ( RCt == 0 ) {
-            if ( ! Synchronized ) {
+            RCt = _RCacheEntryGetAndCheckFile (
+                                            self,
+                                            & File,
+                                            & Synchronized
+                                            );
+            if ( RCt == 0 ) {
+                RCt = KFileAddRef ( File );
+            }
+            if ( RCt != 0 || ! Synchronized ) {
                     /*) do not need synchronisation to read local file
                      (*/
+                KLockUnlock ( self -> reading );
+            }
+        }
+
 /*
 RmOutMsg ( "[KLockUnlock] [%p] [ %d]\n", ( void * ) self -> mutabor, __LINE__ );
 */
-                KLockUnlock ( self -> mutabor );
-            }
+        KLockUnlock ( self -> mutabor );
 
-            RCt = KFileRead (
-                            self -> file,
-                            Offset,
-                            Buffer,
-                            SizeToRead,
-                            NumReaded
-                            );
+        if ( RCt == 0 ) {
+            RCt = KFileRead ( File, Offset, Buffer, SizeToRead, NumReaded );
 /*
 RmOutMsg ( "|||<-- Reading [%s][%s] [O=%d][S=%d][R=%d][A=%d]\n", self -> Name, self -> Url, Offset, SizeToRead, * NumReaded, RCt );
 */
-        }
+            if ( Synchronized ) {
+                KLockUnlock ( self -> reading );
+            }
 
-        if ( Synchronized ) {
-/*
-RmOutMsg ( "[KLockUnlock] [%p] [ %d]\n", ( void * ) self -> mutabor, __LINE__ );
-*/
-            KLockUnlock ( self -> mutabor );
+            ReleaseComplain ( KFileRelease, File );
         }
     }
 
@@ -1946,6 +3020,479 @@ RmOutMsg ( "|||<- Failed to read file [%s][%s] at attempt [+1]\n", self -> Name,
     return RCt;
 }   /* _RCacheEntryDoRead () */
 
+/*)))
+ ///  Read-ahead
+(((*/
+/* Lyrics:
+ * Tools reading a mounted file sequentially pay full HTTP latency on
+ * every cache miss. So for each entry we are tracking where previous
+ * read stopped, and after _sRaTrigger sequential reads in a row we
+ * are asking background threads to read next blocks through their
+ * own cache tee file, which stores them in cache. Window starts from
+ * _sRaMinWindow blocks and doubles each time reader gets closer than
+ * half of window to the end of requested area, up to _RaMaxWindow.
+ * Any non sequential read resets window. There is no read-ahead in
+ * diskless mode or for complete ( local ) entries.
+ */
+#define _RA_THREAD_QTY 4
+
+struct _RaJob {
+    struct _RaJob * next;
+
+    struct RCacheEntry * entry;
+    uint64_t offset;
+    size_t size;
+};
+
+static const uint32_t _sRaTrigger = 2;
+static const uint32_t _sRaMinWindow = 2;
+static const size_t _sRaMaxQueueQty = 1024;
+static const size_t _sRaDefaultBlockSize = 128 * 1024;
+
+static struct KLock * _RaLock = NULL;
+static struct KCondition * _RaCond = NULL;
+static struct KThread * _RaThreads [ _RA_THREAD_QTY ];
+static struct _RaJob * _RaHead = NULL;
+static struct _RaJob * _RaTail = NULL;
+static size_t _RaQty = 0;
+static bool _RaQuit = false;
+
+static
+size_t CC
+_RaBlockSize ()
+{
+    return _HttpBlockSize == 0 ? _sRaDefaultBlockSize : _HttpBlockSize;
+}   /* _RaBlockSize () */
+
+static
+void CC
+_RaJobDispose ( struct _RaJob * Job )
+{
+    if ( Job != NULL ) {
+        if ( Job -> entry != NULL ) {
+            RCacheEntryRelease ( Job -> entry );
+            Job -> entry = NULL;
+        }
+
+        free ( Job );
+    }
+}   /* _RaJobDispose () */
+
+/*))
+ //  Block at Offset was not read ahead : moving requested boundary
+ \\  back, so it will be requested again. Entry is locked here
+((*/
+static
+void CC
+_RaGiveBack ( struct RCacheEntry * Entry, uint64_t Offset )
+{
+    if ( KLockAcquire ( Entry -> mutabor ) == 0 ) {
+        if ( Offset < Entry -> ra_requested ) {
+            Entry -> ra_requested = Offset;
+        }
+        KLockUnlock ( Entry -> mutabor );
+    }
+}   /* _RaGiveBack () */
+
+/*))
+ //  Entry should be locked by caller, _RaLock is locked here
+((*/
+static
+rc_t CC
+_RaJobAdd ( struct RCacheEntry * Entry, uint64_t Offset, size_t Size )
+{
+    rc_t RCt;
+    struct _RaJob * Job;
+
+    RCt = 0;
+    Job = NULL;
+
+    if ( _RaLock == NULL ) {
+        return RC ( rcExe, rcQueue, rcInserting, rcSelf, rcNull );
+    }
+
+    Job = calloc ( 1, sizeof ( struct _RaJob ) );
+    if ( Job == NULL ) {
+        return RC ( rcExe, rcQueue, rcInserting, rcMemory, rcExhausted );
+    }
+
+    RCt = RCacheEntryAddRef ( Entry );
+    if ( RCt == 0 ) {
+        Job -> entry = Entry;
+        Job -> offset = Offset;
+        Job -> size = Size;
+
+        RCt = KLockAcquire ( _RaLock );
+        if ( RCt == 0 ) {
+            if ( _RaQuit || _sRaMaxQueueQty <= _RaQty ) {
+                    /*) Too busy : that is just a hint, dropping it
+                     (*/
+                RCt = RC ( rcExe, rcQueue, rcInserting, rcQueue, rcExhausted );
+            }
+            else {
+                if ( _RaTail == NULL ) {
+                    _RaHead = Job;
+                }
+                else {
+                    _RaTail -> next = Job;
+                }
+                _RaTail = Job;
+                _RaQty ++;
+
+                KConditionSignal ( _RaCond );
+            }
+
+            KLockUnlock ( _RaLock );
+        }
+    }
+
+    if ( RCt != 0 ) {
+        _RaJobDispose ( Job );
+    }
+
+    return RCt;
+}   /* _RaJobAdd () */
+
+/*))
+ //  Opens connection and cache tee for read-ahead. It is not promoting
+ //  cache file when it is complete : that is foreground business. Called
+ \\  without locks, because it could talk to network
+((*/
+static
+rc_t CC
+_RaOpenFile ( struct RCacheEntry * Entry, const struct KFile ** File )
+{
+    rc_t RCt;
+    struct KDirectory * Directory;
+    const struct KFile * HttpFile;
+
+    RCt = 0;
+    Directory = NULL;
+    HttpFile = NULL;
+
+    * File = NULL;
+
+    RCt = KNSManagerMakeHttpFile (
+                                _ManagerOfKNS,
+                                & HttpFile,
+                                NULL, /* no open connections */
+                                0x01010000,
+                                "%s",
+                                Entry -> Url
+                                );
+    if ( RCt == 0 ) {
+        RCt = KDirectoryNativeDir ( & Directory );
+        if ( RCt == 0 ) {
+            RCt = KDirectoryMakeCacheTee (
+                                    Directory,
+                                    File,
+                                    HttpFile,
+                                    _HttpBlockSize, /* blocksize */
+                                    Entry -> Path
+                                    );
+
+            ReleaseComplain ( KDirectoryRelease, Directory );
+        }
+
+        ReleaseComplain ( KFileRelease, HttpFile );
+    }
+
+    return RCt;
+}   /* _RaOpenFile () */
+
+/*))
+ //  Read-ahead has its own read path : it reads through its own cache
+ //  tee file, so it does not wait for foreground reads and foreground
+ //  does not wait for it. It does not retry, and never drops or
+ //  disposes entry on failure : that is foreground business. Block
+ //  which was not read is given back, so it will be requested again
+ \\  next time reader passes by
+((*/
+static
+void CC
+_RaJobDo ( struct _RaJob * Job, char * Buffer )
+{
+    rc_t RCt;
+    struct RCacheEntry * Entry;
+    const struct KFile * File, * NewFile;
+    bool Wanted;
+    size_t NumRead;
+
+    RCt = 0;
+    Entry = Job -> entry;
+    File = NewFile = NULL;
+    Wanted = false;
+    NumRead = 0;
+
+        /*) If file was closed, or became local, nobody needs that
+         (*/
+    if ( KLockAcquire ( Entry -> mutabor ) == 0 ) {
+        Wanted = Entry -> file != NULL && ! Entry -> is_local;
+        if ( Wanted && Entry -> ra_file != NULL ) {
+            if ( KFileAddRef ( Entry -> ra_file ) == 0 ) {
+                File = Entry -> ra_file;
+            }
+        }
+        KLockUnlock ( Entry -> mutabor );
+    }
+
+    if ( Wanted && File == NULL ) {
+        RCt = _RaOpenFile ( Entry, & NewFile );
+        if ( RCt == 0 ) {
+            if ( KLockAcquire ( Entry -> mutabor ) == 0 ) {
+                    /*) Somebody could be faster, or entry could be
+                     |  closed while we were opening
+                     (*/
+                if ( Entry -> file != NULL && ! Entry -> is_local ) {
+                    if ( Entry -> ra_file == NULL ) {
+                        Entry -> ra_file = NewFile;
+                        NewFile = NULL;
+                    }
+                    if ( KFileAddRef ( Entry -> ra_file ) == 0 ) {
+                        File = Entry -> ra_file;
+                    }
+                }
+                KLockUnlock ( Entry -> mutabor );
+            }
+
+            if ( NewFile != NULL ) {
+                ReleaseComplain ( KFileRelease, NewFile );
+            }
+        }
+    }
+
+    if ( File != NULL ) {
+            /*) Reading through cache tee file puts block into cache
+             (*/
+        RCt = KFileRead (
+                        File,
+                        Job -> offset,
+                        Buffer,
+                        Job -> size,
+                        & NumRead
+                        );
+
+        ReleaseComplain ( KFileRelease, File );
+    }
+
+    if ( Wanted && ( File == NULL || RCt != 0 ) ) {
+        _RaGiveBack ( Entry, Job -> offset );
+    }
+}   /* _RaJobDo () */
+
+static
+rc_t CC
+_RaThread ( const KThread * self, void * Data )
+{
+    rc_t RCt;
+    struct _RaJob * Job;
+    char * Buffer;
+
+    RCt = 0;
+    Job = NULL;
+
+    Buffer = malloc ( _RaBlockSize () );
+    if ( Buffer == NULL ) {
+        return RC ( rcExe, rcThread, rcExecuting, rcMemory, rcExhausted );
+    }
+
+    while ( true ) {
+        Job = NULL;
+
+        RCt = KLockAcquire ( _RaLock );
+        if ( RCt != 0 ) {
+            break;
+        }
+
+        while ( ! _RaQuit && _RaHead == NULL ) {
+            KConditionWait ( _RaCond, _RaLock );
+        }
+
+        if ( ! _RaQuit ) {
+            Job = _RaHead;
+            _RaHead = Job -> next;
+            if ( _RaHead == NULL ) {
+                _RaTail = NULL;
+            }
+            _RaQty --;
+        }
+
+        KLockUnlock ( _RaLock );
+
+        if ( Job == NULL ) {
+            break;
+        }
+
+        _RaJobDo ( Job, Buffer );
+        _RaJobDispose ( Job );
+    }
+
+    free ( Buffer );
+
+    return RCt;
+}   /* _RaThread () */
+
+static
+rc_t CC
+_RaStart ()
+{
+    rc_t RCt;
+    size_t llp;
+
+    RCt = 0;
+
+    _RaQuit = false;
+    _RaHead = _RaTail = NULL;
+    _RaQty = 0;
+    memset ( _RaThreads, 0, sizeof ( _RaThreads ) );
+
+    if ( _RaMaxWindow == 0 ) {
+        LOGMSG( klogInfo, "[RemoteCache] read-ahead disabled\n" );
+        return 0;
+    }
+
+    RCt = KLockMake ( & _RaLock );
+    if ( RCt == 0 ) {
+        RCt = KConditionMake ( & _RaCond );
+        for ( llp = 0; RCt == 0 && llp < _RA_THREAD_QTY; llp ++ ) {
+            RCt = KThreadMake ( & ( _RaThreads [ llp ] ), _RaThread, NULL );
+        }
+    }
+
+    if ( RCt != 0 ) {
+        LOGERR ( klogErr, RCt, "[RemoteCache] can not start read-ahead" );
+        _RaStop ();
+    }
+
+    return RCt;
+}   /* _RaStart () */
+
+static
+rc_t CC
+_RaStop ()
+{
+    size_t llp;
+    rc_t Status;
+    struct _RaJob * Job;
+
+    if ( _RaLock == NULL ) {
+        return 0;
+    }
+
+    if ( KLockAcquire ( _RaLock ) == 0 ) {
+        _RaQuit = true;
+        if ( _RaCond != NULL ) {
+            KConditionBroadcast ( _RaCond );
+        }
+        KLockUnlock ( _RaLock );
+    }
+
+    for ( llp = 0; llp < _RA_THREAD_QTY; llp ++ ) {
+        if ( _RaThreads [ llp ] != NULL ) {
+            KThreadWait ( _RaThreads [ llp ], & Status );
+            ReleaseComplain ( KThreadRelease, _RaThreads [ llp ] );
+            _RaThreads [ llp ] = NULL;
+        }
+    }
+
+        /*) Dropping leftovers
+         (*/
+    while ( _RaHead != NULL ) {
+        Job = _RaHead;
+        _RaHead = Job -> next;
+        _RaJobDispose ( Job );
+    }
+    _RaTail = NULL;
+    _RaQty = 0;
+
+    if ( _RaCond != NULL ) {
+        ReleaseComplain ( KConditionRelease, _RaCond );
+        _RaCond = NULL;
+    }
+
+    ReleaseComplain ( KLockRelease, _RaLock );
+    _RaLock = NULL;
+
+    return 0;
+}   /* _RaStop () */
+
+/*))
+ //  Called after each successful read. Tracks access pattern and
+ \\  requests read-ahead for sequential readers
+((*/
+static
+void CC
+_RCacheEntryTrackRead (
+                    struct RCacheEntry * self,
+                    uint64_t Offset,
+                    size_t NumRead
+)
+{
+    uint64_t BlockSize, From, To;
+
+    if ( RemoteCacheIsDisklessMode () || _RaLock == NULL ) {
+        return;
+    }
+
+    if ( KLockAcquire ( self -> mutabor ) != 0 ) {
+        return;
+    }
+
+    if ( Offset == self -> ra_last_end ) {
+        self -> ra_seq_qty ++;
+    }
+    else {
+        self -> ra_seq_qty = 0;
+        self -> ra_window = 0;
+        self -> ra_requested = 0;
+    }
+    self -> ra_last_end = Offset + NumRead;
+
+    if ( ! self -> is_local && _sRaTrigger <= self -> ra_seq_qty ) {
+        BlockSize = _RaBlockSize ();
+
+        if ( self -> ra_window == 0 ) {
+            self -> ra_window = _sRaMinWindow;
+        }
+        else {
+            if ( self -> ra_requested
+                    < self -> ra_last_end
+                        + ( self -> ra_window * BlockSize ) / 2 ) {
+                    /*) Reader is catching up : growing window
+                     (*/
+                self -> ra_window *= 2;
+            }
+        }
+        if ( _RaMaxWindow < self -> ra_window ) {
+            self -> ra_window = _RaMaxWindow;
+        }
+
+        From = self -> ra_requested < self -> ra_last_end
+                                ? self -> ra_last_end
+                                : self -> ra_requested
+                                ;
+        From = ( From / BlockSize ) * BlockSize;
+        To = self -> ra_last_end + self -> ra_window * BlockSize;
+        if ( self -> actual_size < To ) {
+            To = self -> actual_size;
+        }
+
+        while ( From < To ) {
+            if ( _RaJobAdd (
+                        self,
+                        From,
+                        To - From < BlockSize ? To - From : BlockSize
+                        ) != 0 ) {
+                break;
+            }
+            From += BlockSize;
+            self -> ra_requested = From < To ? From : To;
+        }
+    }
+
+    KLockUnlock ( self -> mutabor );
+}   /* _RCacheEntryTrackRead () */
+
 rc_t CC
 RCacheEntryRead (
             struct RCacheEntry * self,
@@ -1998,6 +3545,12 @@ PLOGMSG ( klogErr, ( klogErr, "|||<- Failed to read file $(n)$(u) after $(l) att
         if ( ActualSize != NULL ) {
             * ActualSize = self -> actual_size;
         }
+
+        _RCacheEntryTrackRead ( self, Offset, * NumReaded );
+
+            /*) No locks are held here, right place to free space
+             (*/
+        _LruEvict ();
     }
 
     return RCt;
@@ -26,6 +26,8 @@
 #ifndef _h_remote_cache_fuser_
 #define _h_remote_cache_fuser_
 
+#include <klib/time.h>
+
 /*
  * Lyrics ... because quite exotic requirements of remote file access
  * which means that we are accessing only files which will be described
@@ -40,6 +42,9 @@
  *      while fuser is working. That means that each time when fuser
  *      started, it removes all cached files, if those left from
  *      previous session.
+ *      UPDATE: if cache limit is set, complete files are kept between
+ *      sessions, and least recently used are removed once limit is
+ *      exceeded.
  *   5) There could be two types of files: plain files and XML
  *      documents, which represents filesystem node. Files are stored
  *      in cache directory, and XML documents are loaded and interpreted
@@ -76,6 +81,9 @@ bool CC IsLocalPath ( const char * Path );
  * session is dropped. 
  * For a moment we do beleive that we do have only one cache directory
  * per session, which could be initialized only once
+ * UPDATE: if cache limit is set, cache is persistent: complete files
+ *         are kept between sessions and evicted in least recently used
+ *         order. Partial downloads are dropped, as before.
  * UPDATE: from now we allow non-cacheing or diskless mode. In that case
  *         fuzer will not create any additional files or directories and
  *         will not use cachetee file, but direct HTTP connection 
@@ -105,6 +113,20 @@ rc_t CC RCacheEntryRead (
     ((*/
 uint32_t CC RemoteCacheSetHttpBlockSize ( uint32_t HttpBlockSize );
 
+    /*))
+     //  This method will set maximal read-ahead window in blocks
+     \\  for sequential readers. 0 disables read-ahead. Will return
+     //  previous value
+    ((*/
+uint32_t CC RemoteCacheSetReadAhead ( uint32_t MaxWindow );
+
+    /*))
+     //  This method will set limit of persistent cache in bytes.
+     \\  0 means that cache is dropped after session. Will return
+     //  previous value
+    ((*/
+uint64_t CC RemoteCacheSetLimit ( uint64_t Limit );
+
     /*))
      //  This method will set path for local cache dir
      \\
@@ -114,7 +136,8 @@ rc_t CC RemoteCacheInitialize ( const char * CachePath );
     /*))
      //  This method will initialize local cache dir:
      \\    It will create cache directory if it does not exist
-     //    It will remove all leftovers from previous session
+     //    It will remove all leftovers from previous session, or
+     \\    only incomplete ones for persistent cache
     ((*/
 rc_t CC RemoteCacheCreate ();
     /*))
@@ -129,8 +152,15 @@ const char * RemoteCachePath ();
 
 bool RemoteCacheIsDisklessMode ();
 
+bool CC RemoteCacheIsPersistent ();
+
+    /*))
+     //  Size and MTime are identifying version of remote file
+    ((*/
 rc_t CC RemoteCacheFindOrCreateEntry (
                         const char * Url,
+                        uint64_t Size,
+                        KTime_t MTime,
                         struct RCacheEntry ** Entry
                     );
 
@@ -86,7 +86,7 @@ rc_t RemoteFileNode_Open(
         rc = RC(rcExe, rcFile, rcOpening, rcDirEntry, rcNotFound);
     } else {
         struct RCacheEntry * ke = NULL;
-        if ( ( rc = RemoteCacheFindOrCreateEntry( cself->path, &ke )) == 0 ) {
+        if ( ( rc = RemoteCacheFindOrCreateEntry( cself->path, cself->file_sz, cself->mtime, &ke )) == 0 ) {
             if( rc == 0 ) {
                 if ( ( rc = RemoteFileAccessor_Make(
                                                 accessor,
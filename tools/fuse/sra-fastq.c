@@ -25,6 +25,7 @@
 #include <klib/rc.h>
 #include <kfs/file.h>
 #include <kproc/lock.h>
+#include <kproc/rwlock.h>
 #include <kdb/table.h>
 #include <kdb/index.h>
 
@@ -44,31 +45,55 @@ typedef struct SRAFastqFile SRAFastqFile;
 #define KFILE_IMPL SRAFastqFile
 #include <kfs/impl.h>
 
+/* number of decoded chunks kept per file */
+#define SRAFASTQ_SLOTS 8
+
+/* one decoded chunk, regenerated under its own exclusive lock
+   and copied out under shared lock, so readers of different chunks
+   do not wait for each other */
+typedef struct SRAFastqSlot {
+    KRWLock* lock;
+    const FastqReader* reader;
+    /* current buf content */
+    uint64_t from;
+    uint64_t size;
+    char* buf;
+    char* gzipped; /* serves as flag and a buffer */
+    /* guarded by file lock */
+    uint64_t used;
+    bool loading;
+} SRAFastqSlot;
+
 struct SRAFastqFile {
     KFile dad;
     uint32_t buffer_sz;
     uint64_t file_sz;
-    char* gzipped; /* serves as flag and a buffer */
+    bool gzip;
+    /* guards slot assignment only */
     KLock* lock;
+    uint64_t clock;
     const SRATable* stbl;
     const KTable* ktbl;
     const KIndex* kidx;
-    const FastqReader* reader;
-    /* current buf content */
-    uint64_t from;
-    uint64_t size;
-    char* buf;
+    FileOptions opt;
+    SRAFastqSlot slot[SRAFASTQ_SLOTS];
 };
 
 static
 rc_t SRAFastqFile_Destroy(SRAFastqFile *self)
 {
     if( KLockAcquire(self->lock) == 0 ) {
-        ReleaseComplain(FastqReaderWhack, self->reader);
+        uint32_t i;
+        for(i = 0; i < SRAFASTQ_SLOTS; i++) {
+            SRAFastqSlot* s = &self->slot[i];
+            ReleaseComplain(FastqReaderWhack, s->reader);
+            ReleaseComplain(KRWLockRelease, s->lock);
+            /* buffers are swapped by gzip, free the one allocated */
+            FREE(s->gzipped != NULL && s->gzipped < s->buf ? s->gzipped : s->buf);
+        }
         ReleaseComplain(KIndexRelease, self->kidx);
         ReleaseComplain(KTableRelease, self->ktbl);
         ReleaseComplain(SRATableRelease, self->stbl);
-        FREE(self->buf < self->gzipped ? self->buf : self->gzipped);
         ReleaseComplain(KLockUnlock, self->lock);
         ReleaseComplain(KLockRelease, self->lock);
         FREE(self);
@@ -108,60 +133,188 @@ rc_t SRAFastqFile_SetSize(SRAFastqFile *self, uint64_t size)
     return RC(rcExe, rcFile, rcUpdating, rcInterface, rcUnsupported);
 }
 
+/* called with slot locked exclusively, size is returned and set
+   under file lock, because it is a part of lookup key */
 static
-rc_t SRAFastqFile_Read(const SRAFastqFile* self, uint64_t pos, void *buffer, size_t size, size_t *num_read)
+rc_t SRAFastqSlot_Fill(const SRAFastqFile* self, SRAFastqSlot* s, int64_t id, uint64_t id_qty, uint64_t* size)
 {
     rc_t rc = 0;
+    const FileOptions* opt = &self->opt;
 
-    if( pos >= self->file_sz ) {
-        *num_read = 0;
-    } else if( (rc = KLockAcquire(self->lock)) == 0 ) {
+    if( s->buf == NULL ) {
+        MALLOC(s->buf, self->buffer_sz * (self->gzip ? 2 : 1));
+        if( s->buf == NULL ) {
+            return RC(rcExe, rcFile, rcReading, rcMemory, rcExhausted);
+        }
+        if( self->gzip ) {
+            s->gzipped = &s->buf[self->buffer_sz];
+        }
+    }
+    if( s->reader == NULL ) {
+        rc = FastqReaderMake(&s->reader, self->stbl,
+                             opt->f.fastq.accession, opt->f.fastq.colorSpace,
+                             opt->f.fastq.origFormat, false, opt->f.fastq.printLabel,
+                             opt->f.fastq.printReadId, !opt->f.fastq.clipQuality, false,
+                             opt->f.fastq.minReadLen, opt->f.fastq.qualityOffset,
+                             opt->f.fastq.colorSpaceKey,
+                             opt->f.fastq.minSpotId, opt->f.fastq.maxSpotId);
+    }
+    if( rc == 0 && (rc = FastqReaderSeekSpot(s->reader, id)) == 0 ) {
+        size_t inbuf = 0, w = 0;
+        char* b = s->buf;
+        uint64_t left = self->buffer_sz;
         do {
-            if( pos < self->from || pos >= (self->from + self->size) ) {
-                int64_t id = 0;
-                uint64_t id_qty = 0;
-                DEBUG_MSG(10, ("Caching for pos %lu %lu bytes\n", pos, size - *num_read));
-                if( (rc = KIndexFindU64(self->kidx, pos, &((SRAFastqFile*)self)->from, &((SRAFastqFile*)self)->size, &id, &id_qty)) == 0 ) {
-                    DEBUG_MSG(10, ("Caching from %lu:%lu, %lu bytes\n", self->from, self->from + self->size - 1, self->size));
-                    DEBUG_MSG(10, ("Caching spot %ld, %lu spots\n", id, id_qty));
-                    if( (rc = FastqReaderSeekSpot(self->reader, id)) == 0 ) {
-                        size_t inbuf = 0, w = 0;
-                        char* b = self->buf;
-                        uint64_t left = self->buffer_sz;
-                        do {
-                            if( (rc = FastqReader_GetCurrentSpotSplitData(self->reader, b, left, &w)) != 0 ) {
-                                break;
-                            }
-                            b += w; left -= w; inbuf += w; --id_qty;
-                        } while( id_qty > 0 && (rc = FastqReaderNextSpot(self->reader)) == 0);
-                        if( GetRCObject(rc) == rcRow && GetRCState(rc) == rcExhausted ) {
-                            DEBUG_MSG(10, ("No more rows\n"));
-                            rc = 0;
-                        }
-                        DEBUG_MSG(8, ("Cached %u bytes\n", inbuf));
-                        if( self->gzipped != NULL ) {
-                            size_t compressed = 0;
-                            if( (rc = ZLib_DeflateBlock(self->buf, inbuf, self->gzipped, self->buffer_sz, &compressed)) == 0 ) {
-                                char* b = self->buf;
-                                ((SRAFastqFile*)self)->buf = self->gzipped;
-                                ((SRAFastqFile*)self)->gzipped = b;
-                                ((SRAFastqFile*)self)->size = compressed;
-                                DEBUG_MSG(10, ("gzipped %lu bytes\n", self->size));
-                            }
-                        }
+            if( (rc = FastqReader_GetCurrentSpotSplitData(s->reader, b, left, &w)) != 0 ) {
+                break;
+            }
+            b += w; left -= w; inbuf += w; --id_qty;
+        } while( id_qty > 0 && (rc = FastqReaderNextSpot(s->reader)) == 0);
+        if( GetRCObject(rc) == rcRow && GetRCState(rc) == rcExhausted ) {
+            DEBUG_MSG(10, ("No more rows\n"));
+            rc = 0;
+        }
+        DEBUG_MSG(8, ("Cached %u bytes\n", inbuf));
+        if( rc == 0 && s->gzipped != NULL ) {
+            size_t compressed = 0;
+            if( (rc = ZLib_DeflateBlock(s->buf, inbuf, s->gzipped, self->buffer_sz, &compressed)) == 0 ) {
+                char* b = s->buf;
+                s->buf = s->gzipped;
+                s->gzipped = b;
+                inbuf = compressed;
+                DEBUG_MSG(10, ("gzipped %lu bytes\n", inbuf));
+            }
+        }
+        if( rc == 0 ) {
+            *size = inbuf;
+        }
+    }
+    return rc;
+}
+
+/* called with file lock held, returns slot holding pos or NULL */
+static
+SRAFastqSlot* SRAFastqFile_FindSlot(SRAFastqFile* self, uint64_t pos)
+{
+    uint32_t i;
+    for(i = 0; i < SRAFASTQ_SLOTS; i++) {
+        SRAFastqSlot* s = &self->slot[i];
+        if( pos >= s->from && pos < s->from + s->size ) {
+            s->used = ++self->clock;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+/* returns slot with pos locked shared, filling it if needed */
+static
+rc_t SRAFastqFile_AcquireSlot(const SRAFastqFile* cself, uint64_t pos, SRAFastqSlot** slot)
+{
+    rc_t rc = 0;
+    SRAFastqFile* self = (SRAFastqFile*)cself;
+
+    while( rc == 0 ) {
+        SRAFastqSlot* s = NULL;
+        uint64_t from = 0, size = 0, id_qty = 0;
+        int64_t id = 0;
+        uint32_t i;
+
+        if( (rc = KLockAcquire(self->lock)) != 0 ) {
+            break;
+        }
+        s = SRAFastqFile_FindSlot(self, pos);
+        ReleaseComplain(KLockUnlock, self->lock);
+
+        if( s == NULL ) {
+            /* index lookup is read only, done outside of lock */
+            DEBUG_MSG(10, ("Caching for pos %lu\n", pos));
+            if( (rc = KIndexFindU64(self->kidx, pos, &from, &size, &id, &id_qty)) != 0 ) {
+                break;
+            }
+            DEBUG_MSG(10, ("Caching from %lu:%lu, %lu bytes\n", from, from + size - 1, size));
+            DEBUG_MSG(10, ("Caching spot %ld, %lu spots\n", id, id_qty));
+            if( (rc = KLockAcquire(self->lock)) != 0 ) {
+                break;
+            }
+            /* someone could fill it meanwhile */
+            s = SRAFastqFile_FindSlot(self, pos);
+            if( s == NULL ) {
+                for(i = 0; i < SRAFASTQ_SLOTS; i++) {
+                    SRAFastqSlot* c = &self->slot[i];
+                    if( !c->loading && (s == NULL || c->used < s->used) ) {
+                        s = c;
+                    }
+                }
+                if( s == NULL ) {
+                    /* all slots are being filled, wait for one and retry */
+                    s = &self->slot[self->clock % SRAFASTQ_SLOTS];
+                    ReleaseComplain(KLockUnlock, self->lock);
+                    if( (rc = KRWLockAcquireShared(s->lock)) == 0 ) {
+                        ReleaseComplain(KRWLockUnlock, s->lock);
+                    }
+                    continue;
+                }
+                if( s->lock == NULL ) {
+                    rc = KRWLockMake(&s->lock);
+                }
+                /* readers of old content are done when this returns;
+                   new readers will see new key and wait for content */
+                if( rc == 0 && (rc = KRWLockAcquireExcl(s->lock)) == 0 ) {
+                    s->from = from;
+                    s->size = size;
+                    s->used = ++self->clock;
+                    s->loading = true;
+                }
+                ReleaseComplain(KLockUnlock, self->lock);
+                if( rc != 0 ) {
+                    break;
+                }
+                rc = SRAFastqSlot_Fill(self, s, id, id_qty, &size);
+                if( KLockAcquire(self->lock) == 0 ) {
+                    if( rc == 0 ) {
+                        s->size = size;
+                    } else {
+                        s->from = ~0;
+                        s->size = 0;
                     }
+                    s->loading = false;
+                    ReleaseComplain(KLockUnlock, self->lock);
                 }
+                ReleaseComplain(KRWLockUnlock, s->lock);
+                /* look it up again, shared */
+                continue;
             }
-            if( rc == 0 ) {
-                off_t from = pos - self->from;
-                size_t q = (self->size - from) > (size - *num_read) ? (size - *num_read) : (self->size - from);
-                DEBUG_MSG(10, ("Copying from %lu %u bytes\n", from, q));
-                memmove(&((char*)buffer)[*num_read], &self->buf[from], q);
-                *num_read = *num_read + q;
-                pos += q;
+            ReleaseComplain(KLockUnlock, self->lock);
+        }
+        if( (rc = KRWLockAcquireShared(s->lock)) == 0 ) {
+            if( pos >= s->from && pos < s->from + s->size ) {
+                *slot = s;
+                return 0;
             }
-        } while( rc == 0 && *num_read < size && pos < self->file_sz );
-        ReleaseComplain(KLockUnlock, self->lock);
+            /* slot was taken over before we got there */
+            ReleaseComplain(KRWLockUnlock, s->lock);
+        }
+    }
+    return rc;
+}
+
+static
+rc_t SRAFastqFile_Read(const SRAFastqFile* self, uint64_t pos, void *buffer, size_t size, size_t *num_read)
+{
+    rc_t rc = 0;
+
+    *num_read = 0;
+    while( rc == 0 && *num_read < size && pos < self->file_sz ) {
+        SRAFastqSlot* s = NULL;
+        if( (rc = SRAFastqFile_AcquireSlot(self, pos, &s)) == 0 ) {
+            off_t from = pos - s->from;
+            size_t q = (s->size - from) > (size - *num_read) ? (size - *num_read) : (s->size - from);
+            DEBUG_MSG(10, ("Copying from %lu %u bytes\n", from, q));
+            memmove(&((char*)buffer)[*num_read], &s->buf[from], q);
+            ReleaseComplain(KRWLockUnlock, s->lock);
+            *num_read = *num_read + q;
+            pos += q;
+        }
     }
     return rc;
 }
@@ -205,28 +358,16 @@ rc_t SRAFastqFile_Open(const KFile** cself, const SRAListNode* sra, const FileOp
                     {
                         if ( ( rc = KLockMake( &self->lock ) ) == 0 )
                         {
-                            MALLOC( self->buf, opt->buffer_sz * ( opt->f.fastq.gzip ? 2 : 1 ) );
-                            if ( self->buf == NULL )
-                            {
-                                rc = RC( rcExe, rcFile, rcOpening, rcMemory, rcExhausted );
-                            }
-                            else
+                            uint32_t i;
+                            /* chunks and readers are made on demand */
+                            for ( i = 0; i < SRAFASTQ_SLOTS; i++ )
                             {
-                                self->file_sz = opt->file_sz;
-                                self->buffer_sz = opt->buffer_sz;
-                                if ( opt->f.fastq.gzip )
-                                {
-                                    self->gzipped = &self->buf[ opt->buffer_sz ];
-                                }
-                                self->from = ~0; /* reset position beyond file end */
-                                rc = FastqReaderMake( &self->reader, self->stbl,
-                                                      opt->f.fastq.accession, opt->f.fastq.colorSpace,
-                                                      opt->f.fastq.origFormat, false, opt->f.fastq.printLabel,
-                                                      opt->f.fastq.printReadId, !opt->f.fastq.clipQuality, false,
-                                                      opt->f.fastq.minReadLen, opt->f.fastq.qualityOffset,
-                                                      opt->f.fastq.colorSpaceKey,
-                                                      opt->f.fastq.minSpotId, opt->f.fastq.maxSpotId );
+                                self->slot[ i ].from = ~0; /* reset position beyond file end */
                             }
+                            self->file_sz = opt->file_sz;
+                            self->buffer_sz = opt->buffer_sz;
+                            self->gzip = opt->f.fastq.gzip;
+                            self->opt = *opt;
                         }
                     }
                 }
@@ -461,6 +461,13 @@ void CoreUsage(int fd, const char *progName, bool showHelp, bool showVersion, bo
                 "                                       level is an integer value from 1 to 10,\n"
                 "                                       which correspond to block sizes:\n"
                 "                                       32K,64K,128K,256K,512K,1M,2M,4M,8M,16M\n"
+                "    -A|--read-ahead <blocks>           Maximal number of blocks to read ahead for\n"
+                "                                       sequentially read files, default: 32,\n"
+                "                                       0 - no read-ahead. Requires cache-dir.\n"
+                "    -S|--cache-size <MB>               Keep cached files between sessions, and\n"
+                "                                       evict least recently used ones if total\n"
+                "                                       size exceeds limit, default: 0 - cache\n"
+                "                                       is dropped on exit. Requires cache-dir.\n"
                 );
             KOutMsg(
                 "    --SRA-check <secs>                 Check SRA config and runs for update\n"
@@ -516,7 +523,8 @@ rc_t CC KMain(int argc, char *argv[])
     char** fargs = (char**)calloc(argc, sizeof(char*));
     uint32_t heart_beat_check = 30, log_sync = 0, sra_sync = 0;
     int log_fd = STDOUT_FILENO;
-    uint32_t block_level = 0, block_size = 0;
+    uint32_t block_level = 0, block_size = 0, read_ahead = 32;
+    uint64_t cache_size = 0;
 
 #ifdef SRAFUSER_LOGLOCALTIME
     KLogFmtFlagsSet(klogFmtLocalTimestamp);
@@ -540,6 +548,10 @@ rc_t CC KMain(int argc, char *argv[])
             xml_root = argv[++i];
         } else if(!strcmp(argv[i], "-B") || !strcmp(argv[i], "--Blevel")) {
             block_level = AsciiToU32(argv[++i], NULL, NULL);
+        } else if(!strcmp(argv[i], "-A") || !strcmp(argv[i], "--read-ahead")) {
+            read_ahead = AsciiToU32(argv[++i], NULL, NULL);
+        } else if(!strcmp(argv[i], "-S") || !strcmp(argv[i], "--cache-size")) {
+            cache_size = AsciiToU32(argv[++i], NULL, NULL);
         } else if(!strcmp(argv[i], "-ds") || !strcmp(argv[i], "--SRA-check")) {
             sra_sync = AsciiToU32(argv[++i], NULL, NULL);
         } else if(!strcmp(argv[i], "-u") || !strcmp (argv[i], "--unmount")) {
@@ -626,6 +638,8 @@ rc_t CC KMain(int argc, char *argv[])
     else {
         block_size = 0;
     }
+    RemoteCacheSetReadAhead ( read_ahead );
+    RemoteCacheSetLimit ( cache_size * 1024 * 1024 );
     if( i != argc ) {
         LOGERR(klogErr, RC(rcExe, rcArgv, rcValidating, rcParam, rcExcessive), argv[i]);
         CoreUsage(log_fd, argv[0], true, false, true);
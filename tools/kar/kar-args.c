@@ -30,6 +30,7 @@
 #include <kfs/sra.h>
 #include <klib/log.h>
 #include <klib/out.h>
+#include <klib/text.h>
 
 #include <kapp/main.h>
 
@@ -53,6 +54,9 @@ static const char * directory_usage[] =
   "from", NULL };
 static const char * stdout_usage[] = { "Direct output to stdout", NULL }; 
 static const char * md5_usage[] = { "create md5sum-compatible checksum file", NULL }; 
+static const char * threads_usage[] =
+{ "number of threads copying file contents",
+  "when creating or extracting, default: 1", NULL };
 
 
 OptDef Options [] = 
@@ -64,7 +68,8 @@ OptDef Options [] =
     { OPTION_LONGLIST,  ALIAS_LONGLIST,  NULL, longlist_usage, 0, false, false },
     { OPTION_DIRECTORY, ALIAS_DIRECTORY, NULL, directory_usage, 1, true,  false },
     { OPTION_STDOUT,    ALIAS_STDOUT,    NULL, stdout_usage, 1, true,  false },
-    { OPTION_MD5,       NULL,            NULL, md5_usage, 1, false,  false }
+    { OPTION_MD5,       NULL,            NULL, md5_usage, 1, false,  false },
+    { OPTION_THREADS,   ALIAS_THREADS,   NULL, threads_usage, 1, true,  false }
 };
 
 const char UsageDefaultName[] = "kar";
@@ -129,6 +134,7 @@ rc_t CC Usage (const Args * args)
     HelpOptionLine (ALIAS_DIRECTORY, OPTION_DIRECTORY, "Directory", directory_usage);
     HelpOptionLine (ALIAS_FORCE, OPTION_FORCE, NULL, force_usage);
     HelpOptionLine (ALIAS_LONGLIST, OPTION_LONGLIST, NULL, longlist_usage);
+    HelpOptionLine (ALIAS_THREADS, OPTION_THREADS, "count", threads_usage);
 
     HelpOptionsStandard ();
 
@@ -177,6 +183,7 @@ rc_t parse_params_int ( Params *p, const Args *args )
     rc_t rc;
 
     uint32_t count;
+    const char *value;
     
     /* Parameters */
     rc = ArgsParamCount ( args, &count );
@@ -188,7 +195,6 @@ rc_t parse_params_int ( Params *p, const Args *args )
     else
     {
         uint32_t i;
-        const char *value;
 
         p -> mem_count = count;
 
@@ -223,6 +229,21 @@ rc_t parse_params_int ( Params *p, const Args *args )
         p -> md5sum = true;    
 
     /* Options */
+    rc = ArgsOptionCount ( args, OPTION_THREADS, &count );
+    if ( rc == 0 && count != 0 )
+    {
+        rc = ArgsOptionValue ( args, OPTION_THREADS, 0, ( const void ** ) &value );
+        if ( rc != 0 )
+        {
+            LogErr ( klogFatal, rc, "Failed to access 'threads' value" );
+            return rc;
+        }
+
+        p -> threads = AsciiToU32 ( value, NULL, NULL );
+        if ( p -> threads == 0 )
+            p -> threads = 1;
+    }
+
     rc = ArgsOptionCount ( args, OPTION_CREATE, & p -> c_count );
     if ( rc != 0 )
     {
@@ -313,6 +334,8 @@ rc_t parse_params ( Params *p, Args *args, int argc, char * argv [] )
     p -> long_list = false;
     p -> force = false;
     p -> stdout = false;
+    p -> md5sum = false;
+    p -> threads = 1;
 
     rc = ArgsMakeAndHandle ( &args, argc, argv, 1,
         Options, sizeof Options / sizeof ( Options [ 0 ] ) );
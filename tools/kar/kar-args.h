@@ -40,6 +40,7 @@
 #define OPTION_DIRECTORY "directory"
 #define OPTION_STDOUT    "stdout"
 #define OPTION_MD5       "md5"
+#define OPTION_THREADS   "threads"
 /*TBD - add alignment option */
 
 
@@ -50,6 +51,7 @@
 #define ALIAS_LONGLIST   "l"
 #define ALIAS_DIRECTORY  "d"
 #define ALIAS_STDOUT     "Z"
+#define ALIAS_THREADS    "e"
 
 
 struct Args;
@@ -89,6 +91,9 @@ struct Params
     
     /*modifier to create mode to create an md5sum compatible auxilary file*/
     bool md5sum;
+
+    /* number of threads copying file contents in create or extract mode */
+    uint32_t threads;
 };
 
 
@@ -38,6 +38,9 @@
 #include <klib/printf.h>
 #include <klib/time.h>
 #include <sysalloc.h>
+#include <kproc/thread.h>
+#include <kproc/lock.h>
+#include <kproc/cond.h>
 #include <kfs/directory.h>
 #include <kfs/file.h>
 #include <kfs/toc.h>
@@ -1248,8 +1251,595 @@ void kar_write_file ( KARArchiveFile *af, const KDirectory *wd, const KARFile *f
     KFileRelease ( f );
 }
 
+/********** parallel payload copy  */
+
+/* offsets of all payloads are fixed by the toc before any data
+   is copied, so payloads are moved by a pool of threads with
+   positional reads and writes. work is cut into chunks, so that
+   a single large file is copied in parallel as well.
+
+   in ordered mode workers only read, and chunks are written by
+   the submitting thread in archive order. this is used when the
+   archive is written through the md5 calculating file, which has
+   to see the data sequentially. */
+
+#define KAR_CHUNK_SIZE ( 8 * 1024 * 1024 )
+
+typedef struct kar_copy_done kar_copy_done;
+struct kar_copy_done
+{
+    const KFile *src;
+    KFile *dst;
+
+    /* extraction: directory where access and date are set */
+    KDirectory *dir;
+    const KAREntry *entry;
+
+    /* one reference per chunk in flight plus one for submitter */
+    uint32_t refcount;
+};
+
+typedef struct kar_copy_chunk kar_copy_chunk;
+struct kar_copy_chunk
+{
+    kar_copy_chunk *next;
+    kar_copy_chunk *next_ordered;
+    kar_copy_done *done;
+
+    const KFile *src;
+    KFile *dst;
+    uint64_t src_pos;
+    uint64_t dst_pos;
+    size_t size;
+
+    /* ordered mode only */
+    char *buffer;
+    bool ready;
+};
+
+typedef struct kar_copy_pool kar_copy_pool;
+struct kar_copy_pool
+{
+    KLock *lock;
+    KCondition *cond;
+
+    KThread **threads;
+    uint32_t num_threads;
+
+    /* chunks waiting for a worker */
+    kar_copy_chunk *head, *tail;
+
+    /* ordered mode: all chunks in flight, in archive order */
+    kar_copy_chunk *order_head, *order_tail;
+
+    uint32_t in_flight;
+    uint32_t max_in_flight;
+
+    rc_t rc;
+
+    bool ordered;
+    bool quitting;
+};
+
+static
+rc_t kar_copy_done_make ( kar_copy_done **rtn, const KFile *src, KFile *dst,
+    KDirectory *dir, const KAREntry *entry )
+{
+    kar_copy_done *done = calloc ( 1, sizeof * done );
+    if ( done == NULL )
+        return RC ( rcExe, rcFile, rcAllocating, rcMemory, rcExhausted );
+
+    if ( dir != NULL )
+    {
+        rc_t rc = KDirectoryAddRef ( dir );
+        if ( rc != 0 )
+        {
+            free ( done );
+            return rc;
+        }
+    }
+
+    done -> src = src;
+    done -> dst = dst;
+    done -> dir = dir;
+    done -> entry = entry;
+    done -> refcount = 1;
+
+    * rtn = done;
+    return 0;
+}
+
+static
+rc_t kar_copy_done_whack ( kar_copy_done *done )
+{
+    rc_t rc = 0;
+
+    KFileRelease ( done -> src );
+    KFileRelease ( done -> dst );
+
+    if ( done -> dir != NULL )
+    {
+        const KAREntry *entry = done -> entry;
+
+        rc = KDirectorySetAccess ( done -> dir, false, entry -> access_mode, 0777, "%s", entry -> name );
+        if ( rc == 0 )
+            rc = KDirectorySetDate ( done -> dir, false, entry -> mod_time, "%s", entry -> name );
+
+        KDirectoryRelease ( done -> dir );
+    }
+
+    free ( done );
+    return rc;
+}
+
+/* must be called with lock held, returns record to whack or NULL */
+static
+kar_copy_done * kar_copy_chunk_complete ( kar_copy_pool *self, kar_copy_chunk *chunk, rc_t rc )
+{
+    kar_copy_done *done = chunk -> done;
+
+    if ( rc != 0 && self -> rc == 0 )
+        self -> rc = rc;
+
+    -- self -> in_flight;
+
+    free ( chunk -> buffer );
+    free ( chunk );
+
+    KConditionBroadcast ( self -> cond );
+
+    if ( done != NULL && -- done -> refcount == 0 )
+        return done;
+
+    return NULL;
+}
+
+static
+rc_t kar_copy_chunk_read ( const kar_copy_chunk *chunk, char *buffer )
+{
+    size_t num_read;
+    rc_t rc = KFileReadAll ( chunk -> src, chunk -> src_pos, buffer, chunk -> size, & num_read );
+    if ( rc == 0 && num_read != chunk -> size )
+        rc = RC ( rcExe, rcFile, rcReading, rcTransfer, rcIncomplete );
+    return rc;
+}
+
+static
+rc_t kar_copy_chunk_write ( const kar_copy_chunk *chunk, const char *buffer )
+{
+    size_t num_writ;
+    rc_t rc = KFileWriteAll ( chunk -> dst, chunk -> dst_pos, buffer, chunk -> size, & num_writ );
+    if ( rc == 0 && num_writ != chunk -> size )
+        rc = RC ( rcExe, rcFile, rcWriting, rcTransfer, rcIncomplete );
+    return rc;
+}
+
+static
+rc_t CC kar_copy_worker ( const KThread *thread, void *data )
+{
+    kar_copy_pool *self = data;
+    char *buffer = NULL;
+    rc_t rc = 0;
+
+    if ( ! self -> ordered )
+    {
+        buffer = malloc ( KAR_CHUNK_SIZE );
+        if ( buffer == NULL )
+            rc = RC ( rcExe, rcBuffer, rcAllocating, rcMemory, rcExhausted );
+    }
+
+    KLockAcquire ( self -> lock );
+    if ( rc != 0 && self -> rc == 0 )
+        self -> rc = rc;
+
+    while ( true )
+    {
+        kar_copy_chunk *chunk;
+        kar_copy_done *done = NULL;
+
+        while ( self -> head == NULL && ! self -> quitting )
+            KConditionWait ( self -> cond, self -> lock );
+
+        chunk = self -> head;
+        if ( chunk == NULL )
+            break;
+
+        self -> head = chunk -> next;
+        if ( self -> head == NULL )
+            self -> tail = NULL;
+
+        /* after first error the rest is only drained */
+        rc = self -> rc;
+        KLockUnlock ( self -> lock );
+
+        if ( rc == 0 )
+        {
+            if ( self -> ordered )
+                rc = kar_copy_chunk_read ( chunk, chunk -> buffer );
+            else
+            {
+                rc = kar_copy_chunk_read ( chunk, buffer );
+                if ( rc == 0 )
+                    rc = kar_copy_chunk_write ( chunk, buffer );
+            }
+        }
+
+        KLockAcquire ( self -> lock );
+        if ( self -> ordered )
+        {
+            /* submitter writes it in order */
+            if ( rc != 0 && self -> rc == 0 )
+                self -> rc = rc;
+            chunk -> ready = true;
+            KConditionBroadcast ( self -> cond );
+        }
+        else
+        {
+            done = kar_copy_chunk_complete ( self, chunk, rc );
+        }
+
+        if ( done != NULL )
+        {
+            KLockUnlock ( self -> lock );
+            rc = kar_copy_done_whack ( done );
+            KLockAcquire ( self -> lock );
+            if ( rc != 0 && self -> rc == 0 )
+                self -> rc = rc;
+        }
+    }
+
+    KLockUnlock ( self -> lock );
+
+    free ( buffer );
+    return 0;
+}
+
+/* waits until no more than "limit" chunks are in flight,
+   writing ready chunks in order while in ordered mode */
+static
+rc_t kar_copy_pool_wait ( kar_copy_pool *self, uint32_t limit )
+{
+    rc_t rc = KLockAcquire ( self -> lock );
+    if ( rc != 0 )
+        return rc;
+
+    while ( self -> in_flight > limit )
+    {
+        kar_copy_chunk *chunk = self -> order_head;
+        if ( chunk != NULL && chunk -> ready )
+        {
+            kar_copy_done *done;
+
+            self -> order_head = chunk -> next_ordered;
+            if ( self -> order_head == NULL )
+                self -> order_tail = NULL;
+
+            rc = self -> rc;
+            KLockUnlock ( self -> lock );
+
+            if ( rc == 0 )
+                rc = kar_copy_chunk_write ( chunk, chunk -> buffer );
+
+            KLockAcquire ( self -> lock );
+            done = kar_copy_chunk_complete ( self, chunk, rc );
+            if ( done != NULL )
+            {
+                KLockUnlock ( self -> lock );
+                rc = kar_copy_done_whack ( done );
+                KLockAcquire ( self -> lock );
+                if ( rc != 0 && self -> rc == 0 )
+                    self -> rc = rc;
+            }
+        }
+        else
+        {
+            KConditionWait ( self -> cond, self -> lock );
+        }
+    }
+
+    rc = self -> rc;
+    KLockUnlock ( self -> lock );
+
+    return rc;
+}
+
+static
+rc_t kar_copy_pool_submit ( kar_copy_pool *self, kar_copy_chunk *chunk )
+{
+    rc_t rc = kar_copy_pool_wait ( self, self -> max_in_flight - 1 );
+    if ( rc == 0 )
+        rc = KLockAcquire ( self -> lock );
+    if ( rc != 0 )
+    {
+        free ( chunk -> buffer );
+        free ( chunk );
+        return rc;
+    }
+
+    ++ self -> in_flight;
+    if ( chunk -> done != NULL )
+        ++ chunk -> done -> refcount;
+
+    if ( self -> ordered )
+    {
+        if ( self -> order_tail == NULL )
+            self -> order_head = chunk;
+        else
+            self -> order_tail -> next_ordered = chunk;
+        self -> order_tail = chunk;
+    }
+
+    /* chunks without source ( padding ) are ready as they are */
+    if ( chunk -> src == NULL )
+        chunk -> ready = true;
+    else
+    {
+        if ( self -> tail == NULL )
+            self -> head = chunk;
+        else
+            self -> tail -> next = chunk;
+        self -> tail = chunk;
+
+        KConditionBroadcast ( self -> cond );
+    }
+
+    KLockUnlock ( self -> lock );
+    return 0;
+}
+
+static
+rc_t kar_copy_chunk_make ( kar_copy_pool *self, kar_copy_chunk **rtn, size_t size )
+{
+    kar_copy_chunk *chunk = calloc ( 1, sizeof * chunk );
+    if ( chunk == NULL )
+        return RC ( rcExe, rcBuffer, rcAllocating, rcMemory, rcExhausted );
+
+    if ( self -> ordered )
+    {
+        chunk -> buffer = malloc ( size );
+        if ( chunk -> buffer == NULL )
+        {
+            free ( chunk );
+            return RC ( rcExe, rcBuffer, rcAllocating, rcMemory, rcExhausted );
+        }
+    }
+
+    chunk -> size = size;
+
+    * rtn = chunk;
+    return 0;
+}
+
+/* copies "size" bytes, takes over submitter reference to "done" */
+static
+rc_t kar_copy_pool_copy ( kar_copy_pool *self, kar_copy_done *done,
+    uint64_t src_pos, uint64_t dst_pos, uint64_t size )
+{
+    rc_t rc = 0;
+    uint64_t pos;
+
+    for ( pos = 0; rc == 0 && pos < size; pos += KAR_CHUNK_SIZE )
+    {
+        kar_copy_chunk *chunk;
+        size_t to_copy = KAR_CHUNK_SIZE;
+        if ( pos + to_copy > size )
+            to_copy = ( size_t ) ( size - pos );
+
+        rc = kar_copy_chunk_make ( self, & chunk, to_copy );
+        if ( rc == 0 )
+        {
+            chunk -> done = done;
+            chunk -> src = done -> src;
+            chunk -> dst = done -> dst;
+            chunk -> src_pos = src_pos + pos;
+            chunk -> dst_pos = dst_pos + pos;
+
+            rc = kar_copy_pool_submit ( self, chunk );
+        }
+    }
+
+    /* drop submitter reference */
+    if ( KLockAcquire ( self -> lock ) == 0 )
+    {
+        bool last = -- done -> refcount == 0;
+        KLockUnlock ( self -> lock );
+
+        if ( last )
+        {
+            rc_t rc2 = kar_copy_done_whack ( done );
+            if ( rc == 0 )
+                rc = rc2;
+        }
+    }
+
+    return rc;
+}
+
+static
+rc_t kar_copy_pool_pad ( kar_copy_pool *self, KFile *dst, uint64_t dst_pos, size_t size )
+{
+    rc_t rc;
+    kar_copy_chunk *chunk;
+
+    if ( size == 0 )
+        return 0;
+
+    rc = kar_copy_chunk_make ( self, & chunk, size );
+    if ( rc == 0 )
+    {
+        chunk -> dst = dst;
+        chunk -> dst_pos = dst_pos;
+
+        if ( self -> ordered )
+        {
+            memset ( chunk -> buffer, '0', size );
+            rc = kar_copy_pool_submit ( self, chunk );
+        }
+        else
+        {
+            char align_buffer [ 4 ] = "0000";
+            assert ( size <= sizeof align_buffer );
+            rc = kar_copy_chunk_write ( chunk, align_buffer );
+            free ( chunk );
+        }
+    }
+
+    return rc;
+}
+
+static
+rc_t kar_copy_pool_make ( kar_copy_pool **rtn, uint32_t num_threads, bool ordered )
+{
+    rc_t rc;
+    kar_copy_pool *self = calloc ( 1, sizeof * self );
+    if ( self == NULL )
+        return RC ( rcExe, rcThread, rcAllocating, rcMemory, rcExhausted );
+
+    self -> ordered = ordered;
+    self -> max_in_flight = num_threads * 4;
+
+    self -> threads = calloc ( num_threads, sizeof * self -> threads );
+    if ( self -> threads == NULL )
+        rc = RC ( rcExe, rcThread, rcAllocating, rcMemory, rcExhausted );
+    else
+    {
+        rc = KLockMake ( & self -> lock );
+        if ( rc == 0 )
+            rc = KConditionMake ( & self -> cond );
+
+        for ( ; rc == 0 && self -> num_threads < num_threads; ++ self -> num_threads )
+            rc = KThreadMake ( & self -> threads [ self -> num_threads ], kar_copy_worker, self );
+    }
+
+    if ( rc != 0 )
+    {
+        uint32_t i;
+
+        LogErr ( klogErr, rc, "Failed to start copy threads" );
+
+        if ( self -> lock != NULL )
+        {
+            KLockAcquire ( self -> lock );
+            self -> quitting = true;
+            KConditionBroadcast ( self -> cond );
+            KLockUnlock ( self -> lock );
+        }
+
+        for ( i = 0; i < self -> num_threads; ++ i )
+        {
+            KThreadWait ( self -> threads [ i ], NULL );
+            KThreadRelease ( self -> threads [ i ] );
+        }
+
+        free ( self -> threads );
+        KConditionRelease ( self -> cond );
+        KLockRelease ( self -> lock );
+        free ( self );
+        return rc;
+    }
+
+    STATUS ( STAT_QA, "started %u copy threads", num_threads );
+
+    * rtn = self;
+    return 0;
+}
+
+/* waits for all chunks to be done, returns first error */
+static
+rc_t kar_copy_pool_whack ( kar_copy_pool *self )
+{
+    uint32_t i;
+    rc_t rc = kar_copy_pool_wait ( self, 0 );
+
+    KLockAcquire ( self -> lock );
+    self -> quitting = true;
+    KConditionBroadcast ( self -> cond );
+    KLockUnlock ( self -> lock );
+
+    for ( i = 0; i < self -> num_threads; ++ i )
+    {
+        KThreadWait ( self -> threads [ i ], NULL );
+        KThreadRelease ( self -> threads [ i ] );
+    }
+
+    if ( rc == 0 )
+        rc = self -> rc;
+
+    free ( self -> threads );
+    KConditionRelease ( self -> cond );
+    KLockRelease ( self -> lock );
+    free ( self );
+
+    return rc;
+}
+
+static
+rc_t kar_write_files_parallel ( KARArchiveFile *af, const KDirectory *wd,
+    const KARFilePtrArray file_array, const char * root_dir, uint32_t num_threads, bool ordered )
+{
+    kar_copy_pool *pool;
+    rc_t rc2, rc = kar_copy_pool_make ( & pool, num_threads, ordered );
+    if ( rc == 0 )
+    {
+        uint64_t i;
+
+        for ( i = 0; rc == 0 && i < num_files; ++ i )
+        {
+            const KARFile *file = file_array [ i ];
+            uint64_t pos = af -> starting_pos + file -> byte_offset;
+
+            char filename [ 4096 ];
+            const KFile *f;
+            kar_copy_done *done;
+
+            if ( file -> byte_size == 0 )
+                continue;
+
+            if ( kar_entry_full_path ( & file -> dad, root_dir, filename, sizeof filename ) == sizeof filename )
+            {
+                rc = RC ( rcExe, rcFile, rcWriting, rcMemory, rcExhausted );
+                LogErr ( klogInt, rc, "File path was too long" );
+                break;
+            }
+
+            STATUS ( STAT_QA, "queueing file %lu: '%s'", i, filename );
+            rc = KDirectoryOpenFileRead ( wd, &f, "%s", filename );
+            if ( rc != 0 )
+            {
+                pLogErr ( klogInt, rc, "Failed to open file $(fname)", "fname=%s", file -> dad . name );
+                break;
+            }
+
+            /* same alignment filler as sequential write */
+            rc = kar_copy_pool_pad ( pool, af -> archive, af -> pos, ( size_t ) ( pos - af -> pos ) );
+            if ( rc == 0 )
+            {
+                KFileAddRef ( af -> archive );
+                rc = kar_copy_done_make ( & done, f, af -> archive, NULL, NULL );
+                if ( rc != 0 )
+                    KFileRelease ( af -> archive );
+            }
+
+            if ( rc != 0 )
+                KFileRelease ( f );
+            else
+            {
+                rc = kar_copy_pool_copy ( pool, done, 0, pos, file -> byte_size );
+                af -> pos = pos + file -> byte_size;
+            }
+        }
+
+        rc2 = kar_copy_pool_whack ( pool );
+        if ( rc == 0 )
+            rc = rc2;
+    }
+
+    return rc;
+}
+
 static
-rc_t kar_make ( const KDirectory * wd, KFile *archive, const BSTree *tree, const char * root_dir )
+rc_t kar_make ( const KDirectory * wd, KFile *archive, const BSTree *tree, const char * root_dir,
+    uint32_t num_threads, bool ordered )
 {
     rc_t rc = 0;
 
@@ -1275,10 +1865,15 @@ rc_t kar_make ( const KDirectory * wd, KFile *archive, const BSTree *tree, const
 
         /* write each of the files in order */
         STATUS ( STAT_QA, "about to write %u files", num_files );
-        for ( i = 0; i < num_files; ++ i )
+        if ( num_threads > 1 )
+            rc = kar_write_files_parallel ( & af, wd, file_array, root_dir, num_threads, ordered );
+        else
         {
-            STATUS ( STAT_QA, "writing file %u: '%s'", i, file_array [ i ] -> dad . name );
-            kar_write_file ( & af, wd, file_array [ i ], root_dir );
+            for ( i = 0; i < num_files; ++ i )
+            {
+                STATUS ( STAT_QA, "writing file %u: '%s'", i, file_array [ i ] -> dad . name );
+                kar_write_file ( & af, wd, file_array [ i ], root_dir );
+            }
         }
         
         free ( file_array );
@@ -1337,7 +1932,8 @@ rc_t kar_create ( const Params *p )
                         {
                             BSTreeForEach ( &tree, false, kar_entry_link_parent_dir, NULL );
                             
-                            rc = kar_make ( wd, archive, &tree, p -> directory_path );
+                            rc = kar_make ( wd, archive, &tree, p -> directory_path,
+                                            p -> threads, p -> md5sum );
                             if ( rc != 0 )
                                 LogErr ( klogInt, rc, "Failed to build archive" );
                         }
@@ -1799,6 +2395,9 @@ struct extract_block
     KDirectory *cdir;
     const KFile *archive;
 
+    /* NULL for sequential extraction */
+    kar_copy_pool *pool;
+
     rc_t rc;
 
 };
@@ -1821,6 +2420,31 @@ rc_t extract_file ( const KARFile *src, const extract_block *eb )
         exit ( 4 );
     }
 
+    if ( eb -> pool != NULL )
+    {
+        /* file is created here, so that directory date set after
+           its contents are extracted is not changed by workers.
+           access and date of file are set when it is written */
+        kar_copy_done *done;
+
+        KFileAddRef ( eb -> archive );
+        rc = kar_copy_done_make ( &done, eb -> archive, dst, eb -> cdir, & src -> dad );
+        if ( rc != 0 )
+        {
+            KFileRelease ( eb -> archive );
+            KFileRelease ( dst );
+        }
+        else
+        {
+            rc = kar_copy_pool_copy ( eb -> pool, done, src -> byte_offset + eb -> extract_pos,
+                                      0, src -> byte_size );
+        }
+
+        if ( rc != 0 )
+            pLogErr (klogErr, rc, "failed to extract file '$(fname)'", "fname=%s", src -> dad . name );
+
+        return rc;
+    }
 
     buffer = malloc ( bsize );
     if ( buffer == NULL )
@@ -1905,6 +2529,9 @@ bool CC kar_extract ( BSTNode *node, void *data )
     {
     case kptFile:
         eb -> rc = extract_file ( ( const KARFile * ) entry, eb );
+        /* pool sets access and date once file is written */
+        if ( eb -> pool != NULL )
+            return eb -> rc != 0;
         break;
     case kptDir:
         eb -> rc = extract_dir ( ( const KARDir * ) entry, eb ); 
@@ -2008,6 +2635,7 @@ rc_t kar_test_extract ( const Params *p )
                     eb . archive = archive;
                     eb . extract_pos = file_offset;
                     eb . rc = 0;
+                    eb . pool = NULL;
 
                     STATUS ( STAT_QA, "creating directory from path: %s", p -> directory_path );
                     rc = KDirectoryCreateDir ( wd, 0777, kcmInit, "%s", p -> directory_path );
@@ -2015,10 +2643,19 @@ rc_t kar_test_extract ( const Params *p )
                     {
                         STATUS ( STAT_QA, "opening directory"  );
                         rc = KDirectoryOpenDirUpdate ( wd, &eb . cdir, false, "%s", p -> directory_path );
+                        if ( rc == 0 && p -> threads > 1 )
+                            rc = kar_copy_pool_make ( &eb . pool, p -> threads, false );
                         if ( rc == 0 )
                         {
                             BSTreeDoUntil ( tree, false, kar_extract, &eb );
                             rc = eb . rc;
+
+                            if ( eb . pool != NULL )
+                            {
+                                rc_t rc2 = kar_copy_pool_whack ( eb . pool );
+                                if ( rc == 0 )
+                                    rc = rc2;
+                            }
                         }
                         
                         KDirectoryRelease ( eb . cdir );
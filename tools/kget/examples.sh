@@ -55,6 +55,11 @@ echo "example number 10: download the remote file, no buffering, no cachefile"
 echo "                  in 32k blocks, but requests are made in random order"
 execute "time kget $URL --random"
 
+echo "example number 11: download the remote file, using a cache-file"
+echo "                   with 4 parallel connections, in 32k blocks"
+execute "rm -f $CACHEFILE"
+execute "time kget $URL --cache $CACHEFILE --threads 4"
+
 #enable this example only after updating the PROXY-variable
 #and actually having a running proxy there!
 #echo "example number X: download the remote file, using a proxy"
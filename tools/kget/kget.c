@@ -45,6 +45,8 @@
 #include <kns/stream.h>
 
 #include <kproc/timeout.h>
+#include <kproc/thread.h>
+#include <kproc/lock.h>
 
 #include <os-native.h>
 #include <sysalloc.h>
@@ -142,6 +144,10 @@ static const char * ccompl_usage[]      = { "check completeness on open cachetee
 #define ALIAS_FULL "f"
 static const char * full_usage[]        = { "download via one http-request, not partial requests in a loop", NULL };
 
+#define OPTION_THREADS "threads"
+#define ALIAS_THREADS "t"
+static const char * threads_usage[]     = { "fetch blocks in parallel with this many threads/connections", NULL };
+
 OptDef MyOptions[] =
 {
 /*    name              alias           fkt    usage-txt,       cnt, needs value, required */
@@ -164,7 +170,8 @@ OptDef MyOptions[] =
     { OPTION_COUNT,     NULL,           NULL, count_usage,      1,  true,        false },
     { OPTION_PROGRESS,  NULL,           NULL, progress_usage,   1,  false,       false },
     { OPTION_RELIABLE,  NULL,           NULL, reliable_usage,   1,  false,       false },
-    { OPTION_FULL,      ALIAS_FULL,     NULL, full_usage,       1,  false,       false }
+    { OPTION_FULL,      ALIAS_FULL,     NULL, full_usage,       1,  false,       false },
+    { OPTION_THREADS,   ALIAS_THREADS,  NULL, threads_usage,    1,  true,        false }
 };
 
 rc_t CC Usage ( const Args * args )
@@ -205,6 +212,7 @@ typedef struct fetch_ctx
     size_t sleep_time;
     size_t timeout_time;
     size_t cache_blk;
+    size_t threads;
     bool verbose;
     bool show_filesize;
     bool random;
@@ -221,12 +229,10 @@ typedef struct fetch_ctx
 } fetch_ctx;
 
 
-static rc_t src_2_dst( const KFile *src, KFile *dst, char * buffer,
-                       uint64_t pos, size_t * num_read, fetch_ctx * ctx )
+static rc_t range_2_dst( const KFile *src, KFile *dst, char * buffer,
+                         uint64_t pos, size_t n_transfer, size_t * num_read, fetch_ctx * ctx )
 {
     rc_t rc;
-    size_t n_transfer = ( ctx->count == 0 ? ctx->blocksize : ctx->count );
-    
     if ( ctx->timeout_time == 0 )
         rc = KFileReadAll ( src, pos, buffer, n_transfer, num_read );
     else
@@ -245,6 +251,14 @@ static rc_t src_2_dst( const KFile *src, KFile *dst, char * buffer,
 }
 
 
+static rc_t src_2_dst( const KFile *src, KFile *dst, char * buffer,
+                       uint64_t pos, size_t * num_read, fetch_ctx * ctx )
+{
+    size_t n_transfer = ( ctx->count == 0 ? ctx->blocksize : ctx->count );
+    return range_2_dst( src, dst, buffer, pos, n_transfer, num_read, ctx );
+}
+
+
 static rc_t block_loop_in_order( const KFile *src, KFile *dst, char * buffer, 
                                  uint64_t * bytes_copied, fetch_ctx * ctx )
 {
@@ -276,6 +290,21 @@ static uint32_t randr( uint32_t min, uint32_t max )
 }
 
 
+static void shuffle_vector( uint32_t * v, uint32_t count )
+{
+    uint32_t loop;
+    for ( loop = 0; loop < count; loop++ )
+    {
+        uint32_t src_idx = randr( 0, count - 1 );
+        uint32_t dst_idx = randr( 0, count - 1 );
+        /* swap it... */
+        uint32_t tmp = v[ dst_idx ];
+        v[ dst_idx ] = v[ src_idx ];
+        v[ src_idx ] = tmp;
+    }
+}
+
+
 static rc_t block_loop_random( const KFile *src, KFile *dst, char * buffer,
                                uint64_t *bytes_copied, fetch_ctx * ctx )
 {
@@ -298,15 +327,7 @@ static rc_t block_loop_random( const KFile *src, KFile *dst, char * buffer,
                     block_vector[ loop ] = loop;
                 
                 /* randomize them */
-                for ( loop = 0; loop < block_count; loop++ )
-                {
-                    uint32_t src_idx = randr( 0, block_count - 1 );
-                    uint32_t dst_idx = randr( 0, block_count - 1 );
-                    /* swap it... */
-                    uint32_t tmp = block_vector[ dst_idx ];
-                    block_vector[ dst_idx ] = block_vector[ src_idx ];
-                    block_vector[ src_idx ] = tmp;
-                }
+                shuffle_vector( block_vector, block_count );
 
                 for ( loop = 0; rc == 0 && loop < block_count; loop++ )
                 {
@@ -387,45 +408,6 @@ static rc_t fetch_cached( KDirectory *dir, const KFile *src, KFile *dst, fetch_c
 }
 
 
-static void extract_name( char ** dst, const char * url )
-{
-    char * last_slash = string_rchr ( url, string_size( url ), '/' );
-    if ( last_slash == NULL )
-        *dst = string_dup_measure( "out.bin", NULL );
-    else
-        *dst = string_dup_measure( last_slash + 1, NULL );
-}
-
-
-static rc_t fetch_from( KDirectory *dir, fetch_ctx *ctx, char * outfile,
-                        const KFile * src )
-{
-    uint64_t file_size;
-    rc_t rc = KFileSize( src, &file_size );
-    if ( rc != 0 )
-        KOutMsg( "cannot disover src-size >%R<\n", rc );
-    else
-    {
-        KFile *dst;
-        KOutMsg( "src-size = %lu\n", file_size );
-        rc = KDirectoryCreateFile ( dir, &dst, false, 0664, kcmInit, outfile );
-        if ( rc == 0 )
-        {
-            KOutMsg( "dst >%s< created\n", outfile );
-            if ( rc == 0 )
-            {
-                if ( ctx->cache_file != NULL )
-                    rc = fetch_cached( dir, src, dst, ctx );
-                else
-                    rc = copy_file( src, dst, ctx );
-            }
-            KFileRelease( dst );
-        }
-    }
-    return rc;
-}
-
-
 static rc_t make_remote_file( struct KNSManager * kns_mgr, const KFile ** src, fetch_ctx * ctx )
 {
     rc_t rc;
@@ -462,6 +444,288 @@ static rc_t make_remote_file( struct KNSManager * kns_mgr, const KFile ** src, f
 }
 
 
+/* -------------------------------------------------------------------------------------------------------------------- */
+
+/* parallel fetch:
+   every worker opens its own remote file ( = its own http-connection ) and, if a cache-file is requested,
+   its own cache-tee on the same cache-file. The workers claim chunks from a shared vector. A chunk covers
+   32 cache-tee blocks, that is exactly one 32-bit word of the cache-tee bitmap: no two workers will ever
+   update the same bitmap word. Blocks already present in the cache are served locally by the tee,
+   only the missing blocks go over the network. */
+
+#define BLOCKS_PER_CHUNK 32
+
+typedef struct par_fetch
+{
+    KLock * lock;
+    KDirectory * dir;
+    struct KNSManager * kns_mgr;
+    KFile * dst;
+    fetch_ctx * ctx;
+    uint32_t * chunk_vector;
+    uint32_t chunk_count;
+    uint32_t next_chunk;
+    uint64_t src_size;
+    uint64_t chunk_size;
+    uint64_t bytes_copied;
+    rc_t rc;
+} par_fetch;
+
+
+static bool par_fetch_claim( par_fetch * pf, uint32_t * chunk )
+{
+    bool res = false;
+    if ( KLockAcquire ( pf->lock ) == 0 )
+    {
+        if ( pf->rc == 0 && pf->next_chunk < pf->chunk_count )
+        {
+            *chunk = pf->chunk_vector[ pf->next_chunk++ ];
+            if ( pf->ctx->show_progress && ( ( pf->next_chunk & 0x0F ) == 0 ) ) KOutMsg( "." );
+            res = true;
+        }
+        KLockUnlock ( pf->lock );
+    }
+    return res;
+}
+
+
+static void par_fetch_done( par_fetch * pf, uint64_t bytes_copied, rc_t rc )
+{
+    if ( KLockAcquire ( pf->lock ) == 0 )
+    {
+        pf->bytes_copied += bytes_copied;
+        if ( pf->rc == 0 )
+            pf->rc = rc;
+        KLockUnlock ( pf->lock );
+    }
+}
+
+
+static rc_t par_fetch_chunks( par_fetch * pf, const KFile * src, char * buffer, uint64_t * bytes_copied )
+{
+    rc_t rc = 0;
+    uint32_t chunk;
+    fetch_ctx * ctx = pf->ctx;
+    while ( rc == 0 && par_fetch_claim( pf, &chunk ) )
+    {
+        uint64_t pos = pf->chunk_size * chunk;
+        uint64_t end = pos + pf->chunk_size;
+        size_t num_read = 1;
+        if ( end > pf->src_size ) end = pf->src_size;
+        while ( rc == 0 && pos < end && num_read > 0 )
+        {
+            size_t n_transfer = ctx->blocksize;
+            if ( pos + n_transfer > end ) n_transfer = ( size_t )( end - pos );
+            rc = range_2_dst( src, pf->dst, buffer, pos, n_transfer, &num_read, ctx );
+            if ( rc == 0 )
+            {
+                pos += num_read;
+                *bytes_copied += num_read;
+            }
+            if ( ctx->sleep_time > 0 ) KSleepMs( ctx->sleep_time );
+        }
+        /* the destination is pre-sized: a short chunk would leave a hole of zeros */
+        if ( rc == 0 && pos < end )
+        {
+            rc = RC( rcExe, rcFile, rcReading, rcTransfer, rcIncomplete );
+            (void)PLOGERR( klogErr, ( klogErr, rc, "chunk #$(c) ended at $(p) instead of $(e)",
+                                      "c=%u,p=%lu,e=%lu", chunk, pos, end ) );
+        }
+    }
+    return rc;
+}
+
+
+static rc_t CC par_fetch_worker( const KThread * self, void * data )
+{
+    par_fetch * pf = data;
+    fetch_ctx * ctx = pf->ctx;
+    uint64_t bytes_copied = 0;
+    const KFile * remote;
+    rc_t rc = make_remote_file( pf->kns_mgr, &remote, ctx );
+    if ( rc == 0 )
+    {
+        const KFile * src = remote;
+        if ( ctx->cache_file != NULL )
+            rc = KDirectoryMakeCacheTee ( pf->dir, &src, remote, ctx->cache_blk, ctx->cache_file );
+        if ( rc == 0 )
+        {
+            char * buffer = malloc( ctx->blocksize );
+            if ( buffer == NULL )
+                rc = RC( rcExe, rcFile, rcPacking, rcMemory, rcExhausted );
+            else
+            {
+                rc = par_fetch_chunks( pf, src, buffer, &bytes_copied );
+                free( buffer );
+            }
+            if ( src != remote )
+                KFileRelease( src );
+        }
+        KFileRelease( remote );
+    }
+    par_fetch_done( pf, bytes_copied, rc );
+    return rc;
+}
+
+
+static rc_t par_fetch_run( par_fetch * pf )
+{
+    rc_t rc = 0;
+    uint32_t i, started = 0;
+    uint32_t n = ( uint32_t )pf->ctx->threads;
+    KThread ** threads = calloc( n, sizeof * threads );
+    if ( threads == NULL )
+        return RC( rcExe, rcFile, rcPacking, rcMemory, rcExhausted );
+
+    for ( i = 0; rc == 0 && i < n; ++i )
+    {
+        rc = KThreadMake ( &threads[ i ], par_fetch_worker, pf );
+        if ( rc != 0 )
+            (void)LOGERR( klogInt, rc, "KThreadMake() failed" );
+        else
+            started++;
+    }
+    if ( rc != 0 )
+        par_fetch_done( pf, 0, rc ); /* stops the workers already started */
+
+    for ( i = 0; i < started; ++i )
+    {
+        rc_t status;
+        KThreadWait ( threads[ i ], &status );
+        KThreadRelease ( threads[ i ] );
+    }
+    free( threads );
+    return pf->rc;
+}
+
+
+static rc_t fetch_parallel( KDirectory *dir, struct KNSManager * kns_mgr,
+                            const KFile * src, KFile *dst, fetch_ctx *ctx )
+{
+    par_fetch pf;
+    rc_t rc;
+
+    memset( &pf, 0, sizeof pf );
+    pf.dir = dir;
+    pf.kns_mgr = kns_mgr;
+    pf.dst = dst;
+    pf.ctx = ctx;
+    if ( ctx->cache_file != NULL )
+        pf.chunk_size = ( ctx->cache_blk == 0 ? CACHE_TEE_DEFAULT_BLOCKSIZE : ctx->cache_blk );
+    else
+        pf.chunk_size = ctx->blocksize;
+    pf.chunk_size *= BLOCKS_PER_CHUNK;
+
+    KOutMsg( "copy-mode : parallel, %zu connections, %lu bytes per chunk\n", ctx->threads, pf.chunk_size );
+
+    rc = KFileSize ( src, &pf.src_size );
+    if ( rc == 0 )
+        rc = KFileSetSize ( dst, pf.src_size );
+    if ( rc == 0 && ctx->cache_file != NULL )
+    {
+        /* create ( or open ) the cache-file once, before the workers open their own tees on it */
+        const KFile *tee;
+        rc = KDirectoryMakeCacheTee ( dir, &tee, src, ctx->cache_blk, ctx->cache_file );
+        if ( rc == 0 )
+            KFileRelease( tee );
+    }
+    if ( rc == 0 )
+        rc = KLockMake ( &pf.lock );
+    if ( rc == 0 )
+    {
+        pf.chunk_count = ( uint32_t )( ( pf.src_size + pf.chunk_size - 1 ) / pf.chunk_size );
+        pf.chunk_vector = malloc( ( pf.chunk_count + 1 ) * ( sizeof * pf.chunk_vector ) );
+        if ( pf.chunk_vector == NULL )
+            rc = RC( rcExe, rcFile, rcPacking, rcMemory, rcExhausted );
+        else
+        {
+            uint32_t loop;
+            KTimeMs_t t_start, t_ms;
+
+            for ( loop = 0; loop < pf.chunk_count; loop++ )
+                pf.chunk_vector[ loop ] = loop;
+            if ( ctx->random )
+                shuffle_vector( pf.chunk_vector, pf.chunk_count );
+
+            t_start = KTimeMsStamp();
+            rc = par_fetch_run( &pf );
+            t_ms = KTimeMsStamp() - t_start;
+
+            if ( ctx->show_progress ) KOutMsg( "\n" );
+            KOutMsg( "%u chunks a %lu bytes\n", pf.next_chunk, pf.chunk_size );
+            KOutMsg( "%lu bytes copied in %lu ms", pf.bytes_copied, t_ms );
+            if ( t_ms > 0 )
+                KOutMsg( " ( %.2f MB/s )", ( ( double )pf.bytes_copied / ( 1024 * 1024 ) ) / ( ( double )t_ms / 1000 ) );
+            KOutMsg( "\n" );
+
+            free( pf.chunk_vector );
+
+            if ( rc == 0 && pf.bytes_copied != pf.src_size )
+            {
+                rc = RC( rcExe, rcFile, rcReading, rcTransfer, rcIncomplete );
+                (void)PLOGERR( klogErr, ( klogErr, rc, "$(c) of $(s) bytes copied",
+                                          "c=%lu,s=%lu", pf.bytes_copied, pf.src_size ) );
+            }
+        }
+        KLockRelease ( pf.lock );
+    }
+    if ( rc == 0 && ctx->cache_file != NULL )
+    {
+        const KFile *tee;
+        rc = KDirectoryMakeCacheTee ( dir, &tee, src, ctx->cache_blk, ctx->cache_file );
+        if ( rc == 0 )
+        {
+            bool complete = false;
+            rc = IsCacheTeeComplete( tee, &complete );
+            KOutMsg( "cache complete = %s\n", complete ? "YES" : "NO" );
+            KFileRelease( tee );
+        }
+    }
+    return rc;
+}
+
+
+static void extract_name( char ** dst, const char * url )
+{
+    char * last_slash = string_rchr ( url, string_size( url ), '/' );
+    if ( last_slash == NULL )
+        *dst = string_dup_measure( "out.bin", NULL );
+    else
+        *dst = string_dup_measure( last_slash + 1, NULL );
+}
+
+
+static rc_t fetch_from( KDirectory *dir, struct KNSManager * kns_mgr, fetch_ctx *ctx,
+                        char * outfile, const KFile * src )
+{
+    uint64_t file_size;
+    rc_t rc = KFileSize( src, &file_size );
+    if ( rc != 0 )
+        KOutMsg( "cannot disover src-size >%R<\n", rc );
+    else
+    {
+        KFile *dst;
+        KOutMsg( "src-size = %lu\n", file_size );
+        rc = KDirectoryCreateFile ( dir, &dst, false, 0664, kcmInit, outfile );
+        if ( rc == 0 )
+        {
+            KOutMsg( "dst >%s< created\n", outfile );
+            if ( rc == 0 )
+            {
+                if ( ctx->threads > 1 )
+                    rc = fetch_parallel( dir, kns_mgr, src, dst, ctx );
+                else if ( ctx->cache_file != NULL )
+                    rc = fetch_cached( dir, src, dst, ctx );
+                else
+                    rc = copy_file( src, dst, ctx );
+            }
+            KFileRelease( dst );
+        }
+    }
+    return rc;
+}
+
+
 static rc_t fetch( KDirectory *dir, fetch_ctx *ctx )
 {
     rc_t rc = 0;
@@ -495,7 +759,7 @@ static rc_t fetch( KDirectory *dir, fetch_ctx *ctx )
             rc = make_remote_file( kns_mgr, &remote, ctx );
             if ( rc == 0 )
             {
-                rc = fetch_from( dir, ctx, outfile, remote );
+                rc = fetch_from( dir, kns_mgr, ctx, outfile, remote );
                 KFileRelease( remote );
             }
         }
@@ -889,6 +1153,12 @@ rc_t get_fetch_ctx( Args * args, fetch_ctx * ctx )
     if ( rc == 0 ) rc = get_bool( args, OPTION_PROGRESS, &ctx->show_progress );
     if ( rc == 0 ) rc = get_bool( args, OPTION_RELIABLE, &ctx->reliable );
     if ( rc == 0 ) rc = get_bool( args, OPTION_FULL, &ctx->full_download );
+    if ( rc == 0 ) rc = get_size_t( args, OPTION_THREADS, &ctx->threads, 1 );
+    if ( rc == 0 && ctx->threads > 1 && ctx->count > 0 )
+    {
+        rc = RC ( rcApp, rcArgv, rcAccessing, rcParam, rcInvalid );
+        (void)LOGERR( klogErr, rc, "--" OPTION_THREADS " cannot be combined with --" OPTION_COUNT );
+    }
     
     return rc;
 }
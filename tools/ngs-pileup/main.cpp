@@ -33,6 +33,7 @@
 #include <klib/rc.h>
 
 #include <sysalloc.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <iostream>
@@ -43,11 +44,17 @@ const char * ref_usage[] = { "Filter by position on genome.",
                              "Name can either be file specific or canonical",
                              "(ex: \"chr1\" or \"1\").",
                              "\"from\" and \"to\" are 1-based coordinates",
+                             "(ex: \"chr1:1000-2000\")",
                              NULL };
+
+#define OPTION_THREADS "threads"
+#define ALIAS_THREADS  "t"
+const char * threads_usage[] = { "Number of slices processed concurrently ( default 1 )", NULL };
                              
 OptDef options[] =
 {   /*name,           alias,         hfkt, usage-help,    maxcount, needs value, required */
     { OPTION_REF,     ALIAS_REF,     NULL, ref_usage,     0,        true,        false },
+    { OPTION_THREADS, ALIAS_THREADS, NULL, threads_usage, 1,        true,        false },
 };
 
 
@@ -85,6 +92,43 @@ rc_t CC Usage ( const Args * args )
     return rc;
 }
 
+/* "name", "name:from" or "name:from-to", with 1-based coordinates; names of references
+   can contain ':', so the whole region is tried as a name first ( NGS_Pileup::Run ) */
+static
+void AddRegion ( NGS_Pileup::Settings & settings, const std::string & region )
+{
+    std::string::size_type colon = region . rfind ( ':' );
+    if ( colon == std::string::npos )
+    {
+        settings . AddReference ( region );
+        return;
+    }
+    
+    std::string name = region . substr ( 0, colon );
+    std::string range = region . substr ( colon + 1 );
+    std::string::size_type dash = range . find ( '-' );
+    
+    /* not a range: can only be the name of a reference */
+    char * end;
+    int64_t from = strtol ( range . substr ( 0, dash ) . c_str (), & end, 10 );
+    if ( * end != 0 || from < 1 )
+    {
+        settings . AddReference ( region );
+        return;
+    }
+    int64_t to = 0; // 0: up to the end of the reference
+    if ( dash != std::string::npos )
+    {
+        to = strtol ( range . substr ( dash + 1 ) . c_str (), & end, 10 );
+        if ( * end != 0 || to < from )
+        {
+            settings . AddReference ( region );
+            return;
+        }
+    }
+    settings . AddReferenceSlice ( region, name, from - 1, to == 0 ? 0 : to - from + 1 );
+}
+
 rc_t CC KMain( int argc, char *argv [] )
 {
     Args * args;
@@ -99,19 +143,28 @@ rc_t CC KMain( int argc, char *argv [] )
             uint32_t pcount;
             
             rc = ArgsOptionCount ( args, OPTION_REF, &pcount );
-            if ( pcount > 1 )
+            for ( uint32_t i = 0; rc == 0 && i < pcount; ++i )
             {
-                throw ngs :: ErrorMsg ( "multiple positions are not supported at this point" );
+                const void * value;
+                rc = ArgsOptionValue ( args, OPTION_REF, i, & value );
+                if ( rc != 0 )
+                {
+                    throw ngs :: ErrorMsg ( "ArgsOptionValue (" OPTION_REF ") failed" );
+                }
+                AddRegion ( settings, static_cast <char const*> (value) );
             }
-            if ( pcount == 1 )
+            
+            rc = ArgsOptionCount ( args, OPTION_THREADS, &pcount );
+            if ( rc == 0 && pcount == 1 )
             {
                 const void * value;
-                rc = ArgsOptionValue ( args, OPTION_REF, 0, & value );
+                rc = ArgsOptionValue ( args, OPTION_THREADS, 0, & value );
                 if ( rc != 0 )
                 {
-                    throw ngs :: ErrorMsg ( "ArgsOptionValue (" OPTION_REF ") failed" );
+                    throw ngs :: ErrorMsg ( "ArgsOptionValue (" OPTION_THREADS ") failed" );
                 }
-                settings . AddReference ( static_cast <char const*> (value) );
+                int threads = atoi ( static_cast <char const*> (value) );
+                settings . threads = threads > 0 ? threads : 1;
             }
             
             rc = ArgsParamCount ( args, &pcount );
@@ -27,37 +27,117 @@
 #include "ngs-pileup.hpp"
 
 #include <iostream>
+#include <algorithm>
 
 #include <ngs/ncbi/NGS.hpp>
 #include <ngs/ReadCollection.hpp>
-#include <ngs/PileupIterator.hpp>
+#include <ngs/AlignmentIterator.hpp>
+
+#include <kproc/lock.h>
+#include <kproc/cond.h>
+#include <kproc/thread.h>
 
 using namespace std;
 
+/* slices are cut into windows of at most this many positions: the windows are the unit of
+   work for the worker threads, and bound the output held for one window */
+static const int64_t WindowSize = 1024 * 1024;
+
+/* the output is formatted into a buffer of this size before it is written to the stream */
+static const size_t OutputBufferSize = 4 * 1024 * 1024;
+
+/* formats the depth-lines; with a stream the buffer is written whenever it is full,
+   without one it collects the output of a window */
+class OutputBuffer
+{
+public:
+    OutputBuffer ( ostream * p_out = 0 )
+    : m_out ( p_out )
+    {
+        if ( m_out != 0 )
+        {
+            m_buffer . reserve ( OutputBufferSize + 256 );
+        }
+    }
+    ~OutputBuffer ()
+    {
+        Flush ();
+    }
+    
+    void Line ( const string & p_name, int64_t p_pos, uint32_t p_depth )
+    {
+        m_buffer . append ( p_name );
+        m_buffer . push_back ( '\t' );
+        AppendNumber ( ( uint64_t ) p_pos );
+        m_buffer . push_back ( '\t' );
+        AppendNumber ( p_depth );
+        m_buffer . push_back ( '\n' );
+        if ( m_out != 0 && m_buffer . size () >= OutputBufferSize )
+        {
+            Flush ();
+        }
+    }
+    
+    void Flush ()
+    {
+        if ( m_out != 0 && ! m_buffer . empty () )
+        {
+            m_out -> write ( m_buffer . data (), m_buffer . size () );
+            m_buffer . clear ();
+        }
+    }
+    
+    string & Buffer () { return m_buffer; }
+    
+private:
+    void AppendNumber ( uint64_t p_value )
+    {
+        char digits [ 24 ];
+        size_t n = 0;
+        do
+        {
+            digits [ n ++ ] = ( char ) ( '0' + p_value % 10 );
+            p_value /= 10;
+        }
+        while ( p_value != 0 );
+        while ( n > 0 )
+        {
+            m_buffer . push_back ( digits [ -- n ] );
+        }
+    }
+    
+    ostream *   m_out;
+    string      m_buffer;
+};
+
 struct NGS_Pileup::TargetReference
 {
-    typedef pair < int64_t, int64_t >       Slice;
+    typedef pair < int64_t, int64_t >       Slice; // 0-based, inclusive
     typedef vector < Slice >                Slices;
     typedef vector < ngs :: Reference >     Targets;
-    typedef vector < ngs :: PileupIterator> Pileups;
+    typedef vector < int32_t >              Events;
+    typedef pair < size_t, string >         Source; // index of the input, common name
+    typedef vector < Source >               Sources;
     
     string  m_canonicalName;
     Slices  m_slices;
     Targets m_targets;
-    Pileups m_pileups;
+    Sources m_sources;
     bool    m_complete;
     
-    TargetReference ( ngs :: Reference p_ref )
+    TargetReference ( ngs :: Reference p_ref, size_t p_input )
     : m_canonicalName ( p_ref . getCanonicalName() ), m_complete ( true )
     {
-        AddReference ( p_ref );
+        AddReference ( p_ref, p_input );
     }
     TargetReference ( ngs :: Reference p_ref, 
+                      size_t p_input,
                       int64_t p_first, 
                       int64_t p_last )
     : m_canonicalName ( p_ref . getCanonicalName() ), m_complete ( false )
     {
-        AddReference ( p_ref );
+        AddReference ( p_ref, p_input );
+        AddSlice ( p_first, p_last );
     }
     ~TargetReference ()
     {
@@ -65,6 +145,10 @@ struct NGS_Pileup::TargetReference
     
     void AddSlice ( int64_t p_first, int64_t p_last )
     {
+        if ( ! m_complete )
+        {
+            m_slices . push_back ( Slice ( p_first, p_last ) );
+        }
     }
     void MakeComplete ()
     {
@@ -72,42 +156,116 @@ struct NGS_Pileup::TargetReference
         m_slices . clear();
     }
     
-    void AddReference ( ngs :: Reference p_ref )
+    void AddReference ( ngs :: Reference p_ref, size_t p_input )
     {
+        for ( Sources :: const_iterator i = m_sources . begin (); i != m_sources . end (); ++i )
+        {
+            if ( i -> first == p_input )
+            {
+                return;
+            }
+        }
         m_targets. push_back ( p_ref );
+        m_sources . push_back ( Source ( p_input, p_ref . getCommonName () ) );
     }
     
-    void Process ( ostream& out )
+    /* the slices clipped to the reference, sorted and merged; or the whole reference */
+    Slices Regions () const
     {
-        int64_t firstPos = 0;
         int64_t lastPos = m_targets . front () . getLength () - 1;
-
-        // create pileup iterators 
-        for ( Targets::iterator i = m_targets.begin(); i != m_targets.end(); ++i ) 
+        Slices res;
+        if ( m_complete )
+        {
+            res . push_back ( Slice ( 0, lastPos ) );
+        }
+        else
         {
-            m_pileups . push_back ( i -> getPileups ( ngs::Alignment::all ) );
+            Slices slices ( m_slices );
+            sort ( slices . begin (), slices . end () );
+            for ( Slices :: iterator i = slices . begin (); i != slices . end (); ++i )
+            {
+                int64_t first = i -> first < 0 ? 0 : i -> first;
+                int64_t last = ( i -> second < 0 || i -> second > lastPos ) ? lastPos : i -> second; // < 0: up to the end
+                if ( first > last )
+                {
+                    continue;
+                }
+                if ( ! res . empty () && first <= res . back () . second + 1 )
+                {
+                    res . back () . second = max ( res . back () . second, last );
+                }
+                else
+                {
+                    res . push_back ( Slice ( first, last ) );
+                }
+            }
         }
+        return res;
+    }
+    
+    /* The depth of a position is the number of alignments covering it. Every alignment
+       overlapping the window adds +1 at its start and -1 past its end; the running sum
+       over the window is the depth, no pileup is materialised per position.
+       On a circular reference an alignment can run past the end of the reference: that
+       part covers the start of the reference. Such alignments are also returned for the
+       windows at the start, where their own start is past the window. */
+    static void Process ( const string & p_name, 
+                          const Targets & p_targets, 
+                          int64_t p_first, 
+                          int64_t p_last, 
+                          Events & events,
+                          OutputBuffer & out )
+    {
+        size_t len = ( size_t ) ( p_last - p_first + 1 );
+        events . assign ( len + 1, 0 );
         
-        int64_t curPos = firstPos;
-        while ( curPos <= lastPos ) 
+        for ( Targets::const_iterator i = p_targets.begin(); i != p_targets.end(); ++i ) 
         {
-            uint32_t total_depth = 0;
-            for ( Pileups :: iterator i = m_pileups . begin (); i != m_pileups. end (); ++i )
+            int64_t refLength = i -> getIsCircular () ? ( int64_t ) i -> getLength () : 0;
+            ngs :: AlignmentIterator it = i -> getAlignmentSlice ( p_first, len, ngs::Alignment::all );
+            while ( it . nextAlignment () )
             {
-                bool next = i -> nextPileup ();
-                assert ( next );
-                total_depth += i -> getPileupDepth ();
+                int64_t start = it . getAlignmentPosition ();
+                int64_t end = start + ( int64_t ) it . getAlignmentLength (); // exclusive
+                if ( refLength > 0 && end > refLength )
+                {
+                    AddEvents ( events, p_first, p_last, start, refLength );
+                    AddEvents ( events, p_first, p_last, 0, end - refLength );
+                }
+                else
+                {
+                    AddEvents ( events, p_first, p_last, start, end );
+                }
             }
+        }
         
-            if ( total_depth > 0 )
+        int64_t depth = 0;
+        for ( size_t i = 0; i < len; ++i )
+        {
+            depth += events [ i ];
+            if ( depth > 0 )
             {
-                out << m_canonicalName
-                    << '\t' << ( curPos + 1 ) // convert to 1-based position to emulate samtools
-                    << '\t' << total_depth
-                    << endl;
+                // convert to 1-based position to emulate samtools
+                out . Line ( p_name, p_first + ( int64_t ) i + 1, ( uint32_t ) depth );
             }
-            
-            ++ curPos;
+        }
+    }
+    
+    /* one alignment covering [p_start, p_end), clipped to the window */
+    static void AddEvents ( Events & events, int64_t p_first, int64_t p_last, int64_t p_start, int64_t p_end )
+    {
+        if ( p_start < p_first )
+        {
+            p_start = p_first;
+        }
+        if ( p_end > p_last + 1 )
+        {
+            p_end = p_last + 1;
+        }
+        if ( p_start < p_end )
+        {
+            ++ events [ p_start - p_first ];
+            -- events [ p_end - p_first ];
         }
     }
 };
@@ -115,20 +273,250 @@ struct NGS_Pileup::TargetReference
 class NGS_Pileup::TargetReferences : public vector < TargetReference >
 {
 public :
-    void AddComplete ( ngs :: Reference ref )
+    TargetReference * Find ( const string & name )
     {
-        string name = ref . getCanonicalName ();
         for ( iterator i = begin(); i != end (); ++ i )
         {   
             if ( i -> m_canonicalName == name )
             {
-                i -> AddReference ( ref );
-                return;
+                return & ( * i );
+            }
+        }
+        return 0;
+    }
+
+    void AddComplete ( ngs :: Reference ref, size_t input )
+    {
+        TargetReference * target = Find ( ref . getCanonicalName () );
+        if ( target != 0 )
+        {
+            target -> AddReference ( ref, input );
+            target -> MakeComplete ();
+        }
+        else
+        {
+            // not found - add new reference
+            push_back ( TargetReference ( ref, input ) );
+        }
+    }
+    
+    void AddSlice ( ngs :: Reference ref, size_t input, int64_t first, int64_t last )
+    {
+        TargetReference * target = Find ( ref . getCanonicalName () );
+        if ( target != 0 )
+        {
+            target -> AddReference ( ref, input );
+            target -> AddSlice ( first, last );
+        }
+        else
+        {
+            push_back ( TargetReference ( ref, input, first, last ) );
+        }
+    }
+};
+
+struct NGS_Pileup::Window
+{
+    size_t  m_target;
+    int64_t m_first;
+    int64_t m_last;
+    
+    Window ( size_t p_target, int64_t p_first, int64_t p_last )
+    : m_target ( p_target ), m_first ( p_first ), m_last ( p_last )
+    {
+    }
+};
+
+/* The windows are handed out to worker threads in order, each worker with its own
+   read-collections. The output of a window is kept until all windows before it are
+   written; the workers stay at most a few windows ahead of the writer. */
+class NGS_Pileup::WindowPool
+{
+public:
+    WindowPool ( const Settings & p_settings, 
+                 const TargetReferences & p_references, 
+                 const vector < Window > & p_windows )
+    :   m_settings ( p_settings ),
+        m_references ( p_references ),
+        m_windows ( p_windows ),
+        m_output ( p_windows . size () ),
+        m_done ( p_windows . size (), false ),
+        m_next ( 0 ),
+        m_emitted ( 0 ),
+        m_ahead ( 2 * p_settings . threads ),
+        m_failed ( false ),
+        m_lock ( 0 ),
+        m_cond ( 0 )
+    {
+        if ( KLockMake ( & m_lock ) != 0 || KConditionMake ( & m_cond ) != 0 )
+        {
+            KLockRelease ( m_lock );
+            throw ngs :: ErrorMsg ( "cannot create the worker threads" );
+        }
+    }
+    ~WindowPool ()
+    {
+        KConditionRelease ( m_cond );
+        KLockRelease ( m_lock );
+    }
+    
+    void Run ( ostream & out )
+    {
+        vector < KThread * > workers;
+        for ( unsigned i = 0; i < m_settings . threads && i < m_windows . size (); ++i )
+        {
+            KThread * t;
+            if ( KThreadMake ( & t, Worker, this ) == 0 )
+            {
+                workers . push_back ( t );
+            }
+        }
+        if ( workers . empty () )
+        {
+            throw ngs :: ErrorMsg ( "cannot create the worker threads" );
+        }
+        
+        // write the output of the windows in order
+        for ( size_t idx = 0; idx < m_windows . size (); ++idx )
+        {
+            string output;
+            KLockAcquire ( m_lock );
+            while ( ! m_done [ idx ] && ! m_failed )
+            {
+                KConditionWait ( m_cond, m_lock );
+            }
+            bool failed = m_failed;
+            if ( ! failed )
+            {
+                output . swap ( m_output [ idx ] );
+                m_emitted = idx + 1;
+                KConditionBroadcast ( m_cond );
             }
+            KLockUnlock ( m_lock );
+            
+            if ( failed )
+            {
+                break;
+            }
+            out . write ( output . data (), output . size () );
+        }
+        
+        for ( vector < KThread * > :: iterator i = workers . begin (); i != workers . end (); ++i )
+        {
+            rc_t rc;
+            KThreadWait ( * i, & rc );
+            KThreadRelease ( * i );
         }
-        // not found - add new reference
-        push_back ( TargetReference ( ref ) );
+        if ( m_failed )
+        {
+            throw ngs :: ErrorMsg ( m_error );
+        }
+    }
+    
+private:
+    static rc_t CC Worker ( const KThread * self, void * data )
+    {
+        WindowPool * pool = static_cast < WindowPool * > ( data );
+        try
+        {
+            pool -> Work ();
+        }
+        catch ( ngs :: ErrorMsg & ex )
+        {
+            pool -> Fail ( ex . what () );
+        }
+        catch ( ... )
+        {
+            pool -> Fail ( "unknown error in worker thread" );
+        }
+        return 0;
     }
+    
+    void Work ()
+    {
+        vector < ngs :: ReadCollection > cols;
+        for ( Settings :: Inputs :: const_iterator i = m_settings . inputs . begin(); 
+              i != m_settings . inputs . end (); 
+              ++i )
+        {   
+            cols . push_back ( ncbi :: NGS :: openReadCollection ( *i ) );
+        }
+        
+        // the references of this worker, opened when first needed
+        vector < TargetReference :: Targets > targets ( m_references . size () );
+        TargetReference :: Events events;
+        
+        size_t idx;
+        while ( Next ( idx ) )
+        {
+            const Window & w = m_windows [ idx ];
+            const TargetReference & ref = m_references [ w . m_target ];
+            TargetReference :: Targets & t = targets [ w . m_target ];
+            if ( t . empty () )
+            {
+                for ( TargetReference :: Sources :: const_iterator i = ref . m_sources . begin (); 
+                      i != ref . m_sources . end (); 
+                      ++i )
+                {
+                    t . push_back ( cols [ i -> first ] . getReference ( i -> second ) );
+                }
+            }
+            
+            OutputBuffer out;
+            TargetReference :: Process ( ref . m_canonicalName, t, w . m_first, w . m_last, events, out );
+            Done ( idx, out . Buffer () );
+        }
+    }
+    
+    bool Next ( size_t & idx )
+    {
+        KLockAcquire ( m_lock );
+        while ( ! m_failed && m_next < m_windows . size () && m_next >= m_emitted + m_ahead )
+        {
+            KConditionWait ( m_cond, m_lock );
+        }
+        bool res = ( ! m_failed && m_next < m_windows . size () );
+        if ( res )
+        {
+            idx = m_next ++;
+        }
+        KLockUnlock ( m_lock );
+        return res;
+    }
+    
+    void Done ( size_t idx, string & output )
+    {
+        KLockAcquire ( m_lock );
+        m_output [ idx ] . swap ( output );
+        m_done [ idx ] = true;
+        KConditionBroadcast ( m_cond );
+        KLockUnlock ( m_lock );
+    }
+    
+    void Fail ( const string & error )
+    {
+        KLockAcquire ( m_lock );
+        if ( ! m_failed )
+        {
+            m_failed = true;
+            m_error = error;
+        }
+        KConditionBroadcast ( m_cond );
+        KLockUnlock ( m_lock );
+    }
+    
+    const Settings &            m_settings;
+    const TargetReferences &    m_references;
+    const vector < Window > &   m_windows;
+    vector < string >           m_output;
+    vector < bool >             m_done;
+    size_t                      m_next;
+    size_t                      m_emitted;
+    size_t                      m_ahead;
+    bool                        m_failed;
+    string                      m_error;
+    KLock *                     m_lock;
+    KCondition *                m_cond;
 };
  
 NGS_Pileup::NGS_Pileup ( const Settings& p_settings )
@@ -137,18 +525,53 @@ NGS_Pileup::NGS_Pileup ( const Settings& p_settings )
 }
 
 static
-bool FindReference ( const NGS_Pileup :: Settings :: References & requested, const ngs :: Reference & ref )
+bool IsNamed ( const string & name, const ngs :: Reference & ref )
+{
+    return name == ref . getCanonicalName () || name == ref . getCommonName ();
+}
+
+/* a region which is itself the name of a reference requests the entire reference */
+static
+void ResolveRegions ( NGS_Pileup :: Settings :: References & requested, const ngs :: Reference & ref )
 {
-    for ( NGS_Pileup :: Settings :: References :: const_iterator i = requested . begin(); 
+    for ( NGS_Pileup :: Settings :: References :: iterator i = requested . begin(); 
           i != requested . end (); 
           ++i )
     {   
-        if ( i->m_name == ref . getCanonicalName () || i->m_name == ref . getCommonName () )
+        if ( ! i -> m_region . empty () && IsNamed ( i -> m_region, ref ) )
+        {
+            * i = NGS_Pileup :: Settings :: ReferenceSlice ( i -> m_region );
+        }
+    }
+}
+
+static
+bool FindReference ( const NGS_Pileup :: Settings :: References & requested, 
+                     const ngs :: Reference & ref,
+                     bool & complete,
+                     vector < pair < int64_t, int64_t > > & slices,
+                     vector < bool > & matched )
+{
+    bool found = false;
+    for ( size_t i = 0; i < requested . size (); ++i )
+    {   
+        const NGS_Pileup :: Settings :: ReferenceSlice & req = requested [ i ];
+        if ( IsNamed ( req . m_name, ref ) )
         {
-            return true;
+            found = true;
+            matched [ i ] = true;
+            if ( req . m_full )
+            {
+                complete = true;
+            }
+            else
+            {
+                int64_t last = req . m_length == 0 ? -1 : req . m_firstPos + ( int64_t ) req . m_length - 1; // < 0: up to the end
+                slices . push_back ( make_pair ( req . m_firstPos, last ) );
+            }
         }
     }
-    return false;
+    return found;
 }
     
 void 
@@ -156,36 +579,93 @@ NGS_Pileup::Run () const
 {
     TargetReferences references;
     
+    // open the inputs; a requested region which names a reference is that reference
+    vector < ngs :: ReadCollection > cols;
+    Settings :: References requested ( m_settings . references );
+    for ( size_t input = 0; input < m_settings . inputs . size (); ++input )
+    {   
+        cols . push_back ( ncbi :: NGS :: openReadCollection ( m_settings . inputs [ input ] ) );
+        if ( ! requested . empty () )
+        {
+            ngs :: ReferenceIterator refIt = cols . back () . getReferences ();
+            while ( refIt . nextReference () )
+            {
+                ResolveRegions ( requested, refIt );
+            }
+        }
+    }
+    
     // build the set of target references
-    for ( Settings :: Inputs :: const_iterator i = m_settings . inputs . begin(); 
-          i != m_settings . inputs . end (); 
-          ++i )
+    vector < bool > matched ( requested . size (), false );
+    for ( size_t input = 0; input < cols . size (); ++input )
     {   
-        ngs :: ReadCollection col = ncbi :: NGS :: openReadCollection ( *i );
+        ngs :: ReadCollection & col = cols [ input ];
         ngs :: ReferenceIterator refIt = col . getReferences ();
         while ( refIt . nextReference () )
         {
-            if ( m_settings . references . empty () ) // all references requested
+            bool complete = false;
+            TargetReference :: Slices slices;
+            if ( requested . empty () ) // all references requested
             {
                 /* need to create a Reference object that is not attached to the iterator, so as
                     it is not invalidated on the next call to refIt.NextReference() */
-                references . AddComplete ( col . getReference ( refIt. getCommonName () ) );
+                references . AddComplete ( col . getReference ( refIt. getCommonName () ), input );
             }
-            else if ( FindReference ( m_settings . references, refIt ) )
+            else if ( FindReference ( requested, refIt, complete, slices, matched ) )
+            {
+                ngs :: Reference ref = col . getReference ( refIt. getCommonName () );
+                if ( complete )
+                {
+                    references . AddComplete ( ref, input );
+                }
+                for ( TargetReference :: Slices :: const_iterator i = slices . begin (); i != slices . end (); ++i )
+                {
+                    references . AddSlice ( ref, input, i -> first, i -> second );
+                }
+            }
+        }
+    }
+    for ( size_t i = 0; i < requested . size (); ++i )
+    {
+        if ( ! matched [ i ] )
+        {
+            throw ngs :: ErrorMsg ( "unknown reference or invalid region: " + 
+                ( requested [ i ] . m_region . empty () ? requested [ i ] . m_name : requested [ i ] . m_region ) );
+        }
+    }
+    
+    // cut the requested regions into windows
+    vector < Window > windows;
+    for ( size_t target = 0; target < references . size (); ++target )
+    {   
+        TargetReference :: Slices regions = references [ target ] . Regions ();
+        for ( TargetReference :: Slices :: const_iterator i = regions . begin (); i != regions . end (); ++i )
+        {
+            for ( int64_t first = i -> first; first <= i -> second; first += WindowSize )
             {
-                //TODO: handle slices
-                references . AddComplete ( col . getReference ( refIt. getCommonName () ) );
+                windows . push_back ( Window ( target, first, min ( first + WindowSize - 1, i -> second ) ) );
             }
         }
     }
     
     ostream & out ( m_settings . output != (ostream*)0 ? * m_settings . output : cout );
     
-    // walk the references and output pileups
-    for ( TargetReferences :: iterator i = references . begin(); i != references . end (); ++i )
-    {   
-        i -> Process ( out );
+    if ( m_settings . threads > 1 && windows . size () > 1 )
+    {
+        WindowPool ( m_settings, references, windows ) . Run ( out );
+    }
+    else
+    {
+        // walk the windows and output the depth
+        OutputBuffer buffer ( & out );
+        TargetReference :: Events events;
+        for ( vector < Window > :: const_iterator i = windows . begin (); i != windows . end (); ++i )
+        {   
+            const TargetReference & ref = references [ i -> m_target ];
+            TargetReference :: Process ( ref . m_canonicalName, ref . m_targets, i -> m_first, i -> m_last, events, buffer );
+        }
     }
+    out . flush ();
 }
 
 //// NGS_Pileup::Settings
@@ -199,8 +679,16 @@ NGS_Pileup::Settings::AddReference ( const string& commonOrCanonicalName )
 void 
 NGS_Pileup::Settings::AddReferenceSlice ( const string& commonOrCanonicalName, 
                                         int64_t firstPos, 
-                                        int64_t lastPos )
+                                        uint64_t length )
 { 
-    references . push_back ( ReferenceSlice ( commonOrCanonicalName, firstPos, lastPos ) ); 
+    references . push_back ( ReferenceSlice ( commonOrCanonicalName, firstPos, length ) ); 
 }
 
+void 
+NGS_Pileup::Settings::AddReferenceSlice ( const string& region,
+                                        const string& commonOrCanonicalName, 
+                                        int64_t firstPos, 
+                                        uint64_t length )
+{ 
+    references . push_back ( ReferenceSlice ( commonOrCanonicalName, firstPos, length, region ) ); 
+}
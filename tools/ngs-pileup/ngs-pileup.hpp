@@ -47,31 +47,46 @@ public:
             ReferenceSlice( const std::string& p_name ) /* entire reference */
             :   m_name ( p_name ), 
                 m_firstPos ( 0 ),
-                m_lastPos ( 0 ),
+                m_length ( 0 ),
                 m_full ( true )
             {
             }
             ReferenceSlice( const std::string& p_name, 
                             int64_t p_firstPos, 
-                            int64_t p_lastPos )
+                            uint64_t p_length,
+                            const std::string& p_region = std::string () )
             :   m_name ( p_name ), 
+                m_region ( p_region ),
                 m_firstPos ( p_firstPos ),
-                m_lastPos ( p_lastPos ),
+                m_length ( p_length ),
                 m_full ( false )
             {
             }
             
             std::string m_name;
-            int64_t     m_firstPos; 
-            int64_t     m_lastPos;
+            std::string m_region;   /* "name:from-to" as given, if not empty: the entire reference when one has this name */
+            int64_t     m_firstPos; /* 0-based */
+            uint64_t    m_length;   /* 0: up to the end of the reference */
             bool        m_full;
         };
         
+        Settings ()
+        :   output ( 0 ),
+            threads ( 1 )
+        {
+        }
+        
         void AddInput ( const std::string& accession ) { inputs . push_back ( accession ); }
         void AddReference ( const std::string& commonOrCanonicalName );
+        /* firstPos is 0-based, length 0 means up to the end of the reference */
         void AddReferenceSlice ( const std::string& commonOrCanonicalName, 
                                  int64_t firstPos, 
-                                 int64_t lastPos );
+                                 uint64_t length );
+        /* same, parsed from region; region itself is tried as a reference name first */
+        void AddReferenceSlice ( const std::string& region,
+                                 const std::string& commonOrCanonicalName, 
+                                 int64_t firstPos, 
+                                 uint64_t length );
                                  
                                  
         typedef std::vector < std::string > Inputs;
@@ -80,6 +95,7 @@ public:
         Inputs inputs;
         std::ostream* output;
         References references;
+        unsigned threads; /* slices processed concurrently */
     };
     
 public:
@@ -90,6 +106,8 @@ public:
 private:
     struct TargetReference;
     class TargetReferences;
+    struct Window;
+    class WindowPool;
     
     Settings            m_settings;
 };
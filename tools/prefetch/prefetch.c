@@ -59,6 +59,7 @@
 #include <kfs/subfile.h> /* KFileMakeSubRead */
 #include <kfs/cacheteefile.h> /* KDirectoryMakeCacheTee */
 
+#include <klib/checksum.h> /* MD5State */
 #include <klib/container.h> /* BSTree */
 #include <klib/data-buffer.h> /* KDataBuffer */
 #include <klib/log.h> /* PLOGERR */
@@ -222,6 +223,8 @@ typedef struct {
 
     bool dryRun; /* Dry run the app: don't download, only check resolving */
 
+    bool noVerify; /* don't check md5 of downloaded http stream */
+
     const char * location; /* do not free! */
     const char * outDir;  /* do not free! */
     const char * outFile; /* do not free! */
@@ -1253,6 +1256,12 @@ static rc_t MainDownloadHttpFile(Resolved *self,
     const VPathStr * remote = NULL;
     String src;
 
+    /* md5 is calculated on the fly while the stream is written:
+       no need to re-read the downloaded file to verify it */
+    MD5State md5;
+    const uint8_t * md5Expected = NULL;
+    uint64_t szExpected = 0;
+
     KStsLevel lvl = STS_INFO;
 
     char spath[PATH_MAX] = "";
@@ -1278,6 +1287,13 @@ static rc_t MainDownloadHttpFile(Resolved *self,
                                                : & self -> remoteHttps;
     assert(remote);
 
+    if (!mane->dryRun && !mane->stripQuals && !mane->noVerify) {
+        md5Expected = VPathGetMd5(path);
+        szExpected = VPathGetSize(path);
+        if (md5Expected != NULL)
+            MD5StateInit(&md5);
+    }
+
     if (rc == 0 && !mane->dryRun) {
         STSMSG(STS_DBG, ("creating %s", to));
         rc = KDirectoryCreateFile(mane->dir, &out,
@@ -1382,6 +1398,8 @@ static rc_t MainDownloadHttpFile(Resolved *self,
                         rc = RC ( rcExe,
                             rcFile, rcCopying, rcTransfer, rcIncomplete );
                     }
+                    if ( rc == 0 && md5Expected != NULL )
+                        MD5StateAppend ( & md5, mane -> buffer, num_writ );
                     opos += num_writ;
                 }
 
@@ -1396,6 +1414,25 @@ static rc_t MainDownloadHttpFile(Resolved *self,
 
     RELEASE(KFile, out);
 
+    if (rc == 0 && szExpected != 0 && opos != szExpected) {
+        rc = RC(rcExe, rcFile, rcCopying, rcTransfer, rcIncomplete);
+        PLOGERR(klogErr, (klogErr, rc, "$(path): size mismatch: "
+            "expected $(exp), downloaded $(got)", "path=%S,exp=%lu,got=%lu",
+            &src, szExpected, opos));
+    }
+
+    if (rc == 0 && md5Expected != NULL) {
+        uint8_t digest[16];
+        MD5StateFinish(&md5, digest);
+        if (memcmp(digest, md5Expected, sizeof digest) != 0) {
+            rc = RC(rcExe, rcFile, rcValidating, rcChecksum, rcUnequal);
+            PLOGERR(klogErr, (klogErr, rc,
+                "$(path): md5 mismatch", "path=%S", &src));
+        }
+        else
+            STSMSG(STS_DBG, ("%s: md5 ok", to));
+    }
+
     if (rc == 0 && !mane->dryRun)
         STSMSG(STS_INFO, ("%s (%ld)", to, opos));
 
@@ -3519,6 +3556,11 @@ static const char* TRANS_USAGE[] = { "Transport: one of: fasp; http; both.",
 static const char* TYPE_USAGE[] = { "Specify file type to download.",
     "Default: sra", NULL };
 
+#define VERIFY_OPTION "verify"
+static const char* VERIFY_USAGE[] = {
+    "Verify md5 of downloaded files while downloading: one of: no, yes.",
+    "Default: yes", NULL };
+
 #define DEFAULT_MAX_FILE_SIZE "20G"
 #define SIZE_OPTION "max-size"
 #define SIZE_ALIAS  "X"
@@ -3553,6 +3595,7 @@ static OptDef OPTIONS[] = {
 ,{ FORCE_OPTION       , FORCE_ALIAS       , NULL, FORCE_USAGE , 1, true, false }
 ,{ HBEAT_OPTION       , HBEAT_ALIAS       , NULL, HBEAT_USAGE , 1, true, false }
 ,{ ELIM_QUALS_OPTION  , NULL             ,NULL,ELIM_QUALS_USAGE,1, false,false }
+,{ VERIFY_OPTION      , NULL              , NULL, VERIFY_USAGE, 1, true, false }
 ,{ CHECK_ALL_OPTION   , CHECK_ALL_ALIAS   ,NULL,CHECK_ALL_USAGE,1, false,false }
 ,{ LIST_OPTION        , LIST_ALIAS        , NULL, LIST_USAGE  , 1, false,false }
 ,{ NM_L_OPTION        , NM_L_ALIAS        , NULL, NM_L_USAGE  , 1, false,false }
@@ -4012,6 +4055,33 @@ option_name = TYPE_OPTION;
         if ( self->outFile != NULL )
             self->outDir = NULL;
 
+/* VERIFY_OPTION */
+        rc = ArgsOptionCount(self->args, VERIFY_OPTION, &pcount);
+        if (rc != 0) {
+            LOGERR(klogErr, rc, "Failure to get '" VERIFY_OPTION "' argument");
+            break;
+        }
+        if (pcount > 0) {
+            const char *val = NULL;
+            rc = ArgsOptionValue(self->args,
+                VERIFY_OPTION, 0, (const void **)&val);
+            if (rc != 0) {
+                LOGERR(klogErr, rc,
+                    "Failure to get '" VERIFY_OPTION "' argument value");
+                break;
+            }
+            if (val != NULL && (val[0] == 'n' || val[0] == 'N'))
+                self->noVerify = true;
+            else if (val != NULL && (val[0] == 'y' || val[0] == 'Y'))
+                self->noVerify = false;
+            else {
+                rc = RC(rcExe, rcArgv, rcParsing, rcParam, rcInvalid);
+                LOGERR(klogErr, rc,
+                    "Unrecognized '" VERIFY_OPTION "' argument value");
+                break;
+            }
+        }
+
 /* ORDR_OPTION */
         rc = ArgsOptionCount(self->args, ORDR_OPTION, &pcount);
         if (rc != 0) {
@@ -4141,7 +4211,8 @@ rc_t CC Usage(const Args *args) {
             param = "FILE";
             alias = OUT_FILE_ALIAS;
         }
-        else if (strcmp(opt->name, ASCP_PAR_OPTION) == 0)
+        else if (strcmp(opt->name, ASCP_PAR_OPTION) == 0 ||
+                 strcmp(opt->name, VERIFY_OPTION) == 0)
             param = "value";
         else if (strcmp(opt->name, DRY_RUN_OPTION) == 0)
             continue; /* debug option */
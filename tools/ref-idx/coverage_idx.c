@@ -0,0 +1,691 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnologmsgy Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+#include "coverage_idx.h"
+#include "coverage_iter.h"
+#include "common.h"
+
+#include <klib/text.h>
+#include <klib/printf.h>
+
+#include <kfs/directory.h>
+#include <kfs/file.h>
+
+#include <kproc/lock.h>
+#include <kproc/thread.h>
+
+/* ----------------------------------------------------------------------------------------------- */
+
+/* the index-file ( native byte-order ):
+    header
+    ref-entry[ ref_count ]
+    names of the references ( not 0-terminated )
+    for each reference:
+        uint32_t alignment-count[ row_count ]
+        uint32_t coverage[ reflen ]
+        CoverageBin bins_1kb[]
+        CoverageBin bins_100kb[]
+*/
+
+#define COVERAGE_IDX_MAGIC "RCOVIDX1"
+
+typedef struct cov_idx_hdr
+{
+    char magic[ 8 ];
+    uint32_t ref_count;
+    uint32_t bin_size[ COVERAGE_IDX_LEVELS ];
+    uint32_t reserved;
+    uint64_t names_offset;
+    uint64_t names_size;
+} cov_idx_hdr;
+
+typedef struct cov_idx_ref
+{
+    int64_t start_row_id;
+    uint64_t row_count;
+    uint64_t reflen;
+    uint64_t name_offset;       /* relative to the names */
+    uint32_t name_len;
+    uint32_t block_size;
+    uint64_t rows_offset;
+    uint64_t bases_offset;
+    uint64_t bins_offset[ COVERAGE_IDX_LEVELS ];
+} cov_idx_ref;
+
+typedef struct coverage_idx
+{
+    const KFile * f;
+    cov_idx_hdr hdr;
+    cov_idx_ref * refs;
+    char * names;
+} coverage_idx;
+
+
+uint32_t coverage_idx_bin_size( uint32_t level )
+{
+    return ( level == 0 ) ? COVERAGE_IDX_BIN_1 : COVERAGE_IDX_BIN_2;
+}
+
+static uint64_t bin_count( uint64_t reflen, uint32_t level )
+{
+    uint32_t bin_size = coverage_idx_bin_size( level );
+    return ( reflen + bin_size - 1 ) / bin_size;
+}
+
+static uint64_t align8( uint64_t offset )
+{
+    return ( offset + 7 ) & ~( uint64_t )7;
+}
+
+
+/* ----------------------------------------------------------------------------------------------- */
+
+/* the 1 kb bins are made from the bases, the 100 kb bins from the 1 kb bins */
+static void make_bins( const uint32_t * coverage, uint64_t reflen, CoverageBin * bins_1, CoverageBin * bins_2 )
+{
+    uint64_t pos, n1 = bin_count( reflen, 0 ), n2 = bin_count( reflen, 1 );
+    uint64_t i;
+    const uint64_t per_bin_2 = COVERAGE_IDX_BIN_2 / COVERAGE_IDX_BIN_1;
+
+    for ( i = 0; i < n1; ++i )
+    {
+        bins_1[ i ].min = 0xFFFFFFFF;
+        bins_1[ i ].max = 0;
+        bins_1[ i ].sum = 0;
+    }
+    for ( pos = 0; pos < reflen; ++pos )
+    {
+        CoverageBin * b = &bins_1[ pos / COVERAGE_IDX_BIN_1 ];
+        uint32_t c = coverage[ pos ];
+        if ( c < b->min ) b->min = c;
+        if ( c > b->max ) b->max = c;
+        b->sum += c;
+    }
+    for ( i = 0; i < n2; ++i )
+    {
+        bins_2[ i ].min = 0xFFFFFFFF;
+        bins_2[ i ].max = 0;
+        bins_2[ i ].sum = 0;
+    }
+    for ( i = 0; i < n1; ++i )
+    {
+        CoverageBin * b = &bins_2[ i / per_bin_2 ];
+        if ( bins_1[ i ].min < b->min ) b->min = bins_1[ i ].min;
+        if ( bins_1[ i ].max > b->max ) b->max = bins_1[ i ].max;
+        b->sum += bins_1[ i ].sum;
+    }
+}
+
+
+typedef struct build_ctx
+{
+    const char * src;
+    size_t cache_capacity;
+    const Vector * refs;
+    const cov_idx_ref * entries;
+    KFile * f;
+    KLock * lock;
+    uint32_t next;
+    rc_t rc;
+} build_ctx;
+
+
+static bool build_next( build_ctx * ctx, uint32_t * idx )
+{
+    bool res;
+    KLockAcquire( ctx->lock );
+    res = ( ctx->rc == 0 && ctx->next < VectorLength( ctx->refs ) );
+    if ( res )
+        *idx = ctx->next++;
+    KLockUnlock( ctx->lock );
+    return res;
+}
+
+
+static rc_t write_section( build_ctx * ctx, uint64_t pos, const void * buffer, size_t size )
+{
+    size_t num_writ;
+    rc_t rc = KFileWriteAll( ctx->f, pos, buffer, size, &num_writ );
+    if ( rc != 0 )
+        log_err( "coverage_idx_build() : KFileWriteAll() failed %R", rc );
+    else if ( num_writ != size )
+    {
+        rc = RC( rcApp, rcFile, rcWriting, rcTransfer, rcIncomplete );
+        log_err( "coverage_idx_build() : KFileWriteAll() incomplete" );
+    }
+    return rc;
+}
+
+
+static rc_t build_one_ref( build_ctx * ctx, uint32_t idx )
+{
+    const RefT * ref = VectorGet( ctx->refs, VectorStart( ctx->refs ) + idx );
+    const cov_idx_ref * e = &ctx->entries[ idx ];
+    uint32_t * coverage;
+    uint32_t * row_counts;
+    rc_t rc = reference_coverage_make( ctx->src, ctx->cache_capacity, ref, &coverage, &row_counts );
+    if ( rc == 0 )
+    {
+        uint64_t n1 = bin_count( ref->reflen, 0 );
+        uint64_t n2 = bin_count( ref->reflen, 1 );
+        CoverageBin * bins = malloc( ( n1 + n2 ) * sizeof *bins );
+        if ( bins == NULL )
+        {
+            rc = RC( rcApp, rcNoTarg, rcAllocating, rcMemory, rcExhausted );
+            log_err( "coverage_idx_build() memory exhausted" );
+        }
+        else
+        {
+            make_bins( coverage, ref->reflen, bins, bins + n1 );
+            /* every reference has its own part of the file, no locking needed */
+            rc = write_section( ctx, e->rows_offset, row_counts, ref->count * sizeof *row_counts );
+            if ( rc == 0 )
+                rc = write_section( ctx, e->bases_offset, coverage, ref->reflen * sizeof *coverage );
+            if ( rc == 0 )
+                rc = write_section( ctx, e->bins_offset[ 0 ], bins, n1 * sizeof *bins );
+            if ( rc == 0 )
+                rc = write_section( ctx, e->bins_offset[ 1 ], bins + n1, n2 * sizeof *bins );
+            free( ( void * ) bins );
+        }
+        free( ( void * ) coverage );
+        free( ( void * ) row_counts );
+    }
+    return rc;
+}
+
+
+static rc_t CC build_thread( const KThread * self, void * data )
+{
+    build_ctx * ctx = data;
+    uint32_t idx;
+    while ( build_next( ctx, &idx ) )
+    {
+        rc_t rc = build_one_ref( ctx, idx );
+        if ( rc != 0 )
+        {
+            KLockAcquire( ctx->lock );
+            if ( ctx->rc == 0 ) ctx->rc = rc;
+            KLockUnlock( ctx->lock );
+        }
+    }
+    return 0;
+}
+
+
+/* header, ref-entries and names are written up front, the layout of the file is known
+   before any reference has been processed */
+static rc_t build_layout( const Vector * refs, KFile * f, cov_idx_ref ** entries )
+{
+    rc_t rc = 0;
+    uint32_t count = VectorLength( refs );
+    cov_idx_hdr hdr;
+    uint64_t names_size = 0;
+    char * names;
+    cov_idx_ref * e = calloc( count + 1, sizeof *e );
+    uint32_t idx;
+
+    for ( idx = 0; idx < count; ++idx )
+    {
+        const RefT * ref = VectorGet( refs, VectorStart( refs ) + idx );
+        names_size += ref->rname.size;
+    }
+    names = malloc( names_size + 1 );
+    if ( e == NULL || names == NULL )
+    {
+        rc = RC( rcApp, rcNoTarg, rcAllocating, rcMemory, rcExhausted );
+        log_err( "coverage_idx_build() memory exhausted" );
+    }
+    else
+    {
+        uint64_t offset, name_offset = 0;
+
+        memset( &hdr, 0, sizeof hdr );
+        memmove( hdr.magic, COVERAGE_IDX_MAGIC, sizeof hdr.magic );
+        hdr.ref_count = count;
+        hdr.bin_size[ 0 ] = COVERAGE_IDX_BIN_1;
+        hdr.bin_size[ 1 ] = COVERAGE_IDX_BIN_2;
+        hdr.names_offset = sizeof hdr + count * sizeof *e;
+        hdr.names_size = names_size;
+
+        offset = align8( hdr.names_offset + names_size );
+        for ( idx = 0; idx < count; ++idx )
+        {
+            const RefT * ref = VectorGet( refs, VectorStart( refs ) + idx );
+            cov_idx_ref * r = &e[ idx ];
+            r->start_row_id = ref->start_row_id;
+            r->row_count = ref->count;
+            r->reflen = ref->reflen;
+            r->block_size = ref->block_size;
+            r->name_offset = name_offset;
+            r->name_len = ( uint32_t )ref->rname.size;
+            memmove( names + name_offset, ref->rname.addr, ref->rname.size );
+            name_offset += ref->rname.size;
+
+            r->rows_offset = offset;
+            offset += ref->count * sizeof( uint32_t );
+            r->bases_offset = offset;
+            offset = align8( offset + ref->reflen * sizeof( uint32_t ) );
+            r->bins_offset[ 0 ] = offset;
+            offset += bin_count( ref->reflen, 0 ) * sizeof( CoverageBin );
+            r->bins_offset[ 1 ] = offset;
+            offset += bin_count( ref->reflen, 1 ) * sizeof( CoverageBin );
+        }
+
+        {
+            size_t num_writ;
+            rc = KFileWriteAll( f, 0, &hdr, sizeof hdr, &num_writ );
+            if ( rc == 0 && count > 0 )
+                rc = KFileWriteAll( f, sizeof hdr, e, count * sizeof *e, &num_writ );
+            if ( rc == 0 && names_size > 0 )
+                rc = KFileWriteAll( f, hdr.names_offset, names, names_size, &num_writ );
+            if ( rc != 0 )
+                log_err( "coverage_idx_build() : KFileWriteAll() failed %R", rc );
+        }
+    }
+    if ( names != NULL )
+        free( ( void * ) names );
+    if ( rc == 0 )
+        *entries = e;
+    else if ( e != NULL )
+        free( ( void * ) e );
+    return rc;
+}
+
+
+static rc_t build_refs( build_ctx * ctx, uint32_t threads )
+{
+    rc_t rc = KLockMake( &ctx->lock );
+    if ( rc != 0 )
+        log_err( "coverage_idx_build() : KLockMake() failed %R", rc );
+    else
+    {
+        KThread * workers[ 64 ];
+        uint32_t n = 0, i;
+        uint32_t count = VectorLength( ctx->refs );
+
+        if ( threads > 64 ) threads = 64;
+        if ( threads > count ) threads = count;
+        for ( i = 1; i < threads; ++i )
+        {
+            if ( KThreadMake( &workers[ n ], build_thread, ctx ) == 0 )
+                n++;
+        }
+        /* the calling thread is one of the workers */
+        build_thread( NULL, ctx );
+        for ( i = 0; i < n; ++i )
+        {
+            rc_t rc_thread;
+            KThreadWait( workers[ i ], &rc_thread );
+            KThreadRelease( workers[ i ] );
+        }
+        rc = ctx->rc;
+        KLockRelease( ctx->lock );
+    }
+    return rc;
+}
+
+
+rc_t coverage_idx_build( const char * src,
+                         size_t cache_capacity,
+                         uint32_t threads,
+                         const char * filename )
+{
+    rc_t rc = 0;
+    if ( src == NULL || filename == NULL )
+    {
+        rc = RC( rcApp, rcNoTarg, rcConstructing, rcParam, rcNull );
+        log_err( "coverage_idx_build() given a NULL-ptr" );
+    }
+    else
+    {
+        Vector refs;
+        rc = ref_iter_make_vector( &refs, src, cache_capacity );
+        if ( rc == 0 )
+        {
+            KDirectory * dir;
+            rc = KDirectoryNativeDir( &dir );
+            if ( rc != 0 )
+                log_err( "coverage_idx_build() : KDirectoryNativeDir() failed %R", rc );
+            else
+            {
+                /* written under a temporary name: an incomplete index is never opened */
+                char tmp_name[ 4096 ];
+                size_t num_writ;
+                rc = string_printf( tmp_name, sizeof tmp_name, &num_writ, "%s.tmp", filename );
+                if ( rc != 0 )
+                    log_err( "coverage_idx_build() : string_printf() failed %R", rc );
+                else
+                {
+                    KFile * f;
+                    rc = KDirectoryCreateFile( dir, &f, false, 0664, kcmInit | kcmParents, "%s", tmp_name );
+                    if ( rc != 0 )
+                        log_err( "coverage_idx_build() : KDirectoryCreateFile( '%s' ) failed %R", tmp_name, rc );
+                    else
+                    {
+                        build_ctx ctx;
+                        memset( &ctx, 0, sizeof ctx );
+                        ctx.src = src;
+                        ctx.cache_capacity = cache_capacity;
+                        ctx.refs = &refs;
+                        ctx.f = f;
+
+                        rc = build_layout( &refs, f, ( cov_idx_ref ** )&ctx.entries );
+                        if ( rc == 0 )
+                        {
+                            rc = build_refs( &ctx, threads );
+                            free( ( void * ) ctx.entries );
+                        }
+                        KFileRelease( f );
+
+                        if ( rc == 0 )
+                        {
+                            rc = KDirectoryRename( dir, true, tmp_name, filename );
+                            if ( rc != 0 )
+                                log_err( "coverage_idx_build() : KDirectoryRename( '%s' ) failed %R", filename, rc );
+                        }
+                        if ( rc != 0 )
+                            KDirectoryRemove( dir, true, "%s", tmp_name );
+                    }
+                }
+                KDirectoryRelease( dir );
+            }
+            ref_iter_release_vector( &refs );
+        }
+    }
+    return rc;
+}
+
+
+/* ----------------------------------------------------------------------------------------------- */
+
+
+static rc_t read_section( const coverage_idx * self, uint64_t pos, void * buffer, size_t size )
+{
+    size_t num_read;
+    rc_t rc = KFileReadAll( self->f, pos, buffer, size, &num_read );
+    if ( rc != 0 )
+        log_err( "coverage_idx : KFileReadAll() failed %R", rc );
+    else if ( num_read != size )
+    {
+        rc = RC( rcApp, rcFile, rcReading, rcTransfer, rcIncomplete );
+        log_err( "coverage_idx : index-file is truncated" );
+    }
+    return rc;
+}
+
+
+rc_t coverage_idx_release( struct coverage_idx * self )
+{
+    rc_t rc = 0;
+    if ( self == NULL )
+        rc = RC( rcApp, rcNoTarg, rcReleasing, rcParam, rcNull );
+    else
+    {
+        if ( self->f != NULL )
+            rc = KFileRelease( self->f );
+        if ( self->refs != NULL )
+            free( ( void * ) self->refs );
+        if ( self->names != NULL )
+            free( ( void * ) self->names );
+        free( ( void * ) self );
+    }
+    return rc;
+}
+
+
+rc_t coverage_idx_open( struct coverage_idx ** self, const char * filename )
+{
+    rc_t rc = 0;
+    if ( self == NULL || filename == NULL )
+    {
+        rc = RC( rcApp, rcNoTarg, rcConstructing, rcParam, rcNull );
+        log_err( "coverage_idx_open() given a NULL-ptr" );
+    }
+    else
+    {
+        coverage_idx * o = calloc( 1, sizeof *o );
+        *self = NULL;
+        if ( o == NULL )
+        {
+            rc = RC( rcApp, rcNoTarg, rcAllocating, rcMemory, rcExhausted );
+            log_err( "coverage_idx_open() memory exhausted" );
+        }
+        else
+        {
+            KDirectory * dir;
+            rc = KDirectoryNativeDir( &dir );
+            if ( rc != 0 )
+                log_err( "coverage_idx_open() : KDirectoryNativeDir() failed %R", rc );
+            else
+            {
+                rc = KDirectoryOpenFileRead( dir, &o->f, "%s", filename );
+                KDirectoryRelease( dir );
+            }
+            if ( rc == 0 )
+                rc = read_section( o, 0, &o->hdr, sizeof o->hdr );
+            if ( rc == 0 && memcmp( o->hdr.magic, COVERAGE_IDX_MAGIC, sizeof o->hdr.magic ) != 0 )
+            {
+                rc = RC( rcApp, rcFile, rcOpening, rcFormat, rcInvalid );
+                log_err( "coverage_idx_open() : '%s' is not a coverage-index", filename );
+            }
+            if ( rc == 0 )
+            {
+                o->refs = calloc( o->hdr.ref_count + 1, sizeof *( o->refs ) );
+                o->names = malloc( o->hdr.names_size + 1 );
+                if ( o->refs == NULL || o->names == NULL )
+                {
+                    rc = RC( rcApp, rcNoTarg, rcAllocating, rcMemory, rcExhausted );
+                    log_err( "coverage_idx_open() memory exhausted" );
+                }
+            }
+            if ( rc == 0 )
+                rc = read_section( o, sizeof o->hdr, o->refs, o->hdr.ref_count * sizeof *( o->refs ) );
+            if ( rc == 0 )
+                rc = read_section( o, o->hdr.names_offset, o->names, o->hdr.names_size );
+        }
+
+        if ( rc == 0 )
+            *self = o;
+        else if ( o != NULL )
+            coverage_idx_release( o );
+    }
+    return rc;
+}
+
+
+static void ref_name( const coverage_idx * self, const cov_idx_ref * r, String * name )
+{
+    StringInit( name, self->names + r->name_offset, r->name_len, r->name_len );
+}
+
+
+static const cov_idx_ref * find_ref( const coverage_idx * self, const String * rname )
+{
+    uint32_t idx;
+    for ( idx = 0; idx < self->hdr.ref_count; ++idx )
+    {
+        String name;
+        ref_name( self, &self->refs[ idx ], &name );
+        if ( 0 == StringCompare( rname, &name ) )
+            return &self->refs[ idx ];
+    }
+    log_err( "coverage_idx : reference '%S' not found", rname );
+    return NULL;
+}
+
+
+rc_t coverage_idx_make_vector( const struct coverage_idx * self, Vector * vec )
+{
+    rc_t rc = 0;
+    if ( self == NULL || vec == NULL )
+    {
+        rc = RC( rcApp, rcNoTarg, rcAllocating, rcParam, rcNull );
+        log_err( "coverage_idx_make_vector() given a NULL-ptr" );
+    }
+    else
+    {
+        uint32_t idx;
+        VectorInit( vec, 0, 10 );
+        for ( idx = 0; rc == 0 && idx < self->hdr.ref_count; ++idx )
+        {
+            const cov_idx_ref * r = &self->refs[ idx ];
+            RefT ref;
+            RefT * ref_copy;
+
+            ref_name( self, r, &ref.rname );
+            ref.start_row_id = r->start_row_id;
+            ref.count = r->row_count;
+            ref.reflen = r->reflen;
+            ref.block_size = r->block_size;
+            rc = RefT_copy( &ref, &ref_copy );
+            if ( rc == 0 )
+            {
+                rc = VectorAppend( vec, NULL, ref_copy );
+                if ( rc != 0 )
+                    RefT_release( ref_copy );
+            }
+        }
+        if ( rc != 0 )
+            ref_iter_release_vector( vec );
+    }
+    return rc;
+}
+
+
+rc_t coverage_idx_row_counts( const struct coverage_idx * self,
+                              const RefT * ref,
+                              uint32_t ** row_counts,
+                              int64_t * first_row )
+{
+    rc_t rc = 0;
+    if ( self == NULL || ref == NULL || row_counts == NULL || first_row == NULL )
+    {
+        rc = RC( rcApp, rcNoTarg, rcReading, rcParam, rcNull );
+        log_err( "coverage_idx_row_counts() given a NULL-ptr" );
+    }
+    else
+    {
+        const cov_idx_ref * r = find_ref( self, &ref->rname );
+        if ( r == NULL )
+            rc = RC( rcApp, rcNoTarg, rcReading, rcItem, rcNotFound );
+        else if ( ref->start_row_id < r->start_row_id ||
+                  ref->start_row_id + ref->count > r->start_row_id + r->row_count )
+        {
+            rc = RC( rcApp, rcNoTarg, rcReading, rcRange, rcInvalid );
+            log_err( "coverage_idx_row_counts() : rows of '%S' out of range", &ref->rname );
+        }
+        else
+        {
+            *row_counts = malloc( ( ref->count + 1 ) * sizeof **row_counts );
+            if ( *row_counts == NULL )
+            {
+                rc = RC( rcApp, rcNoTarg, rcAllocating, rcMemory, rcExhausted );
+                log_err( "coverage_idx_row_counts() memory exhausted" );
+            }
+            else
+            {
+                uint64_t pos = r->rows_offset + ( ref->start_row_id - r->start_row_id ) * sizeof **row_counts;
+                rc = read_section( self, pos, *row_counts, ref->count * sizeof **row_counts );
+                if ( rc == 0 )
+                    *first_row = r->start_row_id;
+                else
+                {
+                    free( ( void * ) *row_counts );
+                    *row_counts = NULL;
+                }
+            }
+        }
+    }
+    return rc;
+}
+
+
+rc_t coverage_idx_bases( const struct coverage_idx * self,
+                         const String * rname,
+                         uint64_t start,
+                         uint64_t count,
+                         uint32_t * coverage )
+{
+    rc_t rc = 0;
+    if ( self == NULL || rname == NULL || coverage == NULL )
+    {
+        rc = RC( rcApp, rcNoTarg, rcReading, rcParam, rcNull );
+        log_err( "coverage_idx_bases() given a NULL-ptr" );
+    }
+    else
+    {
+        const cov_idx_ref * r = find_ref( self, rname );
+        if ( r == NULL )
+            rc = RC( rcApp, rcNoTarg, rcReading, rcItem, rcNotFound );
+        else
+        {
+            /* bases beyond the end of the reference are not covered */
+            uint64_t avail = ( start < r->reflen ) ? r->reflen - start : 0;
+            if ( avail > count ) avail = count;
+            if ( avail > 0 )
+                rc = read_section( self, r->bases_offset + start * sizeof *coverage,
+                                   coverage, avail * sizeof *coverage );
+            if ( rc == 0 && avail < count )
+                memset( coverage + avail, 0, ( count - avail ) * sizeof *coverage );
+        }
+    }
+    return rc;
+}
+
+
+rc_t coverage_idx_bins( const struct coverage_idx * self,
+                        const String * rname,
+                        uint32_t level,
+                        uint64_t first,
+                        uint64_t count,
+                        CoverageBin * bins )
+{
+    rc_t rc = 0;
+    if ( self == NULL || rname == NULL || bins == NULL )
+    {
+        rc = RC( rcApp, rcNoTarg, rcReading, rcParam, rcNull );
+        log_err( "coverage_idx_bins() given a NULL-ptr" );
+    }
+    else if ( level >= COVERAGE_IDX_LEVELS )
+    {
+        rc = RC( rcApp, rcNoTarg, rcReading, rcParam, rcInvalid );
+        log_err( "coverage_idx_bins() : invalid level %u", level );
+    }
+    else
+    {
+        const cov_idx_ref * r = find_ref( self, rname );
+        if ( r == NULL )
+            rc = RC( rcApp, rcNoTarg, rcReading, rcItem, rcNotFound );
+        else if ( first + count > bin_count( r->reflen, level ) )
+        {
+            rc = RC( rcApp, rcNoTarg, rcReading, rcRange, rcInvalid );
+            log_err( "coverage_idx_bins() : bins of '%S' out of range", rname );
+        }
+        else if ( count > 0 )
+            rc = read_section( self, r->bins_offset[ level ] + first * sizeof *bins,
+                               bins, count * sizeof *bins );
+    }
+    return rc;
+}
@@ -0,0 +1,93 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnologmsgy Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#ifndef _h_coverage_idx_
+#define _h_coverage_idx_
+
+#include <klib/rc.h>
+#include <klib/text.h>
+#include <klib/vector.h>
+
+#include "ref_iter.h"
+
+/* a coverage-index persists the coverage of every reference of a run in 3 resolutions:
+   per base, and in bins of 1 kb and of 100 kb, together with the count of primary
+   alignments of every REFERENCE-row */
+
+#define COVERAGE_IDX_LEVELS 2
+#define COVERAGE_IDX_BIN_1 1000
+#define COVERAGE_IDX_BIN_2 100000
+
+typedef struct CoverageBin
+{
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;       /* mean = sum / bases in the bin */
+} CoverageBin;
+
+struct coverage_idx;
+
+/* compute the coverage of every reference of src, with <threads> references in parallel,
+   and write it into the index-file */
+rc_t coverage_idx_build( const char * src,
+                         size_t cache_capacity,
+                         uint32_t threads,
+                         const char * filename );
+
+/* open an existing index-file */
+rc_t coverage_idx_open( struct coverage_idx ** self, const char * filename );
+
+rc_t coverage_idx_release( struct coverage_idx * self );
+
+/* initialize the vector and fill it with RefT-structs ( release with ref_iter_release_vector() ) */
+rc_t coverage_idx_make_vector( const struct coverage_idx * self, Vector * vec );
+
+/* the alignment-counts of the REFERENCE-rows described by ref ( allocated, ref->count values ),
+   and the first REFERENCE-row of the whole reference */
+rc_t coverage_idx_row_counts( const struct coverage_idx * self,
+                              const RefT * ref,
+                              uint32_t ** row_counts,
+                              int64_t * first_row );
+
+/* the coverage of the bases [ start, start + count ) of a reference */
+rc_t coverage_idx_bases( const struct coverage_idx * self,
+                         const String * rname,
+                         uint64_t start,
+                         uint64_t count,
+                         uint32_t * coverage );
+
+/* the bins [ first, first + count ) of a reference, level 0 = 1 kb, level 1 = 100 kb */
+rc_t coverage_idx_bins( const struct coverage_idx * self,
+                        const String * rname,
+                        uint32_t level,
+                        uint64_t first,
+                        uint64_t count,
+                        CoverageBin * bins );
+
+/* the bin-size of a level */
+uint32_t coverage_idx_bin_size( uint32_t level );
+
+#endif
@@ -57,6 +57,12 @@ typedef struct simple_coverage_iter
     int64_t current_row;
     uint64_t position;
     uint32_t last_len;
+
+    /* for the INDEX-MODE: the alignment-counts per REFERENCE-row */
+    uint32_t * row_counts;
+    int64_t first_row;          /* the first REFERENCE-row of the whole reference */
+    uint64_t reflen;
+    uint32_t block_size;
 } simple_coverage_iter;
 
 
@@ -81,6 +87,8 @@ rc_t simple_coverage_iter_release( struct simple_coverage_iter * self )
                 log_err( "error (%R) releasing VDatabase for %s", rc, self->source );
            
         }
+        if ( self->row_counts != NULL )
+            free( ( void * ) self->row_counts );
         free( ( void * ) self );
     }
     return rc;
@@ -171,6 +179,46 @@ rc_t simple_coverage_iter_make( struct simple_coverage_iter ** self,
 }
 
 
+/* construct an coverage-iterator over the alignment-counts of a coverage-index */
+rc_t simple_coverage_iter_make_from_counts( struct simple_coverage_iter ** self,
+                                            const char * src,
+                                            uint32_t * row_counts,
+                                            int64_t first_row,
+                                            const RefT * ref )
+{
+    rc_t rc = 0;
+    if ( self == NULL || src == NULL || row_counts == NULL || ref == NULL )
+    {
+        rc = RC( rcApp, rcNoTarg, rcAllocating, rcParam, rcNull );
+        log_err( "coverage_iter.make_from_counts() given a NULL-ptr" );
+    }
+    else
+    {
+        simple_coverage_iter * o = calloc( 1, sizeof *o );
+        *self = NULL;
+        if ( o == NULL )
+        {
+            rc = RC( rcApp, rcNoTarg, rcAllocating, rcMemory, rcExhausted );
+            log_err( "coverage_iter.make_from_counts() memory exhausted" );
+            free( ( void * ) row_counts );
+        }
+        else
+        {
+            o->source = src;
+            o->row_counts = row_counts;
+            o->reflen = ref->reflen;
+            o->block_size = ref->block_size;
+            o->to_process.first_row = ref->start_row_id;
+            o->to_process.row_count = ref->count;
+            o->current_row = ref->start_row_id;
+            o->first_row = first_row;
+            *self = o;
+        }
+    }
+    return rc;
+}
+
+
 static rc_t fill_simple_coverage_row( struct simple_coverage_iter * self,
                                       int64_t row_id,
                                       SimpleCoverageT * ct )
@@ -217,6 +265,22 @@ static rc_t fill_simple_coverage_row( struct simple_coverage_iter * self,
 }
 
 
+static void fill_counted_coverage_row( struct simple_coverage_iter * self,
+                                       int64_t row_id,
+                                       SimpleCoverageT * ct )
+{
+    uint64_t row_start = ( row_id - self->first_row ) * ( uint64_t )self->block_size;
+    ct->prim = self->row_counts[ self->rows_processed ];
+    ct->sec = 0;
+    ct->prim_ids = NULL;
+    ct->sec_ids = NULL;
+    if ( row_start + self->block_size > self->reflen )
+        ct->len = ( uint32_t )( self->reflen - row_start );
+    else
+        ct->len = self->block_size;
+}
+
+
 /* get the next reference from the iter */
 bool simple_coverage_iter_get( struct simple_coverage_iter * self,
                                SimpleCoverageT * ct )
@@ -228,7 +292,10 @@ bool simple_coverage_iter_get( struct simple_coverage_iter * self,
         if ( res )
         {
             self->position += self->last_len;
-            res = ( fill_simple_coverage_row( self, self->current_row, ct ) == 0 );
+            if ( self->row_counts != NULL )
+                fill_counted_coverage_row( self, self->current_row, ct );
+            else
+                res = ( fill_simple_coverage_row( self, self->current_row, ct ) == 0 );
             if ( res )
             {
                 self->current_row++;
@@ -395,6 +462,76 @@ static rc_t simple_alig_iter_read( const simple_alig_iter * self,
 }
                             
                             
+/* adds the alignment [ start, start + len ) to the difference-array of the window
+   [ win_start, win_start + win_len ), the array has win_len + 1 elements */
+static void coverage_diff_add( uint32_t * diff, uint64_t win_start, uint64_t win_len,
+                               uint64_t start, uint64_t len )
+{
+    uint64_t end = start + len;
+    uint64_t win_end = win_start + win_len;
+    if ( end > win_start && start < win_end )
+    {
+        if ( start < win_start ) start = win_start;
+        if ( end > win_end ) end = win_end;
+        diff[ start - win_start ]++;
+        diff[ end - win_start ]--;
+    }
+}
+
+
+/* turns the difference-array into coverage, the unsigned wrap-around of the
+   decrements cancels out in the prefix-sum */
+static void coverage_diff_sum( uint32_t * diff, uint64_t len )
+{
+    uint64_t i;
+    for ( i = 1; i < len; ++i )
+        diff[ i ] += diff[ i - 1 ];
+}
+
+
+/* every primary alignment of the REFERENCE-rows of ref is entered into the difference-array
+   of the window, the alignment-count of each row is stored in row_counts if not NULL */
+static rc_t coverage_accumulate( const char * src,
+                                 size_t cache_capacity,
+                                 const RefT * ref,
+                                 uint64_t win_start,
+                                 uint64_t win_len,
+                                 uint32_t * diff,
+                                 uint32_t * row_counts )
+{
+    simple_coverage_iter * c_iter;
+    rc_t rc = simple_coverage_iter_make( &c_iter, src, cache_capacity, ref );
+    if ( rc == 0 )
+    {
+        simple_alig_iter * a_iter;
+        
+        rc = simple_alig_iter_make( &a_iter, c_iter->db, src, cache_capacity );
+        if ( rc == 0 )
+        {
+            SimpleCoverageT ct;
+            uint64_t row = 0;
+            while( rc == 0 &&
+                    simple_coverage_iter_get( c_iter, &ct ) )
+            {
+                uint32_t idx;
+                if ( row_counts != NULL )
+                    row_counts[ row++ ] = ct.prim;
+                for ( idx = 0; rc == 0 && idx < ct.prim; ++idx )
+                {
+                    uint32_t ref_pos, ref_len;
+                    rc = simple_alig_iter_read( a_iter, ct.prim_ids[ idx ], &ref_pos, &ref_len );
+                    if ( rc == 0 )
+                        coverage_diff_add( diff, win_start, win_len, ref_pos, ref_len );
+                }
+            }
+            simple_alig_iter_release( a_iter );    
+        }
+        simple_coverage_iter_release( c_iter );
+    }
+    return rc;
+}
+
+
 rc_t detailed_coverage_make( const char * src,
                              size_t cache_capacity,
                              const slice * slice,
@@ -408,7 +545,8 @@ rc_t detailed_coverage_make( const char * src,
     }
     else
     {
-        dcoverage->coverage = calloc( slice->count, sizeof *( dcoverage->coverage ) );
+        /* one more element for the difference-array */
+        dcoverage->coverage = calloc( slice->count + 1, sizeof *( dcoverage->coverage ) );
         if ( dcoverage->coverage == NULL )
         {
             rc = RC( rcApp, rcNoTarg, rcAllocating, rcMemory, rcExhausted );
@@ -420,8 +558,6 @@ rc_t detailed_coverage_make( const char * src,
             rc = ref_iter_find( &ref, src, cache_capacity, slice->refname );
             if ( rc == 0 )
             {
-                simple_coverage_iter * c_iter;
-                
                 dcoverage->start_pos = slice->start;
                 dcoverage->len = slice->count;
                 
@@ -435,50 +571,57 @@ rc_t detailed_coverage_make( const char * src,
                     ref->count = ( end_offset - start_offset ) + 1;
                 }
                 
-                rc = simple_coverage_iter_make( &c_iter, src, cache_capacity, ref );
+                rc = coverage_accumulate( src, cache_capacity, ref,
+                                          slice->start, slice->count, dcoverage->coverage, NULL );
                 if ( rc == 0 )
-                {
-                    simple_alig_iter * a_iter;
-                    
-                    rc = simple_alig_iter_make( &a_iter, c_iter->db, src, cache_capacity );
-                    if ( rc == 0 )
-                    {
-                        SimpleCoverageT ct;
-                        while( rc == 0 &&
-                                simple_coverage_iter_get( c_iter, &ct ) )
-                        {
-                            uint32_t idx;
-                            for ( idx = 0; rc == 0 && idx < ct.prim; ++idx )
-                            {
-                                uint32_t ref_pos, ref_len;
-                                rc = simple_alig_iter_read( a_iter, ct.prim_ids[ idx ], &ref_pos, &ref_len );
-                                if ( rc == 0 )
-                                {
-                                    if ( ( ( ref_pos + ref_len - 1 ) >= slice->start ) &&
-                                          ref_pos < slice->end )
-                                    {
-                                        int32_t rel_start = ( ref_pos - ( uint32_t )slice->start );
-                                        int32_t i;
-                                        
-                                        if ( rel_start < 0 )
-                                        {
-                                            ref_len += rel_start;
-                                            rel_start = 0;
-                                        }
-                                        for ( i = rel_start; i < ref_len && i < slice->count; ++i )
-                                        {
-                                            dcoverage->coverage[ i ]++;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                        simple_alig_iter_release( a_iter );    
-                    }
-                    simple_coverage_iter_release( c_iter );
-                }
+                    coverage_diff_sum( dcoverage->coverage, slice->count );
                 RefT_release( ref );                
             }
+            if ( rc != 0 )
+            {
+                free( ( void * ) dcoverage->coverage );
+                dcoverage->coverage = NULL;
+            }
+        }
+    }
+    return rc;
+}
+
+
+rc_t reference_coverage_make( const char * src,
+                              size_t cache_capacity,
+                              const RefT * ref,
+                              uint32_t ** coverage,
+                              uint32_t ** row_counts )
+{
+    rc_t rc = 0;
+    if ( src == NULL || ref == NULL || coverage == NULL || row_counts == NULL )
+    {
+        rc = RC( rcApp, rcNoTarg, rcAllocating, rcParam, rcNull );
+        log_err( "reference_coverage_make() given a NULL-ptr" );
+    }
+    else
+    {
+        *coverage = calloc( ref->reflen + 1, sizeof **coverage );
+        *row_counts = calloc( ref->count + 1, sizeof **row_counts );
+        if ( *coverage == NULL || *row_counts == NULL )
+        {
+            rc = RC( rcApp, rcNoTarg, rcAllocating, rcMemory, rcExhausted );
+            log_err( "reference_coverage_make() memory exhausted" );
+        }
+        else
+        {
+            rc = coverage_accumulate( src, cache_capacity, ref,
+                                      0, ref->reflen, *coverage, *row_counts );
+            if ( rc == 0 )
+                coverage_diff_sum( *coverage, ref->reflen );
+        }
+        if ( rc != 0 )
+        {
+            if ( *coverage != NULL ) free( ( void * ) *coverage );
+            if ( *row_counts != NULL ) free( ( void * ) *row_counts );
+            *coverage = NULL;
+            *row_counts = NULL;
         }
     }
     return rc;
@@ -58,6 +58,15 @@ rc_t simple_coverage_iter_release( struct simple_coverage_iter * self );
 /* get the next alignemnt from the iter */
 bool simple_coverage_iter_get( struct simple_coverage_iter * self, SimpleCoverageT * ct );
 
+/* construct an coverage-iterator over the alignment-counts of a coverage-index,
+   takes ownership of row_counts ( one per REFERENCE-row of ref ),
+   first_row is the first REFERENCE-row of the whole reference */
+rc_t simple_coverage_iter_make_from_counts( struct simple_coverage_iter ** self,
+                                            const char * src,
+                                            uint32_t * row_counts,
+                                            int64_t first_row,
+                                            const RefT * ref );
+
 bool simple_coverage_iter_get_capped( struct simple_coverage_iter * self, SimpleCoverageT * ct, uint32_t min, uint32_t max );
 
 
@@ -75,5 +84,13 @@ rc_t detailed_coverage_make( const char * src,
                              DetailedCoverage * coverage );
 
 rc_t detailed_coverage_release( DetailedCoverage * self );
+
+/* the coverage of every base of the reference ( reflen values ) and the count of primary
+   alignments of every REFERENCE-row ( count values ), both allocated, release with free() */
+rc_t reference_coverage_make( const char * src,
+                              size_t cache_capacity,
+                              const RefT * ref,
+                              uint32_t ** coverage,
+                              uint32_t ** row_counts );
                              
 #endif
\ No newline at end of file
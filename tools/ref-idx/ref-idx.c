@@ -34,12 +34,16 @@
 #include <kfs/directory.h>
 #include <kfs/filetools.h>
 
+#include <kproc/lock.h>
+#include <kproc/thread.h>
+
 #include <insdc/insdc.h>
 
 #include "common.h"
 #include "slice.h"
 #include "ref_iter.h"
 #include "coverage_iter.h"
+#include "coverage_idx.h"
 
 const char UsageDefaultName[] = "ref-idx";
 
@@ -73,8 +77,22 @@ static const char * max_usage[]     = { "max coverage to look for ( dflt = 0xFFF
 static const char * func_usage[]    = { "function to perform: 0...collect min/max for whole run",
                                          "1...collect min/max for each reference",
                                          "2...report reference-rows based on min/max-constrains",
+                                         "3...detailed coverage of the slice",
+                                         "5...build the coverage-index ( needs --index )",
+                                         "6...coverage min/max/mean in bins ( needs --index )",
                                          NULL };
 
+#define OPTION_INDEX   "index"
+static const char * index_usage[]   = { "directory of coverage-indices, used by functions 0...3",
+                                         "and 6 if it has one for the accession", NULL };
+
+#define OPTION_THREADS "threads"
+#define ALIAS_THREADS  "t"
+static const char * threads_usage[] = { "references processed in parallel by functions 0, 1 and 5 ( dflt = 1 )", NULL };
+
+#define OPTION_BIN     "bin"
+static const char * bin_usage[]     = { "bin-size for function 6: 1000 or 100000 ( dflt = 1000 )", NULL };
+
 OptDef ToolOptions[] =
 {
 /*    name              alias           fkt    usage-txt,       cnt, needs value, required */
@@ -82,7 +100,10 @@ OptDef ToolOptions[] =
     { OPTION_SLICE,     ALIAS_SLICE,   NULL, slice_usage,     1,   true,        false },    
     { OPTION_FUNC,      ALIAS_FUNC,    NULL, func_usage,      1,   true,        false },
     { OPTION_MIN,       ALIAS_MIN,     NULL, min_usage,       1,   true,        false },
-    { OPTION_MAX,       ALIAS_MAX,     NULL, max_usage,       1,   true,        false }
+    { OPTION_MAX,       ALIAS_MAX,     NULL, max_usage,       1,   true,        false },
+    { OPTION_INDEX,     NULL,          NULL, index_usage,     1,   true,        false },
+    { OPTION_THREADS,   ALIAS_THREADS, NULL, threads_usage,   1,   true,        false },
+    { OPTION_BIN,       NULL,          NULL, bin_usage,       1,   true,        false }
 };
 
 rc_t CC Usage ( const Args * args )
@@ -115,8 +136,10 @@ rc_t CC Usage ( const Args * args )
 typedef struct tool_ctx
 {
     size_t cursor_cache_size;
-    uint32_t min_coverage, max_coverage, function;
+    uint32_t min_coverage, max_coverage, function, threads, bin_size;
     slice * slice;
+    const char * index_dir;
+    struct coverage_idx * cov_idx;  /* the coverage-index of the current accession, if any */
 } tool_ctx;
 
 
@@ -131,6 +154,13 @@ static rc_t fill_out_tool_ctx( const Args * args, tool_ctx * ctx )
         rc = get_uint32( args, OPTION_MAX, &ctx->max_coverage, 0xFFFFFFFF );
     if ( rc == 0 )
         rc = get_slice( args, OPTION_SLICE, &ctx->slice );
+    if ( rc == 0 )
+        rc = get_charptr( args, OPTION_INDEX, &ctx->index_dir );
+    if ( rc == 0 )
+        rc = get_uint32( args, OPTION_THREADS, &ctx->threads, 1 );
+    if ( rc == 0 )
+        rc = get_uint32( args, OPTION_BIN, &ctx->bin_size, COVERAGE_IDX_BIN_1 );
+    ctx->cov_idx = NULL;
     return rc;
 }
 
@@ -162,82 +192,210 @@ static void limit_set( limit * l, uint32_t value, int64_t row, uint64_t pos, Str
     l->ref = ref;
 }
 
-static rc_t f0_min_max_for_whole_run( tool_ctx * ctx, const char * src, const Vector *vec )
+/* the alignment-counts per REFERENCE-row come from the coverage-index if there is one */
+static rc_t make_coverage_iter( tool_ctx * ctx, const char * src, const RefT * ref,
+                                struct simple_coverage_iter ** ci )
+{
+    rc_t rc;
+    if ( ctx->cov_idx == NULL )
+        rc = simple_coverage_iter_make( ci, src, ctx->cursor_cache_size, ref );
+    else
+    {
+        uint32_t * row_counts;
+        int64_t first_row;
+        rc = coverage_idx_row_counts( ctx->cov_idx, ref, &row_counts, &first_row );
+        if ( rc == 0 )
+            rc = simple_coverage_iter_make_from_counts( ci, src, row_counts, first_row, ref );
+    }
+    return rc;
+}
+
+/* the min/max of one reference, found by a worker-thread */
+typedef struct ref_min_max
 {
-    rc_t rc = 0;
-    uint32_t idx;
     limit min, max;
-    limit_set( &min, 0xFFFFFFFF, 0, 0, NULL );
-    limit_set( &max, 0, 0, 0, NULL );
-    for ( idx = VectorStart( vec ); rc == 0 && idx < VectorLength( vec ); ++idx )
+    bool done;
+} ref_min_max;
+
+static rc_t min_max_of_ref( tool_ctx * ctx, const char * src, RefT * ref, ref_min_max * mm )
+{
+    struct simple_coverage_iter * ci;
+    rc_t rc = make_coverage_iter( ctx, src, ref, &ci );
+    if ( rc == 0 )
     {
-        RefT * ref = VectorGet( vec, idx );
+        SimpleCoverageT cv;
+
+        limit_set( &mm->min, 0xFFFFFFFF, 0, 0, NULL );
+        limit_set( &mm->max, 0, 0, 0, NULL );
+
+        while ( rc == 0 &&
+                simple_coverage_iter_get_capped( ci, &cv, ctx->min_coverage, ctx->max_coverage ) )
+        {
+            if ( cv.prim > mm->max.value )
+                limit_set( &mm->max, cv.prim, cv.ref_row_id, cv.start_pos, &ref->rname );
+            if ( cv.prim < mm->min.value )
+                limit_set( &mm->min, cv.prim, cv.ref_row_id, cv.start_pos, &ref->rname );
+        }
+        simple_coverage_iter_release( ci );
+        mm->done = true;
+    }
+    return rc;
+}
+
+#define MAX_THREADS 64
+
+typedef struct min_max_pool
+{
+    tool_ctx * ctx;
+    const char * src;
+    const Vector * vec;
+    ref_min_max * results;
+    KLock * lock;
+    uint32_t next;
+    rc_t rc;
+} min_max_pool;
+
+static bool min_max_next( min_max_pool * pool, uint32_t * idx )
+{
+    bool res;
+    if ( pool->lock != NULL ) KLockAcquire( pool->lock );
+    res = ( pool->rc == 0 && pool->next < VectorLength( pool->vec ) );
+    if ( res )
+        *idx = pool->next++;
+    if ( pool->lock != NULL ) KLockUnlock( pool->lock );
+    return res;
+}
+
+/* every worker scans whole references, each with its own cursor */
+static rc_t CC min_max_thread( const KThread * self, void * data )
+{
+    min_max_pool * pool = data;
+    uint32_t idx;
+    while ( min_max_next( pool, &idx ) )
+    {
+        RefT * ref = VectorGet( pool->vec, idx );
         if ( ref != NULL )
         {
-            struct simple_coverage_iter * ci;
-            rc = simple_coverage_iter_make( &ci, src, ctx->cursor_cache_size, ref );
-            if ( rc == 0 )
+            rc_t rc = min_max_of_ref( pool->ctx, pool->src, ref, &pool->results[ idx - VectorStart( pool->vec ) ] );
+            if ( rc != 0 )
             {
-                SimpleCoverageT cv;
-                while ( rc == 0 &&
-                        simple_coverage_iter_get_capped( ci, &cv, ctx->min_coverage, ctx->max_coverage ) )
-                {
-                    if ( cv.prim > max.value )
-                        limit_set( &max, cv.prim, cv.ref_row_id, cv.start_pos, &ref->rname );
-                    if ( cv.prim < min.value )
-                        limit_set( &min, cv.prim, cv.ref_row_id, cv.start_pos, &ref->rname );                    
-                }
-                simple_coverage_iter_release( ci );
+                if ( pool->lock != NULL ) KLockAcquire( pool->lock );
+                if ( pool->rc == 0 ) pool->rc = rc;
+                if ( pool->lock != NULL ) KLockUnlock( pool->lock );
+            }
+        }
+    }
+    return 0;
+}
+
+/* results[ i ] holds the min/max of the i-th reference of the vector */
+static rc_t min_max_of_all_refs( tool_ctx * ctx, const char * src, const Vector *vec, ref_min_max ** results )
+{
+    rc_t rc = 0;
+    min_max_pool pool;
+    uint32_t count = VectorLength( vec ) - VectorStart( vec );
+
+    memset( &pool, 0, sizeof pool );
+    pool.ctx = ctx;
+    pool.src = src;
+    pool.vec = vec;
+    pool.next = VectorStart( vec );
+    pool.results = calloc( count + 1, sizeof *pool.results );
+    if ( pool.results == NULL )
+    {
+        rc = RC( rcApp, rcNoTarg, rcAllocating, rcMemory, rcExhausted );
+        log_err( "min_max_of_all_refs() memory exhausted" );
+    }
+    else
+    {
+        KThread * workers[ MAX_THREADS ];
+        uint32_t threads = ctx->threads, n = 0, i;
+
+        if ( threads > MAX_THREADS ) threads = MAX_THREADS;
+        if ( threads > count ) threads = count;
+        if ( threads > 1 && KLockMake( &pool.lock ) == 0 )
+        {
+            for ( i = 1; i < threads; ++i )
+            {
+                if ( KThreadMake( &workers[ n ], min_max_thread, &pool ) == 0 )
+                    n++;
             }
         }
+        /* the calling thread is one of the workers */
+        min_max_thread( NULL, &pool );
+        for ( i = 0; i < n; ++i )
+        {
+            rc_t rc_thread;
+            KThreadWait( workers[ i ], &rc_thread );
+            KThreadRelease( workers[ i ] );
+        }
+        if ( pool.lock != NULL )
+            KLockRelease( pool.lock );
+
+        rc = pool.rc;
+        if ( rc == 0 )
+            *results = pool.results;
+        else
+            free( ( void * ) pool.results );
     }
+    return rc;
+}
+
+static rc_t f0_min_max_for_whole_run( tool_ctx * ctx, const char * src, const Vector *vec )
+{
+    ref_min_max * results;
+    rc_t rc = min_max_of_all_refs( ctx, src, vec, &results );
     if ( rc == 0 )
+    {
+        uint32_t idx, count = VectorLength( vec ) - VectorStart( vec );
+        limit min, max;
+        limit_set( &min, 0xFFFFFFFF, 0, 0, NULL );
+        limit_set( &max, 0, 0, 0, NULL );
+
+        /* reduced in the order of the references: the same result as one sequential scan */
+        for ( idx = 0; idx < count; ++idx )
+        {
+            const ref_min_max * mm = &results[ idx ];
+            if ( mm->done )
+            {
+                if ( mm->max.value > max.value ) max = mm->max;
+                if ( mm->min.value < min.value ) min = mm->min;
+            }
+        }
+        free( ( void * ) results );
+
         rc = KOutMsg( "MAX\t%S:%u\tref-row = %ld\talignments = %,u\n",
             max.ref, max.pos, max.row, max.value );
-    if ( rc == 0 )
-        rc = KOutMsg( "MIN\t%S:%u\tref-row = %ld\talignments = %,u\n",
-            min.ref, min.pos, min.row, min.value );
+        if ( rc == 0 )
+            rc = KOutMsg( "MIN\t%S:%u\tref-row = %ld\talignments = %,u\n",
+                min.ref, min.pos, min.row, min.value );
+    }
     return rc;
 }
 
 static rc_t f1_min_max_for_each_ref( tool_ctx * ctx, const char * src, const Vector *vec )
 {
-    rc_t rc = 0;
-    uint32_t idx;
-    limit min, max;    
-    for ( idx = VectorStart( vec ); rc == 0 && idx < VectorLength( vec ); ++idx )
+    ref_min_max * results;
+    rc_t rc = min_max_of_all_refs( ctx, src, vec, &results );
+    if ( rc == 0 )
     {
-        RefT * ref = VectorGet( vec, idx );
-        if ( ref != NULL )
+        uint32_t idx;
+        for ( idx = VectorStart( vec ); rc == 0 && idx < VectorLength( vec ); ++idx )
         {
-            struct simple_coverage_iter * ci;
-            rc = simple_coverage_iter_make( &ci, src, ctx->cursor_cache_size, ref );
-            if ( rc == 0 )
+            const RefT * ref = VectorGet( vec, idx );
+            const ref_min_max * mm = &results[ idx - VectorStart( vec ) ];
+            if ( ref != NULL && mm->done )
             {
-                SimpleCoverageT cv;
-                
-                limit_set( &min, 0xFFFFFFFF, 0, 0, NULL );
-                limit_set( &max, 0, 0, 0, NULL );
-                
-                while ( rc == 0 &&
-                        simple_coverage_iter_get_capped( ci, &cv, ctx->min_coverage, ctx->max_coverage ) )
-                {
-                    if ( cv.prim > max.value )
-                        limit_set( &max, cv.prim, cv.ref_row_id, cv.start_pos, &ref->rname );
-                    if ( cv.prim < min.value )
-                        limit_set( &min, cv.prim, cv.ref_row_id, cv.start_pos, &ref->rname );                    
-                }
-                simple_coverage_iter_release( ci );
-                if ( rc == 0 )
-                    rc = KOutMsg( "%S\n", &ref->rname );
+                rc = KOutMsg( "%S\n", &ref->rname );
                 if ( rc == 0 )
                     rc = KOutMsg( "\tMAX\tpos = %u\tref-row = %ld\talignments = %,u\n",
-                        max.pos, max.row, max.value );
+                        mm->max.pos, mm->max.row, mm->max.value );
                 if ( rc == 0 )
                     rc = KOutMsg( "\tMIN\tpos = %u\tref-row = %ld\talignments = %,u\n\n",
-                        min.pos, min.row, min.value );
+                        mm->min.pos, mm->min.row, mm->min.value );
             }
         }
+        free( ( void * ) results );
     }
     return rc;
 }
@@ -266,7 +424,7 @@ static rc_t f2_refrows_between_min_max( tool_ctx * ctx, const char * src, const
             if ( perform )
             {
                 struct simple_coverage_iter * ci;
-                rc = simple_coverage_iter_make( &ci, src, ctx->cursor_cache_size, ref );
+                rc = make_coverage_iter( ctx, src, ref, &ci );
                 if ( rc == 0 )
                 {
                     SimpleCoverageT cv;
@@ -285,10 +443,43 @@ static rc_t f2_refrows_between_min_max( tool_ctx * ctx, const char * src, const
 }
 
 
+static rc_t detailed_coverage_from_idx( tool_ctx * ctx, DetailedCoverage * dc )
+{
+    rc_t rc = 0;
+    const slice * slice = ctx->slice;
+    if ( slice == NULL )
+    {
+        rc = RC( rcApp, rcNoTarg, rcAccessing, rcParam, rcNull );
+        log_err( "detailed coverage needs a slice" );
+    }
+    else
+    {
+        dc->coverage = calloc( slice->count + 1, sizeof *( dc->coverage ) );
+        if ( dc->coverage == NULL )
+        {
+            rc = RC( rcApp, rcNoTarg, rcAllocating, rcMemory, rcExhausted );
+            log_err( "detailed_coverage_from_idx() memory exhausted" );
+        }
+        else
+        {
+            dc->start_pos = slice->start;
+            dc->len = slice->count;
+            rc = coverage_idx_bases( ctx->cov_idx, slice->refname, slice->start, slice->count, dc->coverage );
+            if ( rc != 0 )
+                detailed_coverage_release( dc );
+        }
+    }
+    return rc;
+}
+
 static rc_t detailed_coverage( tool_ctx * ctx, const char * src )
 {
     DetailedCoverage dc;
-    rc_t rc = detailed_coverage_make( src, ctx->cursor_cache_size, ctx->slice, &dc );
+    rc_t rc;
+    if ( ctx->cov_idx != NULL )
+        rc = detailed_coverage_from_idx( ctx, &dc );
+    else
+        rc = detailed_coverage_make( src, ctx->cursor_cache_size, ctx->slice, &dc );
     if ( rc == 0 )
     {
         uint32_t idx;
@@ -301,6 +492,60 @@ static rc_t detailed_coverage( tool_ctx * ctx, const char * src )
     return rc;
 }
 
+static rc_t report_bins_of_ref( tool_ctx * ctx, const RefT * ref, uint32_t level )
+{
+    rc_t rc = 0;
+    uint32_t bin_size = coverage_idx_bin_size( level );
+    uint64_t start = 0, end = ref->reflen;
+    CoverageBin bins[ 256 ];
+
+    if ( ctx->slice != NULL && ctx->slice->count > 0 )
+    {
+        start = ctx->slice->start;
+        if ( ctx->slice->end < end ) end = ctx->slice->end;
+    }
+    if ( start < end )
+    {
+        uint64_t bin = start / bin_size;
+        uint64_t last = ( end - 1 ) / bin_size;
+        while ( rc == 0 && bin <= last )
+        {
+            uint64_t n = last - bin + 1, i;
+            if ( n > 256 ) n = 256;
+            rc = coverage_idx_bins( ctx->cov_idx, &ref->rname, level, bin, n, bins );
+            for ( i = 0; rc == 0 && i < n; ++i )
+            {
+                uint64_t bin_start = ( bin + i ) * bin_size;
+                uint64_t bin_end = bin_start + bin_size;
+                if ( bin_end > ref->reflen ) bin_end = ref->reflen;
+                rc = KOutMsg( "%S\t%lu\t%lu\t%u\t%u\t%.2f\n",
+                              &ref->rname, bin_start, bin_end - bin_start,
+                              bins[ i ].min, bins[ i ].max,
+                              ( double )bins[ i ].sum / ( double )( bin_end - bin_start ) );
+            }
+            bin += n;
+        }
+    }
+    return rc;
+}
+
+static rc_t f6_binned_coverage( tool_ctx * ctx, const char * src, const Vector *vec )
+{
+    rc_t rc = 0;
+    uint32_t idx;
+    uint32_t level = ( ctx->bin_size >= COVERAGE_IDX_BIN_2 ) ? 1 : 0;
+    for ( idx = VectorStart( vec ); rc == 0 && idx < VectorLength( vec ); ++idx )
+    {
+        const RefT * ref = VectorGet( vec, idx );
+        if ( ref != NULL )
+        {
+            if ( ctx->slice == NULL || 0 == StringCompare( ctx->slice->refname, &ref->rname ) )
+                rc = report_bins_of_ref( ctx, ref, level );
+        }
+    }
+    return rc;
+}
+
 static rc_t list_test( tool_ctx * ctx, const char * src )
 {
     KDirectory * dir;
@@ -328,13 +573,41 @@ static rc_t list_test( tool_ctx * ctx, const char * src )
     return rc;
 }
 
-static rc_t common_part( tool_ctx * ctx, const char * src )
+/* the coverage-index of an accession is <index-dir>/<last part of the accession>.cov */
+static rc_t index_file_name( tool_ctx * ctx, const char * src, char * buffer, size_t buffer_size )
+{
+    size_t num_writ, len = string_size( src );
+    const char * name;
+    while ( len > 1 && src[ len - 1 ] == '/' ) len--;
+    name = string_rchr( src, len, '/' );
+    name = ( name == NULL ) ? src : name + 1;
+    return string_printf( buffer, buffer_size, &num_writ, "%s/%.*s.cov",
+                          ctx->index_dir, ( uint32_t )( ( src + len ) - name ), name );
+}
+
+static rc_t open_coverage_idx( tool_ctx * ctx, const char * filename )
+{
+    KDirectory * dir;
+    rc_t rc = KDirectoryNativeDir( &dir );
+    if ( rc == 0 )
+    {
+        if ( ( KDirectoryPathType( dir, "%s", filename ) & ~kptAlias ) == kptFile )
+            rc = coverage_idx_open( &ctx->cov_idx, filename );
+        KDirectoryRelease( dir );
+    }
+    return rc;
+}
+
+static rc_t perform_function( tool_ctx * ctx, const char * src, const char * idx_name )
 {
     rc_t rc = 0;
-    if ( ctx->function < 3 )
+    if ( ctx->function < 3 || ctx->function == 6 )
     {
         Vector vec;
-        rc = ref_iter_make_vector( &vec, src, ctx->cursor_cache_size );
+        if ( ctx->cov_idx != NULL )
+            rc = coverage_idx_make_vector( ctx->cov_idx, &vec );
+        else
+            rc = ref_iter_make_vector( &vec, src, ctx->cursor_cache_size );
         if ( rc == 0 )
         {
             switch( ctx->function )
@@ -342,6 +615,7 @@ static rc_t common_part( tool_ctx * ctx, const char * src )
                 case 0 : rc = f0_min_max_for_whole_run( ctx, src, &vec ); break;
                 case 1 : rc = f1_min_max_for_each_ref( ctx, src, &vec ); break;
                 case 2 : rc = f2_refrows_between_min_max( ctx, src, &vec ); break;
+                case 6 : rc = f6_binned_coverage( ctx, src, &vec ); break;
             }
             ref_iter_release_vector( &vec );
         }
@@ -352,8 +626,41 @@ static rc_t common_part( tool_ctx * ctx, const char * src )
         {
             case 3 : rc = detailed_coverage( ctx, src ); break;
             case 4 : rc = list_test( ctx, src ); break;
+            case 5 : rc = coverage_idx_build( src, ctx->cursor_cache_size, ctx->threads, idx_name ); break;
+        }
+    }
+    return rc;
+}
+
+static rc_t common_part( tool_ctx * ctx, const char * src )
+{
+    rc_t rc = 0;
+    char idx_name[ 4096 ] = "";
+
+    if ( ctx->index_dir != NULL )
+        rc = index_file_name( ctx, src, idx_name, sizeof idx_name );
+    else if ( ctx->function >= 5 )
+    {
+        rc = RC( rcApp, rcNoTarg, rcConstructing, rcParam, rcNull );
+        log_err( "function %u needs --index", ctx->function );
+    }
+    if ( rc == 0 && ctx->index_dir != NULL && ctx->function != 5 )
+    {
+        rc = open_coverage_idx( ctx, idx_name );
+        if ( rc == 0 && ctx->cov_idx == NULL && ctx->function == 6 )
+        {
+            rc = RC( rcApp, rcNoTarg, rcOpening, rcFile, rcNotFound );
+            log_err( "no coverage-index '%s'", idx_name );
         }
     }
+    if ( rc == 0 )
+        rc = perform_function( ctx, src, idx_name );
+
+    if ( ctx->cov_idx != NULL )
+    {
+        coverage_idx_release( ctx->cov_idx );
+        ctx->cov_idx = NULL;
+    }
     return rc;
 }
 
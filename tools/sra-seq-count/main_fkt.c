@@ -42,23 +42,32 @@
 #define OPTION_ID_ATTR         	"id_attr"
 #define OPTION_FEATURE_TYPE    	"feature_type"
 #define OPTION_MODE            	"mode"
+#define OPTION_THREADS         	"threads"
+#define OPTION_CACHE           	"cache"
 
 #define ALIAS_ID_ATTR          	"i"
 #define ALIAS_FEATURE_TYPE     	"f"
 #define ALIAS_MODE     			"m"
+#define ALIAS_THREADS  			"t"
+#define ALIAS_CACHE    			"c"
 
 #define DEFAULT_ID_ATTR         "gene_id"
 #define DEFAULT_FEATURE_TYPE    "exon"
+#define DEFAULT_THREADS         1
 
 static const char * id_attr_usage[] 		= { "id-attr (default gene_id)", NULL };
 static const char * feature_type_usage[] 	= { "feature-type (default exon)", NULL };
 static const char * mode_usage[] 			= { "output-mode (norm, debug)", NULL };
+static const char * threads_usage[] 		= { "count references on this many threads (default 1)", NULL };
+static const char * cache_usage[] 			= { "keep the parsed gtf-file in a binary cache next to it", NULL };
 
 OptDef sra_seq_count_options[] =
 {
     { OPTION_ID_ATTR, 		ALIAS_ID_ATTR,			NULL, id_attr_usage,		1, true, false },
     { OPTION_FEATURE_TYPE, 	ALIAS_FEATURE_TYPE, 	NULL, feature_type_usage, 	1, true, false },
-    { OPTION_MODE, 			ALIAS_MODE, 			NULL, mode_usage, 			1, true, false }	
+    { OPTION_MODE, 			ALIAS_MODE, 			NULL, mode_usage, 			1, true, false },
+    { OPTION_THREADS, 		ALIAS_THREADS, 			NULL, threads_usage, 		1, true, false },
+    { OPTION_CACHE, 		ALIAS_CACHE, 			NULL, cache_usage, 			1, false, false }
 };
 
 const char UsageDefaultName[] = "sra-seq-count";
@@ -68,7 +77,11 @@ rc_t CC UsageSummary ( const char * progname )
     return KOutMsg ( 	"\n"
 						"Usage:\n"
 						"  %s <sra-accession> <gtf-file> [options]\n"
-						"\n", progname );
+						"  %s <sra-accession> <sra-accession> ... <gtf-file> [options]\n"
+						"\n"
+						"  with more than one accession a matrix of counts\n"
+						"  ( features by accessions ) is printed\n"
+						"\n", progname, progname );
 }
 
 rc_t CC Usage ( const Args * args )
@@ -91,6 +104,8 @@ rc_t CC Usage ( const Args * args )
     HelpOptionLine ( ALIAS_ID_ATTR,			OPTION_ID_ATTR,			NULL, 		id_attr_usage );
     HelpOptionLine ( ALIAS_FEATURE_TYPE, 	OPTION_FEATURE_TYPE, 	NULL, 		feature_type_usage );
     HelpOptionLine ( ALIAS_MODE, 			OPTION_MODE, 			NULL, 		mode_usage );
+    HelpOptionLine ( ALIAS_THREADS, 		OPTION_THREADS, 		NULL, 		threads_usage );
+    HelpOptionLine ( ALIAS_CACHE, 			OPTION_CACHE, 			NULL, 		cache_usage );
 
     KOutMsg ( "\n" );	
     HelpOptionsStandard ();
@@ -111,6 +126,22 @@ static rc_t get_str_option( const Args * args, const char * option_name, const c
 }
 
 
+static rc_t get_int_option( const Args * args, const char * option_name, int * dst, int default_value )
+{
+    uint32_t count;
+    rc_t rc = ArgsOptionCount( args, option_name, &count );
+    (*dst) = default_value;
+    if ( ( rc == 0 )&&( count > 0 ) )
+    {
+        const char * s;
+        rc = ArgsOptionValue( args, option_name, 0, (const void **)&s );
+        if ( rc == 0 )
+            (*dst) = atoi( s );
+    }
+    return rc;
+}
+
+
 static rc_t gather_options( const Args * args, struct sra_seq_count_options * options )
 {
 	rc_t rc;
@@ -132,6 +163,19 @@ static rc_t gather_options( const Args * args, struct sra_seq_count_options * op
 			}
 		}
 	}
+	if ( rc == 0 )
+	{
+		rc = get_int_option( args, OPTION_THREADS, &options->threads, DEFAULT_THREADS );
+		if ( rc == 0 && options->threads < 1 )
+			options->threads = 1;
+	}
+	if ( rc == 0 )
+	{
+		uint32_t count;
+		rc = ArgsOptionCount( args, OPTION_CACHE, &count );
+		if ( rc == 0 )
+			options->use_cache = ( count > 0 );
+	}
 	
 	if ( rc == 0 )
 	{
@@ -139,11 +183,24 @@ static rc_t gather_options( const Args * args, struct sra_seq_count_options * op
 		rc = ArgsParamCount( args, &count );
 		if ( rc == 0 )
 		{
-			if ( count == 2 )
+			if ( count >= 2 )
 			{
-				rc = ArgsParamValue( args, 0, (const void **)&options->sra_accession );
+				/* all parameters but the last one are accessions */
+				options->accession_count = count - 1;
+				options->accessions = malloc( options->accession_count * sizeof options->accessions[ 0 ] );
+				if ( options->accessions == NULL )
+					rc = RC ( rcApp, rcArgv, rcAccessing, rcMemory, rcExhausted );
+				else
+				{
+					uint32_t idx;
+					for ( idx = 0; rc == 0 && idx < options->accession_count; ++idx )
+						rc = ArgsParamValue( args, idx, (const void **)&options->accessions[ idx ] );
+				}
 				if ( rc == 0 )
-					rc = ArgsParamValue( args, 1, (const void **)&options->gtf_file );
+				{
+					options->sra_accession = options->accessions[ 0 ];
+					rc = ArgsParamValue( args, count - 1, (const void **)&options->gtf_file );
+				}
 				if ( rc == 0 )
 					options -> valid = true;
 			}
@@ -159,13 +216,20 @@ static rc_t gather_options( const Args * args, struct sra_seq_count_options * op
 
 static rc_t report_options( const struct sra_seq_count_options * options )
 {
-	rc_t rc = KOutMsg( "accession    : %s\n", options->sra_accession );
+	uint32_t idx;
+	rc_t rc = 0;
+	for ( idx = 0; rc == 0 && idx < options->accession_count; ++idx )
+		rc = KOutMsg( "accession    : %s\n", options->accessions[ idx ] );
 	if ( rc == 0 )
 		rc =  KOutMsg( "gtf-file     : %s\n", options->gtf_file );
 	if ( rc == 0 )
 		rc =  KOutMsg( "id-attr      : %s\n", options->id_attrib );
 	if ( rc == 0 )
 		rc =  KOutMsg( "feature-type : %s\n", options->feature_type );
+	if ( rc == 0 )
+		rc =  KOutMsg( "threads      : %d\n", options->threads );
+	if ( rc == 0 )
+		rc =  KOutMsg( "gtf-cache    : %s\n", options->use_cache ? "yes" : "no" );
 	if ( rc == 0 )
 	{
 		switch ( options->output_mode )
@@ -197,6 +261,7 @@ rc_t CC KMain ( int argc, char *argv [] )
 				rc = matching( &options );	/* here we are calling into C++ */
 			}
 		}
+		free( ( void * )options.accessions );
         ArgsWhack ( args );
     }
     return rc;
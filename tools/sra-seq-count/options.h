@@ -39,10 +39,14 @@ extern "C" {
 struct sra_seq_count_options
 {
     const char * sra_accession;
+    const char ** accessions;	/* more than one: batch-mode, count-matrix */
+    uint32_t accession_count;
     const char * gtf_file;
     const char * id_attrib;
     const char * feature_type;
 	int output_mode;
+	int threads;
+	bool use_cache;
 	bool valid;
 };
 
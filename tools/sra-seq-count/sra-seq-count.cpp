@@ -37,7 +37,14 @@
 #include <stdexcept>
 #include <vector>
 #include <list>
+#include <map>
 #include <algorithm>
+#include <cstdio>
+
+#include <kproc/lock.h>
+#include <kproc/thread.h>
+
+#include <sys/stat.h>
 
 #include "options.h"
 #include "range.hpp"
@@ -45,85 +52,6 @@
 using namespace seq_ranges;
 
 
-struct feature_range
-{
-	const std::string ref_name;
-	const std::string feature_id;
-	const char strand;
-	range ft_range;
-
-	feature_range( const std::string &ref_name_, const std::string &feature_id_,
-				   const long start_, const long end_, const char strand_ )
-		: ref_name( ref_name_ ), feature_id( feature_id_ ), strand( strand_ ), ft_range( start_, end_ )
-	{ }
-};
-
-
-class feature
-{
-	private :
-		const std::string ref_name;
-		const std::string feature_id;
-		const char strand;		
-		ranges feature_ranges;
-		range outer;
-		long counter;
-
-	public :
-		feature( const feature_range &fr ) : ref_name( fr.ref_name ), feature_id( fr.feature_id ),
-				strand( fr.strand ), outer( fr.ft_range ), counter( 0 )
-		{
-			feature_ranges.add( fr.ft_range );
-		}
-	
-		bool add( const feature_range &fr )
-		{
-			bool res = ( feature_id == fr.feature_id );
-			if ( res )
-			{
-				feature_ranges.merge( fr.ft_range );
-				outer.include( fr.ft_range );
-			}
-			return res;
-		}
-
-		void debug_report ( void )
-		{
-			std::cout << "FEATURE: " << feature_id << " ( refname: " << ref_name << " ) strand = '" << strand << "' " << outer << std::endl;
-			std::cout << feature_ranges << std::endl;
-			std::cout << "counter : " << counter << std::endl;
-			std::cout << std::endl;
-		}
-
-		void report ( int output_mode )
-		{
-			if ( counter > 0 )
-			{
-				if ( output_mode == SSC_MODE_NORMAL )
-				{
-					std::cout << feature_id << "\t" << counter << std::endl;
-				}
-				else
-				{
-					std::cout << ref_name << "." << outer << "(" << feature_ranges.get_count() << ") "
-						<< feature_id << "\t" << counter << std::endl;
-				}
-			}
-		}
-
-		void sort_ranges( void ) { feature_ranges.sort(); }		
-		void get_ref_name( std::string &s ) { s = ref_name; }
-		void get_outer_range( range &r ) { r = outer; }
-
-		/* does this feature end before the given range */
-		bool ends_before( const range &r ) const { return outer.ends_before( r ); }
-		bool is_ref( const std::string &r_name ) { return ( ref_name == r_name ); }
-		long start( void ) { return outer.get_start(); }
-		
-		void check( const range &r ) { if ( outer.intersect( r ) ) counter++; }
-};
-
-
 void trim( std::string &s )
 {
 	bool to_trim = false;
@@ -213,139 +141,424 @@ bool split_line( const std::string &line, const std::string feature_type, const
 }
 
 
-class gtf_iter
+/* -----------------------------------------------------------------------
+	a feature: consecutive gtf-lines with the same feature-id,
+	its ranges live in the vector of the reference it belongs to
+   ----------------------------------------------------------------------- */
+struct feature
+{
+	std::string feature_id;
+	char strand;
+	range outer;
+	size_t first_range;
+	long range_count;
+};
+
+
+/* -----------------------------------------------------------------------
+	binary cache of a parsed gtf-file, in native byte-order
+   ----------------------------------------------------------------------- */
+template < typename T > void write_value( std::ostream &out, const T &v )
+{
+	out.write( reinterpret_cast< const char * >( &v ), sizeof v );
+}
+
+template < typename T > bool read_value( std::istream &in, T &v )
+{
+	return in.read( reinterpret_cast< char * >( &v ), sizeof v ).good();
+}
+
+/* a count read from the cache is only trusted if that many records can still be in it */
+uint64_t bytes_left( std::istream &in )
+{
+	std::streamoff pos = in.tellg();
+	std::streamoff end = in.seekg( 0, std::ios::end ).tellg();
+	in.seekg( pos );
+	return ( pos < 0 || end < pos ) ? 0 : ( uint64_t )( end - pos );
+}
+
+void write_string( std::ostream &out, const std::string &s )
+{
+	uint32_t len = ( uint32_t )s.size();
+	write_value( out, len );
+	out.write( s.data(), len );
+}
+
+bool read_string( std::istream &in, std::string &s )
+{
+	uint32_t len;
+	bool res = ( read_value( in, len ) && len <= bytes_left( in ) );
+	if ( res )
+	{
+		s.resize( len );
+		if ( len > 0 ) res = in.read( &s[ 0 ], len ).good();
+	}
+	return res;
+}
+
+void write_range( std::ostream &out, const range &r )
+{
+	write_value( out, r.get_start() );
+	write_value( out, r.get_end() );
+}
+
+bool read_range( std::istream &in, range &r )
+{
+	long start, end;
+	bool res = ( read_value( in, start ) && read_value( in, end ) );
+	if ( res ) r.set( start, end );
+	return res;
+}
+
+
+/* -----------------------------------------------------------------------
+	all features of one reference, stored contiguously in gtf-order
+
+	interval index: the features sorted by start, plus the running maximum
+	of their ends. The features overlapping a range are found by a binary
+	search for the last feature starting before the range ends, followed
+	by a walk back that stops as soon as the running maximum of the ends
+	is before the range.
+   ----------------------------------------------------------------------- */
+class ref_features
 {
 	private :
-		const std::string filename;
-		const std::string idattr;
-		const std::string feature_type;
-		feature_range * stored_feature_range;
-		feature * stored_next_feature;
-		std::ifstream inputstream;
-		
-		feature_range * read_next_feature_range( void )
+		std::string ref_name;
+		std::vector< feature > features;
+		std::vector< range > feature_ranges;
+		std::vector< size_t > by_start;
+		std::vector< long > max_end;
+
+		struct start_less
+		{
+			const std::vector< feature > &f;
+			start_less( const std::vector< feature > &f_ ) : f( f_ ) {}
+			bool operator() ( size_t a, size_t b ) const
+			{ return f[ a ].outer.get_start() < f[ b ].outer.get_start(); }
+		};
+
+	public :
+		ref_features( const std::string &ref_name_ ) : ref_name( ref_name_ ) {}
+
+		const std::string &name( void ) const { return ref_name; }
+		size_t count( void ) const { return features.size(); }
+		const feature &operator[] ( size_t idx ) const { return features[ idx ]; }
+
+		/* the end of the last feature, no alignment after it can match */
+		long last_end( void ) const { return max_end.empty() ? 0 : max_end.back(); }
+
+		void add( const std::string &feature_id, const range &r, char strand )
+		{
+			feature f;
+			f.feature_id = feature_id;
+			f.strand = strand;
+			f.outer = r;
+			f.first_range = feature_ranges.size();
+			f.range_count = 1;
+			features.push_back( f );
+			feature_ranges.push_back( r );
+		}
+
+		/* merges the range into the last feature if it has the same id */
+		bool extend_last( const std::string &feature_id, const range &r )
 		{
-			feature_range * res = NULL;
-			if ( inputstream.good() )
+			bool res = ( !features.empty() && features.back().feature_id == feature_id );
+			if ( res )
 			{
-				std::string line;
-				if ( std::getline( inputstream, line ) )
+				feature &f = features.back();
+				bool merged = false;
+				for ( size_t i = f.first_range; i < feature_ranges.size() && !merged; ++i )
+					merged = feature_ranges[ i ].merge( r );
+				if ( !merged )
 				{
-					std::string ref_name, feature_id;
-					long start, end;
-					char strand;
-					if ( split_line( line, feature_type, idattr,
-									  ref_name, feature_id, start, end, strand ) )
-					{
-						res = new feature_range( ref_name, feature_id, start, end, strand );
-					}
+					feature_ranges.push_back( r );
+					f.range_count++;
 				}
+				f.outer.include( r );
 			}
 			return res;
 		}
 
-		feature_range * next_feature_range( void )
+		void build_index( void )
 		{
-			feature_range * res = NULL;
-			if ( stored_feature_range != NULL )
+			by_start.resize( features.size() );
+			for ( size_t i = 0; i < features.size(); ++i )
+				by_start[ i ] = i;
+			std::stable_sort( by_start.begin(), by_start.end(), start_less( features ) );
+
+			max_end.resize( features.size() );
+			long end = 0;
+			for ( size_t i = 0; i < by_start.size(); ++i )
 			{
-				res = stored_feature_range;
-				stored_feature_range = NULL;
+				long e = features[ by_start[ i ] ].outer.get_end();
+				if ( e > end ) end = e;
+				max_end[ i ] = end;
 			}
-			else while ( inputstream.good() && res == NULL )
+		}
+
+		/* increments the counter of every feature overlapping the range */
+		void count_overlaps( const range &r, std::vector< long > &counter ) const
+		{
+			size_t lo = 0, hi = by_start.size();
+			while ( lo < hi )
 			{
-				/* because read_next_feature_range can return NULL if the line contains the wrong feature_type */
-				res = read_next_feature_range();
+				size_t mid = lo + ( hi - lo ) / 2;
+				if ( features[ by_start[ mid ] ].outer.get_start() <= r.get_end() )
+					lo = mid + 1;
+				else
+					hi = mid;
 			}
-			return res;
+			while ( lo > 0 && max_end[ lo - 1 ] >= r.get_start() )
+			{
+				size_t idx = by_start[ --lo ];
+				if ( features[ idx ].outer.get_end() >= r.get_start() )
+					counter[ idx ]++;
+			}
+		}
+
+		/* the name of a feature in the report */
+		void print_feature( size_t idx, int output_mode, std::ostream &out ) const
+		{
+			const feature &f = features[ idx ];
+			if ( output_mode != SSC_MODE_NORMAL )
+				out << ref_name << "." << f.outer << "(" << f.range_count << ") ";
+			out << f.feature_id;
 		}
 
-		feature * read_next_feature( void )
+		void report( const std::vector< long > &counter, int output_mode, std::ostream &out ) const
 		{
-			feature * res = NULL;
-			feature_range * fr = next_feature_range();
-			if ( fr != NULL )
+			for ( size_t i = 0; i < features.size(); ++i )
 			{
-				res = new feature( *fr );
-				delete fr;
-				bool done = ( res == NULL );
-				while ( !done )
+				if ( counter[ i ] > 0 )
 				{
-					fr = next_feature_range();
-					done = ( fr == NULL );
-					if ( !done )
-					{
-						done = !( res -> add( *fr ) );
-						if ( done )
-							stored_feature_range = fr;
-						else
-							delete fr;
-					}
+					print_feature( i, output_mode, out );
+					out << "\t" << counter[ i ] << std::endl;
 				}
-				if ( done ) res->sort_ranges();
 			}
-			return res;
 		}
-		
-	public :
-		gtf_iter( const char * filename_, const std::string &idattr_, const std::string &feature_type_  ) :
-			filename( filename_ ), idattr( idattr_ ), feature_type( feature_type_ ),
-			stored_feature_range( NULL ), inputstream( filename_ )
+
+		void write( std::ostream &out ) const
+		{
+			write_string( out, ref_name );
+			write_value( out, ( uint64_t )features.size() );
+			for ( size_t i = 0; i < features.size(); ++i )
 			{
-				stored_next_feature = read_next_feature();
+				const feature &f = features[ i ];
+				write_string( out, f.feature_id );
+				write_value( out, f.strand );
+				write_range( out, f.outer );
+				write_value( out, ( uint64_t )f.first_range );
+				write_value( out, f.range_count );
 			}
-		
-		bool good( void ) { return ( stored_next_feature != NULL ); }
-		
-		feature * next_feature( void )
+			write_value( out, ( uint64_t )feature_ranges.size() );
+			for ( size_t i = 0; i < feature_ranges.size(); ++i )
+				write_range( out, feature_ranges[ i ] );
+		}
+
+		/* a cache which does not fit together is rejected, the gtf-file is parsed again */
+		bool read( std::istream &in )
 		{
-			feature * res = stored_next_feature;
-			if ( res != NULL )
-				stored_next_feature = read_next_feature();
+			const uint64_t feature_size = sizeof( uint32_t ) + sizeof( char ) + 2 * sizeof( long ) +
+										  sizeof( uint64_t ) + sizeof( long );
+			const uint64_t range_size = 2 * sizeof( long );
+			uint64_t n;
+			bool res = ( read_string( in, ref_name ) && read_value( in, n ) &&
+						 n <= bytes_left( in ) / feature_size );
+			if ( res )
+			{
+				features.resize( ( size_t )n );
+				for ( size_t i = 0; i < features.size() && res; ++i )
+				{
+					feature &f = features[ i ];
+					uint64_t first_range;
+					res = ( read_string( in, f.feature_id ) && read_value( in, f.strand ) &&
+							read_range( in, f.outer ) && read_value( in, first_range ) &&
+							read_value( in, f.range_count ) );
+					f.first_range = ( size_t )first_range;
+				}
+			}
+			if ( res ) res = ( read_value( in, n ) && n <= bytes_left( in ) / range_size );
+			if ( res )
+			{
+				feature_ranges.resize( ( size_t )n );
+				for ( size_t i = 0; i < feature_ranges.size() && res; ++i )
+					res = read_range( in, feature_ranges[ i ] );
+			}
+			for ( size_t i = 0; i < features.size() && res; ++i )
+			{
+				const feature &f = features[ i ];
+				res = ( f.range_count >= 0 && f.first_range <= feature_ranges.size() &&
+						( uint64_t )f.range_count <= feature_ranges.size() - f.first_range );
+			}
+			if ( res ) build_index();
 			return res;
 		}
+};
+
+
+/* -----------------------------------------------------------------------
+	identifies a gtf-file and how it was parsed, a cached parse is only
+	used if all of it matches
+   ----------------------------------------------------------------------- */
+struct gtf_stamp
+{
+	uint64_t size;
+	int64_t mtime;
+	std::string idattr;
+	std::string feature_type;
+
+	bool make( const char * filename, const std::string &idattr_, const std::string &feature_type_ )
+	{
+		struct stat st;
+		bool res = ( stat( filename, &st ) == 0 );
+		if ( res )
+		{
+			size = ( uint64_t )st.st_size;
+			mtime = ( int64_t )st.st_mtime;
+			idattr = idattr_;
+			feature_type = feature_type_;
+		}
+		return res;
+	}
+
+	void write( std::ostream &out ) const
+	{
+		write_value( out, size );
+		write_value( out, mtime );
+		write_string( out, idattr );
+		write_string( out, feature_type );
+	}
+
+	bool matches( std::istream &in ) const
+	{
+		gtf_stamp other;
+		bool res = ( read_value( in, other.size ) && read_value( in, other.mtime ) &&
+					 read_string( in, other.idattr ) && read_string( in, other.feature_type ) );
+		return ( res && size == other.size && mtime == other.mtime &&
+				 idattr == other.idattr && feature_type == other.feature_type );
+	}
+};
+
+
+/* -----------------------------------------------------------------------
+	the whole gtf-file, loaded once, the references in the order in
+	which they first appear in the file
+   ----------------------------------------------------------------------- */
+class gtf_index
+{
+	private :
+		std::vector< ref_features > refs;
+		std::map< std::string, size_t > ref_idx;
+		long features;
+
+		static const char * cache_magic( void ) { return "sra-seq-count gtf-cache 1"; }
+
+		void clear( void )
+		{
+			refs.clear();
+			ref_idx.clear();
+			features = 0;
+		}
 
-		feature * forward_to_next_ref( const std::string & ref )
+		void parse( const char * filename, const std::string &idattr, const std::string &feature_type )
 		{
-			feature * res = NULL;
-			bool done = false;
-			while ( !done )
+			std::ifstream inputstream( filename );
+			std::string line;
+			size_t last_ref = 0;
+			bool have_last = false;
+
+			while ( std::getline( inputstream, line ) )
 			{
-				res = next_feature();
-				done = ( res == NULL );
-				if ( !done )
+				std::string ref_name, feature_id;
+				long start, end;
+				char strand;
+				if ( split_line( line, feature_type, idattr, ref_name, feature_id, start, end, strand ) )
 				{
-					if ( res -> is_ref( ref ) )
-						delete res;
-					else
-						done = true;
+					const range r( start, end );
+					if ( !have_last || !refs[ last_ref ].extend_last( feature_id, r ) )
+					{
+						std::map< std::string, size_t >::iterator it = ref_idx.find( ref_name );
+						if ( it == ref_idx.end() )
+						{
+							it = ref_idx.insert( std::make_pair( ref_name, refs.size() ) ).first;
+							refs.push_back( ref_features( ref_name ) );
+						}
+						last_ref = it -> second;
+						have_last = true;
+						refs[ last_ref ].add( feature_id, r, strand );
+						features++;
+					}
 				}
 			}
-			return res;
+			for ( size_t i = 0; i < refs.size(); ++i )
+				refs[ i ].build_index();
 		}
-		
-		long peek_next_feature_start( void )
+
+		bool read_cache( const std::string &cache_name, const gtf_stamp &stamp )
 		{
-			if ( stored_next_feature != NULL )
-				return stored_next_feature -> start();
-			else
-				return 0;
+			std::ifstream in( cache_name.c_str(), std::ios::in | std::ios::binary );
+			std::string magic;
+			uint64_t n;
+			bool res = ( in.good() && read_string( in, magic ) && magic == cache_magic() &&
+						 stamp.matches( in ) && read_value( in, n ) );
+			for ( uint64_t i = 0; res && i < n; ++i )
+			{
+				refs.push_back( ref_features( std::string() ) );
+				res = refs.back().read( in );
+				if ( res )
+				{
+					ref_idx[ refs.back().name() ] = refs.size() - 1;
+					features += ( long )refs.back().count();
+				}
+			}
+			if ( !res ) clear();
+			return res;
 		}
 
-		bool peek_next_feature_range( range &r )
+		/* written under a temporary name and renamed: a reader never sees half of it */
+		bool write_cache( const std::string &cache_name, const gtf_stamp &stamp ) const
 		{
-			bool res = ( stored_next_feature != NULL );
-			if ( res ) stored_next_feature -> get_outer_range( r );
+			std::string tmp_name( cache_name + ".tmp" );
+			bool res;
+			{
+				std::ofstream out( tmp_name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+				write_string( out, cache_magic() );
+				stamp.write( out );
+				write_value( out, ( uint64_t )refs.size() );
+				for ( size_t i = 0; i < refs.size(); ++i )
+					refs[ i ].write( out );
+				out.flush();
+				res = out.good();
+			}
+			if ( res )
+				res = ( rename( tmp_name.c_str(), cache_name.c_str() ) == 0 );
+			if ( !res )
+				remove( tmp_name.c_str() );
 			return res;
 		}
-		
-		bool peek_next_feature_is_ref( const std::string &ref_name )
+
+	public :
+		gtf_index( void ) : features( 0 ) {}
+
+		/* parses the gtf-file, or reads the parse from the cache next to it */
+		void load( const char * filename, const std::string &idattr, const std::string &feature_type,
+				   bool use_cache )
 		{
-			if ( stored_next_feature != NULL )
-				return stored_next_feature -> is_ref( ref_name );
-			else
-				return false;
+			std::string cache_name( std::string( filename ) + ".ssc" );
+			gtf_stamp stamp;
+			bool cacheable = ( use_cache && stamp.make( filename, idattr, feature_type ) );
+
+			clear();
+			if ( cacheable && read_cache( cache_name, stamp ) )
+				return;
+			parse( filename, idattr, feature_type );
+			if ( cacheable && !write_cache( cache_name, stamp ) )
+				std::cerr << "cannot write gtf-cache " << cache_name << std::endl;
 		}
+
+		size_t count( void ) const { return refs.size(); }
+		long feature_count( void ) const { return features; }
+		const ref_features &operator[] ( size_t idx ) const { return refs[ idx ]; }
 };
 
 
@@ -366,6 +579,7 @@ class global_counter
 
 		void inc_refs( void ) { refs++; }		
 		void inc_total_alignments( void ) { total_alignments++; }
+		void add_total_alignments( long n ) { total_alignments += n; }
 		void inc_no_feature( void ) { no_feature++; }
 		void inc_ambiguous( void ) { ambiguous++; }
 		void inc_too_low_qual( void ) { too_low_qual++; }
@@ -387,176 +601,269 @@ class global_counter
 };
 
 
-class feature_list
+/* the outcome of counting the alignments of one reference in one run */
+struct ref_result
 {
-	private :
-		const std::string &ref_name;
-		int output_mode;
-		std::list< feature * > flist;
+	bool found;			/* the reference is in the run */
+	bool failed;		/* reading the alignments failed */
+	long alignments;
+	std::vector< long > counter;	/* one per feature of the reference */
+	std::string error;
 
-		void clear( void )
+	ref_result( void ) : found( false ), failed( false ), alignments( 0 ) {}
+};
+
+
+void count_reference( ngs::ReadCollection &run, const ref_features &rf, ref_result &res )
+{
+	ngs::Reference ref = run.getReference( rf.name() );
+	res.found = true;
+
+	try
+	{
+		const long last_end = rf.last_end();
+		ngs::AlignmentIterator al_iter = ref.getAlignments( ngs::Alignment::primaryAlignment );
+
+		res.counter.assign( rf.count(), 0 );
+		while ( al_iter.nextAlignment() )
+		{
+			int64_t  pos = al_iter.getAlignmentPosition() + 1; /* al_iter returns 0-based ! */
+			uint64_t len = al_iter.getAlignmentLength();
+
+			const range al_range( pos, pos + len - 1 );
+
+			/* the alignments are sorted by position: past the last feature nothing can match */
+			if ( al_range.get_start() > last_end )
+				break;
+
+			rf.count_overlaps( al_range, res.counter );
+			res.alignments++;
+		}
+	}
+	catch ( ngs::ErrorMsg e )
+	{
+		std::ostringstream out;
+		out << "error in ref " << rf.name() << " : " << e.what() << std::endl;
+		res.error = out.str();
+		res.failed = true;
+	}
+}
+
+
+/* -----------------------------------------------------------------------
+	every ( run, reference ) pair is a job, handed out run by run to
+	worker threads; a worker keeps the read-collection of its current run
+	open until it is given a job of another run
+   ----------------------------------------------------------------------- */
+struct count_pool
+{
+	const char ** accessions;
+	const gtf_index * gtf;
+	std::vector< std::vector< ref_result > > * results;	/* [ run ][ reference ] */
+	std::vector< bool > run_failed;
+	KLock * lock;
+	size_t next;
+	size_t jobs;
+};
+
+
+static void count_pool_lock( count_pool * pool )
+{
+	if ( pool -> lock != NULL ) KLockAcquire( pool -> lock );
+}
+
+
+static void count_pool_unlock( count_pool * pool )
+{
+	if ( pool -> lock != NULL ) KLockUnlock( pool -> lock );
+}
+
+
+/* the next job, skipping the references of runs that already failed */
+static bool count_pool_next( count_pool * pool, size_t &run_idx, size_t &ref_idx )
+{
+	const size_t refs = pool -> gtf -> count();
+	bool res = false;
+	count_pool_lock( pool );
+	while ( !res && pool -> next < pool -> jobs )
+	{
+		size_t job = pool -> next++;
+		run_idx = job / refs;
+		ref_idx = job % refs;
+		res = !pool -> run_failed[ run_idx ];
+	}
+	count_pool_unlock( pool );
+	return res;
+}
+
+
+static void count_pool_fail( count_pool * pool, size_t run_idx )
+{
+	count_pool_lock( pool );
+	pool -> run_failed[ run_idx ] = true;
+	count_pool_unlock( pool );
+}
+
+
+static rc_t CC count_thread( const KThread * self, void * data )
+{
+	count_pool * pool = ( count_pool * )data;
+	ngs::ReadCollection * run = NULL;
+	size_t open_idx = 0, run_idx, ref_idx;
+
+	while ( count_pool_next( pool, run_idx, ref_idx ) )
+	{
+		ref_result &res = ( *pool -> results )[ run_idx ][ ref_idx ];
+		try
 		{
-			while ( !flist.empty() )
+			if ( run == NULL || open_idx != run_idx )
 			{
-				feature * f = flist.front();
-				flist.pop_front();
-				if ( f != NULL ) delete f;
+				delete run;
+				run = NULL;
+				run = new ngs::ReadCollection( ncbi::NGS::openReadCollection( pool -> accessions[ run_idx ] ) );
+				open_idx = run_idx;
 			}
+			count_reference( *run, ( *pool -> gtf )[ ref_idx ], res );
 		}
-
-		void add( feature * f )
+		catch ( ngs::ErrorMsg e )
 		{
-			flist.push_back( f );
+			/* this reference is not in the run */
 		}
-		
-	public :
-		feature_list( const std::string &ref_name_, int output_mode_, feature * f )
-			: ref_name( ref_name_ ), output_mode( output_mode_ ) { add( f ); }
-		~feature_list( void ) { clear(); }
+		if ( res.failed )
+		{
+			/* the references after it are not reported */
+			count_pool_fail( pool, run_idx );
+		}
+	}
+	delete run;
+	return 0;
+}
 
-		bool empty( void ) { return flist.empty(); }
-		
-		void remove_all_features_before( const range &al_range )
+
+/* counts all runs against the gtf, results[ run ][ reference ] */
+void count_all_runs( const char ** accessions, size_t run_count, const gtf_index &gtf, int threads,
+					 std::vector< std::vector< ref_result > > &results )
+{
+	count_pool pool;
+	pool.accessions = accessions;
+	pool.gtf = &gtf;
+	pool.results = &results;
+	pool.run_failed.assign( run_count, false );
+	pool.lock = NULL;
+	pool.next = 0;
+	pool.jobs = run_count * gtf.count();
+
+	results.assign( run_count, std::vector< ref_result >( gtf.count() ) );
+
+	std::vector< KThread * > workers;
+	if ( threads > 1 && pool.jobs > 1 && KLockMake( &pool.lock ) == 0 )
+	{
+		for ( int i = 0; i < threads && ( size_t )i < pool.jobs; ++i )
 		{
-			bool done = flist.empty();
-			while ( !done )
-			{
-				feature * f = flist.front();
-				if ( f -> ends_before( al_range ) )
-				{
-					flist.pop_front();
-					f -> report( output_mode );
-					done = flist.empty();
-					delete f;
-				}
-				else
-					done = true;
-			}
+			KThread * t;
+			if ( KThreadMake( &t, count_thread, &pool ) == 0 )
+				workers.push_back( t );
 		}
+	}
 
-		void load_all_features_starting_inside( const range &al_range, gtf_iter &gtf_it )
+	if ( workers.empty() )
+	{
+		/* single threaded, on the calling thread */
+		count_thread( NULL, &pool );
+	}
+	else
+	{
+		for ( size_t i = 0; i < workers.size(); ++i )
 		{
-			bool done = false;
-			while ( !done )
-			{
-				done = !gtf_it.peek_next_feature_is_ref( ref_name );
-				if ( !done )
-				{
-					range r;
-					done = !gtf_it.peek_next_feature_range( r );
-					if ( !done )
-					{
-						if ( r.ends_before( al_range ) )
-						{
-							/* we can skip this feature! */
-							feature * f = gtf_it.next_feature();
-							delete f;
-						}
-						else if ( r.starts_after( al_range ) )
-						{
-							/* we are done, this feature if for alignments that come later */
-							done = true;
-						}
-						else
-						{
-							feature * f = gtf_it.next_feature();
-							if ( f != NULL ) add( f );
-						}
-					}
-				}
-			}
+			rc_t rc_thread;
+			KThreadWait( workers[ i ], &rc_thread );
+			KThreadRelease( workers[ i ] );
 		}
-		
-		void count_matches_between_alignment_and_features( const range &al_range )
+	}
+	KLockRelease( pool.lock );
+}
+
+
+/* one run: the counts of each reference, followed by the summary */
+void report_run( const gtf_index &gtf, const std::vector< ref_result > &results, int output_mode )
+{
+	global_counter counter;
+	for ( size_t idx = 0; idx < results.size(); ++idx )
+	{
+		const ref_result &res = results[ idx ];
+		if ( res.found )
 		{
-			std::list< feature * >::iterator it;
-			for ( it = flist.begin(); it != flist.end(); ++it )
+			std::cout << std::endl << "processing ref: " << gtf[ idx ].name() << std::endl;
+			std::cout << "-------------------------------------------" << std::endl;
+			if ( res.failed )
 			{
-				feature * f = *it;
-				if ( f != NULL )
-				{
-					f -> check( al_range );
-				}
+				std::cout << res.error;
+				break;
 			}
+			gtf[ idx ].report( res.counter, output_mode, std::cout );
+			counter.inc_refs();
+			counter.add_total_alignments( res.alignments );
 		}
-};
+	}
+	counter.report();
+}
 
 
-class iter_window
+/* many runs: a matrix with one row per feature and one column per run */
+void report_matrix( const gtf_index &gtf, const char ** accessions,
+					const std::vector< std::vector< ref_result > > &results, int output_mode )
 {
-	private :
-		ngs::ReadCollection &run;	
-		gtf_iter &gtf_it;
-		int output_mode;
-		global_counter counter;
-		
-	public :
-		iter_window( ngs::ReadCollection &run_, gtf_iter &gtf_it_, int output_mode_ )
-			: run( run_ ), gtf_it( gtf_it_ ), output_mode( output_mode_ ) {}
+	const size_t runs = results.size();
+	std::vector< long > totals( runs, 0 );
+	std::vector< long > refs( runs, 0 );
+	std::vector< bool > failed( runs, false );
+
+	std::cout << "feature_id";
+	for ( size_t run = 0; run < runs; ++run )
+		std::cout << "\t" << accessions[ run ];
+	std::cout << std::endl;
 
-		void walk( void )
+	for ( size_t idx = 0; idx < gtf.count(); ++idx )
+	{
+		const ref_features &rf = gtf[ idx ];
+		for ( size_t run = 0; run < runs; ++run )
 		{
-			feature * f = gtf_it.next_feature();
-			while ( f != NULL )
+			const ref_result &res = results[ run ][ idx ];
+			if ( res.found && !failed[ run ] )
 			{
-				/* get the name of the reference of the fist feature in here... */
-				std::string ref_name;
-				f -> get_ref_name( ref_name );
-				try
+				if ( res.failed )
 				{
-					ngs::Reference ref = run.getReference ( ref_name );
-					try
-					{
-						bool done = false;
-						feature_list flist( ref_name, output_mode, f );
-						ngs::AlignmentIterator al_iter = ref.getAlignments( ngs::Alignment::primaryAlignment );
-
-						std::cout << std::endl << "processing ref: " << ref_name << std::endl;
-						std::cout << "-------------------------------------------" << std::endl;
-						counter.inc_refs();
-						
-						/* now walk all alignments of this al_iter */
-						while ( al_iter.nextAlignment() && !done )
-						{
-							int64_t  pos = al_iter.getAlignmentPosition() + 1; /* al_iter returns 0-based ! */
-							uint64_t len = al_iter.getAlignmentLength();
-							
-							const range al_range( pos, pos + len - 1 );
-							
-							/* remove and report all features that end before this alignment */
-							flist.remove_all_features_before( al_range );
-							flist.load_all_features_starting_inside( al_range, gtf_it );
-							
-							/* now we can count matches between the feature-list and this alignment */
-							flist.count_matches_between_alignment_and_features( al_range );
-							
-							/* look if we have to cancel the loop if the feature-list is empty
-							   and we have no more features in this reference */
-							if ( flist.empty() )
-							{
-								done = ( gtf_it.peek_next_feature_start() == 0 );
-								if ( !done )
-									done = !gtf_it.peek_next_feature_is_ref( ref_name );
-							}
-							counter.inc_total_alignments();
-						}
-						f = gtf_it.forward_to_next_ref( ref_name );
-					}
-					catch ( ngs::ErrorMsg e )
-					{
-						std::cout << "error in ref " << ref_name << " : " << e.what() << std::endl;
-						f = NULL;
-					}
+					std::cerr << accessions[ run ] << " : " << res.error;
+					failed[ run ] = true;
 				}
-				catch ( ngs::ErrorMsg e )
+				else
 				{
-					f = gtf_it.forward_to_next_ref( ref_name );
+					refs[ run ]++;
+					totals[ run ] += res.alignments;
 				}
-
 			}
-			counter.report();
 		}
-};
+		for ( size_t f = 0; f < rf.count(); ++f )
+		{
+			rf.print_feature( f, output_mode, std::cout );
+			for ( size_t run = 0; run < runs; ++run )
+			{
+				const ref_result &res = results[ run ][ idx ];
+				bool counted = ( res.found && !res.failed && !res.counter.empty() );
+				std::cout << "\t" << ( counted ? res.counter[ f ] : 0 );
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	std::cout << "__total";
+	for ( size_t run = 0; run < runs; ++run )
+		std::cout << "\t" << totals[ run ];
+	std::cout << std::endl << "__refs";
+	for ( size_t run = 0; run < runs; ++run )
+		std::cout << "\t" << refs[ run ];
+	std::cout << std::endl;
+}
 
 
 int matching( const struct sra_seq_count_options * options )
@@ -566,65 +873,52 @@ int matching( const struct sra_seq_count_options * options )
 	std::string id_attr( options->id_attrib );
 	std::string feature_type( options->feature_type );
 
-	/* create the ngs-iterator, which delivers references and alignments */
-	try
+	bool all_open = true;
+
+	/* every run has to be accessible before the gtf is loaded and the counting starts */
+	for ( uint32_t run = 0; run < options->accession_count && all_open; ++run )
 	{
-		ngs::ReadCollection run ( ncbi::NGS::openReadCollection( options->sra_accession ) );
-		
-		/* create the gtf-iterator, which delivers gtf-features */		
-		gtf_iter gtf_it( options->gtf_file, id_attr, feature_type );
-		
-		/* create a iterator window that walks both iterators to count alignments for the features */
-		iter_window window( run, gtf_it, options->output_mode );
-		
-		/* walk the window... */
-		window.walk();
+		try
+		{
+			ngs::ReadCollection rc ( ncbi::NGS::openReadCollection( options->accessions[ run ] ) );
+		}
+		catch ( ngs::ErrorMsg e )
+		{
+			std::cout << "cannot open " << options->accessions[ run ] << " because " << e.what() << std::endl;
+			all_open = false;
+		}
 	}
-	catch ( ngs::ErrorMsg e )
+
+	if ( all_open )
 	{
-		std::cout << "cannot open " << options->sra_accession << " because " << e.what() << std::endl;
+		/* load the gtf-features once into an interval-index per reference */
+		gtf_index gtf;
+		gtf.load( options->gtf_file, id_attr, feature_type, options->use_cache );
+
+		/* count the alignments of each run and reference against the features */
+		std::vector< std::vector< ref_result > > results;
+		count_all_runs( options->accessions, options->accession_count, gtf, options->threads, results );
+
+		if ( options->accession_count == 1 )
+			report_run( gtf, results[ 0 ], options->output_mode );
+		else
+			report_matrix( gtf, options->accessions, results, options->output_mode );
 	}
 	return res;
 }
 
 
-int list_refs_in_gtf( const char * gtf )
+int list_refs_in_gtf( const char * gtf_file )
 {
 	int res = 0;
-	long feature_count = 0;
-	long feature_ref_count = 0;
-	std::string ref_name;
 	std::string id_attr( "gene_id" );
 	std::string feature_type( "exon" );
 
-	/* create the gtf-iterator, which delivers gtf-features */		
-	gtf_iter gtf_it( gtf, id_attr, feature_type );
-	
-	feature * f = gtf_it.next_feature();
-	while ( f != NULL )
-	{
-		/* count feature */
-		feature_count ++;
-
-		if ( f -> is_ref( ref_name ) )
-		{
-			feature_ref_count++;
-		}
-		else
-		{
-			if ( feature_ref_count > 0 )
-			{
-				std::cout << ref_name << "\t" << feature_ref_count << std::endl;
-				feature_ref_count = 0;
-			}
-			f -> get_ref_name( ref_name );
-		}
-
-		/* dispose feature */
-		delete f;
-		f = gtf_it.next_feature();	
-	}
-	std::cout << feature_count << " features" << std::endl;
+	gtf_index gtf;
+	gtf.load( gtf_file, id_attr, feature_type, false );
+	for ( size_t idx = 0; idx < gtf.count(); ++idx )
+		std::cout << gtf[ idx ].name() << "\t" << gtf[ idx ].count() << std::endl;
+	std::cout << gtf.feature_count() << " features" << std::endl;
 	
 	return res;
 }
@@ -0,0 +1,251 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include "blob_copy.h"
+#include "copy_meta.h"
+#include "definitions.h"
+
+#include <kdb/table.h>
+#include <kdb/column.h>
+#include <kdb/namelist.h>
+#include <klib/namelist.h>
+#include <kapp/main.h>
+#include <sysalloc.h>
+#include <stdlib.h>
+
+typedef struct blob_buffer
+{
+    void * data;
+    size_t size;
+} blob_buffer;
+
+
+static rc_t blob_copy_read( const KColumnBlob * blob, blob_buffer * buf, size_t * blob_size )
+{
+    size_t num_read, remaining;
+    /* ask for the size of the blob */
+    rc_t rc = KColumnBlobRead ( blob, 0, buf->data, 0, &num_read, &remaining );
+    DISP_RC( rc, "blob_copy_read:KColumnBlobRead() failed" );
+    if ( rc == 0 && remaining > buf->size )
+    {
+        void * tmp = realloc( buf->data, remaining );
+        if ( tmp == NULL )
+            rc = RC( rcExe, rcNoTarg, rcCopying, rcMemory, rcExhausted );
+        else
+        {
+            buf->data = tmp;
+            buf->size = remaining;
+        }
+    }
+    if ( rc == 0 )
+    {
+        size_t total = 0, to_read = remaining;
+        *blob_size = to_read;
+        while ( rc == 0 && total < to_read )
+        {
+            rc = KColumnBlobRead ( blob, total, ( uint8_t * )buf->data + total,
+                                   to_read - total, &num_read, &remaining );
+            DISP_RC( rc, "blob_copy_read:KColumnBlobRead() failed" );
+            if ( rc == 0 )
+            {
+                if ( num_read == 0 )
+                    rc = RC( rcExe, rcNoTarg, rcCopying, rcBlob, rcInsufficient );
+                total += num_read;
+            }
+        }
+    }
+    return rc;
+}
+
+
+static rc_t blob_copy_write( KColumn * dst_col, const blob_buffer * buf, size_t blob_size,
+                             int64_t first, uint32_t count )
+{
+    KColumnBlob * blob;
+    rc_t rc = KColumnCreateBlob ( dst_col, &blob );
+    DISP_RC( rc, "blob_copy_write:KColumnCreateBlob() failed" );
+    if ( rc == 0 )
+    {
+        rc = KColumnBlobAppend ( blob, buf->data, blob_size );
+        DISP_RC( rc, "blob_copy_write:KColumnBlobAppend() failed" );
+        if ( rc == 0 )
+        {
+            rc = KColumnBlobAssignRange ( blob, first, count );
+            DISP_RC( rc, "blob_copy_write:KColumnBlobAssignRange() failed" );
+        }
+        if ( rc == 0 )
+        {
+            rc = KColumnBlobCommit ( blob );
+            DISP_RC( rc, "blob_copy_write:KColumnBlobCommit() failed" );
+        }
+        KColumnBlobRelease ( blob );
+    }
+    return rc;
+}
+
+
+static rc_t blob_copy_blobs( const KColumn * src_col, KColumn * dst_col, blob_buffer * buf,
+                             uint64_t * blob_count )
+{
+    int64_t first, id, end;
+    uint64_t count;
+    rc_t rc = KColumnIdRange ( src_col, &first, &count );
+    DISP_RC( rc, "blob_copy_blobs:KColumnIdRange() failed" );
+
+    end = first + count;
+    for ( id = first; rc == 0 && id < end; )
+    {
+        const KColumnBlob * blob;
+
+        rc = Quitting();
+        if ( rc == 0 )
+        {
+            /* the column may have gaps: skip to the next existing row */
+            rc = KColumnFindFirstRowId ( src_col, &id, id );
+            if ( rc != 0 )
+            {
+                if ( GetRCState( rc ) == rcNotFound )
+                    rc = 0;
+                else
+                    DISP_RC( rc, "blob_copy_blobs:KColumnFindFirstRowId() failed" );
+                break;
+            }
+        }
+        if ( rc == 0 )
+        {
+            rc = KColumnOpenBlobRead ( src_col, &blob, id );
+            if ( rc != 0 )
+                PLOGERR( klogInt, (klogInt, rc,
+                         "KColumnOpenBlobRead() row #$(row_nr) failed",
+                         "row_nr=%ld", id ));
+            else
+            {
+                int64_t blob_first;
+                uint32_t blob_rows;
+                rc = KColumnBlobIdRange ( blob, &blob_first, &blob_rows );
+                DISP_RC( rc, "blob_copy_blobs:KColumnBlobIdRange() failed" );
+                if ( rc == 0 )
+                {
+                    size_t blob_size;
+                    rc = blob_copy_read( blob, buf, &blob_size );
+                    if ( rc == 0 )
+                        rc = blob_copy_write( dst_col, buf, blob_size, blob_first, blob_rows );
+                    if ( rc == 0 )
+                    {
+                        ( *blob_count )++;
+                        id = blob_first + blob_rows;
+                    }
+                }
+                KColumnBlobRelease ( blob );
+            }
+        }
+    }
+    return rc;
+}
+
+
+static rc_t blob_copy_column( const KTable * src_ktab, KTable * dst_ktab, const char * name,
+                              KCreateMode cmode, KChecksum cs_mode, blob_buffer * buf,
+                              const bool show_progress, const bool show_meta )
+{
+    const KColumn * src_col;
+    rc_t rc = KTableOpenColumnRead ( src_ktab, &src_col, "%s", name );
+    if ( rc != 0 )
+        PLOGERR( klogInt, (klogInt, rc,
+                 "KTableOpenColumnRead( $(col_name) ) failed", "col_name=%s", name ));
+    else
+    {
+        KColumn * dst_col;
+        rc = KTableCreateColumn ( dst_ktab, &dst_col, cmode, cs_mode, 0, "%s", name );
+        if ( rc != 0 )
+            PLOGERR( klogInt, (klogInt, rc,
+                     "KTableCreateColumn( $(col_name) ) failed", "col_name=%s", name ));
+        else
+        {
+            /* the column-metadata contains the physical encoding of the blobs */
+            rc = copy_column_meta ( src_col, dst_col, show_meta );
+            if ( rc == 0 )
+            {
+                uint64_t blob_count = 0;
+                rc = blob_copy_blobs( src_col, dst_col, buf, &blob_count );
+                if ( rc == 0 && show_progress )
+                    KOutMsg( "copied column >%s< ( %lu blobs )\n", name, blob_count );
+            }
+            KColumnRelease ( dst_col );
+        }
+        KColumnRelease ( src_col );
+    }
+    return rc;
+}
+
+
+rc_t blob_copy_table( const VTable * src_table, VTable * dst_table,
+                      KCreateMode cmode, KChecksum cs_mode,
+                      const bool show_progress, const bool show_meta )
+{
+    const KTable * src_ktab;
+    rc_t rc = VTableOpenKTableRead ( src_table, &src_ktab );
+    DISP_RC( rc, "blob_copy_table:VTableOpenKTableRead() failed" );
+    if ( rc == 0 )
+    {
+        KTable * dst_ktab;
+        rc = VTableOpenKTableUpdate ( dst_table, &dst_ktab );
+        DISP_RC( rc, "blob_copy_table:VTableOpenKTableUpdate() failed" );
+        if ( rc == 0 )
+        {
+            KNamelist * names;
+            rc = KTableListCol ( src_ktab, &names );
+            DISP_RC( rc, "blob_copy_table:KTableListCol() failed" );
+            if ( rc == 0 )
+            {
+                uint32_t i, count;
+                blob_buffer buf;
+
+                buf.size = 1024 * 1024;
+                buf.data = malloc( buf.size );
+                if ( buf.data == NULL )
+                    rc = RC( rcExe, rcNoTarg, rcCopying, rcMemory, rcExhausted );
+                else
+                    rc = KNamelistCount ( names, &count );
+
+                for ( i = 0; rc == 0 && i < count; ++i )
+                {
+                    const char * name;
+                    rc = KNamelistGet ( names, i, &name );
+                    DISP_RC( rc, "blob_copy_table:KNamelistGet() failed" );
+                    if ( rc == 0 )
+                        rc = blob_copy_column( src_ktab, dst_ktab, name, cmode, cs_mode,
+                                               &buf, show_progress, show_meta );
+                }
+                free( buf.data );
+                KNamelistRelease ( names );
+            }
+            KTableRelease ( dst_ktab );
+        }
+        KTableRelease ( src_ktab );
+    }
+    return rc;
+}
@@ -81,8 +81,11 @@ static void context_init_values( p_context ctx )
     ctx->md5_mode = MD5_MODE_AUTO;
     ctx->force_kcmInit = false;
     ctx->force_unlock = false;
+    ctx->threads = 1;
 
     ctx->dont_remove_target = false;
+    ctx->progress = NULL;
+    ctx->progress_slot = 0;
     config_values_init( &(ctx->config) );
     redact_vals_init( &(ctx->rvals) );
     ctx->dst_schema_tabname = NULL;
@@ -395,6 +398,22 @@ static const char* context_get_str_option( const Args *my_args,
 }
 
 
+static uint32_t context_get_uint32_option( const Args *my_args,
+                                           const char *name,
+                                           const uint32_t def )
+{
+    uint32_t res = def;
+    const char * value = context_get_str_option( my_args, name );
+    if ( value != NULL )
+    {
+        res = atoi( value );
+        if ( res == 0 )
+            res = def;
+    }
+    return res;
+}
+
+
 /*
  * returns the number of schema's given on the commandline
 */
@@ -428,6 +447,7 @@ static void context_evaluate_options( const Args *my_args, p_context ctx )
     ctx->show_meta     = context_get_bool_option( my_args, OPTION_SHOW_META, false );
     ctx->force_kcmInit = context_get_bool_option( my_args, OPTION_FORCE, false );
     ctx->force_unlock  = context_get_bool_option( my_args, OPTION_UNLOCK, false );
+    ctx->threads       = context_get_uint32_option( my_args, OPTION_THREADS, 1 );
 
     context_set_md5_mode( ctx, context_get_str_option( my_args, OPTION_MD5_MODE ) );
     context_set_blob_checksum( ctx, context_get_str_option( my_args, OPTION_BLOB_CHECKSUM ) );
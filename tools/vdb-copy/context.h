@@ -71,6 +71,7 @@ extern "C" {
 #define OPTION_FORCE             "force"
 #define OPTION_UNLOCK            "unlock"
 #define OPTION_BLOB_CHECKSUM     "blob_checksum"
+#define OPTION_THREADS           "threads"
 
 
 #define ALIAS_TABLE             "T"
@@ -96,6 +97,7 @@ extern "C" {
 #define ALIAS_FORCE             "f"
 #define ALIAS_UNLOCK            "u"
 #define ALIAS_BLOB_CHECKSUM     "b"
+#define ALIAS_THREADS           "j"
 
 
 /* *******************************************************************
@@ -127,9 +129,13 @@ typedef struct context
     uint8_t blob_checksum;
     bool force_kcmInit;
     bool force_unlock;
+    uint32_t threads;
 
     /* set by application */
     bool dont_remove_target;
+    /* progress shared by tables copied in parallel, NULL if not */
+    struct shared_progress * progress;
+    uint32_t progress_slot;
     config_values config;
     redact_vals * rvals;
     /* for the destination table*/
@@ -39,6 +39,10 @@ rc_t copy_database_meta ( const VDatabase *src_db, VDatabase *dst_db,
                           const char * excluded_nodes,
                           const bool show_meta );
 
+struct KColumn;
+rc_t copy_column_meta ( const struct KColumn *src_col, struct KColumn *dst_col,
+                        const bool show_meta );
+
 #ifdef __cplusplus
 }
 #endif
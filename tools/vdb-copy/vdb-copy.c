@@ -31,11 +31,14 @@
 #include "coldefs.h"
 #include "get_platform.h"
 #include "copy_meta.h"
+#include "blob_copy.h"
 #include "type_matcher.h"
 #include "redactval.h"
 
 #include <kapp/main.h>
 #include <klib/progressbar.h>
+#include <kproc/lock.h>
+#include <kproc/thread.h>
 #include <sysalloc.h>
 
 /*
@@ -71,6 +74,7 @@ static const char * md5mode_usage[] = { "MD5-mode def.: auto, '1'...forced ON, '
 static const char * blcmode_usage[] = { "Blob-checksum def.: auto, '1'...CRC32, 'M'...MD5, '0'...OFF)", NULL };
 static const char * force_usage[] = { "forces an existing target to be overwritten", NULL };
 static const char * unlock_usage[] = { "forces a locked target to be unlocked", NULL };
+static const char * threads_usage[] = { "copy the tables of a database on this many threads (def.: 1)", NULL };
 
 OptDef MyOptions[] =
 {
@@ -96,7 +100,8 @@ OptDef MyOptions[] =
     { OPTION_MD5_MODE, ALIAS_MD5_MODE, NULL, md5mode_usage, 1, true, false },
     { OPTION_BLOB_CHECKSUM, ALIAS_BLOB_CHECKSUM, NULL, blcmode_usage, 1, true, false },
     { OPTION_FORCE, ALIAS_FORCE, NULL, force_usage, 1, false, false },
-    { OPTION_UNLOCK, ALIAS_UNLOCK, NULL, unlock_usage, 1, false, false }
+    { OPTION_UNLOCK, ALIAS_UNLOCK, NULL, unlock_usage, 1, false, false },
+    { OPTION_THREADS, ALIAS_THREADS, NULL, threads_usage, 1, true, false }
 };
 
 
@@ -152,6 +157,7 @@ rc_t CC Usage ( const Args * args )
     HelpOptionLine ( ALIAS_UNLOCK, OPTION_UNLOCK, NULL, unlock_usage );
     HelpOptionLine ( ALIAS_MD5_MODE, OPTION_MD5_MODE, NULL, md5mode_usage );
     HelpOptionLine ( ALIAS_BLOB_CHECKSUM, OPTION_BLOB_CHECKSUM, NULL, blcmode_usage );
+    HelpOptionLine ( ALIAS_THREADS, OPTION_THREADS, "count", threads_usage );
 
     HelpOptionsStandard ();
 
@@ -365,6 +371,84 @@ static rc_t vdb_copy_read_row_flags( const p_context ctx,
 }
 
 
+/* one progressbar for all tables copied in parallel:
+   every table reports its own percentage into its slot,
+   the bar shows the average over all slots */
+typedef struct shared_progress
+{
+    KLock * lock;
+    struct progressbar * bar;
+    uint32_t * percent;
+    uint32_t count;
+    uint32_t shown;
+} shared_progress;
+
+
+static rc_t shared_progress_make( shared_progress ** sp, uint32_t count )
+{
+    rc_t rc;
+    shared_progress * p = calloc( 1, sizeof *p );
+    if ( p == NULL )
+        return RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+    p->count = count;
+    p->percent = calloc( count, sizeof *( p->percent ) );
+    if ( p->percent == NULL )
+        rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+    else
+    {
+        rc = KLockMake( &p->lock );
+        DISP_RC( rc, "shared_progress_make:KLockMake() failed" );
+        if ( rc == 0 )
+        {
+            rc = make_progressbar( &p->bar, 2 );
+            DISP_RC( rc, "shared_progress_make:make_progressbar() failed" );
+        }
+    }
+    if ( rc == 0 )
+        *sp = p;
+    else
+    {
+        KLockRelease( p->lock );
+        free( p->percent );
+        free( p );
+    }
+    return rc;
+}
+
+
+static void shared_progress_update( shared_progress * p, uint32_t slot, uint32_t percent )
+{
+    uint64_t sum = 0;
+    uint32_t idx, avg;
+
+    KLockAcquire( p->lock );
+    if ( percent > p->percent[ slot ] )
+        p->percent[ slot ] = percent;
+    for ( idx = 0; idx < p->count; ++idx )
+        sum += p->percent[ idx ];
+    avg = ( uint32_t )( sum / p->count );
+    if ( avg > p->shown )
+    {
+        update_progressbar( p->bar, avg );
+        p->shown = avg;
+    }
+    KLockUnlock( p->lock );
+}
+
+
+static void shared_progress_destroy( shared_progress * p )
+{
+    if ( p != NULL )
+    {
+        KOutMsg( "\n" );
+        destroy_progressbar( p->bar );
+        KLockRelease( p->lock );
+        free( p->percent );
+        free( p );
+    }
+}
+
+
 static rc_t vdb_copy_row_loop( const p_context ctx,
                                const VCursor * src_cursor,
                                VCursor * dst_cursor,
@@ -386,9 +470,12 @@ static rc_t vdb_copy_row_loop( const p_context ctx,
     rc = num_gen_iterator_make( ctx->row_generator, &iter );
     if ( rc != 0 ) return rc;
 
-    rc = make_progressbar( &progress, 2 );
-    DISP_RC( rc, "vdb_copy_row_loop:make_progressbar() failed" );
-    if ( rc != 0 ) return rc;
+    if ( ctx->progress == NULL )
+    {
+        rc = make_progressbar( &progress, 2 );
+        DISP_RC( rc, "vdb_copy_row_loop:make_progressbar() failed" );
+        if ( rc != 0 ) return rc;
+    }
 
     redact_buf_init( &rbuf );
     col_defs_find_redact_vals( columns, rvals );
@@ -440,7 +527,12 @@ static rc_t vdb_copy_row_loop( const p_context ctx,
                 if ( ctx->show_progress )
                 {
                     if ( num_gen_iterator_percent( iter, 2, &percent ) == 0 )
-                        update_progressbar( progress, percent );
+                    {
+                        if ( ctx->progress != NULL )
+                            shared_progress_update( ctx->progress, ctx->progress_slot, percent );
+                        else
+                            update_progressbar( progress, percent );
+                    }
                 }
             }
         }
@@ -454,9 +546,12 @@ static rc_t vdb_copy_row_loop( const p_context ctx,
          GetRCState( rc ) == rcInvalid )
         rc = 0;
 
-    if ( ctx->show_progress )
-        KOutMsg( "\n" );
-    destroy_progressbar( progress );
+    if ( ctx->progress == NULL )
+    {
+        if ( ctx->show_progress )
+            KOutMsg( "\n" );
+        destroy_progressbar( progress );
+    }
 
     PLOGMSG( klogInfo, ( klogInfo, "\n $(row_cnt) rows copied", "row_cnt=%lu", count ));
 
@@ -838,6 +933,34 @@ static rc_t vdb_copy_open_source_table( const p_context ctx,
 }
 
 
+/* the blobs of a table can be copied without decoding them, if the
+   rows are not touched on the way: all columns, all rows, the same schema
+   on both sides and no filter-column that would reject or redact rows */
+static bool vdb_copy_blobs_possible( const p_context ctx,
+                                     const VTable * src_table,
+                                     bool whole_table,
+                                     bool is_legacy )
+{
+    bool res = ( whole_table && !is_legacy &&
+                 ctx->columns == NULL && ctx->excluded_columns == NULL );
+    if ( res && !( ctx->ignore_reject && ctx->ignore_redact ) &&
+         ctx->config.filter_col_name != NULL )
+    {
+        KNamelist * names;
+        rc_t rc = VTableListReadableColumns( src_table, &names );
+        DISP_RC( rc, "vdb_copy_blobs_possible:VTableListReadableColumns() failed" );
+        if ( rc == 0 )
+        {
+            res = !nlt_is_name_in_namelist( names, ctx->config.filter_col_name );
+            KNamelistRelease( names );
+        }
+        else
+            res = false;
+    }
+    return res;
+}
+
+
 static rc_t vdb_copy_table2( const p_context ctx,
                              VDBManager * vdb_mgr,
                              const VTable * src_table,
@@ -852,10 +975,32 @@ static rc_t vdb_copy_table2( const p_context ctx,
 
     KCreateMode cmode = helper_assemble_CreateMode( src_table, 
                               ctx->force_kcmInit, ctx->md5_mode );
+    /* has to be asked before the range-check fills the number-generator */
+    bool whole_table = num_gen_empty( ctx->row_generator );
     rc_t rc = vdb_copy_open_source_table( ctx, vdb_mgr, src_schema, &dst_schema,
                                      src_table, src_cursor, cmode, &dst_table, columns,
                                      &is_legacy, type_matcher );
-    if ( rc == 0 )
+    if ( rc == 0 && vdb_copy_blobs_possible( ctx, src_table, whole_table, is_legacy ) )
+    {
+        rc = copy_table_meta( src_table, dst_table, 
+                              ctx->config.meta_ignore_nodes, 
+                              ctx->show_meta, is_legacy );
+        if ( rc == 0 )
+        {
+            KChecksum cs_mode = helper_assemble_ChecksumMode( ctx->blob_checksum );
+            rc = blob_copy_table( src_table, dst_table, cmode, cs_mode,
+                                  ctx->show_progress, ctx->show_meta );
+            /* the blobs bypass the index-functions of the schema */
+            if ( rc == 0 )
+            {
+                rc = VTableReindex( dst_table );
+                DISP_RC( rc, "vdb_copy_table2:VTableReindex() failed" );
+            }
+        }
+        VSchemaRelease( dst_schema );
+        VTableRelease( dst_table );
+    }
+    else if ( rc == 0 )
     {
         VCursor * dst_cursor;
         rc = vdb_copy_open_dest_table( ctx, src_table, dst_table, &dst_cursor, columns, 
@@ -977,7 +1122,7 @@ static rc_t vdb_copy_cur_2_cur( const p_context ctx,
                             col_defs_unmark_do_not_redact_columns( columns,
                                             ctx->config.do_not_redact_columns );
 
-                            if ( ctx->show_progress )
+                            if ( ctx->show_progress && ctx->progress == NULL )
                                 KOutMsg( "copy of >%s<\n", tab_name );
 
                             vdb_copy_find_filter_and_redact_columns( schema,
@@ -1067,49 +1212,240 @@ static rc_t vdb_copy_tab_2_tab( const p_context ctx,
 }
 
 
-static rc_t vdb_copy_db_tab( const p_context ctx,
-                             const VDatabase * src_db,
-                             VDatabase * dst_db,
-                             const char *tab_name )
+/* a table of a database: source and destination opened,
+   ready to have its content copied */
+typedef struct db_tab_job
 {
+    const char * tab_name;
     const VTable * src_tab;
-    rc_t rc = VDatabaseOpenTableRead( src_db, &src_tab, "%s", tab_name );
+    VTable * dst_tab;
+    KCreateMode cmode;
+    KChecksum cs_mode;
+} db_tab_job;
+
+
+static rc_t vdb_copy_db_tab_open( const p_context ctx,
+                                  const VDatabase * src_db,
+                                  VDatabase * dst_db,
+                                  const char *tab_name,
+                                  db_tab_job * job )
+{
+    rc_t rc;
+
+    job->tab_name = tab_name;
+    job->src_tab = NULL;
+    job->dst_tab = NULL;
+    rc = VDatabaseOpenTableRead( src_db, &job->src_tab, "%s", tab_name );
     DISP_RC( rc, "vdb_copy_db_tab:VDatabaseOpenTableRead(src) failed" );
     if ( rc == 0 )
     {
-        VTable * dst_tab;
-        KCreateMode cmode = helper_assemble_CreateMode( src_tab, 
+        job->cmode = helper_assemble_CreateMode( job->src_tab, 
                             ctx->force_kcmInit, ctx->md5_mode );
 
-        rc = VDatabaseCreateTable ( dst_db, &dst_tab, tab_name, 
-                                    cmode, "%s", tab_name );
+        rc = VDatabaseCreateTable ( dst_db, &job->dst_tab, tab_name, 
+                                    job->cmode, "%s", tab_name );
         DISP_RC( rc, "vdb_copy_db_tab:VDatabaseCreateTable(dst) failed" );
         if ( rc == 0 )
         {
-            KChecksum cs_mode = helper_assemble_ChecksumMode( ctx->blob_checksum );
-            rc = VTableColumnCreateParams ( dst_tab, cmode, cs_mode, 0 );
+            job->cs_mode = helper_assemble_ChecksumMode( ctx->blob_checksum );
+            rc = VTableColumnCreateParams ( job->dst_tab, job->cmode, job->cs_mode, 0 );
             DISP_RC( rc, "vdb_copy_db_tab:VTableColumnCreateParams failed" );
             if ( rc == 0 )
             {
-                rc = copy_table_meta( src_tab, dst_tab, 
+                rc = copy_table_meta( job->src_tab, job->dst_tab, 
                                       ctx->config.meta_ignore_nodes, 
                                       ctx->show_meta, false );
                 DISP_RC( rc, "vdb_copy_db_tab:copy_table_meta failed" );
-                if ( rc == 0 )
-                {
-                    /********************************************************/
-                    rc = vdb_copy_tab_2_tab( ctx, src_tab, dst_tab, tab_name );
-                    /********************************************************/
-                }
             }
-            VTableRelease( dst_tab );
         }
-        VTableRelease( src_tab );
     }
     return rc;
 }
 
 
+static rc_t vdb_copy_db_tab_run( const p_context ctx, db_tab_job * job )
+{
+    rc_t rc;
+    if ( vdb_copy_blobs_possible( ctx, job->src_tab, true, false ) )
+    {
+        rc = blob_copy_table( job->src_tab, job->dst_tab, job->cmode, job->cs_mode,
+                              ctx->show_progress && ctx->progress == NULL,
+                              ctx->show_meta );
+        /* the blobs bypass the index-functions of the schema */
+        if ( rc == 0 )
+        {
+            rc = VTableReindex( job->dst_tab );
+            DISP_RC( rc, "vdb_copy_db_tab_run:VTableReindex() failed" );
+        }
+    }
+    else
+    {
+        /********************************************************/
+        rc = vdb_copy_tab_2_tab( ctx, job->src_tab, job->dst_tab, job->tab_name );
+        /********************************************************/
+    }
+    return rc;
+}
+
+
+static void vdb_copy_db_tab_close( db_tab_job * job )
+{
+    VTableRelease( job->dst_tab );
+    VTableRelease( job->src_tab );
+    job->dst_tab = NULL;
+    job->src_tab = NULL;
+}
+
+
+static rc_t vdb_copy_db_tab( const p_context ctx,
+                             const VDatabase * src_db,
+                             VDatabase * dst_db,
+                             const char *tab_name )
+{
+    db_tab_job job;
+    rc_t rc = vdb_copy_db_tab_open( ctx, src_db, dst_db, tab_name, &job );
+    if ( rc == 0 )
+        rc = vdb_copy_db_tab_run( ctx, &job );
+    vdb_copy_db_tab_close( &job );
+    return rc;
+}
+
+
+/* the tables of a database live in directories of their own:
+   the worker-threads take the next table from the list and copy it
+   with a private context, because the context carries the row-range */
+typedef struct db_tab_pool
+{
+    p_context ctx;
+    db_tab_job * jobs;
+    KLock * lock;
+    uint32_t count;
+    uint32_t next;
+    rc_t rc;
+} db_tab_pool;
+
+
+static rc_t CC vdb_copy_db_tab_worker( const KThread *self, void *data )
+{
+    db_tab_pool * pool = data;
+    context w_ctx = *( pool->ctx );
+    rc_t rc = num_gen_make( &w_ctx.row_generator );
+    DISP_RC( rc, "vdb_copy_db_tab_worker:num_gen_make() failed" );
+
+    while ( rc == 0 )
+    {
+        uint32_t idx;
+
+        KLockAcquire( pool->lock );
+        idx = pool->next;
+        if ( pool->rc == 0 && idx < pool->count )
+            pool->next++;
+        else
+            idx = pool->count;
+        KLockUnlock( pool->lock );
+        if ( idx >= pool->count )
+            break;
+
+        w_ctx.progress_slot = idx;
+        rc = vdb_copy_db_tab_run( &w_ctx, &pool->jobs[ idx ] );
+        if ( rc == 0 && w_ctx.progress != NULL )
+            shared_progress_update( w_ctx.progress, idx, 10000 );
+    }
+
+    if ( w_ctx.row_generator != NULL )
+        num_gen_destroy( w_ctx.row_generator );
+
+    if ( rc != 0 )
+    {
+        KLockAcquire( pool->lock );
+        if ( pool->rc == 0 )
+            pool->rc = rc;
+        KLockUnlock( pool->lock );
+    }
+    return rc;
+}
+
+
+static rc_t vdb_copy_db_sub_tables_parallel( const p_context ctx,
+                                             const VDatabase * src_db,
+                                             VDatabase * dst_db,
+                                             const KNamelist * names,
+                                             uint32_t count )
+{
+    db_tab_pool pool;
+    KThread ** threads;
+    uint32_t idx, opened = 0, num_threads = 0;
+    uint32_t max_threads = ( ctx->threads < count ) ? ctx->threads : count;
+    rc_t rc;
+
+    memset( &pool, 0, sizeof pool );
+    pool.ctx = ctx;
+    pool.count = count;
+    pool.jobs = calloc( count, sizeof *( pool.jobs ) );
+    threads = calloc( max_threads, sizeof *threads );
+    if ( pool.jobs == NULL || threads == NULL )
+    {
+        free( pool.jobs );
+        free( threads );
+        return RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+    }
+
+    /* creating the tables and copying their metadata changes the
+       destination-database: this is done here before the threads start */
+    for ( rc = 0; rc == 0 && opened < count; ++opened )
+    {
+        const char *a_name;
+        rc = KNamelistGet( names, opened, &a_name );
+        DISP_RC( rc, "vdb_copy_db_sub_tables:KNamelistGet() failed" );
+        if ( rc == 0 )
+            rc = vdb_copy_db_tab_open( ctx, src_db, dst_db, a_name, &pool.jobs[ opened ] );
+    }
+
+    if ( rc == 0 )
+    {
+        rc = KLockMake( &pool.lock );
+        DISP_RC( rc, "vdb_copy_db_sub_tables:KLockMake() failed" );
+    }
+    if ( rc == 0 && ctx->show_progress )
+        rc = shared_progress_make( &( ctx->progress ), count );
+
+    while ( rc == 0 && num_threads < max_threads )
+    {
+        rc = KThreadMake( &threads[ num_threads ], vdb_copy_db_tab_worker, &pool );
+        DISP_RC( rc, "vdb_copy_db_sub_tables:KThreadMake() failed" );
+        if ( rc == 0 )
+            num_threads++;
+    }
+    if ( rc != 0 && pool.lock != NULL )
+    {
+        /* stop the threads already running after their current table */
+        KLockAcquire( pool.lock );
+        if ( pool.rc == 0 )
+            pool.rc = rc;
+        KLockUnlock( pool.lock );
+    }
+
+    for ( idx = 0; idx < num_threads; ++idx )
+    {
+        rc_t rc_thread;
+        KThreadWait( threads[ idx ], &rc_thread );
+        KThreadRelease( threads[ idx ] );
+    }
+    if ( rc == 0 )
+        rc = pool.rc;
+
+    shared_progress_destroy( ctx->progress );
+    ctx->progress = NULL;
+
+    for ( idx = 0; idx < opened; ++idx )
+        vdb_copy_db_tab_close( &pool.jobs[ idx ] );
+    KLockRelease( pool.lock );
+    free( pool.jobs );
+    free( threads );
+    return rc;
+}
+
+
 static rc_t vdb_copy_db_sub_tables( const p_context ctx,
                                     const VDatabase * src_db,
                                     VDatabase * dst_db )
@@ -1122,7 +1458,13 @@ static rc_t vdb_copy_db_sub_tables( const p_context ctx,
         uint32_t idx, count;
         rc = KNamelistCount( names, &count );
         DISP_RC( rc, "vdb_copy_db_sub_tables:KNamelistCount failed" );
-        if ( rc == 0 )
+        if ( rc == 0 && ctx->threads > 1 && count > 1 )
+        {
+            /**************************************************/
+            rc = vdb_copy_db_sub_tables_parallel( ctx, src_db, dst_db, names, count );
+            /**************************************************/
+        }
+        else if ( rc == 0 )
             for ( idx = 0; idx < count && rc == 0; ++idx )
             {
                 const char *a_name;
@@ -0,0 +1,795 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include "blob_diff.h"
+#include "namelist_tools.h"
+
+#include <kapp/main.h>
+
+#include <klib/log.h>
+#include <klib/namelist.h>
+
+#include <kdb/table.h>
+#include <kdb/column.h>
+#include <kdb/meta.h>
+#include <kdb/namelist.h>
+
+#include <vdb/schema.h>
+
+#include <sysalloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+void diff_ranges_init( diff_ranges * self )
+{
+	self -> ranges = NULL;
+	self -> count = 0;
+	self -> alloc = 0;
+	self -> usable = false;
+}
+
+
+void diff_ranges_release( diff_ranges * self )
+{
+	if ( self -> ranges != NULL )
+		free( self -> ranges );
+	diff_ranges_init( self );
+}
+
+
+bool diff_ranges_all_equal( const diff_ranges * self )
+{
+	return ( self -> usable && self -> count == 0 );
+}
+
+
+bool diff_ranges_contains( const diff_ranges * self, uint32_t * hint, int64_t row_id )
+{
+	while ( *hint < self -> count )
+	{
+		const row_range * r = &( self -> ranges[ *hint ] );
+		if ( row_id < r -> first )
+			return false;
+		if ( row_id < r -> first + ( int64_t )r -> count )
+			return true;
+		( *hint )++;
+	}
+	return false;
+}
+
+
+static rc_t diff_ranges_add( diff_ranges * self, int64_t first, uint64_t count )
+{
+	if ( self -> count > 0 )
+	{
+		/* the blobs of one column come in ascending order: extend the last range */
+		row_range * last = &( self -> ranges[ self -> count - 1 ] );
+		if ( first >= last -> first && first <= last -> first + ( int64_t )last -> count )
+		{
+			int64_t end = first + count;
+			if ( end > last -> first + ( int64_t )last -> count )
+				last -> count = end - last -> first;
+			return 0;
+		}
+	}
+	if ( self -> count == self -> alloc )
+	{
+		uint32_t new_alloc = ( self -> alloc == 0 ) ? 64 : self -> alloc * 2;
+		row_range * tmp = realloc( self -> ranges, new_alloc * sizeof * tmp );
+		if ( tmp == NULL )
+			return RC( rcExe, rcNoTarg, rcComparing, rcMemory, rcExhausted );
+		self -> ranges = tmp;
+		self -> alloc = new_alloc;
+	}
+	self -> ranges[ self -> count ].first = first;
+	self -> ranges[ self -> count ].count = count;
+	self -> count++;
+	return 0;
+}
+
+
+static int CC row_range_cmp( const void * a, const void * b )
+{
+	const row_range * ra = a;
+	const row_range * rb = b;
+	if ( ra -> first < rb -> first ) return -1;
+	if ( ra -> first > rb -> first ) return 1;
+	return 0;
+}
+
+
+/* the ranges of all columns are collected: sort them and join overlapping ones */
+static void diff_ranges_normalize( diff_ranges * self )
+{
+	if ( self -> count > 1 )
+	{
+		uint32_t src, dst = 0;
+		qsort( self -> ranges, self -> count, sizeof self -> ranges[ 0 ], row_range_cmp );
+		for ( src = 1; src < self -> count; ++src )
+		{
+			row_range * d = &( self -> ranges[ dst ] );
+			const row_range * s = &( self -> ranges[ src ] );
+			int64_t d_end = d -> first + d -> count;
+			if ( s -> first <= d_end )
+			{
+				int64_t s_end = s -> first + s -> count;
+				if ( s_end > d_end )
+					d -> count = s_end - d -> first;
+			}
+			else
+				self -> ranges[ ++dst ] = *s;
+		}
+		self -> count = dst + 1;
+	}
+}
+
+
+/********************************************************************
+is the schema of both tables the same?
+********************************************************************/
+typedef struct schema_text
+{
+	char * buf;
+	size_t len;
+	size_t alloc;
+} schema_text;
+
+
+static rc_t CC schema_text_flush( void * dst, const void * buffer, size_t bsize )
+{
+	schema_text * st = dst;
+	if ( st -> len + bsize > st -> alloc )
+	{
+		size_t new_alloc = ( st -> alloc == 0 ) ? 64 * 1024 : st -> alloc * 2;
+		char * tmp;
+		while ( new_alloc < st -> len + bsize )
+			new_alloc *= 2;
+		tmp = realloc( st -> buf, new_alloc );
+		if ( tmp == NULL )
+			return RC( rcExe, rcNoTarg, rcComparing, rcMemory, rcExhausted );
+		st -> buf = tmp;
+		st -> alloc = new_alloc;
+	}
+	memmove( st -> buf + st -> len, buffer, bsize );
+	st -> len += bsize;
+	return 0;
+}
+
+
+static rc_t dump_table_schema( const VTable * tab, schema_text * st )
+{
+	const VSchema * schema;
+	rc_t rc = VTableOpenSchema( tab, &schema );
+	if ( rc != 0 )
+	{
+		LOGERR ( klogInt, rc, "VTableOpenSchema() failed" );
+	}
+	else
+	{
+		char typespec[ 1024 ];
+		rc = VTableTypespec( tab, typespec, sizeof typespec );
+		if ( rc != 0 )
+		{
+			LOGERR ( klogInt, rc, "VTableTypespec() failed" );
+		}
+		else
+		{
+			rc = schema_text_flush( st, typespec, strlen( typespec ) + 1 );
+			if ( rc == 0 )
+				rc = VSchemaDump( schema, sdmCompact, NULL, schema_text_flush, st );
+			if ( rc != 0 )
+			{
+				LOGERR ( klogInt, rc, "VSchemaDump() failed" );
+			}
+		}
+		VSchemaRelease( schema );
+	}
+	return rc;
+}
+
+
+static rc_t same_schema( const VTable * tab_1, const VTable * tab_2, bool * same )
+{
+	schema_text st_1, st_2;
+	rc_t rc;
+
+	memset( &st_1, 0, sizeof st_1 );
+	memset( &st_2, 0, sizeof st_2 );
+	rc = dump_table_schema( tab_1, &st_1 );
+	if ( rc == 0 )
+		rc = dump_table_schema( tab_2, &st_2 );
+	if ( rc == 0 )
+		*same = ( st_1.len == st_2.len && memcmp( st_1.buf, st_2.buf, st_1.len ) == 0 );
+	free( st_1.buf );
+	free( st_2.buf );
+	return rc;
+}
+
+
+/********************************************************************
+is the metadata of both tables ( or columns ) the same?
+the schema-functions read the metadata too, so identical blobs do not
+make identical cells if it differs
+********************************************************************/
+static rc_t read_node_value( const KMDataNode * node, schema_text * st )
+{
+	char buffer[ 4096 ];
+	size_t offset = 0, num_read, remaining;
+	rc_t rc;
+	do
+	{
+		rc = KMDataNodeRead( node, offset, buffer, sizeof buffer, &num_read, &remaining );
+		if ( rc == 0 && num_read > 0 )
+			rc = schema_text_flush( st, buffer, num_read );
+		offset += num_read;
+	} while ( rc == 0 && remaining > 0 && num_read > 0 );
+	return rc;
+}
+
+
+static rc_t same_node_value( const KMDataNode * node_1, const KMDataNode * node_2, bool * same )
+{
+	schema_text st_1, st_2;
+	rc_t rc;
+
+	memset( &st_1, 0, sizeof st_1 );
+	memset( &st_2, 0, sizeof st_2 );
+	rc = read_node_value( node_1, &st_1 );
+	if ( rc == 0 )
+		rc = read_node_value( node_2, &st_2 );
+	if ( rc == 0 )
+		*same = ( st_1.len == st_2.len && memcmp( st_1.buf, st_2.buf, st_1.len ) == 0 );
+	free( st_1.buf );
+	free( st_2.buf );
+	return rc;
+}
+
+
+static rc_t same_node_attr( const KMDataNode * node_1, const KMDataNode * node_2, bool * same )
+{
+	KNamelist * attr_1;
+	rc_t rc = KMDataNodeListAttr( node_1, &attr_1 );
+	if ( rc == 0 )
+	{
+		KNamelist * attr_2;
+		rc = KMDataNodeListAttr( node_2, &attr_2 );
+		if ( rc == 0 )
+		{
+			uint32_t idx, count = 0;
+			*same = nlt_compare_namelists( attr_1, attr_2, NULL );
+			if ( *same )
+				rc = KNamelistCount( attr_1, &count );
+			for ( idx = 0; rc == 0 && *same && idx < count; ++idx )
+			{
+				const char * name;
+				rc = KNamelistGet( attr_1, idx, &name );
+				if ( rc == 0 )
+				{
+					char value_1[ 1024 ], value_2[ 1024 ];
+					size_t size_1, size_2;
+					/* a value too long for the buffer counts as different */
+					*same = ( KMDataNodeReadAttr( node_1, name, value_1, sizeof value_1, &size_1 ) == 0 &&
+							  KMDataNodeReadAttr( node_2, name, value_2, sizeof value_2, &size_2 ) == 0 &&
+							  size_1 == size_2 && memcmp( value_1, value_2, size_1 ) == 0 );
+				}
+			}
+			KNamelistRelease( attr_2 );
+		}
+		KNamelistRelease( attr_1 );
+	}
+	return rc;
+}
+
+
+static rc_t same_node( const KMDataNode * node_1, const KMDataNode * node_2, bool * same )
+{
+	rc_t rc = same_node_value( node_1, node_2, same );
+	if ( rc == 0 && *same )
+		rc = same_node_attr( node_1, node_2, same );
+	if ( rc == 0 && *same )
+	{
+		KNamelist * children_1;
+		rc = KMDataNodeListChild( node_1, &children_1 );
+		if ( rc == 0 )
+		{
+			KNamelist * children_2;
+			rc = KMDataNodeListChild( node_2, &children_2 );
+			if ( rc == 0 )
+			{
+				uint32_t idx, count = 0;
+				*same = nlt_compare_namelists( children_1, children_2, NULL );
+				if ( *same )
+					rc = KNamelistCount( children_1, &count );
+				for ( idx = 0; rc == 0 && *same && idx < count; ++idx )
+				{
+					const char * name;
+					rc = KNamelistGet( children_1, idx, &name );
+					if ( rc == 0 )
+					{
+						const KMDataNode * child_1;
+						rc = KMDataNodeOpenNodeRead( node_1, &child_1, "%s", name );
+						if ( rc == 0 )
+						{
+							const KMDataNode * child_2;
+							rc = KMDataNodeOpenNodeRead( node_2, &child_2, "%s", name );
+							if ( rc == 0 )
+							{
+								rc = same_node( child_1, child_2, same );
+								KMDataNodeRelease( child_2 );
+							}
+							KMDataNodeRelease( child_1 );
+						}
+					}
+				}
+				KNamelistRelease( children_2 );
+			}
+			KNamelistRelease( children_1 );
+		}
+	}
+	return rc;
+}
+
+
+static rc_t same_metadata( const KMetadata * meta_1, const KMetadata * meta_2, bool * same )
+{
+	const KMDataNode * root_1;
+	rc_t rc = KMetadataOpenNodeRead( meta_1, &root_1, NULL );
+	if ( rc == 0 )
+	{
+		const KMDataNode * root_2;
+		rc = KMetadataOpenNodeRead( meta_2, &root_2, NULL );
+		if ( rc == 0 )
+		{
+			rc = same_node( root_1, root_2, same );
+			KMDataNodeRelease( root_2 );
+		}
+		KMDataNodeRelease( root_1 );
+	}
+	if ( rc != 0 )
+	{
+		LOGERR ( klogInt, rc, "comparing the metadata failed" );
+	}
+	return rc;
+}
+
+
+static rc_t same_table_metadata( const KTable * ktab_1, const KTable * ktab_2, bool * same )
+{
+	const KMetadata * meta_1;
+	rc_t rc = KTableOpenMetadataRead( ktab_1, &meta_1 );
+	if ( rc != 0 )
+	{
+		LOGERR ( klogInt, rc, "KTableOpenMetadataRead( acc #1 ) failed" );
+	}
+	else
+	{
+		const KMetadata * meta_2;
+		rc = KTableOpenMetadataRead( ktab_2, &meta_2 );
+		if ( rc != 0 )
+		{
+			LOGERR ( klogInt, rc, "KTableOpenMetadataRead( acc #2 ) failed" );
+		}
+		else
+		{
+			rc = same_metadata( meta_1, meta_2, same );
+			KMetadataRelease( meta_2 );
+		}
+		KMetadataRelease( meta_1 );
+	}
+	return rc;
+}
+
+
+static rc_t same_column_metadata( const KColumn * col_1, const KColumn * col_2, const char * name, bool * same )
+{
+	const KMetadata * meta_1;
+	rc_t rc = KColumnOpenMetadataRead( col_1, &meta_1 );
+	if ( rc != 0 )
+	{
+		PLOGERR( klogInt, ( klogInt, rc, "KColumnOpenMetadataRead( #1 $(col) ) failed", "col=%s", name ) );
+	}
+	else
+	{
+		const KMetadata * meta_2;
+		rc = KColumnOpenMetadataRead( col_2, &meta_2 );
+		if ( rc != 0 )
+		{
+			PLOGERR( klogInt, ( klogInt, rc, "KColumnOpenMetadataRead( #2 $(col) ) failed", "col=%s", name ) );
+		}
+		else
+		{
+			rc = same_metadata( meta_1, meta_2, same );
+			KMetadataRelease( meta_2 );
+		}
+		KMetadataRelease( meta_1 );
+	}
+	return rc;
+}
+
+
+/********************************************************************
+compare one physical column of both tables blob by blob
+********************************************************************/
+typedef struct blob_buffer
+{
+	void * data;
+	size_t size;
+} blob_buffer;
+
+
+static rc_t read_blob( const KColumnBlob * blob, blob_buffer * buf, size_t * blob_size )
+{
+	size_t num_read, remaining;
+	/* ask for the size of the blob */
+	rc_t rc = KColumnBlobRead ( blob, 0, buf -> data, 0, &num_read, &remaining );
+	if ( rc != 0 )
+	{
+		LOGERR ( klogInt, rc, "KColumnBlobRead() failed" );
+	}
+	else if ( remaining > buf -> size )
+	{
+		void * tmp = realloc( buf -> data, remaining );
+		if ( tmp == NULL )
+			rc = RC( rcExe, rcNoTarg, rcComparing, rcMemory, rcExhausted );
+		else
+		{
+			buf -> data = tmp;
+			buf -> size = remaining;
+		}
+	}
+	if ( rc == 0 )
+	{
+		size_t total = 0, to_read = remaining;
+		*blob_size = to_read;
+		while ( rc == 0 && total < to_read )
+		{
+			rc = KColumnBlobRead ( blob, total, ( uint8_t * )buf -> data + total,
+								   to_read - total, &num_read, &remaining );
+			if ( rc != 0 )
+			{
+				LOGERR ( klogInt, rc, "KColumnBlobRead() failed" );
+			}
+			else if ( num_read == 0 )
+				rc = RC( rcExe, rcNoTarg, rcComparing, rcBlob, rcInsufficient );
+			else
+				total += num_read;
+		}
+	}
+	return rc;
+}
+
+
+/* finds the next row >= id that exists in the column, 'found' is false at the end */
+static rc_t next_row_in_column( const KColumn * col, int64_t id, int64_t * next, bool * found )
+{
+	rc_t rc = KColumnFindFirstRowId ( col, next, id );
+	*found = ( rc == 0 );
+	if ( rc != 0 && GetRCState( rc ) == rcNotFound )
+		rc = 0;
+	if ( rc != 0 )
+	{
+		LOGERR ( klogInt, rc, "KColumnFindFirstRowId() failed" );
+	}
+	return rc;
+}
+
+
+static rc_t open_blob( const KColumn * col, int64_t id, const KColumnBlob ** blob,
+					   int64_t * first, uint32_t * count )
+{
+	rc_t rc = KColumnOpenBlobRead ( col, blob, id );
+	if ( rc != 0 )
+	{
+		PLOGERR( klogInt, ( klogInt, rc, "KColumnOpenBlobRead( $(row) ) failed", "row=%ld", id ) );
+	}
+	else
+	{
+		rc = KColumnBlobIdRange ( *blob, first, count );
+		if ( rc != 0 )
+		{
+			LOGERR ( klogInt, rc, "KColumnBlobIdRange() failed" );
+			KColumnBlobRelease ( *blob );
+		}
+	}
+	return rc;
+}
+
+
+static rc_t compare_blobs( const KColumnBlob * blob_1, const KColumnBlob * blob_2,
+						   blob_buffer * buf_1, blob_buffer * buf_2, bool * equal )
+{
+	size_t size_1;
+	rc_t rc = read_blob( blob_1, buf_1, &size_1 );
+	if ( rc == 0 )
+	{
+		size_t size_2;
+		rc = read_blob( blob_2, buf_2, &size_2 );
+		if ( rc == 0 )
+			*equal = ( size_1 == size_2 && memcmp( buf_1 -> data, buf_2 -> data, size_1 ) == 0 );
+	}
+	return rc;
+}
+
+
+static rc_t blob_diff_columns( const KColumn * col_1, const KColumn * col_2,
+							   blob_buffer * buf_1, blob_buffer * buf_2, diff_ranges * differ )
+{
+	int64_t id, first_1, first_2;
+	uint64_t count_1, count_2;
+	rc_t rc = KColumnIdRange ( col_1, &first_1, &count_1 );
+	if ( rc == 0 )
+		rc = KColumnIdRange ( col_2, &first_2, &count_2 );
+	if ( rc != 0 )
+	{
+		LOGERR ( klogInt, rc, "KColumnIdRange() failed" );
+	}
+	id = ( first_1 < first_2 ) ? first_1 : first_2;
+
+	while ( rc == 0 )
+	{
+		int64_t next_1, next_2;
+		bool found_1, found_2;
+
+		rc = Quitting();
+		if ( rc == 0 )
+			rc = next_row_in_column( col_1, id, &next_1, &found_1 );
+		if ( rc == 0 )
+			rc = next_row_in_column( col_2, id, &next_2, &found_2 );
+		if ( rc != 0 || ( !found_1 && !found_2 ) )
+			break;
+
+		if ( found_1 && found_2 && next_1 == next_2 )
+		{
+			const KColumnBlob * blob_1;
+			int64_t bfirst_1;
+			uint32_t bcount_1;
+			rc = open_blob( col_1, next_1, &blob_1, &bfirst_1, &bcount_1 );
+			if ( rc == 0 )
+			{
+				const KColumnBlob * blob_2;
+				int64_t bfirst_2;
+				uint32_t bcount_2;
+				rc = open_blob( col_2, next_2, &blob_2, &bfirst_2, &bcount_2 );
+				if ( rc == 0 )
+				{
+					int64_t bend_1 = bfirst_1 + bcount_1;
+					int64_t bend_2 = bfirst_2 + bcount_2;
+					bool equal = false;
+					if ( bfirst_1 == bfirst_2 && bcount_1 == bcount_2 )
+						rc = compare_blobs( blob_1, blob_2, buf_1, buf_2, &equal );
+					if ( rc == 0 && !equal )
+					{
+						/* different blob-boundaries are treated as difference, the cells decide */
+						int64_t first = ( bfirst_1 < bfirst_2 ) ? bfirst_1 : bfirst_2;
+						int64_t end = ( bend_1 > bend_2 ) ? bend_1 : bend_2;
+						rc = diff_ranges_add( differ, first, end - first );
+					}
+					id = ( bend_1 < bend_2 ) ? bend_1 : bend_2;
+					KColumnBlobRelease ( blob_2 );
+				}
+				KColumnBlobRelease ( blob_1 );
+			}
+		}
+		else
+		{
+			/* the rows of the blob found first are missing in the other column */
+			const KColumn * col = ( !found_2 || ( found_1 && next_1 < next_2 ) ) ? col_1 : col_2;
+			int64_t next = ( col == col_1 ) ? next_1 : next_2;
+			const KColumnBlob * blob;
+			int64_t first;
+			uint32_t count;
+			rc = open_blob( col, next, &blob, &first, &count );
+			if ( rc == 0 )
+			{
+				int64_t end = first + count;
+				if ( col == col_1 && found_2 && next_2 < end )
+					end = next_2;
+				else if ( col == col_2 && found_1 && next_1 < end )
+					end = next_1;
+				rc = diff_ranges_add( differ, next, end - next );
+				id = end;
+				KColumnBlobRelease ( blob );
+			}
+		}
+	}
+	return rc;
+}
+
+
+static rc_t blob_diff_ktables( const KTable * ktab_1, const KTable * ktab_2, diff_ranges * differ )
+{
+	KNamelist * cols_1;
+	rc_t rc = KTableListCol ( ktab_1, &cols_1 );
+	if ( rc != 0 )
+	{
+		LOGERR ( klogInt, rc, "KTableListCol( acc #1 ) failed" );
+	}
+	else
+	{
+		KNamelist * cols_2;
+		rc = KTableListCol ( ktab_2, &cols_2 );
+		if ( rc != 0 )
+		{
+			LOGERR ( klogInt, rc, "KTableListCol( acc #2 ) failed" );
+		}
+		else
+		{
+			differ -> usable = nlt_compare_namelists( cols_1, cols_2, NULL );
+			if ( differ -> usable )
+			{
+				uint32_t idx, count;
+				blob_buffer buf_1, buf_2;
+
+				buf_1.size = buf_2.size = 1024 * 1024;
+				buf_1.data = malloc( buf_1.size );
+				buf_2.data = malloc( buf_2.size );
+				if ( buf_1.data == NULL || buf_2.data == NULL )
+					rc = RC( rcExe, rcNoTarg, rcComparing, rcMemory, rcExhausted );
+				else
+					rc = KNamelistCount( cols_1, &count );
+
+				for ( idx = 0; rc == 0 && differ -> usable && idx < count; ++idx )
+				{
+					const char * name;
+					rc = KNamelistGet( cols_1, idx, &name );
+					if ( rc == 0 )
+					{
+						const KColumn * col_1;
+						rc = KTableOpenColumnRead ( ktab_1, &col_1, "%s", name );
+						if ( rc != 0 )
+						{
+							PLOGERR( klogInt, ( klogInt, rc, "KTableOpenColumnRead( #1 $(col) ) failed", "col=%s", name ) );
+						}
+						else
+						{
+							const KColumn * col_2;
+							rc = KTableOpenColumnRead ( ktab_2, &col_2, "%s", name );
+							if ( rc != 0 )
+							{
+								PLOGERR( klogInt, ( klogInt, rc, "KTableOpenColumnRead( #2 $(col) ) failed", "col=%s", name ) );
+							}
+							else
+							{
+								bool same = false;
+								rc = same_column_metadata( col_1, col_2, name, &same );
+								if ( rc == 0 && !same )
+									differ -> usable = false;
+								if ( rc == 0 && differ -> usable )
+									rc = blob_diff_columns( col_1, col_2, &buf_1, &buf_2, differ );
+								KColumnRelease ( col_2 );
+							}
+							KColumnRelease ( col_1 );
+						}
+					}
+				}
+				free( buf_1.data );
+				free( buf_2.data );
+			}
+			KNamelistRelease( cols_2 );
+		}
+		KNamelistRelease( cols_1 );
+	}
+	return rc;
+}
+
+
+rc_t blob_diff_tables( const VTable * tab_1, const VTable * tab_2, diff_ranges * differ )
+{
+	bool same = false;
+	rc_t rc = same_schema( tab_1, tab_2, &same );
+	differ -> usable = false;
+	if ( rc == 0 && same )
+	{
+		const KTable * ktab_1;
+		rc = VTableOpenKTableRead( tab_1, &ktab_1 );
+		if ( rc != 0 )
+		{
+			LOGERR ( klogInt, rc, "VTableOpenKTableRead( acc #1 ) failed" );
+		}
+		else
+		{
+			const KTable * ktab_2;
+			rc = VTableOpenKTableRead( tab_2, &ktab_2 );
+			if ( rc != 0 )
+			{
+				LOGERR ( klogInt, rc, "VTableOpenKTableRead( acc #2 ) failed" );
+			}
+			else
+			{
+				rc = same_table_metadata( ktab_1, ktab_2, &same );
+				if ( rc == 0 && same )
+					rc = blob_diff_ktables( ktab_1, ktab_2, differ );
+				if ( rc == 0 && differ -> usable )
+					diff_ranges_normalize( differ );
+				KTableRelease( ktab_2 );
+			}
+			KTableRelease( ktab_1 );
+		}
+	}
+	if ( rc != 0 )
+		differ -> usable = false;
+	return rc;
+}
+
+
+rc_t blob_diff_databases( const VDatabase * db_1, const VDatabase * db_2, bool * equal )
+{
+	KNamelist * tables_1;
+	rc_t rc = VDatabaseListTbl ( db_1, &tables_1 );
+	*equal = false;
+	if ( rc != 0 )
+	{
+		LOGERR ( klogInt, rc, "VDatabaseListTbl( acc #1 ) failed" );
+	}
+	else
+	{
+		KNamelist * tables_2;
+		rc = VDatabaseListTbl ( db_2, &tables_2 );
+		if ( rc != 0 )
+		{
+			LOGERR ( klogInt, rc, "VDatabaseListTbl( acc #2 ) failed" );
+		}
+		else
+		{
+			uint32_t idx, count = 0;
+			*equal = nlt_compare_namelists( tables_1, tables_2, NULL );
+			if ( *equal )
+				rc = KNamelistCount( tables_1, &count );
+			for ( idx = 0; rc == 0 && *equal && idx < count; ++idx )
+			{
+				const char * name;
+				rc = KNamelistGet( tables_1, idx, &name );
+				if ( rc == 0 )
+				{
+					const VTable * tab_1;
+					rc = VDatabaseOpenTableRead ( db_1, &tab_1, "%s", name );
+					if ( rc == 0 )
+					{
+						const VTable * tab_2;
+						rc = VDatabaseOpenTableRead ( db_2, &tab_2, "%s", name );
+						if ( rc == 0 )
+						{
+							diff_ranges differ;
+							diff_ranges_init( &differ );
+							rc = blob_diff_tables( tab_1, tab_2, &differ );
+							*equal = diff_ranges_all_equal( &differ );
+							diff_ranges_release( &differ );
+							VTableRelease( tab_2 );
+						}
+						VTableRelease( tab_1 );
+					}
+				}
+			}
+			KNamelistRelease( tables_2 );
+		}
+		KNamelistRelease( tables_1 );
+	}
+	if ( rc != 0 )
+		*equal = false;
+	return rc;
+}
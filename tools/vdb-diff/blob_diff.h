@@ -0,0 +1,93 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef _h_blob_diff_
+#define _h_blob_diff_
+
+#include <klib/defs.h>
+#include <klib/rc.h>
+
+#include <vdb/table.h>
+#include <vdb/database.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/********************************************************************
+a sorted list of non-overlapping row-ranges, in which the stored
+blobs of 2 tables are not byte-identical
+********************************************************************/
+typedef struct row_range
+{
+	int64_t first;
+	uint64_t count;
+} row_range;
+
+typedef struct diff_ranges
+{
+	row_range * ranges;
+	uint32_t count;
+	uint32_t alloc;
+	bool usable;			/* false: the physical layout cannot be compared */
+} diff_ranges;
+
+
+void diff_ranges_init( diff_ranges * self );
+void diff_ranges_release( diff_ranges * self );
+
+/*
+ * true, if the tables are physically identical in all rows
+*/
+bool diff_ranges_all_equal( const diff_ranges * self );
+
+/*
+ * is the row-id inside of one of the ranges?
+ * rows have to be asked for in ascending order, 'hint' starts at zero
+*/
+bool diff_ranges_contains( const diff_ranges * self, uint32_t * hint, int64_t row_id );
+
+
+/*
+ * compares the physical columns of 2 tables blob by blob, without decoding
+ * them: if both tables have the same schema, the same metadata ( of the table
+ * and of every column ) and the same set of physical columns the rows of every
+ * blob that is not byte-identical in both tables ( or missing in one of them )
+ * are collected, otherwise 'usable' is false
+*/
+rc_t blob_diff_tables( const VTable * tab_1, const VTable * tab_2, diff_ranges * differ );
+
+
+/*
+ * true, if every table of both databases is physically identical
+*/
+rc_t blob_diff_databases( const VDatabase * db_1, const VDatabase * db_2, bool * equal );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
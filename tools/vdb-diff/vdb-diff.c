@@ -31,6 +31,12 @@
 #include <klib/log.h>
 #include <klib/num-gen.h>
 #include <klib/progressbar.h>
+#include <klib/printf.h>
+#include <klib/text.h>
+
+#include <kproc/lock.h>
+#include <kproc/cond.h>
+#include <kproc/thread.h>
 
 #include <vdb/manager.h>
 #include <vdb/schema.h>
@@ -41,10 +47,13 @@
 #include <sra/sraschema.h>
 
 #include "coldefs.h"
+#include "blob_diff.h"
 #include "namelist_tools.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
 
 
 #define OPTION_ROWS         "rows"
@@ -68,6 +77,12 @@
 #define OPTION_EXCLUDE      "exclude"
 #define ALIAS_EXCLUDE       "x"
 
+#define OPTION_THREADS      "threads"
+#define ALIAS_THREADS       "j"
+
+#define OPTION_CELLS        "cells"
+#define ALIAS_CELLS         "c"
+
 static const char * rows_usage[] = { "set of rows to be comparend (default = all)", NULL };
 static const char * columns_usage[] = { "set of columns to be compared (default = all)", NULL };
 static const char * table_usage[] = { "name of table (in case of database ) to be compared", NULL };
@@ -75,6 +90,8 @@ static const char * progress_usage[] = { "show progress in percent", NULL };
 static const char * maxerr_usage[] = { "max errors im comparing (default = 1)", NULL };
 static const char * intersect_usage[] = { "intersect column-set from both runs", NULL };
 static const char * exclude_usage[] = { "exclude these columns from comapring", NULL };
+static const char * threads_usage[] = { "compare with this many threads (default = 1)", NULL };
+static const char * cells_usage[] = { "compare every cell, even if the stored blobs are identical", NULL };
 
 OptDef MyOptions[] =
 {
@@ -84,7 +101,9 @@ OptDef MyOptions[] =
 	{ OPTION_PROGRESS, 		ALIAS_PROGRESS,		NULL, 	progress_usage,		1, 	false, 	false },
 	{ OPTION_MAXERR, 		ALIAS_MAXERR,		NULL, 	maxerr_usage,		1, 	true, 	false },
 	{ OPTION_INTERSECT,		ALIAS_INTERSECT,	NULL, 	intersect_usage,	1, 	false, 	false },
-	{ OPTION_EXCLUDE,		ALIAS_EXCLUDE,		NULL, 	exclude_usage,		1, 	true, 	false }		
+	{ OPTION_EXCLUDE,		ALIAS_EXCLUDE,		NULL, 	exclude_usage,		1, 	true, 	false },
+	{ OPTION_THREADS,		ALIAS_THREADS,		NULL, 	threads_usage,		1, 	true, 	false },
+	{ OPTION_CELLS,			ALIAS_CELLS,		NULL, 	cells_usage,		1, 	false, 	false }
 };
 
 
@@ -124,6 +143,8 @@ rc_t CC Usage ( const Args * args )
 	HelpOptionLine ( ALIAS_MAXERR, 		OPTION_MAXERR,	    "max value",	maxerr_usage );
 	HelpOptionLine ( ALIAS_INTERSECT, 	OPTION_INTERSECT,   NULL,			intersect_usage );
 	HelpOptionLine ( ALIAS_EXCLUDE, 	OPTION_EXCLUDE,   	"column-set",	exclude_usage );
+	HelpOptionLine ( ALIAS_THREADS, 	OPTION_THREADS,   	"count",		threads_usage );
+	HelpOptionLine ( ALIAS_CELLS, 		OPTION_CELLS,   	NULL,			cells_usage );
 	
     HelpOptionsStandard ();
     HelpVersion ( fullpath, KAppVersion() );
@@ -141,8 +162,10 @@ struct diff_ctx
 	
     struct num_gen * rows;
 	uint32_t max_err;
+	uint32_t threads;
 	bool show_progress;
 	bool intersect;
+	bool blob_check;
 };
 
 
@@ -157,6 +180,8 @@ static void init_diff_ctx( struct diff_ctx * dctx )
     dctx -> rows = NULL;
 	dctx -> show_progress = false;
 	dctx -> intersect = false;
+	dctx -> threads = 1;
+	dctx -> blob_check = true;
 }
 
 
@@ -267,12 +292,26 @@ static rc_t gather_diff_ctx( struct diff_ctx * dctx, Args * args )
 		dctx -> show_progress = get_bool_option( args, OPTION_PROGRESS, false );
 		dctx -> intersect = get_bool_option( args, OPTION_INTERSECT, false );
 		dctx -> max_err = get_uint32t_option( args, OPTION_MAXERR, 1 );
+		dctx -> threads = get_uint32t_option( args, OPTION_THREADS, 1 );
+		dctx -> blob_check = !get_bool_option( args, OPTION_CELLS, false );
     }
 
     return rc;
 }
 
 
+/* the blob-compare always covers all rows and columns of all tables,
+   it is skipped if only a part of the accessions has to be compared */
+static bool blob_check_wanted( const struct diff_ctx * dctx )
+{
+	return ( dctx -> blob_check &&
+			 dctx -> rows == NULL &&
+			 dctx -> columns == NULL &&
+			 dctx -> excluded == NULL &&
+			 dctx -> table == NULL );
+}
+
+
 static rc_t report_diff_ctx( struct diff_ctx * dctx )
 {
     rc_t rc = KOutMsg( "src[ 1 ] : %s\n", dctx -> src1 );
@@ -304,6 +343,10 @@ static rc_t report_diff_ctx( struct diff_ctx * dctx )
 		rc = KOutMsg( "- intersect: %s\n", dctx -> intersect ? "yes" : "no" );
 	if ( rc == 0 )
 		rc = KOutMsg( "- max err : %u\n", dctx -> max_err );
+	if ( rc == 0 )
+		rc = KOutMsg( "- threads : %u\n", dctx -> threads );
+	if ( rc == 0 )
+		rc = KOutMsg( "- blobs : %s\n", blob_check_wanted( dctx ) ? "compare first" : "ignore" );
 
 	if ( rc == 0 )
 		rc = KOutMsg( "\n" );
@@ -311,135 +354,688 @@ static rc_t report_diff_ctx( struct diff_ctx * dctx )
 }
 
 
-static rc_t diff_columns_iter( col_defs * defs, const VCursor * cur_1, const VCursor * cur_2,
-							   struct diff_ctx * dctx, const struct num_gen_iter * iter )
+/***************************************************************************
+    the rows are cut into windows, every column of a window is one work-unit
+    for a pool of threads ( the main-thread is one of them ); a window is
+    printed row by row as soon as all of its columns are done, only a few
+    windows are in flight at any time
+***************************************************************************/
+#define DIFF_WINDOW_ROWS ( 64 * 1024 )
+
+typedef struct diff_rec
 {
-	uint32_t column_count;
-	rc_t rc = col_defs_count( defs, &column_count );
+	int64_t row_id;
+	char * text;
+	bool differs;			/* false: only a note, the row itself is not different */
+} diff_rec;
+
+
+/* the differences of one column inside of one window */
+typedef struct col_diff
+{
+	const col_pair * pair;
+	diff_rec * recs;
+	uint32_t rec_count;
+	uint32_t rec_alloc;
+} col_diff;
+
+
+/* the cursors of one thread for one column, opened on first use */
+typedef struct col_cursors
+{
+	const VCursor * cur_1;
+	const VCursor * cur_2;
+	uint32_t idx_1;
+	uint32_t idx_2;
+} col_cursors;
+
+
+typedef struct diff_pool
+{
+	const VTable * tab_1;
+	const VTable * tab_2;
+	const struct num_gen * rows;
+	const diff_ranges * differ;	/* NULL: compare all rows */
+	col_defs * defs;
+	uint32_t col_count;
+	int64_t first;				/* first row of window #0 */
+	uint64_t count;				/* rows covered by all windows */
+	uint64_t windows;
+	uint32_t ahead;				/* windows in flight */
+	col_diff * slots;			/* ahead * col_count, window #w uses the slots of ( w % ahead ) */
+	uint32_t * done;			/* columns done, per window in flight */
+	uint32_t * pos;				/* used by the report */
+	uint64_t next_window;		/* the next work-unit to be handed out */
+	uint32_t next_col;
+	uint64_t report_window;		/* the next window to be printed */
+	uint64_t rows_different;
+	uint32_t max_err;
+	KLock * lock;
+	KCondition * cond;
+	int64_t * first_rows;		/* the lowest differing row-ids found so far, ascending */
+	uint32_t first_rows_count;
+	int64_t limit;				/* rows above this one cannot be reported any more */
+	struct progressbar * progress;
+	rc_t rc;
+} diff_pool;
+
+
+static rc_t col_diff_add( col_diff * col, int64_t row_id, const char * text, bool differs )
+{
+	if ( col -> rec_count == col -> rec_alloc )
+	{
+		uint32_t new_alloc = ( col -> rec_alloc == 0 ) ? 16 : col -> rec_alloc * 2;
+		diff_rec * tmp = realloc( col -> recs, new_alloc * sizeof * tmp );
+		if ( tmp == NULL )
+			return RC( rcExe, rcNoTarg, rcComparing, rcMemory, rcExhausted );
+		col -> recs = tmp;
+		col -> rec_alloc = new_alloc;
+	}
+	col -> recs[ col -> rec_count ].text = string_dup_measure( text, NULL );
+	if ( col -> recs[ col -> rec_count ].text == NULL )
+		return RC( rcExe, rcNoTarg, rcComparing, rcMemory, rcExhausted );
+	col -> recs[ col -> rec_count ].row_id = row_id;
+	col -> recs[ col -> rec_count ].differs = differs;
+	col -> rec_count++;
+	return 0;
+}
+
+
+/* drops the differences, the slot can be used for the next window */
+static void col_diff_clear( col_diff * col )
+{
+	uint32_t idx;
+	for ( idx = 0; idx < col -> rec_count; ++idx )
+		free( col -> recs[ idx ].text );
+	col -> rec_count = 0;
+}
+
+
+static void col_diff_release( col_diff * col )
+{
+	col_diff_clear( col );
+	if ( col -> recs != NULL )
+		free( col -> recs );
+}
+
+
+static void col_cursors_release( col_cursors * curs, uint32_t count )
+{
+	uint32_t idx;
+	for ( idx = 0; idx < count; ++idx )
+	{
+		if ( curs[ idx ].cur_1 != NULL )
+			VCursorRelease( curs[ idx ].cur_1 );
+		if ( curs[ idx ].cur_2 != NULL )
+			VCursorRelease( curs[ idx ].cur_2 );
+	}
+	free( curs );
+}
+
+
+/* remembers a differing row, returns the highest row that still has to be looked at */
+static int64_t diff_pool_note_row( diff_pool * pool, int64_t row_id )
+{
+	int64_t limit;
+	uint32_t pos;
+
+	KLockAcquire( pool -> lock );
+	pos = pool -> first_rows_count;
+	while ( pos > 0 && pool -> first_rows[ pos - 1 ] > row_id )
+		pos--;
+	if ( pos < pool -> max_err && ( pos == 0 || pool -> first_rows[ pos - 1 ] != row_id ) )
+	{
+		uint32_t keep = ( pool -> first_rows_count < pool -> max_err ) ? pool -> first_rows_count : pool -> max_err - 1;
+		memmove( &( pool -> first_rows[ pos + 1 ] ), &( pool -> first_rows[ pos ] ),
+				 ( keep - pos ) * sizeof pool -> first_rows[ 0 ] );
+		pool -> first_rows[ pos ] = row_id;
+		if ( pool -> first_rows_count < pool -> max_err )
+			pool -> first_rows_count++;
+		if ( pool -> first_rows_count == pool -> max_err )
+			pool -> limit = pool -> first_rows[ pool -> max_err - 1 ];
+	}
+	limit = pool -> limit;
+	KLockUnlock( pool -> lock );
+	return limit;
+}
+
+
+static rc_t open_column_cursor( const VTable * tab, const char * name, const VCursor ** cur, uint32_t * idx, int nr )
+{
+	rc_t rc = VTableCreateCursorRead( tab, cur );
 	if ( rc != 0 )
 	{
-		LOGERR ( klogInt, rc, "col_defs_count() failed" );
+		PLOGERR( klogInt, ( klogInt, rc, "VTableCreateCursorRead( acc #$(nr) ) failed", "nr=%d", nr ) );
 	}
 	else
 	{
-		struct progressbar * progress = NULL;
-		int64_t row_id;
-		uint64_t rows_checked = 0;
-		uint64_t rows_different = 0;
-		
-		if ( dctx -> show_progress )
-			make_progressbar( &progress, 2 );
-	
-		while ( rc == 0 && num_gen_iterator_next( iter, &row_id, &rc ) )
+		rc = VCursorAddColumn( *cur, idx, "%s", name );
+		if ( rc != 0 )
 		{
-			if ( rc == 0 ) rc = Quitting();    /* to be able to cancel the loop by signal */
-			if ( rc == 0 )
+			PLOGERR( klogInt, ( klogInt, rc, "VCursorAddColumn( acc #$(nr) [$(col)] ) failed", "nr=%d,col=%s", nr, name ) );
+		}
+		else
+		{
+			rc = VCursorOpen( *cur );
+			if ( rc != 0 )
 			{
-				bool row_equal = true;
-				
-				uint32_t col_id;
-				for ( col_id = 0; col_id < column_count && rc == 0; ++col_id )
+				PLOGERR( klogInt, ( klogInt, rc, "VCursorOpen( acc #$(nr) ) failed", "nr=%d", nr ) );
+			}
+		}
+		if ( rc != 0 )
+		{
+			VCursorRelease( *cur );
+			*cur = NULL;
+		}
+	}
+	return rc;
+}
+
+
+/* appends a formatted message to the text of the current row */
+static void diff_text_printf( char * text, size_t size, size_t * len, const char * fmt, ... )
+{
+	size_t num_writ = 0;
+	va_list args;
+	va_start( args, fmt );
+	if ( string_vprintf( text + *len, size - *len, &num_writ, fmt, args ) == 0 )
+		*len += num_writ;
+	va_end( args );
+}
+
+
+static rc_t diff_cell( col_diff * col, const VCursor * cur_1, uint32_t idx_1,
+					   const VCursor * cur_2, uint32_t idx_2, int64_t row_id, bool * row_equal )
+{
+	const col_pair * pair = col -> pair;
+	uint32_t elem_bits_1, boff_1, row_len_1;
+	const void * base_1;
+	rc_t rc = VCursorCellDataDirect ( cur_1, row_id, idx_1, 
+									  &elem_bits_1, &base_1, &boff_1, &row_len_1 );
+	*row_equal = true;
+	if ( rc != 0 )
+	{
+		PLOGERR( klogInt, ( klogInt, rc, 
+				 "VCursorCellDataDirect( #1 [$(col)].$(row) ) failed",
+				 "col=%s,row=%ld", pair->name, row_id ) );
+	}
+	else
+	{
+		uint32_t elem_bits_2, boff_2, row_len_2;
+		const void * base_2;
+		rc = VCursorCellDataDirect ( cur_2, row_id, idx_2, 
+									 &elem_bits_2, &base_2, &boff_2, &row_len_2 );
+		if ( rc != 0 )
+		{
+			PLOGERR( klogInt, ( klogInt, rc, 
+					 "VCursorCellDataDirect( #2 [$(col)].$(row) ) failed",
+					 "col=%s,row=%ld", pair->name, row_id ) );
+		}
+		else
+		{
+			char text[ 4096 ];
+			size_t len = 0;
+			bool bin_diff = true;
+
+			text[ 0 ] = 0;
+			if ( elem_bits_1 != elem_bits_2 )
+			{
+				bin_diff = *row_equal = false;
+				diff_text_printf( text, sizeof text, &len, "%s[ %ld ].elem_bits %u != %u\n", pair->name, row_id, elem_bits_1, elem_bits_2 );
+			}
+
+			if ( row_len_1 != row_len_2 )
+			{
+				bin_diff = *row_equal = false;
+				diff_text_printf( text, sizeof text, &len, "%s[ %ld ].row_len %u != %u\n", pair->name, row_id, row_len_1, row_len_2 );
+			}
+
+			if ( boff_1 != 0 || boff_2 != 0 )
+			{
+				bin_diff = *row_equal = false;
+				diff_text_printf( text, sizeof text, &len, "%s[ %ld ].bit_offset: %u, %u\n", pair->name, row_id, boff_1, boff_2 );
+			}
+
+			if ( bin_diff )
+			{
+				size_t num_bits = ( row_len_1 * elem_bits_1 );
+				if ( num_bits & 0x07 )
+				{
+					diff_text_printf( text, sizeof text, &len, "%s[ %ld ].bits_total %% 8 = %u\n", pair->name, row_id, ( num_bits % 8 ) );
+				}
+				else
 				{
-					col_pair * pair = VectorGet( &( defs -> cols ), col_id );
-					if ( pair != NULL )
+					size_t num_bytes = ( num_bits >> 3 );
+					int cmp = memcmp ( base_1, base_2, num_bytes );
+					if ( cmp != 0 )
 					{
-						uint32_t elem_bits_1, boff_1, row_len_1;
-						const void * base_1;
-						rc = VCursorCellDataDirect ( cur_1, row_id, pair->pair[ 0 ].idx, 
-													 &elem_bits_1, &base_1, &boff_1, &row_len_1 );
-						if ( rc != 0 )
-						{
-							PLOGERR( klogInt, ( klogInt, rc, 
-									 "VCursorCellDataDirect( #1 [$(col)].$(row) ) failed",
-									 "col=%s,row=%ld", pair->name, row_id ) );
-						}
-						else
-						{
-							uint32_t elem_bits_2, boff_2, row_len_2;
-							const void * base_2;
-							rc = VCursorCellDataDirect ( cur_2, row_id, pair->pair[ 1 ].idx, 
-														 &elem_bits_2, &base_2, &boff_2, &row_len_2 );
-							if ( rc != 0 )
-							{
-								PLOGERR( klogInt, ( klogInt, rc, 
-										 "VCursorCellDataDirect( #2 [$(col)].$(row) ) failed",
-										 "col=%s,row=%ld", pair->name, row_id ) );
-							}
-							else
-							{
-								bool bin_diff = true;
-								
-								if ( elem_bits_1 != elem_bits_2 )
-								{
-									bin_diff = row_equal = false;
-									rc = KOutMsg( "%s[ %ld ].elem_bits %u != %u\n", pair->name, row_id, elem_bits_1, elem_bits_2 );
-								}
+						diff_text_printf( text, sizeof text, &len, "%s[ %ld ] differ\n", pair->name, row_id );
+						*row_equal = false;
+					}
+				}
+			}
 
-								if ( row_len_1 != row_len_2 )
-								{
-									bin_diff = row_equal = false;
-									if ( rc == 0 )
-									{
-										rc = KOutMsg( "%s[ %ld ].row_len %u != %u\n", pair->name, row_id, row_len_1, row_len_2 );
-									}
-								}
+			if ( len > 0 )
+				rc = col_diff_add( col, row_id, text, !*row_equal );
+		}
+	}
+	return rc;
+}
 
-								if ( boff_1 != 0 || boff_2 != 0 )
-								{
-									bin_diff = row_equal = false;
-									if ( rc == 0 )
-									{
-										rc = KOutMsg( "%s[ %ld ].bit_offset: %u, %u\n", pair->name, row_id, boff_1, boff_2 );
-									}
-								}
-								
-								if ( bin_diff )
-								{
-									size_t num_bits = ( row_len_1 * elem_bits_1 );
-									if ( num_bits & 0x07 )
-									{
-										if ( rc == 0 )
-										{
-											rc = KOutMsg( "%s[ %ld ].bits_total %% 8 = %u\n", pair->name, row_id, ( num_bits % 8 ) );
-										}
-									}
-									else
-									{
-										size_t num_bytes = ( num_bits >> 3 );
-										int cmp = memcmp ( base_1, base_2, num_bytes );
-										if ( cmp != 0 )
-										{
-											if ( rc == 0 )
-											{
-												rc = KOutMsg( "%s[ %ld ] differ\n", pair->name, row_id );
-											}
-											row_equal = false;
-										}
-									}
-								}
-							}
-						}
-					}
-				} /* for ( col_id ... ) */
-				
-				if ( !row_equal )
+
+/* compares one column inside of one window of rows */
+static rc_t diff_unit( diff_pool * pool, col_cursors * curs, col_diff * col, uint64_t window )
+{
+	rc_t rc = 0;
+	if ( curs -> cur_1 == NULL )
+		rc = open_column_cursor( pool -> tab_1, col -> pair -> name, &curs -> cur_1, &curs -> idx_1, 1 );
+	if ( rc == 0 && curs -> cur_2 == NULL )
+		rc = open_column_cursor( pool -> tab_2, col -> pair -> name, &curs -> cur_2, &curs -> idx_2, 2 );
+	if ( rc == 0 )
+	{
+		uint64_t offset = window * DIFF_WINDOW_ROWS;
+		uint64_t count = pool -> count - offset;
+		struct num_gen * rows;
+
+		if ( count > DIFF_WINDOW_ROWS )
+			count = DIFF_WINDOW_ROWS;
+		rc = num_gen_copy( pool -> rows, &rows );
+		if ( rc != 0 )
+		{
+			LOGERR ( klogInt, rc, "num_gen_copy() failed" );
+		}
+		else
+		{
+			rc = num_gen_trim( rows, pool -> first + offset, count );
+			if ( rc != 0 )
+			{
+				LOGERR ( klogInt, rc, "num_gen_trim() failed" );
+			}
+			else if ( !num_gen_empty( rows ) )
+			{
+				const struct num_gen_iter * iter;
+				rc = num_gen_iterator_make( rows, &iter );
+				if ( rc != 0 )
 				{
-					if ( rc == 0 )	rc = KOutMsg( "\n" );
-					rows_different ++;
-					if ( rows_different >= dctx -> max_err )
-						rc = RC( rcExe, rcNoTarg, rcComparing, rcRow, rcInconsistent );		
+					LOGERR ( klogInt, rc, "num_gen_iterator_make() failed" );
 				}
-				rows_checked ++;
-				
-				if ( progress != NULL )
+				else
 				{
-					uint32_t progress_value;
-					if ( num_gen_iterator_percent( iter, 2, &progress_value ) == 0 )
-						update_progressbar( progress, progress_value );
+					int64_t row_id;
+					int64_t limit;
+					uint32_t hint = 0;
+
+					KLockAcquire( pool -> lock );
+					limit = pool -> limit;
+					KLockUnlock( pool -> lock );
+
+					while ( rc == 0 && num_gen_iterator_next( iter, &row_id, &rc ) )
+					{
+						if ( rc == 0 ) rc = Quitting();    /* to be able to cancel the loop by signal */
+						if ( rc == 0 && row_id > limit )
+							break;
+						/* rows inside of byte-identical blobs do not need to be looked at */
+						if ( rc == 0 && ( pool -> differ == NULL ||
+										  diff_ranges_contains( pool -> differ, &hint, row_id ) ) )
+						{
+							bool row_equal;
+							rc = diff_cell( col, curs -> cur_1, curs -> idx_1, curs -> cur_2, curs -> idx_2,
+											row_id, &row_equal );
+							if ( rc == 0 && !row_equal )
+								limit = diff_pool_note_row( pool, row_id );
+						}
+					}
+					num_gen_iterator_destroy( iter );
 				}
-				
-			} /* if (!Quitting) */
-		} /* while ( num_gen_iterator_next() ) */
+			}
+			num_gen_destroy( rows );
+		}
+	}
+	return rc;
+}
+
+
+/* no more work-units will be handed out, the lock is held */
+static bool diff_pool_exhausted( const diff_pool * pool )
+{
+	return ( pool -> rc != 0 ||
+			 pool -> next_window >= pool -> windows ||
+			 ( pool -> next_col == 0 &&
+			   pool -> first + ( int64_t )( pool -> next_window * DIFF_WINDOW_ROWS ) > pool -> limit ) );
+}
+
+
+/* hands out the next work-unit, NULL if there is none or too many windows are not printed yet;
+   the lock is held */
+static col_diff * diff_pool_take( diff_pool * pool, uint64_t * window, uint32_t * col_id )
+{
+	col_diff * col = NULL;
+	if ( !diff_pool_exhausted( pool ) && pool -> next_window < pool -> report_window + pool -> ahead )
+	{
+		*window = pool -> next_window;
+		*col_id = pool -> next_col;
+		col = &( pool -> slots[ ( *window % pool -> ahead ) * pool -> col_count + *col_id ] );
+		col -> pair = VectorGet( &( pool -> defs -> cols ), *col_id );
+		if ( ++( pool -> next_col ) == pool -> col_count )
+		{
+			pool -> next_col = 0;
+			pool -> next_window++;
+		}
+	}
+	return col;
+}
+
+
+/* runs one work-unit without holding the lock, the lock is held before and after */
+static void diff_pool_run( diff_pool * pool, col_cursors * curs, col_diff * col, uint64_t window, uint32_t col_id )
+{
+	rc_t rc;
+	KLockUnlock( pool -> lock );
+	rc = diff_unit( pool, &( curs[ col_id ] ), col, window );
+	KLockAcquire( pool -> lock );
+	pool -> done[ window % pool -> ahead ]++;
+	if ( rc != 0 && pool -> rc == 0 )
+		pool -> rc = rc;
+	KConditionBroadcast( pool -> cond );
+}
+
+
+static rc_t diff_pool_fail( diff_pool * pool, rc_t rc )
+{
+	KLockAcquire( pool -> lock );
+	if ( pool -> rc == 0 )
+		pool -> rc = rc;
+	KConditionBroadcast( pool -> cond );
+	KLockUnlock( pool -> lock );
+	return rc;
+}
+
+
+/* takes work-units from the pool, until all are handed out or an error happened */
+static rc_t CC diff_pool_worker( const KThread *self, void *data )
+{
+	diff_pool * pool = data;
+	col_cursors * curs = calloc( pool -> col_count, sizeof * curs );
+	if ( curs == NULL )
+		return diff_pool_fail( pool, RC( rcExe, rcNoTarg, rcComparing, rcMemory, rcExhausted ) );
+
+	KLockAcquire( pool -> lock );
+	while ( !diff_pool_exhausted( pool ) )
+	{
+		uint64_t window;
+		uint32_t col_id;
+		col_diff * col = diff_pool_take( pool, &window, &col_id );
+		if ( col != NULL )
+			diff_pool_run( pool, curs, col, window, col_id );
+		else
+			KConditionWait( pool -> cond, pool -> lock );
+	}
+	KLockUnlock( pool -> lock );
+
+	col_cursors_release( curs, pool -> col_count );
+	return 0;
+}
+
+
+/* prints the differences of all columns of one window in row-order */
+static rc_t diff_pool_report( diff_pool * pool, col_diff * cols )
+{
+	rc_t rc = 0;
+	uint32_t col_id;
+
+	memset( pool -> pos, 0, pool -> col_count * sizeof pool -> pos[ 0 ] );
+	while ( rc == 0 )
+	{
+		int64_t row_id = 0;
+		bool found = false, differs = false;
+
+		for ( col_id = 0; col_id < pool -> col_count; ++col_id )
+		{
+			const col_diff * col = &( cols[ col_id ] );
+			if ( pool -> pos[ col_id ] < col -> rec_count )
+			{
+				int64_t r = col -> recs[ pool -> pos[ col_id ] ].row_id;
+				if ( !found || r < row_id )
+					row_id = r;
+				found = true;
+			}
+		}
+		if ( !found )
+			break;
+
+		for ( col_id = 0; col_id < pool -> col_count && rc == 0; ++col_id )
+		{
+			const col_diff * col = &( cols[ col_id ] );
+			while ( rc == 0 && pool -> pos[ col_id ] < col -> rec_count &&
+					col -> recs[ pool -> pos[ col_id ] ].row_id == row_id )
+			{
+				rc = KOutMsg( "%s", col -> recs[ pool -> pos[ col_id ] ].text );
+				if ( col -> recs[ pool -> pos[ col_id ] ].differs )
+					differs = true;
+				pool -> pos[ col_id ]++;
+			}
+		}
+
+		if ( differs )
+		{
+			if ( rc == 0 )	rc = KOutMsg( "\n" );
+			pool -> rows_different ++;
+			if ( pool -> rows_different >= pool -> max_err )
+				rc = RC( rcExe, rcNoTarg, rcComparing, rcRow, rcInconsistent );
+		}
+	}
+
+	for ( col_id = 0; col_id < pool -> col_count; ++col_id )
+		col_diff_clear( &( cols[ col_id ] ) );
+	return rc;
+}
+
+
+/* the main-thread prints every window as soon as it is complete, and works on units otherwise */
+static rc_t diff_pool_main( diff_pool * pool )
+{
+	rc_t rc;
+	col_cursors * curs = calloc( pool -> col_count, sizeof * curs );
+	if ( curs == NULL )
+		return diff_pool_fail( pool, RC( rcExe, rcNoTarg, rcComparing, rcMemory, rcExhausted ) );
+
+	KLockAcquire( pool -> lock );
+	while ( pool -> rc == 0 )
+	{
+		uint64_t window;
+		uint32_t col_id;
+		col_diff * col;
+		uint32_t slot = ( uint32_t )( pool -> report_window % pool -> ahead );
+
+		if ( pool -> report_window < pool -> windows && pool -> done[ slot ] == pool -> col_count )
+		{
+			/* the workers do not touch the slots of a complete window */
+			KLockUnlock( pool -> lock );
+			rc = diff_pool_report( pool, &( pool -> slots[ slot * pool -> col_count ] ) );
+			if ( pool -> progress != NULL )
+				update_progressbar( pool -> progress,
+					( uint32_t )( ( ( pool -> report_window + 1 ) * 10000 ) / pool -> windows ) );
+			KLockAcquire( pool -> lock );
+			pool -> done[ slot ] = 0;
+			pool -> report_window++;
+			if ( rc != 0 && pool -> rc == 0 )
+				pool -> rc = rc;
+			KConditionBroadcast( pool -> cond );
+		}
+		else if ( ( col = diff_pool_take( pool, &window, &col_id ) ) != NULL )
+			diff_pool_run( pool, curs, col, window, col_id );
+		else if ( diff_pool_exhausted( pool ) && pool -> report_window == pool -> next_window )
+			break;
+		else
+			KConditionWait( pool -> cond, pool -> lock );
+	}
+	rc = pool -> rc;
+	KLockUnlock( pool -> lock );
+
+	col_cursors_release( curs, pool -> col_count );
+	return rc;
+}
+
+
+static rc_t diff_columns_parallel( col_defs * defs, const VTable * tab_1, const VTable * tab_2,
+								   struct diff_ctx * dctx, const struct num_gen * rows,
+								   int64_t first, uint64_t count,
+								   const diff_ranges * differ, uint64_t * rows_different )
+{
+	diff_pool pool;
+	uint32_t idx, num_threads = 0;
+	KThread ** threads = NULL;
+	rc_t rc;
+
+	memset( &pool, 0, sizeof pool );
+	rc = col_defs_count( defs, &pool.col_count );
+	if ( rc != 0 )
+	{
+		LOGERR ( klogInt, rc, "col_defs_count() failed" );
+		return rc;
+	}
+
+	pool.tab_1 = tab_1;
+	pool.tab_2 = tab_2;
+	pool.rows = rows;
+	pool.differ = differ;
+	pool.defs = defs;
+	pool.first = first;
+	pool.count = count;
+	pool.windows = ( count + DIFF_WINDOW_ROWS - 1 ) / DIFF_WINDOW_ROWS;
+	/* enough windows in flight to keep all threads busy while the oldest one is printed */
+	pool.ahead = ( pool.col_count > 0 ? dctx -> threads / pool.col_count : 0 ) + 2;
+	pool.max_err = ( dctx -> max_err > 0 ) ? dctx -> max_err : 1;
+	pool.limit = INT64_MAX;
+	if ( pool.col_count == 0 )
+		pool.windows = 0;
+	pool.slots = calloc( ( size_t )pool.ahead * pool.col_count + 1, sizeof * pool.slots );
+	pool.done = calloc( pool.ahead, sizeof * pool.done );
+	pool.pos = calloc( pool.col_count + 1, sizeof * pool.pos );
+	pool.first_rows = calloc( pool.max_err, sizeof * pool.first_rows );
+	if ( pool.slots == NULL || pool.done == NULL || pool.pos == NULL || pool.first_rows == NULL )
+		rc = RC( rcExe, rcNoTarg, rcComparing, rcMemory, rcExhausted );
+	else
+	{
+		rc = KLockMake( &pool.lock );
+		if ( rc != 0 )
+		{
+			LOGERR ( klogInt, rc, "KLockMake() failed" );
+		}
+		else
+		{
+			rc = KConditionMake( &pool.cond );
+			if ( rc != 0 )
+			{
+				LOGERR ( klogInt, rc, "KConditionMake() failed" );
+			}
+		}
+	}
+
+	if ( rc == 0 && dctx -> show_progress )
+		make_progressbar( &pool.progress, 2 );
+
+	if ( rc == 0 && dctx -> threads > 1 && pool.windows * pool.col_count > 1 )
+	{
+		uint32_t max_threads = dctx -> threads - 1;
+		threads = calloc( max_threads, sizeof * threads );
+		if ( threads == NULL )
+			rc = RC( rcExe, rcNoTarg, rcComparing, rcMemory, rcExhausted );
+		while ( rc == 0 && num_threads < max_threads )
+		{
+			rc = KThreadMake( &threads[ num_threads ], diff_pool_worker, &pool );
+			if ( rc != 0 )
+			{
+				LOGERR ( klogInt, rc, "KThreadMake() failed" );
+				/* stop the threads already running after their current unit */
+				diff_pool_fail( &pool, rc );
+			}
+			else
+				num_threads++;
+		}
+	}
+
+	if ( rc == 0 )
+	{
+		/* ********************************* */
+		rc = diff_pool_main( &pool );
+		/* ********************************* */
+	}
+
+	for ( idx = 0; idx < num_threads; ++idx )
+	{
+		rc_t rc_thread;
+		KThreadWait( threads[ idx ], &rc_thread );
+		KThreadRelease( threads[ idx ] );
+	}
+	if ( threads != NULL )
+		free( threads );
+
+	if ( pool.progress != NULL )
+		destroy_progressbar( pool.progress );
+
+	*rows_different = pool.rows_different;
+
+	if ( pool.slots != NULL )
+	{
+		for ( idx = 0; idx < pool.ahead * pool.col_count; ++idx )
+			col_diff_release( &( pool.slots[ idx ] ) );
+		free( pool.slots );
+	}
+	if ( pool.done != NULL )
+		free( pool.done );
+	if ( pool.pos != NULL )
+		free( pool.pos );
+	if ( pool.first_rows != NULL )
+		free( pool.first_rows );
+	KConditionRelease( pool.cond );
+	KLockRelease( pool.lock );
+	return rc;
+}
+
+
+static rc_t diff_columns_iter( col_defs * defs, const VTable * tab_1, const VTable * tab_2,
+							   struct diff_ctx * dctx, const struct num_gen * rows,
+							   int64_t first, uint64_t count, const diff_ranges * differ )
+{
+	uint32_t column_count;
+	rc_t rc = col_defs_count( defs, &column_count );
+	if ( rc != 0 )
+	{
+		LOGERR ( klogInt, rc, "col_defs_count() failed" );
+	}
+	else
+	{
+		uint64_t rows_checked = 0;
+		uint64_t rows_different = 0;
+		const struct num_gen_iter * iter;
+
+		rc = num_gen_iterator_make( rows, &iter );
+		if ( rc != 0 )
+		{
+			LOGERR ( klogInt, rc, "num_gen_iterator_make() failed" );
+		}
+		else
+		{
+			rc = num_gen_iterator_count( iter, &rows_checked );
+			if ( rc != 0 )
+			{
+				LOGERR ( klogInt, rc, "num_gen_iterator_count() failed" );
+			}
+			num_gen_iterator_destroy( iter );
+		}
+
+		if ( rc == 0 && differ != NULL && diff_ranges_all_equal( differ ) )
+		{
+			/* all blobs are byte-identical: every cell is the same */
+			rc = KOutMsg( "all blobs identical\n" );
+		}
+		else if ( rc == 0 )
+		{
+			/* *************************************************************** */
+			rc = diff_columns_parallel( defs, tab_1, tab_2, dctx, rows, first, count, differ, &rows_different );
+			/* *************************************************************** */
+		}
 
 		if ( rc == 0 )
 			rc = KOutMsg( "\n%,lu rows checked ( %d columns each ), %,lu rows differ\n",
@@ -447,17 +1043,15 @@ static rc_t diff_columns_iter( col_defs * defs, const VCursor * cur_1, const VCu
 
 		if ( rows_different > 0 )
 			rc = RC( rcExe, rcNoTarg, rcComparing, rcRow, rcInconsistent );
-		
-		if ( progress != NULL )
-			destroy_progressbar( progress );
-			
 	} /* if ( col_defs_count == 0 )*/
 	
 	return rc;
 }
 
 
-static rc_t diff_columns_cursor( col_defs * defs, const VCursor * cur_1, const VCursor * cur_2, struct diff_ctx * dctx )
+static rc_t diff_columns_cursor( col_defs * defs, const VTable * tab_1, const VTable * tab_2,
+								 const VCursor * cur_1, const VCursor * cur_2, struct diff_ctx * dctx,
+								 const diff_ranges * differ )
 {
     int64_t  first_1;
     uint64_t count_1;
@@ -522,19 +1116,16 @@ static rc_t diff_columns_cursor( col_defs * defs, const VCursor * cur_1, const V
 			
 			if ( rc == 0 )
 			{
-				const struct num_gen_iter * iter;
-				rc = num_gen_iterator_make( rows_to_diff, &iter );
-				if ( rc != 0 )
-				{
-					LOGERR ( klogInt, rc, "num_gen_iterator_make() failed" );
-				}
-				else
-				{
-					/* *************************************************************** */
-					rc = diff_columns_iter( defs, cur_1, cur_2, dctx, iter );
-					/* *************************************************************** */
-					num_gen_iterator_destroy( iter );
-				}
+				/* the row-ids both tables have, the windows of the parallel diff are cut from it */
+				int64_t first = ( first_1 > first_2 ) ? first_1 : first_2;
+				int64_t end_1 = first_1 + ( int64_t )count_1;
+				int64_t end_2 = first_2 + ( int64_t )count_2;
+				int64_t end = ( end_1 < end_2 ) ? end_1 : end_2;
+				uint64_t count = ( end > first ) ? ( uint64_t )( end - first ) : 0;
+
+				/* *************************************************************** */
+				rc = diff_columns_iter( defs, tab_1, tab_2, dctx, rows_to_diff, first, count, differ );
+				/* *************************************************************** */
 			}
 			
 			if ( rows_to_diff != NULL )
@@ -545,7 +1136,8 @@ static rc_t diff_columns_cursor( col_defs * defs, const VCursor * cur_1, const V
 }
 
 
-static rc_t diff_columns( col_defs * defs, const VTable * tab_1, const VTable * tab_2, struct diff_ctx * dctx )
+static rc_t diff_columns( col_defs * defs, const VTable * tab_1, const VTable * tab_2, struct diff_ctx * dctx,
+						  const diff_ranges * differ )
 {
 	const VCursor * cur_1;
 	rc_t rc = VTableCreateCursorRead( tab_1, &cur_1 );
@@ -592,7 +1184,7 @@ static rc_t diff_columns( col_defs * defs, const VTable * tab_1, const VTable *
 						else
 						{
 							/* ************************************************** */
-							rc = diff_columns_cursor( defs, cur_1, cur_2, dctx );
+							rc = diff_columns_cursor( defs, tab_1, tab_2, cur_1, cur_2, dctx, differ );
 							/* ************************************************** */
 						}
 					}
@@ -707,7 +1299,10 @@ static rc_t extract_columns_from_2_namelists( const KNamelist * cols_1, const KN
 }
 
 
-static rc_t perform_table_diff( const VTable * tab_1, const VTable * tab_2, struct diff_ctx * dctx )
+/* blob_check: the cells of a table can be determined by the stored blobs and
+   the schema alone, this is not true for tables of a database that refer to
+   each other */
+static rc_t perform_table_diff( const VTable * tab_1, const VTable * tab_2, struct diff_ctx * dctx, bool blob_check )
 {
 	col_defs * defs;
 	rc_t rc = col_defs_init( &defs );
@@ -753,9 +1348,18 @@ static rc_t perform_table_diff( const VTable * tab_1, const VTable * tab_2, stru
 					rc = col_defs_fill( defs, cols_to_diff );
 					if ( rc == 0 )
 					{
+						diff_ranges differ;
+						diff_ranges_init( &differ );
+						if ( blob_check && blob_check_wanted( dctx ) )
+						{
+							/* a failing blob-compare is not an error: the cells decide */
+							blob_diff_tables( tab_1, tab_2, &differ );
+						}
 						/* ******************************************* */
-						rc = diff_columns( defs, tab_1, tab_2, dctx );
+						rc = diff_columns( defs, tab_1, tab_2, dctx,
+										   differ.usable ? &differ : NULL );
 						/* ******************************************* */
+						diff_ranges_release( &differ );
 					}
 					KNamelistRelease( cols_to_diff );
 				}
@@ -795,7 +1399,7 @@ static rc_t perform_database_diff_on_this_table( const VDatabase * db_1, const V
 		else
 		{
 			/* ******************************************* */
-			rc = perform_table_diff( tab_1, tab_2, dctx );
+			rc = perform_table_diff( tab_1, tab_2, dctx, false );
 			/* ******************************************* */
 			VTableRelease( tab_2 );
 		}
@@ -808,6 +1412,16 @@ static rc_t perform_database_diff_on_this_table( const VDatabase * db_1, const V
 static rc_t perform_database_diff( const VDatabase * db_1, const VDatabase * db_2, struct diff_ctx * dctx )
 {
 	rc_t rc = 0;
+	if ( blob_check_wanted( dctx ) )
+	{
+		/* the tables of a database can refer to each other: blobs can only be trusted,
+		   if all tables are identical. A failing blob-compare is not an error */
+		bool equal = false;
+		blob_diff_databases( db_1, db_2, &equal );
+		if ( equal )
+			return KOutMsg( "all blobs of all tables identical\n" );
+	}
+
 	if ( dctx -> table != NULL )
 	{
 		/* we want to compare only the table wich name was given at the commandline */
@@ -940,7 +1554,7 @@ static rc_t perform_diff( struct diff_ctx * dctx )
 						if ( rc == 0 )
 						{
 							/* ******************************************** */
-							rc = perform_table_diff( tab_1, tab_2, dctx );
+							rc = perform_table_diff( tab_1, tab_2, dctx, true );
 							/* ******************************************** */
 							VTableRelease( tab_2 );
 						}
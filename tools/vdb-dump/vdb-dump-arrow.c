@@ -0,0 +1,940 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+
+#include <vdb/table.h>
+#include <vdb/cursor.h>
+#include <vdb/schema.h>
+
+#include <klib/out.h>
+#include <klib/log.h>
+#include <klib/rc.h>
+#include <klib/num-gen.h>
+
+#include "vdb-dump-arrow.h"
+
+#include <sysalloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+rc_t Quitting( void );
+
+/* -----------------------------------------------------------------------------------------------------------
+ Arrow IPC stream writer
+
+ the stream is: one schema-message, record-batches of VDA_ROWS_PER_BATCH rows, end-of-stream marker.
+ every message is: 0xFFFFFFFF, metadata-length, flatbuffer-encoded metadata, body.
+ the flatbuffers are built front to back by the few helpers below, no external library needed.
+
+ column mapping:
+    int/uint 8..64 bits, float, double ... List of Int / FloatingPoint, an empty cell is a null list
+    ascii/utf8 text, INSDC:2na:bin, INSDC:x2na:bin, INSDC:4na:bin, 2na-packed ( dim=2, bits=1 ) ... Utf8
+    -I / --row_id_on ... an extra column ROW_ID ( Int64 ) in front
+ the schema does not say how many values a cell has, so every number-column is a List:
+ the arrow-schema has to be written before the first row, a later cell could not change it
+ ----------------------------------------------------------------------------------------------------------- */
+
+#define VDA_ROWS_PER_BATCH ( 64 * 1024 )
+#define VDA_MAX_BATCH_BYTES ( 256 * 1024 * 1024 )
+
+/* from the Arrow-schema ( Schema.fbs / Message.fbs ) */
+#define ARROW_METADATA_V5       4
+#define ARROW_HEADER_SCHEMA     1
+#define ARROW_HEADER_BATCH      3
+#define ARROW_TYPE_INT          2
+#define ARROW_TYPE_FLOAT        3
+#define ARROW_TYPE_UTF8         5
+#define ARROW_TYPE_LIST         12
+#define ARROW_PRECISION_SINGLE  1
+#define ARROW_PRECISION_DOUBLE  2
+
+typedef struct vda_buf
+{
+    uint8_t * data;
+    size_t len;
+    size_t size;
+} vda_buf;
+
+
+static rc_t vda_buf_reserve( vda_buf * b, size_t len )
+{
+    if ( b->len + len > b->size )
+    {
+        size_t new_size = ( b->size == 0 ) ? 4096 : b->size * 2;
+        uint8_t * tmp;
+        while ( new_size < b->len + len )
+            new_size *= 2;
+        tmp = realloc( b->data, new_size );
+        if ( tmp == NULL )
+            return RC( rcVDB, rcNoTarg, rcWriting, rcMemory, rcExhausted );
+        b->data = tmp;
+        b->size = new_size;
+    }
+    return 0;
+}
+
+
+static rc_t vda_buf_append( vda_buf * b, const void * src, size_t len )
+{
+    rc_t rc = vda_buf_reserve( b, len );
+    if ( rc == 0 )
+    {
+        if ( src != NULL )
+            memmove( b->data + b->len, src, len );
+        else
+            memset( b->data + b->len, 0, len );
+        b->len += len;
+    }
+    return rc;
+}
+
+
+static void vda_buf_free( vda_buf * b )
+{
+    free( b->data );
+    b->data = NULL;
+    b->len = b->size = 0;
+}
+
+
+/* ----------------------------------------------------------------------------------------------------------- */
+
+typedef struct vda_fb
+{
+    vda_buf b;
+    rc_t rc;
+} vda_fb;
+
+typedef struct vda_fb_field
+{
+    uint16_t id;
+    uint8_t size;       /* 1, 2, 4, 8 ... a reference to a table/vector/string has size 4 */
+    uint64_t value;
+    size_t pos;         /* set by vda_fb_table(), where the value was written */
+} vda_fb_field;
+
+#define VDA_FB_MAX_FIELDS 8
+
+
+static size_t vda_fb_put( vda_fb * fb, const void * src, size_t len )
+{
+    size_t pos = fb->b.len;
+    if ( fb->rc == 0 )
+        fb->rc = vda_buf_append( &fb->b, src, len );
+    return pos;
+}
+
+
+static void vda_fb_align( vda_fb * fb, size_t align, size_t rest )
+{
+    while ( fb->rc == 0 && ( fb->b.len % align ) != rest )
+        vda_fb_put( fb, NULL, 1 );
+}
+
+
+/* a uoffset_t is relative to its own position and has to point forward */
+static void vda_fb_ref( vda_fb * fb, size_t at, size_t target )
+{
+    if ( fb->rc == 0 )
+    {
+        uint32_t value = ( uint32_t )( target - at );
+        memmove( fb->b.data + at, &value, sizeof value );
+    }
+}
+
+
+/* vtable, followed by the table; fields are laid out largest first to keep them aligned */
+static size_t vda_fb_table( vda_fb * fb, vda_fb_field * fields, uint32_t count )
+{
+    uint16_t vt[ 2 + VDA_FB_MAX_FIELDS ];
+    uint32_t slots = 0, i;
+    uint16_t cur = 4;
+    uint8_t size;
+    size_t vt_pos, table_pos;
+    int32_t soffset;
+
+    memset( vt, 0, sizeof vt );
+    for ( i = 0; i < count; ++i )
+    {
+        if ( fields[ i ].id + 1u > slots )
+            slots = fields[ i ].id + 1;
+    }
+    for ( size = 8; size > 0; size >>= 1 )
+    {
+        for ( i = 0; i < count; ++i )
+        {
+            if ( fields[ i ].size == size )
+            {
+                cur = ( cur + size - 1 ) & ~( size - 1 );
+                fields[ i ].pos = cur;
+                vt[ 2 + fields[ i ].id ] = cur;
+                cur += size;
+            }
+        }
+    }
+    vt[ 0 ] = ( uint16_t )( ( 2 + slots ) * sizeof vt[ 0 ] );
+    vt[ 1 ] = cur;
+
+    vda_fb_align( fb, 2, 0 );
+    vt_pos = vda_fb_put( fb, vt, vt[ 0 ] );
+    vda_fb_align( fb, 8, 0 );
+    table_pos = vda_fb_put( fb, NULL, cur );
+    if ( fb->rc == 0 )
+    {
+        soffset = ( int32_t )( table_pos - vt_pos );
+        memmove( fb->b.data + table_pos, &soffset, sizeof soffset );
+        for ( i = 0; i < count; ++i )
+        {
+            fields[ i ].pos += table_pos;
+            /* little endian: the low bytes of the value */
+            memmove( fb->b.data + fields[ i ].pos, &fields[ i ].value, fields[ i ].size );
+        }
+    }
+    return table_pos;
+}
+
+
+static size_t vda_fb_string( vda_fb * fb, const char * s )
+{
+    uint32_t len = ( uint32_t )strlen( s );
+    size_t pos;
+    vda_fb_align( fb, 4, 0 );
+    pos = vda_fb_put( fb, &len, sizeof len );
+    vda_fb_put( fb, s, len + 1 );
+    return pos;
+}
+
+
+/* returns the position of the first of count reference-slots */
+static size_t vda_fb_ref_vector( vda_fb * fb, uint32_t count )
+{
+    size_t pos;
+    vda_fb_align( fb, 4, 0 );
+    pos = vda_fb_put( fb, &count, sizeof count );
+    vda_fb_put( fb, NULL, count * sizeof count );
+    return pos + sizeof count;
+}
+
+
+/* vector of structs made from 2 int64, the elements have to be 8-byte aligned */
+static size_t vda_fb_struct_vector( vda_fb * fb, const int64_t * pairs, uint32_t count )
+{
+    size_t pos;
+    vda_fb_align( fb, 8, 4 );
+    pos = vda_fb_put( fb, &count, sizeof count );
+    vda_fb_put( fb, pairs, count * 2 * sizeof *pairs );
+    return pos;
+}
+
+
+/* ----------------------------------------------------------------------------------------------------------- */
+
+typedef enum vda_kind
+{
+    vda_row_id,     /* the row-id itself */
+    vda_number,     /* int, uint, float copied as is */
+    vda_text,       /* 8-bit text copied as is */
+    vda_packed_2na, /* dim=2,bits=1 decoded into bases */
+    vda_lookup      /* 8-bit codes decoded into bases via lookup */
+} vda_kind;
+
+typedef struct vda_col
+{
+    p_col_def def;
+    const char * name;
+    const char * lookup;
+    uint32_t lookup_len;
+    vda_kind kind;
+    uint8_t arrow_type;     /* ARROW_TYPE_INT/FLOAT/UTF8 */
+    uint8_t bits;
+    bool is_signed;
+    bool is_list;           /* every number-column except ROW_ID */
+    bool has_nulls;
+    int64_t null_count;
+
+    vda_buf validity;
+    vda_buf offsets;
+    vda_buf values;
+} vda_col;
+
+typedef struct vda_ctx
+{
+    vda_col * cols;
+    uint32_t col_count;
+    uint64_t batch_rows;
+    bool schema_written;
+} vda_ctx;
+
+static const char vda_2na[] = "ACGT";
+static const char vda_x2na[] = "ACGTN";
+static const char vda_4na[] = "-ACMGRSVTWYHKDBN";
+
+
+static rc_t vda_write( const void * data, size_t len )
+{
+    rc_t rc = 0;
+    KWrtWriter writer = KOutWriterGet();
+    void * writer_data = KOutDataGet();
+    const char * src = data;
+
+    while ( rc == 0 && len > 0 )
+    {
+        size_t num_writ = 0;
+        if ( writer == NULL )
+            rc = RC( rcVDB, rcNoTarg, rcWriting, rcFile, rcNotOpen );
+        else
+            rc = writer( writer_data, src, len, &num_writ );
+        if ( rc == 0 )
+        {
+            if ( num_writ == 0 )
+                rc = RC( rcVDB, rcNoTarg, rcWriting, rcTransfer, rcIncomplete );
+            src += num_writ;
+            len -= num_writ;
+        }
+    }
+    if ( rc != 0 )
+        LOGERR( klogInt, rc, "writing arrow-stream failed" );
+    return rc;
+}
+
+
+static rc_t vda_write_padded( const void * data, size_t len )
+{
+    static const uint8_t zeros[ 8 ] = { 0 };
+    rc_t rc = vda_write( data, len );
+    if ( rc == 0 && ( len & 7 ) != 0 )
+        rc = vda_write( zeros, 8 - ( len & 7 ) );
+    return rc;
+}
+
+
+/* continuation-marker, length of the metadata, metadata padded to 8 bytes */
+static rc_t vda_write_message( vda_fb * fb )
+{
+    rc_t rc;
+    uint32_t prefix[ 2 ];
+
+    vda_fb_align( fb, 8, 0 );
+    if ( fb->rc != 0 )
+        return fb->rc;
+    prefix[ 0 ] = 0xFFFFFFFF;
+    prefix[ 1 ] = ( uint32_t )fb->b.len;
+    rc = vda_write( prefix, sizeof prefix );
+    if ( rc == 0 )
+        rc = vda_write( fb->b.data, fb->b.len );
+    return rc;
+}
+
+
+/* ----------------------------------------------------------------------------------------------------------- */
+
+static void vda_fb_type( vda_fb * fb, size_t slot, const vda_col * col )
+{
+    vda_fb_field f[ 2 ];
+    uint32_t n = 0;
+    size_t pos;
+
+    memset( f, 0, sizeof f );
+    switch ( col->arrow_type )
+    {
+        case ARROW_TYPE_INT :
+            f[ 0 ].id = 0; f[ 0 ].size = 4; f[ 0 ].value = col->bits;        /* bitWidth */
+            f[ 1 ].id = 1; f[ 1 ].size = 1; f[ 1 ].value = col->is_signed;   /* is_signed */
+            n = 2;
+            break;
+
+        case ARROW_TYPE_FLOAT :
+            f[ 0 ].id = 0; f[ 0 ].size = 2;                                  /* precision */
+            f[ 0 ].value = ( col->bits == 32 ) ? ARROW_PRECISION_SINGLE : ARROW_PRECISION_DOUBLE;
+            n = 1;
+            break;
+    }
+    pos = vda_fb_table( fb, f, n );
+    vda_fb_ref( fb, slot, pos );
+}
+
+
+/* Field { name, nullable, type_type, type, children }, a list has one child "item" */
+static void vda_fb_schema_field( vda_fb * fb, size_t slot, const vda_col * col, const char * name, bool list )
+{
+    vda_fb_field f[ 5 ];
+    size_t pos;
+
+    memset( f, 0, sizeof f );
+    f[ 0 ].id = 0; f[ 0 ].size = 4;                                         /* name */
+    f[ 1 ].id = 1; f[ 1 ].size = 1; f[ 1 ].value = 1;                       /* nullable */
+    f[ 2 ].id = 2; f[ 2 ].size = 1; f[ 2 ].value = list ? ARROW_TYPE_LIST : col->arrow_type;
+    f[ 3 ].id = 3; f[ 3 ].size = 4;                                         /* type */
+    f[ 4 ].id = 5; f[ 4 ].size = 4;                                         /* children */
+    pos = vda_fb_table( fb, f, 5 );
+    vda_fb_ref( fb, slot, pos );
+
+    vda_fb_ref( fb, f[ 0 ].pos, vda_fb_string( fb, name ) );
+    if ( list )
+    {
+        size_t child;
+        vda_fb_ref( fb, f[ 3 ].pos, vda_fb_table( fb, NULL, 0 ) );          /* List {} */
+        child = vda_fb_ref_vector( fb, 1 );
+        vda_fb_ref( fb, f[ 4 ].pos, child - 4 );
+        vda_fb_schema_field( fb, child, col, "item", false );
+    }
+    else
+    {
+        vda_fb_type( fb, f[ 3 ].pos, col );
+        vda_fb_ref( fb, f[ 4 ].pos, vda_fb_ref_vector( fb, 0 ) - 4 );
+    }
+}
+
+
+/* Message { version, header_type, header, bodyLength } */
+static size_t vda_fb_message( vda_fb * fb, uint8_t header_type, uint64_t body_len )
+{
+    vda_fb_field f[ 4 ];
+    uint32_t root = 0;
+
+    memset( f, 0, sizeof f );
+    vda_fb_put( fb, &root, sizeof root );
+    f[ 0 ].id = 0; f[ 0 ].size = 2; f[ 0 ].value = ARROW_METADATA_V5;
+    f[ 1 ].id = 1; f[ 1 ].size = 1; f[ 1 ].value = header_type;
+    f[ 2 ].id = 2; f[ 2 ].size = 4;
+    f[ 3 ].id = 3; f[ 3 ].size = 8; f[ 3 ].value = body_len;
+    vda_fb_ref( fb, 0, vda_fb_table( fb, f, 4 ) );
+    return f[ 2 ].pos;  /* where the header has to be referenced */
+}
+
+
+static rc_t vda_write_schema( vda_ctx * a )
+{
+    rc_t rc;
+    vda_fb fb;
+    vda_fb_field f[ 2 ];
+    size_t header, slots;
+    uint32_t i;
+
+    memset( &fb, 0, sizeof fb );
+    memset( f, 0, sizeof f );
+    header = vda_fb_message( &fb, ARROW_HEADER_SCHEMA, 0 );
+
+    /* Schema { endianness = Little, fields } */
+    f[ 0 ].id = 0; f[ 0 ].size = 2;
+    f[ 1 ].id = 1; f[ 1 ].size = 4;
+    vda_fb_ref( &fb, header, vda_fb_table( &fb, f, 2 ) );
+
+    slots = vda_fb_ref_vector( &fb, a->col_count );
+    vda_fb_ref( &fb, f[ 1 ].pos, slots - 4 );
+    for ( i = 0; i < a->col_count; ++i )
+    {
+        const vda_col * col = &a->cols[ i ];
+        vda_fb_schema_field( &fb, slots + i * 4, col, col->name, col->is_list );
+    }
+
+    rc = vda_write_message( &fb );
+    vda_buf_free( &fb.b );
+    return rc;
+}
+
+
+/* ----------------------------------------------------------------------------------------------------------- */
+
+static uint32_t vda_node_count( const vda_ctx * a )
+{
+    uint32_t i, res = 0;
+    for ( i = 0; i < a->col_count; ++i )
+        res += a->cols[ i ].is_list ? 2 : 1;
+    return res;
+}
+
+
+/* the body-buffers of one column in the order Arrow expects them */
+static uint32_t vda_col_buffers( const vda_col * col, const vda_buf ** bufs )
+{
+    uint32_t n = 0;
+    bufs[ n++ ] = col->has_nulls ? &col->validity : NULL;
+    if ( col->is_list || col->arrow_type == ARROW_TYPE_UTF8 )
+        bufs[ n++ ] = &col->offsets;
+    if ( col->is_list )
+        bufs[ n++ ] = NULL;     /* validity of the child */
+    bufs[ n++ ] = &col->values;
+    return n;
+}
+
+
+static size_t vda_padded( size_t len )
+{
+    return ( len + 7 ) & ~( ( size_t )7 );
+}
+
+
+static size_t vda_buf_len( const vda_buf * b, const vda_col * col, uint64_t rows )
+{
+    if ( b == NULL )
+        return 0;
+    if ( b == &col->validity )
+        return ( size_t )( ( rows + 7 ) / 8 );
+    return b->len;
+}
+
+
+static rc_t vda_write_batch( vda_ctx * a )
+{
+    rc_t rc = 0;
+    vda_fb fb;
+    vda_fb_field f[ 3 ];
+    uint32_t node_count = vda_node_count( a );
+    uint32_t buf_count = node_count * 2 + a->col_count;
+    int64_t * nodes = calloc( node_count * 2, sizeof *nodes );
+    int64_t * buffers = calloc( buf_count * 2, sizeof *buffers );
+    uint32_t i, ni = 0, bi = 0;
+    uint64_t body_len = 0;
+
+    if ( nodes == NULL || buffers == NULL )
+    {
+        free( nodes );
+        free( buffers );
+        return RC( rcVDB, rcNoTarg, rcWriting, rcMemory, rcExhausted );
+    }
+
+    /* the field-nodes and the position of the buffers within the body */
+    for ( i = 0; i < a->col_count; ++i )
+    {
+        const vda_col * col = &a->cols[ i ];
+        const vda_buf * bufs[ 4 ];
+        uint32_t j, n = vda_col_buffers( col, bufs );
+
+        nodes[ ni++ ] = a->batch_rows;
+        nodes[ ni++ ] = col->null_count;
+        if ( col->is_list )
+        {
+            int32_t total;
+            memmove( &total, col->offsets.data + a->batch_rows * sizeof total, sizeof total );
+            nodes[ ni++ ] = total;
+            nodes[ ni++ ] = 0;
+        }
+        for ( j = 0; j < n; ++j )
+        {
+            size_t len = vda_buf_len( bufs[ j ], col, a->batch_rows );
+            buffers[ bi++ ] = body_len;
+            buffers[ bi++ ] = len;
+            body_len += vda_padded( len );
+        }
+    }
+
+    /* Message { RecordBatch { length, nodes, buffers } } */
+    memset( &fb, 0, sizeof fb );
+    memset( f, 0, sizeof f );
+    f[ 0 ].id = 0; f[ 0 ].size = 8; f[ 0 ].value = a->batch_rows;
+    f[ 1 ].id = 1; f[ 1 ].size = 4;
+    f[ 2 ].id = 2; f[ 2 ].size = 4;
+    {
+        size_t header = vda_fb_message( &fb, ARROW_HEADER_BATCH, body_len );
+        vda_fb_ref( &fb, header, vda_fb_table( &fb, f, 3 ) );
+        vda_fb_ref( &fb, f[ 1 ].pos, vda_fb_struct_vector( &fb, nodes, node_count ) );
+        vda_fb_ref( &fb, f[ 2 ].pos, vda_fb_struct_vector( &fb, buffers, bi / 2 ) );
+    }
+    rc = vda_write_message( &fb );
+    vda_buf_free( &fb.b );
+
+    /* the body */
+    for ( i = 0; rc == 0 && i < a->col_count; ++i )
+    {
+        const vda_col * col = &a->cols[ i ];
+        const vda_buf * bufs[ 4 ];
+        uint32_t j, n = vda_col_buffers( col, bufs );
+        for ( j = 0; rc == 0 && j < n; ++j )
+        {
+            size_t len = vda_buf_len( bufs[ j ], col, a->batch_rows );
+            if ( len > 0 )
+                rc = vda_write_padded( bufs[ j ]->data, len );
+        }
+    }
+
+    free( nodes );
+    free( buffers );
+    return rc;
+}
+
+
+static rc_t vda_start_batch( vda_ctx * a )
+{
+    rc_t rc = 0;
+    uint32_t i;
+    for ( i = 0; rc == 0 && i < a->col_count; ++i )
+    {
+        vda_col * col = &a->cols[ i ];
+        int32_t zero = 0;
+        col->validity.len = 0;
+        col->offsets.len = 0;
+        col->values.len = 0;
+        col->has_nulls = false;
+        col->null_count = 0;
+        if ( col->is_list || col->arrow_type == ARROW_TYPE_UTF8 )
+            rc = vda_buf_append( &col->offsets, &zero, sizeof zero );
+    }
+    a->batch_rows = 0;
+    return rc;
+}
+
+
+static rc_t vda_finish_batch( vda_ctx * a )
+{
+    rc_t rc = 0;
+    if ( !a->schema_written )
+    {
+        rc = vda_write_schema( a );
+        a->schema_written = true;
+    }
+    if ( rc == 0 && a->batch_rows > 0 )
+        rc = vda_write_batch( a );
+    if ( rc == 0 )
+        rc = vda_start_batch( a );
+    return rc;
+}
+
+
+/* the bitmap always covers the rows up to the current one, unset bits are nulls */
+static rc_t vda_set_null( vda_col * col, uint64_t row )
+{
+    rc_t rc = 0;
+    size_t needed = ( size_t )( row / 8 + 1 );
+    if ( !col->has_nulls )
+    {
+        /* the first null: all previous rows are valid */
+        uint64_t i;
+        col->validity.len = 0;
+        rc = vda_buf_append( &col->validity, NULL, needed );
+        for ( i = 0; rc == 0 && i < row; ++i )
+            col->validity.data[ i >> 3 ] |= ( 1 << ( i & 7 ) );
+        col->has_nulls = true;
+    }
+    else if ( col->validity.len < needed )
+        rc = vda_buf_append( &col->validity, NULL, needed - col->validity.len );
+    if ( rc == 0 )
+        col->null_count++;
+    return rc;
+}
+
+
+static rc_t vda_set_valid( vda_col * col, uint64_t row )
+{
+    rc_t rc = 0;
+    if ( col->has_nulls )
+    {
+        size_t needed = ( size_t )( row / 8 + 1 );
+        if ( col->validity.len < needed )
+            rc = vda_buf_append( &col->validity, NULL, needed - col->validity.len );
+        if ( rc == 0 )
+            col->validity.data[ row >> 3 ] |= ( 1 << ( row & 7 ) );
+    }
+    return rc;
+}
+
+
+static rc_t vda_add_offset( vda_col * col )
+{
+    int32_t end;
+    if ( col->values.len > 0x7FFFFFFF )
+        return RC( rcVDB, rcNoTarg, rcWriting, rcSize, rcExcessive );
+    end = ( int32_t )( col->values.len / ( ( col->arrow_type == ARROW_TYPE_UTF8 ) ? 1 : col->bits / 8 ) );
+    return vda_buf_append( &col->offsets, &end, sizeof end );
+}
+
+
+static rc_t vda_add_text( vda_col * col, const uint8_t * src, uint32_t boff, uint32_t count )
+{
+    rc_t rc = vda_buf_reserve( &col->values, count );
+    if ( rc == 0 )
+    {
+        uint8_t * dst = col->values.data + col->values.len;
+        uint32_t i;
+        switch ( col->kind )
+        {
+            case vda_packed_2na :
+                for ( i = 0; i < count; ++i )
+                {
+                    uint32_t bit = boff + 2 * i;
+                    uint8_t b = src[ bit >> 3 ] << ( bit & 7 );
+                    dst[ i ] = vda_2na[ ( b >> 6 ) & 3 ];
+                }
+                break;
+
+            case vda_lookup :
+                src += ( boff >> 3 );
+                for ( i = 0; i < count; ++i )
+                    dst[ i ] = ( src[ i ] < col->lookup_len ) ? col->lookup[ src[ i ] ] : 'N';
+                break;
+
+            default :
+                memmove( dst, src + ( boff >> 3 ), count );
+                break;
+        }
+        col->values.len += count;
+        rc = vda_add_offset( col );
+    }
+    return rc;
+}
+
+
+static rc_t vda_add_cell( vda_ctx * a, vda_col * col, int64_t row_id, const VCursor * cur )
+{
+    rc_t rc;
+    const void * base = NULL;
+    uint32_t elem_bits = 0, boff = 0, count = 0;
+
+    if ( col->kind == vda_row_id )
+    {
+        base = &row_id;
+        count = 1;
+        rc = 0;
+    }
+    else
+    {
+        rc = VCursorCellDataDirect( cur, row_id, col->def->idx, &elem_bits, &base, &boff, &count );
+        if ( rc != 0 )
+        {
+            PLOGERR( klogInt, ( klogInt, rc,
+                     "VCursorCellDataDirect( col:$(col_name) at row #$(row_nr) ) failed",
+                     "col_name=%s,row_nr=%ld", col->name, row_id ) );
+            return rc;
+        }
+    }
+
+    if ( col->arrow_type == ARROW_TYPE_UTF8 )
+        return vda_add_text( col, base, boff, count );
+
+    if ( ( boff & 7 ) != 0 )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcWriting, rcData, rcUnsupported );
+        PLOGERR( klogErr, ( klogErr, rc,
+                 "column $(col_name) at row #$(row_nr) is not byte-aligned",
+                 "col_name=%s,row_nr=%ld", col->name, row_id ) );
+        return rc;
+    }
+
+    if ( col->is_list )
+    {
+        /* an empty cell is a null list, its offset repeats the previous one */
+        rc = vda_buf_append( &col->values, ( const uint8_t * )base + ( boff >> 3 ), count * ( col->bits / 8 ) );
+        if ( rc == 0 )
+            rc = vda_add_offset( col );
+    }
+    else
+        rc = vda_buf_append( &col->values, ( const uint8_t * )base + ( boff >> 3 ), col->bits / 8 );
+    if ( rc == 0 )
+        rc = ( count == 0 ) ? vda_set_null( col, a->batch_rows ) : vda_set_valid( col, a->batch_rows );
+    return rc;
+}
+
+
+/* ----------------------------------------------------------------------------------------------------------- */
+
+/* returns false if the column cannot be represented */
+static bool vda_init_col( vda_col * col, p_col_def def, const VSchema * schema )
+{
+    const VTypedesc * td = &def->type_desc;
+    char type_name[ 256 ];
+
+    memset( col, 0, sizeof *col );
+    col->def = def;
+    col->name = def->name;
+
+    type_name[ 0 ] = 0;
+    if ( schema != NULL && VTypedeclToText( &def->type_decl, schema, type_name, sizeof type_name ) != 0 )
+        type_name[ 0 ] = 0;
+
+    if ( td->intrinsic_dim == 2 && td->intrinsic_bits == 1 )
+    {
+        col->kind = vda_packed_2na;
+        col->arrow_type = ARROW_TYPE_UTF8;
+        return true;
+    }
+    if ( td->intrinsic_dim != 1 )
+        return false;
+
+    if ( strcmp( type_name, "INSDC:2na:bin" ) == 0 )
+        col->lookup = vda_2na;
+    else if ( strcmp( type_name, "INSDC:x2na:bin" ) == 0 )
+        col->lookup = vda_x2na;
+    else if ( strcmp( type_name, "INSDC:4na:bin" ) == 0 )
+        col->lookup = vda_4na;
+    if ( col->lookup != NULL )
+    {
+        col->lookup_len = ( uint32_t )strlen( col->lookup );
+        col->kind = vda_lookup;
+        col->arrow_type = ARROW_TYPE_UTF8;
+        return true;
+    }
+
+    col->bits = ( uint8_t )td->intrinsic_bits;
+    switch ( td->domain )
+    {
+        case vtdBool :
+        case vtdUint :
+        case vtdInt :
+            col->kind = vda_number;
+            col->is_list = true;
+            col->arrow_type = ARROW_TYPE_INT;
+            col->is_signed = ( td->domain == vtdInt );
+            return ( col->bits == 8 || col->bits == 16 || col->bits == 32 || col->bits == 64 );
+
+        case vtdFloat :
+            col->kind = vda_number;
+            col->is_list = true;
+            col->arrow_type = ARROW_TYPE_FLOAT;
+            return ( col->bits == 32 || col->bits == 64 );
+
+        case vtdAscii :
+        case vtdUnicode :
+            col->kind = vda_text;
+            col->arrow_type = ARROW_TYPE_UTF8;
+            return ( col->bits == 8 );
+    }
+    return false;
+}
+
+
+static rc_t vda_init( vda_ctx * a, const p_dump_context ctx, const VTable * tab, p_col_defs col_defs )
+{
+    rc_t rc = 0;
+    const VSchema * schema = NULL;
+    uint32_t i, len = VectorLength( &col_defs->cols );
+
+    memset( a, 0, sizeof *a );
+    a->cols = calloc( len + 1, sizeof *a->cols );
+    if ( a->cols == NULL )
+        return RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+
+    if ( ctx->print_row_id )
+    {
+        vda_col * col = &a->cols[ a->col_count++ ];
+        col->name = "ROW_ID";
+        col->kind = vda_row_id;
+        col->arrow_type = ARROW_TYPE_INT;
+        col->bits = 64;
+        col->is_signed = true;
+    }
+
+    if ( VTableOpenSchema( tab, &schema ) != 0 )
+        schema = NULL;
+    for ( i = 0; i < len; ++i )
+    {
+        p_col_def def = VectorGet( &col_defs->cols, i );
+        if ( def != NULL && def->valid && !def->excluded )
+        {
+            if ( vda_init_col( &a->cols[ a->col_count ], def, schema ) )
+                a->col_count++;
+            else
+                PLOGMSG( klogWarn, ( klogWarn,
+                         "column $(col_name) cannot be written as arrow, skipped",
+                         "col_name=%s", def->name ) );
+        }
+    }
+    if ( schema != NULL )
+        VSchemaRelease( schema );
+
+    if ( a->col_count == 0 )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcConstructing, rcParam, rcInvalid );
+        LOGERR( klogErr, rc, "no column can be written as arrow" );
+    }
+    return rc;
+}
+
+
+static void vda_release( vda_ctx * a )
+{
+    uint32_t i;
+    for ( i = 0; i < a->col_count; ++i )
+    {
+        vda_buf_free( &a->cols[ i ].validity );
+        vda_buf_free( &a->cols[ i ].offsets );
+        vda_buf_free( &a->cols[ i ].values );
+    }
+    free( a->cols );
+}
+
+
+static bool vda_batch_full( const vda_ctx * a )
+{
+    uint32_t i;
+    if ( a->batch_rows >= VDA_ROWS_PER_BATCH )
+        return true;
+    for ( i = 0; i < a->col_count; ++i )
+    {
+        if ( a->cols[ i ].values.len >= VDA_MAX_BATCH_BYTES )
+            return true;
+    }
+    return false;
+}
+
+
+rc_t vda_dump_rows( const p_dump_context ctx, const VTable * tab,
+                    const VCursor * cur, p_col_defs col_defs )
+{
+    vda_ctx a;
+    rc_t rc = vda_init( &a, ctx, tab, col_defs );
+    if ( rc == 0 )
+        rc = vda_start_batch( &a );
+    if ( rc == 0 )
+    {
+        const struct num_gen_iter * iter;
+        rc = num_gen_iterator_make( ctx->rows, &iter );
+        if ( rc != 0 )
+            LOGERR( klogInt, rc, "num_gen_iterator_make() failed" );
+        else
+        {
+            int64_t row_id;
+            while ( rc == 0 && num_gen_iterator_next( iter, &row_id, &rc ) )
+            {
+                if ( rc == 0 )
+                    rc = Quitting();
+                if ( rc == 0 )
+                {
+                    uint32_t i;
+                    for ( i = 0; rc == 0 && i < a.col_count; ++i )
+                        rc = vda_add_cell( &a, &a.cols[ i ], row_id, cur );
+                    if ( rc == 0 )
+                    {
+                        a.batch_rows++;
+                        if ( vda_batch_full( &a ) )
+                            rc = vda_finish_batch( &a );
+                    }
+                }
+            }
+            num_gen_iterator_destroy( iter );
+        }
+
+        /* the last batch and the end-of-stream marker */
+        if ( rc == 0 && ( a.batch_rows > 0 || !a.schema_written ) )
+            rc = vda_finish_batch( &a );
+        if ( rc == 0 )
+        {
+            uint32_t eos[ 2 ] = { 0xFFFFFFFF, 0 };
+            rc = vda_write( eos, sizeof eos );
+        }
+    }
+    vda_release( &a );
+    return rc;
+}
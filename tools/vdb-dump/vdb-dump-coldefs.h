@@ -53,6 +53,10 @@ const char *get_read_filter_txt( const uint32_t id );
 typedef const char* (*value_trans_fct_t)( const uint32_t id );
 typedef char* (*dim_trans_fct_t)( const uint8_t *src );
 
+/* formats a whole cell at once, src is byte-aligned */
+typedef rc_t (*cell_fmt_fct_t)( p_dump_str s, const uint8_t *src,
+                                const uint32_t count, const char *sep );
+
 /********************************************************************
 col-def is the definition of a single column: name/index/type
 ********************************************************************/
@@ -68,6 +72,7 @@ typedef struct col_def
     dump_str content;
     value_trans_fct_t value_trans_fct;
     dim_trans_fct_t dim_trans_fct;
+    cell_fmt_fct_t cell_fmt_fct;    /* NULL ... element by element */
 } col_def;
 typedef col_def* p_col_def;
 
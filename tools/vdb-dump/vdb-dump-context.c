@@ -134,6 +134,7 @@ static void vdco_init_values( p_dump_context ctx )
     ctx->idx_enum_requested = false;
     ctx->idx_range_requested = false;
     ctx->disable_multithreading = false;
+    ctx->threads = 1;
     ctx->table_defined = false;
     ctx->diff = false;
     ctx->show_spotgroups = false;
@@ -438,6 +439,8 @@ static bool vdco_set_format( p_dump_context ctx, const char *src )
         ctx->format = df_bin;
     else if ( strcmp( src, "sql" ) == 0 )
         ctx->format = df_sql;
+    else if ( strcmp( src, "arrow" ) == 0 )
+        ctx->format = df_arrow;
     else ctx->format = df_default;
     return true;
 }
@@ -611,6 +614,9 @@ static void vdco_evaluate_options( const Args *my_args,
     ctx->len_spread = vdco_get_bool_option( my_args, OPTION_LEN_SPREAD, false );
     ctx->interactive = vdco_get_bool_option( my_args, OPTION_INTERACTIVE, false );
     ctx->slice_depth = vdco_get_uint16_option( my_args, OPTION_SLICE, 0 );
+    ctx->threads = vdco_get_uint16_option( my_args, OPTION_THREADS, 1 );
+    if ( ctx->threads < 1 || ctx->disable_multithreading )
+        ctx->threads = 1;
     ctx->append = vdco_get_bool_option( my_args, OPTION_APPEND, false );
     
     ctx->cur_cache_size = vdco_get_size_t_option( my_args, OPTION_CUR_CACHE, CURSOR_CACHE_SIZE );
@@ -90,6 +90,7 @@ extern "C" {
 #define OPTION_SLICE             "slice"
 #define OPTION_INTERACTIVE       "interactive"
 #define OPTION_LEN_SPREAD        "len-spread"
+#define OPTION_THREADS           "threads"
 
 #define ALIAS_ROW_ID_ON         "I"
 #define ALIAS_LINE_FEED         "l"
@@ -117,6 +118,7 @@ extern "C" {
 #define ALIAS_NUMELEM           "u"
 #define ALIAS_NUMELEMSUM        "U"
 #define ALIAS_APPEND            "a"
+#define ALIAS_THREADS           "e"
 
 #define USE_PATHTYPE_TO_DETECT_DB_OR_TAB 1
 #define CURSOR_CACHE_SIZE 256*1024*1024
@@ -139,7 +141,8 @@ typedef enum dump_format_t
     df_qual,
     df_qual1,
     df_bin,
-    df_sql
+    df_sql,
+    df_arrow
 } dump_format_t;
 
 /********************************************************************
@@ -165,6 +168,7 @@ typedef struct dump_context
     uint16_t phase;
     uint32_t generic_idx;
     uint32_t slice_depth;
+    uint32_t threads;
     size_t cur_cache_size;
     size_t output_buffer_size;
     dump_format_t format;
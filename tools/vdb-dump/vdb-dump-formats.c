@@ -29,8 +29,29 @@
 
 #include <klib/rc.h>
 #include <klib/log.h>
+#include <klib/out.h>
+
+#include <stdarg.h>
 #define DISP_RC(rc,err) if( rc != 0 ) LOGERR( klogInt, rc, err );
 
+/*************************************************************************************
+    output goes to stdout ( or its redirection ), or is collected in r_ctx->out
+    if the row is dumped by a worker-thread
+*************************************************************************************/
+static rc_t vdfo_out( const p_row_context r_ctx, const char * fmt, ... )
+{
+    rc_t rc;
+    va_list args;
+
+    va_start( args, fmt );
+    if ( r_ctx->out == NULL )
+        rc = KOutVMsg( fmt, args );
+    else
+        rc = vds_append_vfmt_no_limit_check( r_ctx->out, fmt, args );
+    va_end( args );
+    return rc;
+}
+
 /*************************************************************************************
     default ( with line-length-limitation and pretty print )
 *************************************************************************************/
@@ -81,14 +102,14 @@ static void CC vdfo_print_col_default( void *item, void *data )
     }
 
     /* FINALLY we print the content of a column... */
-    KOutMsg( "%s\n", r_ctx->s_col.buf );
+    vdfo_out( r_ctx, "%s\n", r_ctx->s_col.buf );
 }
 
 static rc_t vdfo_print_row_default( const p_row_context r_ctx )
 {
     rc_t rc = 0;
     if ( r_ctx->ctx->print_row_id )
-        rc = KOutMsg( "ROW-ID = %u\n", r_ctx->row_id );
+        rc = vdfo_out( r_ctx, "ROW-ID = %u\n", r_ctx->row_id );
 
     if ( rc == 0 )
         VectorForEach( &(r_ctx->col_defs->cols), false, vdfo_print_col_default, r_ctx );
@@ -97,7 +118,7 @@ static rc_t vdfo_print_row_default( const p_row_context r_ctx )
     {
         uint16_t i=0;
         while ( i++ < r_ctx->ctx->lf_after_row && rc == 0 )
-            rc = KOutMsg( "\n" );
+            rc = vdfo_out( r_ctx, "\n" );
     }
     return 0;
 }
@@ -137,13 +158,13 @@ static rc_t vdfo_print_row_csv( const p_row_context r_ctx )
     rc_t rc = vds_clear( &(r_ctx->s_col) );
     DISP_RC( rc, "dump_str_clear() failed" )
     if ( rc == 0 && r_ctx->ctx->print_row_id )
-        rc = KOutMsg( "%u", r_ctx->row_id );
+        rc = vdfo_out( r_ctx, "%u", r_ctx->row_id );
     
     if ( rc == 0 )
     {
         r_ctx->col_nr = 0;
         VectorForEach( &(r_ctx->col_defs->cols), false, vdfo_print_col_csv, r_ctx );
-        rc = KOutMsg( "%s\n", r_ctx->s_col.buf );
+        rc = vdfo_out( r_ctx, "%s\n", r_ctx->s_col.buf );
     }
     return rc;
 }
@@ -157,9 +178,9 @@ static void CC vdfo_print_col_xml( void *item, void *data )
     if ( my_col_def->valid == false ) return;
     if ( my_col_def->excluded == true ) return;
 
-    KOutMsg( " <%s>\n", my_col_def->name );
-    KOutMsg( "%s", my_col_def->content.buf );
-    KOutMsg( " </%s>\n", my_col_def->name );
+    vdfo_out( r_ctx, " <%s>\n", my_col_def->name );
+    vdfo_out( r_ctx, "%s", my_col_def->content.buf );
+    vdfo_out( r_ctx, " </%s>\n", my_col_def->name );
 }
 
 static rc_t vdfo_print_row_xml( const p_row_context r_ctx )
@@ -168,11 +189,11 @@ static rc_t vdfo_print_row_xml( const p_row_context r_ctx )
     DISP_RC( rc, "dump_str_clear() failed" )
     if ( rc == 0 )
     {
-        rc = KOutMsg( "<row>\n" );
+        rc = vdfo_out( r_ctx, "<row>\n" );
         if ( rc  == 0 )
         {
             VectorForEach( &(r_ctx->col_defs->cols), false, vdfo_print_col_xml, r_ctx );
-            rc = KOutMsg( "</row>\n");
+            rc = vdfo_out( r_ctx, "</row>\n");
         }
     }
     return rc;
@@ -211,7 +232,7 @@ static void CC vdfo_print_col_json( void *item, void *data )
     }
 
     if ( rc == 0 )
-        KOutMsg( ",\n\"%s\":%s", my_col_def->name, my_col_def->content.buf );
+        vdfo_out( r_ctx, ",\n\"%s\":%s", my_col_def->name, my_col_def->content.buf );
 }
 
 static rc_t vdfo_print_row_json( const p_row_context r_ctx )
@@ -220,14 +241,14 @@ static rc_t vdfo_print_row_json( const p_row_context r_ctx )
     DISP_RC( rc, "dump_str_clear() failed" )
     if ( rc == 0 )
     {
-        rc = KOutMsg( "{\n" );
+        rc = vdfo_out( r_ctx, "{\n" );
         if ( rc == 0 )
         {
-            rc = KOutMsg( "\"row_id\": %lu", r_ctx->row_id );
+            rc = vdfo_out( r_ctx, "\"row_id\": %lu", r_ctx->row_id );
             if ( rc == 0 )
             {
                 VectorForEach( &(r_ctx->col_defs->cols), false, vdfo_print_col_json, r_ctx );
-                rc = KOutMsg( "\n},\n\n" );
+                rc = vdfo_out( r_ctx, "\n},\n\n" );
             }
         }
     }
@@ -248,7 +269,7 @@ static void CC vdfo_print_col_piped( void *item, void *data )
     if ( my_col_def->excluded == true ) return;
 
     /* first we print the row_id and the column-name for every column! */
-    KOutMsg( "%lu, %s: ", r_ctx->row_id, my_col_def->name );
+    vdfo_out( r_ctx, "%lu, %s: ", r_ctx->row_id, my_col_def->name );
 
     if ( ( my_col_def->type_desc.domain == vtdAscii )||
          ( my_col_def->type_desc.domain == vtdUnicode ) )
@@ -271,7 +292,7 @@ static void CC vdfo_print_col_piped( void *item, void *data )
     }
 
     if ( rc == 0 )
-        KOutMsg( "%s\n", my_col_def->content.buf );
+        vdfo_out( r_ctx, "%s\n", my_col_def->content.buf );
 }
 
 
@@ -288,10 +309,10 @@ static void CC vdfo_print_col_sra_dump( void *item, void *data )
     if ( my_col_def->excluded == true ) return;
 
     /* first we print the row_id and the column-name for every column! */
-    KOutMsg( "%lu. %s: ", r_ctx->row_id, my_col_def->name );
+    vdfo_out( r_ctx, "%lu. %s: ", r_ctx->row_id, my_col_def->name );
 
     if ( rc == 0 )
-        KOutMsg( "%s\n", my_col_def->content.buf );
+        vdfo_out( r_ctx, "%s\n", my_col_def->content.buf );
 }
 
 
@@ -328,7 +349,7 @@ static rc_t vdfo_print_row_piped( const p_row_context r_ctx )
     if ( rc == 0 )
     {
         VectorForEach( &(r_ctx->col_defs->cols), false, vdfo_print_col_piped, r_ctx );
-        rc = KOutMsg( "\n" );
+        rc = vdfo_out( r_ctx, "\n" );
     }
     return rc;
 }
@@ -341,7 +362,7 @@ static rc_t vdfo_print_row_sra_dump( const p_row_context r_ctx )
     if ( rc == 0 )
     {
         VectorForEach( &(r_ctx->col_defs->cols), false, vdfo_print_col_sra_dump, r_ctx );
-        rc = KOutMsg( "\n" );
+        rc = vdfo_out( r_ctx, "\n" );
     }
     return rc;
 }
@@ -351,13 +372,13 @@ static rc_t vdfo_print_row_tab( const p_row_context r_ctx )
     rc_t rc = vds_clear( &(r_ctx->s_col) );
     DISP_RC( rc, "dump_str_clear() failed" )
     if ( rc == 0 && r_ctx->ctx->print_row_id )
-        rc = KOutMsg( "%u", r_ctx->row_id );
+        rc = vdfo_out( r_ctx, "%u", r_ctx->row_id );
     
     if ( rc == 0 )
     {
         r_ctx->col_nr = 0;
         VectorForEach( &(r_ctx->col_defs->cols), false, vdfo_print_col_tab, r_ctx );
-        rc = KOutMsg( "%s\n", r_ctx->s_col.buf );
+        rc = vdfo_out( r_ctx, "%s\n", r_ctx->s_col.buf );
     }
     return rc;
 }
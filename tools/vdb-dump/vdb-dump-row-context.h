@@ -44,6 +44,7 @@ extern "C" {
         - a pointer to the column-definitions (Vector of column-definition's)
         - a pointer to the dump-context ( parameters and options for cmd-line )
         - a dump-string (structure not pointer!) to be reused to assemble output
+        - a pointer to a dump-string collecting the output of a worker-thread
         - a Vector containing p_col_data - pointers
         - a return-type to stop if reading data failed ( neccessary to stop after
           last row if no row-range is given at command-line )
@@ -57,6 +58,7 @@ typedef struct row_context
     p_col_defs col_defs;
     p_dump_context ctx;
     dump_str s_col;
+    p_dump_str out;     /* NULL ... print, otherwise collect the output here */
     int64_t row_id;
     uint32_t col_nr;
     rc_t rc;
@@ -180,6 +180,34 @@ rc_t vds_append_fmt( p_dump_str s, const size_t aprox_len, const char *fmt, ...
 }
 
 
+char *vds_reserve( p_dump_str s, const size_t len )
+{
+    if ( vds_inc_buffer( s, len ) != 0 )
+        return NULL;
+    return s->buf + s->str_len;
+}
+
+
+rc_t vds_commit( p_dump_str s, const size_t len )
+{
+    rc_t rc = 0;
+    if ( len > 0 )
+    {
+        if ( ( s->str_limit > 0 )&&( s->str_len >= s->str_limit ) )
+        {
+            s->buf[ s->str_len ] = 0;
+            s->truncated = true;
+        }
+        else
+        {
+            s->buf[ s->str_len + len ] = 0;
+            rc = vds_truncate( s, len ); /* adjusts str_len */
+        }
+    }
+    return rc;
+}
+
+
 rc_t vds_append_str( p_dump_str s, const char *s1 )
 {
     rc_t rc = 0;
@@ -237,6 +265,37 @@ rc_t vds_append_str_no_limit_check( p_dump_str s, const char *s1 )
 }
 
 
+rc_t vds_append_vfmt_no_limit_check( p_dump_str s, const char *fmt, va_list args )
+{
+    rc_t rc;
+    size_t num_writ = 0;
+    va_list cpy;
+
+    if ( ( s == NULL )||( fmt == NULL ) )
+    {
+        return RC( rcVDB, rcNoTarg, rcInserting, rcParam, rcNull );
+    }
+
+    va_copy( cpy, args );
+    rc = string_vprintf( s->buf + s->str_len, s->buf_size - s->str_len, &num_writ, fmt, cpy );
+    va_end( cpy );
+    if ( rc != 0 && GetRCState( rc ) == rcInsufficient )
+    {
+        /* num_writ tells how much space is needed */
+        rc = vds_inc_buffer( s, num_writ );
+        if ( rc == 0 )
+        {
+            va_copy( cpy, args );
+            rc = string_vprintf( s->buf + s->str_len, s->buf_size - s->str_len, &num_writ, fmt, cpy );
+            va_end( cpy );
+        }
+    }
+    if ( rc == 0 )
+        s->str_len += num_writ;
+    return rc;
+}
+
+
 rc_t vds_rinsert( p_dump_str s, const char *s1 )
 {
     size_t len;
@@ -38,6 +38,8 @@ extern "C" {
 #include <klib/rc.h>
 #include <klib/namelist.h>
 
+#include <stdarg.h>
+
 typedef struct dump_str
 {
     char *buf;
@@ -76,6 +78,16 @@ rc_t vds_append_str( p_dump_str s, const char *s1 );
 /* appends the string, does not truncate */
 rc_t vds_append_str_no_limit_check( p_dump_str s, const char *s1 );
 
+/* makes room for len more characters at the end of the string,
+   returns where to write them or NULL if out of memory */
+char *vds_reserve( p_dump_str s, const size_t len );
+
+/* adds len characters written into the reserved space, truncates to the limit */
+rc_t vds_commit( p_dump_str s, const size_t len );
+
+/* appends the formated string with parameters, does not truncate */
+rc_t vds_append_vfmt_no_limit_check( p_dump_str s, const char *fmt, va_list args );
+
 /* right-inserts the string at the end of the ev. limited string */
 rc_t vds_rinsert( p_dump_str s, const char *s1 );
 
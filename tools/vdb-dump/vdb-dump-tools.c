@@ -529,6 +529,187 @@ rc_t vdt_dump_element( const p_dump_src src, const p_col_def def, bool bracket )
 }
 
 
+/*************************************************************************************
+    fast-path cell-formatters:
+    a whole cell is formatted into reserved space of the dump-string, instead of
+    element by element through "vdt_dump_element()". The formatter is selected once
+    per column by "vdt_select_cell_fmt()", it produces the same text as the
+    element-wise path.
+*************************************************************************************/
+static const char vdt_digit_pairs[ 201 ] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static char * vdt_fmt_uint64( char * dst, uint64_t value )
+{
+    char temp[ MAX_CHARS_FOR_DEC_UINT64 ];
+    char * p = temp + sizeof temp;
+    size_t len;
+
+    while ( value >= 100 )
+    {
+        const char * pair = vdt_digit_pairs + ( ( value % 100 ) << 1 );
+        value /= 100;
+        *(--p) = pair[ 1 ];
+        *(--p) = pair[ 0 ];
+    }
+    if ( value >= 10 )
+    {
+        const char * pair = vdt_digit_pairs + ( value << 1 );
+        *(--p) = pair[ 1 ];
+        *(--p) = pair[ 0 ];
+    }
+    else
+        *(--p) = (char)( '0' + value );
+
+    len = ( temp + sizeof temp ) - p;
+    memmove( dst, p, len );
+    return dst + len;
+}
+
+static char * vdt_fmt_int64( char * dst, int64_t value )
+{
+    if ( value < 0 )
+    {
+        *dst++ = '-';
+        return vdt_fmt_uint64( dst, 0 - (uint64_t)value );
+    }
+    return vdt_fmt_uint64( dst, (uint64_t)value );
+}
+
+/* stop formatting elements that would be cut away by the limit anyway */
+#define VDT_PAST_LIMIT( S, LEN ) ( ( (S)->str_limit > 0 )&&( (S)->str_len + (LEN) > (S)->str_limit ) )
+
+#define VDT_INT_CELL_FMT( NAME, C_TYPE, FMT_FKT, FMT_TYPE )                         \
+static rc_t NAME( p_dump_str s, const uint8_t *src,                                 \
+                  const uint32_t count, const char *sep )                           \
+{                                                                                   \
+    size_t sep_len = strlen( sep );                                                 \
+    char * dst = vds_reserve( s, count * ( MAX_CHARS_FOR_DEC_UINT64 + sep_len ) );  \
+    char * p = dst;                                                                 \
+    uint32_t i;                                                                     \
+    if ( dst == NULL )                                                              \
+        return RC( rcVDB, rcNoTarg, rcInserting, rcMemory, rcExhausted );           \
+    for ( i = 0; i < count && !VDT_PAST_LIMIT( s, p - dst ); ++i )                  \
+    {                                                                               \
+        C_TYPE value;                                                               \
+        if ( i > 0 )                                                                \
+        {                                                                           \
+            memmove( p, sep, sep_len );                                             \
+            p += sep_len;                                                           \
+        }                                                                           \
+        memmove( &value, src + i * sizeof value, sizeof value );                    \
+        p = FMT_FKT( p, (FMT_TYPE)value );                                          \
+    }                                                                               \
+    return vds_commit( s, p - dst );                                                \
+}
+
+VDT_INT_CELL_FMT( vdt_fmt_u8_cell,  uint8_t,  vdt_fmt_uint64, uint64_t )
+VDT_INT_CELL_FMT( vdt_fmt_u16_cell, uint16_t, vdt_fmt_uint64, uint64_t )
+VDT_INT_CELL_FMT( vdt_fmt_u32_cell, uint32_t, vdt_fmt_uint64, uint64_t )
+VDT_INT_CELL_FMT( vdt_fmt_u64_cell, uint64_t, vdt_fmt_uint64, uint64_t )
+VDT_INT_CELL_FMT( vdt_fmt_i8_cell,  int8_t,   vdt_fmt_int64,  int64_t )
+VDT_INT_CELL_FMT( vdt_fmt_i16_cell, int16_t,  vdt_fmt_int64,  int64_t )
+VDT_INT_CELL_FMT( vdt_fmt_i32_cell, int32_t,  vdt_fmt_int64,  int64_t )
+VDT_INT_CELL_FMT( vdt_fmt_i64_cell, int64_t,  vdt_fmt_int64,  int64_t )
+
+/* text: one copy, stops at the first 0-byte like "%.*s" does */
+static rc_t vdt_fmt_text_cell( p_dump_str s, const uint8_t *src,
+                               const uint32_t count, const char *sep )
+{
+    const uint8_t * end = memchr( src, 0, count );
+    size_t len = ( end == NULL ) ? count : (size_t)( end - src );
+    char * dst = vds_reserve( s, len );
+    if ( dst == NULL )
+        return RC( rcVDB, rcNoTarg, rcInserting, rcMemory, rcExhausted );
+    memmove( dst, src, len );
+    return vds_commit( s, len );
+}
+
+/* dim=2,bits=1 printed as dna-bases: 2 bases per nibble through a lookup-table */
+static const char vdt_2na_nibble[ 33 ] = "AAACAGATCACCCGCTGAGCGGGTTATCTGTT";
+
+static rc_t vdt_fmt_2na_cell( p_dump_str s, const uint8_t *src,
+                              const uint32_t count, const char *sep )
+{
+    char * dst = vds_reserve( s, count + 4 );
+    uint32_t full = count >> 2;
+    uint32_t i;
+    if ( dst == NULL )
+        return RC( rcVDB, rcNoTarg, rcInserting, rcMemory, rcExhausted );
+    for ( i = 0; i <= full; ++i )
+    {
+        /* the last byte may be partial, the surplus bases are cut away by commit */
+        if ( i < full || ( count & 3 ) != 0 )
+        {
+            memmove( dst + ( i << 2 ), vdt_2na_nibble + ( ( src[ i ] >> 4 ) << 1 ), 2 );
+            memmove( dst + ( i << 2 ) + 2, vdt_2na_nibble + ( ( src[ i ] & 0x0F ) << 1 ), 2 );
+        }
+    }
+    return vds_commit( s, count );
+}
+
+/*************************************************************************************
+def         [IN] ... the definition of the column to be dumped
+in_hex, without_sra_types, print_dna_bases [IN] ... the flags of the dump-context
+
+selects a fast-path cell-formatter for the column, or NULL if the column has to
+be dumped element by element
+*************************************************************************************/
+void vdt_select_cell_fmt( p_col_def def, bool in_hex, bool without_sra_types,
+                          bool print_dna_bases )
+{
+    uint32_t bits, dim;
+
+    if ( def == NULL )
+        return;
+    def->cell_fmt_fct = NULL;
+    if ( in_hex )
+        return;
+
+    bits = def->type_desc.intrinsic_bits;
+    dim  = def->type_desc.intrinsic_dim;
+
+    if ( dim == 2 && bits == 1 && print_dna_bases )
+    {
+        def->cell_fmt_fct = vdt_fmt_2na_cell;
+        return;
+    }
+
+    switch ( def->type_desc.domain )
+    {
+        case vtdUint :
+        case vtdInt  :
+            if ( dim == 1 && ( without_sra_types || def->value_trans_fct == NULL ) )
+            {
+                bool is_signed = ( def->type_desc.domain == vtdInt );
+                switch ( bits )
+                {
+                    case  8 : def->cell_fmt_fct = is_signed ? vdt_fmt_i8_cell  : vdt_fmt_u8_cell;  break;
+                    case 16 : def->cell_fmt_fct = is_signed ? vdt_fmt_i16_cell : vdt_fmt_u16_cell; break;
+                    case 32 : def->cell_fmt_fct = is_signed ? vdt_fmt_i32_cell : vdt_fmt_u32_cell; break;
+                    case 64 : def->cell_fmt_fct = is_signed ? vdt_fmt_i64_cell : vdt_fmt_u64_cell; break;
+                }
+            }
+            break;
+
+        case vtdAscii   :
+        case vtdUnicode :
+            if ( dim == 1 && bits == 8 )
+                def->cell_fmt_fct = vdt_fmt_text_cell;
+            break;
+    }
+}
+
+
 void vdm_clear_recorded_errors( void )
 {
     rc_t rc;
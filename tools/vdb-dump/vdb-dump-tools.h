@@ -53,6 +53,9 @@ typedef dump_src* p_dump_src;
 
 rc_t vdt_dump_element( const p_dump_src src, const p_col_def def, bool bracket );
 
+void vdt_select_cell_fmt( p_col_def def, bool in_hex, bool without_sra_types,
+                          bool print_dna_bases );
+
 void vdm_clear_recorded_errors( void );
 
 rc_t check_table_empty( const VTable * tab );
@@ -58,6 +58,10 @@
 #include <klib/time.h>
 #include <klib/num-gen.h>
 
+#include <kproc/thread.h>
+#include <kproc/lock.h>
+#include <kproc/cond.h>
+
 #include <os-native.h>
 #include <sysalloc.h>
 
@@ -73,6 +77,7 @@
 #include "vdb-dump-fastq.h"
 #include "vdb-dump-redir.h"
 #include "vdb-dump-bin.h"
+#include "vdb-dump-arrow.h"
 #include "vdb-dump-interact.h"
 #include "vdb_info.h"
 
@@ -109,6 +114,7 @@ static const char * objtype_usage[]             = { "report type of object",
 static const char * idx_enum_usage[]            = { "enumerate all available index",                NULL };
 static const char * idx_range_usage[]           = { "enumerate values and row-ranges of one index", NULL };
 static const char * cur_cache_usage[]           = { "size of cursor cache",                         NULL };
+static const char * threads_usage[]             = { "dump rows with this many threads",             NULL };
 static const char * out_file_usage[]            = { "write output to this file",                    NULL };
 static const char * out_path_usage[]            = { "write output to this directory",               NULL };
 static const char * gzip_usage[]                = { "compress output using gzip",                   NULL };
@@ -162,6 +168,7 @@ OptDef DumpOptions[] =
     { OPTION_IDX_ENUM,              NULL,                     NULL, idx_enum_usage,          1, false,  false },
     { OPTION_IDX_RANGE,             NULL,                     NULL, idx_range_usage,         1, true,   false },
     { OPTION_CUR_CACHE,             NULL,                     NULL, cur_cache_usage,         1, true,   false },
+    { OPTION_THREADS,               ALIAS_THREADS,            NULL, threads_usage,           1, true,   false },
     { OPTION_OUT_FILE,              NULL,                     NULL, out_file_usage,          1, true,   false },
     { OPTION_OUT_PATH,              NULL,                     NULL, out_path_usage,          1, true,   false },
     { OPTION_PHASE,                 NULL,                     NULL, NULL,                   1, true,   false },
@@ -239,7 +246,8 @@ rc_t CC Usage ( const Args * args )
     KOutMsg( "      fasta1 .. one FASTA-record for the whole accession (REFSEQ)\n" );
     KOutMsg( "      fasta2 .. one FASTA-record for each REFERENCE in cSRA\n" );
     KOutMsg( "      qual .... QUAL( 2 lines ) for each row\n" );    
-    KOutMsg( "      qual1 ... QUAL( 2 lines ) for each fragment if possible\n\n" );
+    KOutMsg( "      qual1 ... QUAL( 2 lines ) for each fragment if possible\n" );
+    KOutMsg( "      arrow ... Arrow IPC stream, record-batches of the selected columns\n\n" );
     
     HelpOptionLine ( ALIAS_ID_RANGE,            OPTION_ID_RANGE,        NULL,           id_range_usage );
     HelpOptionLine ( ALIAS_WITHOUT_SRA,         OPTION_WITHOUT_SRA,     NULL,           without_sra_usage );
@@ -256,6 +264,7 @@ rc_t CC Usage ( const Args * args )
     HelpOptionLine ( NULL,                      OPTION_IDX_ENUM,        NULL,           idx_enum_usage );    
     HelpOptionLine ( NULL,                      OPTION_IDX_RANGE,       NULL,           idx_range_usage );    
     HelpOptionLine ( NULL,                      OPTION_CUR_CACHE,       NULL,           cur_cache_usage );    
+    HelpOptionLine ( ALIAS_THREADS,             OPTION_THREADS,         "threads",      threads_usage );
     HelpOptionLine ( NULL,                      OPTION_OUT_FILE,        NULL,           out_file_usage );
     HelpOptionLine ( NULL,                      OPTION_OUT_PATH,        NULL,           out_path_usage );
     HelpOptionLine ( NULL,                      OPTION_GZIP,            NULL,           gzip_usage );
@@ -370,6 +379,13 @@ static void CC vdm_read_cell_data( void *item, void *data )
         {
             my_col_def->elementsum += src.number_of_elements;
         }
+        else if ( my_col_def->cell_fmt_fct != NULL && ( src.offset_in_bits & 7 ) == 0 )
+        {
+            /* the whole cell at once, selected by "select_cell_fmt()" in vdb-dump-tools.c */
+            r_ctx->rc = my_col_def->cell_fmt_fct( &(my_col_def->content),
+                            (const uint8_t *)src.buf + ( src.offset_in_bits >> 3 ),
+                            src.number_of_elements, sra_dump_format ? "," : ", " );
+        }
         else
         {
             /* loop through the elements(dimension's) of a cell */
@@ -427,17 +443,69 @@ static void vdm_row_error( const char * fmt, rc_t rc, uint64_t row_id )
 
 }
 
+/*************************************************************************************
+    dump_one_row:
+    * dumps the row r_ctx->row_id, used by "dump_rows()" and by the worker-threads
+      of "dump_rows_parallel()"
+    * set the row-id into the cursor and open the cursor-row
+    * loop throuh the columns
+    * close the row
+    * call print_row (vdb-dump-formats.c) which actually prints the row
+
+r_ctx   [IN] ... row-context ( cursor, dump_context, col_defs ... )
+*************************************************************************************/
+static rc_t vdm_dump_one_row( p_row_context r_ctx )
+{
+    r_ctx->rc = VCursorSetRowId( r_ctx->cursor, r_ctx->row_id );
+    if ( r_ctx->rc != 0 )
+    {
+        vdm_row_error( "VCursorSetRowId( row#$(row_nr) ) failed", 
+                       r_ctx->rc, r_ctx->row_id );
+    }
+    else
+    {
+        r_ctx->rc = VCursorOpenRow( r_ctx->cursor );
+        if ( r_ctx->rc != 0 )
+        {
+            vdm_row_error( "VCursorOpenRow( row#$(row_nr) ) failed", 
+                           r_ctx->rc, r_ctx->row_id );
+        }
+        else
+        {
+            /* first reset the string and valid-flag for every column */
+            vdcd_reset_content( r_ctx->col_defs );
+
+            /* read the data of every column and create a string for it */
+            VectorForEach( &(r_ctx->col_defs->cols),
+                           false, vdm_read_cell_data, r_ctx );
+
+            if ( r_ctx->rc == 0 )
+            {
+                /* prints the collected strings, in vdb-dump-formats.c */
+                if ( !r_ctx->ctx->sum_num_elem )
+                {
+                    r_ctx->rc = vdfo_print_row( r_ctx );
+                    if ( r_ctx->rc != 0 )
+                        vdm_row_error( "vdfo_print_row( row#$(row_nr) ) failed", 
+                               r_ctx->rc, r_ctx->row_id );
+                }
+            }
+            r_ctx->rc = VCursorCloseRow( r_ctx->cursor );
+            if ( r_ctx->rc != 0 )
+                vdm_row_error( "VCursorCloseRow( row#$(row_nr) ) failed", 
+                               r_ctx->rc, r_ctx->row_id );
+        }
+    }
+    return r_ctx->rc;
+}
+
 /*************************************************************************************
     dump_rows:
     * is the main loop to dump all rows or all selected rows ( -R1-10 )
     * creates a dump-string ( parameterizes it with the wanted max. line-len )
     * starts the number-generator
     * as long as the number-generator has a number and the result-code is ok
-      do for every row-id:
-        - set the row-id into the cursor and open the cursor-row
-        - loop throuh the columns
-        - close the row
-        - call print_row (vdb-dump-formats.c) which actually prints the row
+      call "dump_one_row()" for every row-id
     * the collection of the text's for the columns "read_cell_data_and_dump()"
       is separated from the actual printing "print_row()" !
 
@@ -445,6 +513,7 @@ r_ctx   [IN] ... row-context ( cursor, dump_context, col_defs ... )
 *************************************************************************************/
 static rc_t vdm_dump_rows( p_row_context r_ctx )
 {
+    r_ctx->out = NULL;
     /* the important row_id is a member of r_ctx ! */
     r_ctx->rc = vds_make( &(r_ctx->s_col), r_ctx->ctx->max_line_len, 512 );
     if ( r_ctx->rc != 0 )
@@ -464,46 +533,7 @@ static rc_t vdm_dump_rows( p_row_context r_ctx )
                     r_ctx-> rc = Quitting();
                 if ( r_ctx->rc != 0 )
                     break;
-                r_ctx->rc = VCursorSetRowId( r_ctx->cursor, r_ctx->row_id );
-                if ( r_ctx->rc != 0 )
-                {
-                    vdm_row_error( "VCursorSetRowId( row#$(row_nr) ) failed", 
-                                   r_ctx->rc, r_ctx->row_id );
-                }
-                else
-                {
-                    r_ctx->rc = VCursorOpenRow( r_ctx->cursor );
-                    if ( r_ctx->rc != 0 )
-                    {
-                        vdm_row_error( "VCursorOpenRow( row#$(row_nr) ) failed", 
-                                       r_ctx->rc, r_ctx->row_id );
-                    }
-                    else
-                    {
-                        /* first reset the string and valid-flag for every column */
-                        vdcd_reset_content( r_ctx->col_defs );
-
-                        /* read the data of every column and create a string for it */
-                        VectorForEach( &(r_ctx->col_defs->cols),
-                                       false, vdm_read_cell_data, r_ctx );
-
-                        if ( r_ctx->rc == 0 )
-                        {
-                            /* prints the collected strings, in vdb-dump-formats.c */
-                            if ( !r_ctx->ctx->sum_num_elem )
-                            {
-                                r_ctx->rc = vdfo_print_row( r_ctx );
-                                if ( r_ctx->rc != 0 )
-                                    vdm_row_error( "vdfo_print_row( row#$(row_nr) ) failed", 
-                                           r_ctx->rc, r_ctx->row_id );
-                            }
-                        }
-                        r_ctx->rc = VCursorCloseRow( r_ctx->cursor );
-                        if ( r_ctx->rc != 0 )
-                            vdm_row_error( "VCursorCloseRow( row#$(row_nr) ) failed", 
-                                           r_ctx->rc, r_ctx->row_id );
-                    }
-                }
+                vdm_dump_one_row( r_ctx );
             }
         }
         num_gen_iterator_destroy( iter );
@@ -611,8 +641,7 @@ static bool vdm_extract_or_parse_static_columns( const p_dump_context ctx,
 }
 
 /*************************************************************************************
-    dump_tab_table:
-    * called by "dump_db_table()" and "dump_tab()" as a fkt-pointer
+    open_row_context:
     * opens a cursor to read
     * checks if the user did not specify columns, or wants all columns ( "*" )
         no columns specified ---> calls "col_defs_extract_from_table()"
@@ -620,107 +649,454 @@ static bool vdm_extract_or_parse_static_columns( const p_dump_context ctx,
     * we end up with a list of column-definitions (name,type) in my_col_defs
     * calls "col_defs_add_to_cursor()" to add them to the cursor
     * opens the cursor
-    * calls "dump_rows()" to execute the dump
-    * destroys the my_col_defs - structure
-    * releases the cursor
+    * has to be followed by "close_row_context()", even if it fails
 
 ctx       [IN] ... contains path, tablename, columns, row-range etc.
 my_table  [IN] ... open table needed for vdb-calls
+r_ctx    [OUT] ... row-context with open cursor and column-definitions
 *************************************************************************************/
-static rc_t vdm_dump_opened_table( const p_dump_context ctx, const VTable *my_table )
+static rc_t vdm_open_row_context( const p_dump_context ctx, const VTable *my_table,
+                                  p_row_context r_ctx )
 {
     rc_t rc;
 
-    if ( ctx->format == df_bin )
+    memset( r_ctx, 0, sizeof *r_ctx );
+    r_ctx->ctx = ctx;
+    r_ctx->table = my_table;
+
+    rc = VTableCreateCachedCursorRead( my_table, &(r_ctx->cursor), ctx->cur_cache_size );
+    DISP_RC( rc, "VTableCreateCursorRead() failed" );
+    if ( rc == 0 )
     {
-        rc = vdi_dump_opened_table( ctx, my_table ); /* from vdb-dump-bin.c */
+        if ( !vdcd_init( &(r_ctx->col_defs), ctx->max_line_len ) )
+        {
+            r_ctx->col_defs = NULL;
+            rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+            DISP_RC( rc, "col_defs_init() failed" );
+        }
+
+        if ( rc == 0 )
+        {
+            uint32_t n = vdm_extract_or_parse_columns( ctx, my_table, r_ctx->col_defs );
+            if ( n < 1 )
+                rc = RC( rcVDB, rcNoTarg, rcConstructing, rcParam, rcInvalid );
+            else
+            {
+                n = vdcd_add_to_cursor( r_ctx->col_defs, r_ctx->cursor );
+                if ( n < 1 )
+                    rc = RC( rcVDB, rcNoTarg, rcConstructing, rcParam, rcInvalid );
+                else
+                {
+                    const VSchema *my_schema;
+                    rc = VTableOpenSchema( my_table, &my_schema );
+                    DISP_RC( rc, "VTableOpenSchema() failed" );
+                    if ( rc == 0 )
+                    {
+                        /* translate in special columns to numeric values to strings */
+                        vdcd_ins_trans_fkt( r_ctx->col_defs, my_schema );
+                        VSchemaRelease( my_schema );
+                    }
+
+                    rc = VCursorOpen( r_ctx->cursor );
+                    DISP_RC( rc, "VCursorOpen() failed" );
+                    if ( rc == 0 )
+                    {
+                        /* choose the cell-formatter once per column */
+                        uint32_t idx, len = VectorLength( &( r_ctx->col_defs->cols ) );
+                        for ( idx = 0; idx < len; ++idx )
+                        {
+                            p_col_def def = VectorGet( &( r_ctx->col_defs->cols ), idx );
+                            if ( def != NULL )
+                                vdt_select_cell_fmt( def, ctx->print_in_hex, ctx->without_sra_types,
+                                    ctx->print_dna_bases &&
+                                    def->type_desc.intrinsic_dim == 2 &&
+                                    def->type_desc.intrinsic_bits == 1 );
+                        }
+                    }
+                }
+            }
+        }
     }
+    return rc;
+}
+
+
+static void vdm_close_row_context( p_row_context r_ctx )
+{
+    if ( r_ctx->col_defs != NULL )
+    {
+        vdcd_destroy( r_ctx->col_defs );
+        r_ctx->col_defs = NULL;
+    }
+    if ( r_ctx->cursor != NULL )
+    {
+        VCursorRelease( r_ctx->cursor );
+        r_ctx->cursor = NULL;
+    }
+}
+
+
+/*************************************************************************************
+    dump_rows_parallel:
+    * the rows are cut into blocks of VDM_ROWS_PER_BLOCK row-ids
+    * every block is dumped by a worker-thread with its own cursor
+      into a dump-string ( row_context.out )
+    * the main-thread prints the blocks in the order of the row-ids, so the output
+      is identical to "dump_rows()"
+    * the number of blocks in flight is limited to keep the memory bounded
+*************************************************************************************/
+#define VDM_ROWS_PER_BLOCK 4096
+
+typedef struct vdm_block
+{
+    struct vdm_block * next_todo;
+    struct vdm_block * next_out;
+    int64_t row_ids[ VDM_ROWS_PER_BLOCK ];
+    uint32_t count;
+    dump_str out;
+    rc_t rc;
+    bool done;
+} vdm_block;
+
+typedef struct vdm_par_ctx
+{
+    p_dump_context ctx;
+    const VTable * table;
+
+    KLock * lock;
+    KCondition * cond;
+
+    vdm_block * todo_head;  /* waiting for a worker */
+    vdm_block * todo_tail;
+    vdm_block * out_head;   /* all blocks in flight, in order of row-ids */
+    vdm_block * out_tail;
+
+    uint32_t in_flight;
+    bool quitting;
+} vdm_par_ctx;
+
+
+static void vdm_block_release( vdm_block * block )
+{
+    vds_free( &( block->out ) );
+    free( block );
+}
+
+
+static rc_t vdm_block_make( vdm_block ** block )
+{
+    rc_t rc = 0;
+    vdm_block * b = calloc( 1, sizeof *b );
+    if ( b == NULL )
+        rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
     else
     {
-        row_context r_ctx;
+        rc = vds_make( &( b->out ), 0, 64 * 1024 );
+        if ( rc != 0 )
+        {
+            free( b );
+            b = NULL;
+        }
+    }
+    *block = b;
+    return rc;
+}
 
-        rc = VTableCreateCachedCursorRead( my_table, &(r_ctx.cursor), ctx->cur_cache_size );
-        DISP_RC( rc, "VTableCreateCursorRead() failed" );
+
+static rc_t CC vdm_par_worker( const KThread *self, void *data )
+{
+    vdm_par_ctx * p = data;
+    row_context r_ctx;
+
+    rc_t rc = vdm_open_row_context( p->ctx, p->table, &r_ctx );
+    if ( rc == 0 )
+    {
+        rc = vds_make( &( r_ctx.s_col ), p->ctx->max_line_len, 512 );
+        if ( rc != 0 )
+            r_ctx.s_col.buf = NULL;
+    }
+
+    KLockAcquire( p->lock );
+    while ( true )
+    {
+        vdm_block * block;
+
+        while ( p->todo_head == NULL && !p->quitting )
+            KConditionWait( p->cond, p->lock );
+
+        block = p->todo_head;
+        if ( block == NULL )
+            break;
+        p->todo_head = block->next_todo;
+        if ( p->todo_head == NULL )
+            p->todo_tail = NULL;
+        KLockUnlock( p->lock );
+
+        block->rc = rc;
         if ( rc == 0 )
         {
-            r_ctx.table = my_table;
-            if ( !vdcd_init( &(r_ctx.col_defs), ctx->max_line_len ) )
+            uint32_t i;
+            r_ctx.out = &( block->out );
+            r_ctx.rc = 0;
+            for ( i = 0; i < block->count && r_ctx.rc == 0; ++i )
             {
-                rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
-                DISP_RC( rc, "col_defs_init() failed" );
+                r_ctx.rc = Quitting();
+                if ( r_ctx.rc == 0 )
+                {
+                    r_ctx.row_id = block->row_ids[ i ];
+                    vdm_dump_one_row( &r_ctx );
+                }
             }
+            block->rc = r_ctx.rc;
+            r_ctx.out = NULL;
+        }
+
+        KLockAcquire( p->lock );
+        block->done = true;
+        KConditionBroadcast( p->cond );
+    }
+    KLockUnlock( p->lock );
+
+    if ( r_ctx.s_col.buf != NULL )
+        vds_free( &( r_ctx.s_col ) );
+    vdm_close_row_context( &r_ctx );
+    return rc;
+}
+
+
+/* prints finished blocks in order, waits until no more than "limit" blocks are
+   in flight, stops printing after the first error but keeps draining */
+static rc_t vdm_par_flush( vdm_par_ctx * p, uint32_t limit, rc_t rc )
+{
+    KLockAcquire( p->lock );
+    while ( p->in_flight > limit )
+    {
+        vdm_block * block = p->out_head;
+        if ( block != NULL && block->done )
+        {
+            p->out_head = block->next_out;
+            if ( p->out_head == NULL )
+                p->out_tail = NULL;
+            p->in_flight--;
+            KLockUnlock( p->lock );
 
             if ( rc == 0 )
             {
-                uint32_t n = vdm_extract_or_parse_columns( ctx, my_table, r_ctx.col_defs );
-                if ( n < 1 )
-                    rc = RC( rcVDB, rcNoTarg, rcConstructing, rcParam, rcInvalid );
-                else
+                /* what was dumped before an error is printed, as in "dump_rows()" */
+                if ( block->out.str_len > 0 )
+                    rc = KOutMsg( "%s", block->out.buf );
+                if ( rc == 0 )
+                    rc = block->rc;
+            }
+            vdm_block_release( block );
+
+            KLockAcquire( p->lock );
+        }
+        else
+            KConditionWait( p->cond, p->lock );
+    }
+    KLockUnlock( p->lock );
+    return rc;
+}
+
+
+static rc_t vdm_par_submit( vdm_par_ctx * p, vdm_block * block )
+{
+    KLockAcquire( p->lock );
+    block->next_todo = NULL;
+    block->next_out = NULL;
+    if ( p->todo_tail == NULL )
+        p->todo_head = block;
+    else
+        p->todo_tail->next_todo = block;
+    p->todo_tail = block;
+    if ( p->out_tail == NULL )
+        p->out_head = block;
+    else
+        p->out_tail->next_out = block;
+    p->out_tail = block;
+    p->in_flight++;
+    KConditionBroadcast( p->cond );
+    KLockUnlock( p->lock );
+    return 0;
+}
+
+
+static rc_t vdm_dump_rows_parallel( const p_dump_context ctx, const VTable *my_table )
+{
+    vdm_par_ctx p;
+    KThread ** threads;
+    uint32_t num_threads = 0;
+    rc_t rc, rc2;
+
+    memset( &p, 0, sizeof p );
+    p.ctx = ctx;
+    p.table = my_table;
+
+    threads = calloc( ctx->threads, sizeof *threads );
+    if ( threads == NULL )
+        return RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+
+    rc = KLockMake( &p.lock );
+    DISP_RC( rc, "KLockMake() failed" );
+    if ( rc == 0 )
+    {
+        rc = KConditionMake( &p.cond );
+        DISP_RC( rc, "KConditionMake() failed" );
+    }
+    while ( rc == 0 && num_threads < ctx->threads )
+    {
+        rc = KThreadMake( &threads[ num_threads ], vdm_par_worker, &p );
+        DISP_RC( rc, "KThreadMake() failed" );
+        if ( rc == 0 )
+            num_threads++;
+    }
+
+    if ( rc == 0 )
+    {
+        const struct num_gen_iter * iter;
+        rc = num_gen_iterator_make( ctx->rows, &iter );
+        DISP_RC( rc, "num_gen_iterator_make() failed" );
+        if ( rc == 0 )
+        {
+            vdm_block * block = NULL;
+            int64_t row_id;
+            rc_t rc_iter = 0;
+
+            while ( rc == 0 && num_gen_iterator_next( iter, &row_id, &rc_iter ) && rc_iter == 0 )
+            {
+                if ( block == NULL )
+                    rc = vdm_block_make( &block );
+                if ( rc == 0 )
                 {
-                    n = vdcd_add_to_cursor( r_ctx.col_defs, r_ctx.cursor );
-                    if ( n < 1 )
-                        rc = RC( rcVDB, rcNoTarg, rcConstructing, rcParam, rcInvalid );
-                    else
+                    block->row_ids[ block->count++ ] = row_id;
+                    if ( block->count == VDM_ROWS_PER_BLOCK )
                     {
-                        const VSchema *my_schema;
-                        rc = VTableOpenSchema( my_table, &my_schema );
-                        DISP_RC( rc, "VTableOpenSchema() failed" );
+                        /* keep 2 blocks per thread in flight */
+                        rc = vdm_par_flush( &p, 2 * num_threads - 1, rc );
                         if ( rc == 0 )
-                        {
-                            /* translate in special columns to numeric values to strings */
-                            vdcd_ins_trans_fkt( r_ctx.col_defs, my_schema );
-                            VSchemaRelease( my_schema );
-                        }
+                            vdm_par_submit( &p, block );
+                        else
+                            vdm_block_release( block );
+                        block = NULL;
+                    }
+                }
+            }
+            if ( rc == 0 )
+                rc = rc_iter;
+            if ( block != NULL )
+            {
+                if ( rc == 0 )
+                    vdm_par_submit( &p, block );
+                else
+                    vdm_block_release( block );
+            }
+            num_gen_iterator_destroy( iter );
+        }
+    }
 
-                        rc = VCursorOpen( r_ctx.cursor );
-                        DISP_RC( rc, "VCursorOpen() failed" );
-                        if ( rc == 0 )
-                        {
-                            int64_t  first;
-                            uint64_t count;
-                            rc = VCursorIdRange( r_ctx.cursor, 0, &first, &count );
-                            DISP_RC( rc, "VCursorIdRange() failed" );
-                            if ( rc == 0 )
-                            {
-                                if ( ctx->rows == NULL )
-                                {
-                                    /* if the user did not specify a row-range, take all rows */
-                                    rc = num_gen_make_from_range( &ctx->rows, first, count );
-                                    DISP_RC( rc, "num_gen_make_from_range() failed" );
-                                }
-                                else
-                                {
-                                    /* if the user did specify a row-range, check the boundaries */
-                                    if ( count > 0 )
-                                    {
-                                        /* trim only if the row-range is not zero, otherwise
-                                           we will not get data if the user specified only static columns
-                                           because they report a row-range of zero! */
-                                        rc = num_gen_trim( ctx->rows, first, count );
-                                        DISP_RC( rc, "num_gen_trim() failed" );
-                                    }
-                                }
+    /* print the rest, and wait for the workers */
+    if ( p.lock != NULL )
+    {
+        rc = vdm_par_flush( &p, 0, rc );
 
-                                if ( rc == 0 )
-                                {
-                                    if ( num_gen_empty( ctx->rows ) )
-                                    {
-                                        rc = RC( rcExe, rcDatabase, rcReading, rcRange, rcEmpty );
-                                    }
-                                    else
-                                    {
-                                        r_ctx.ctx = ctx;
-                                        rc = vdm_dump_rows( &r_ctx ); /* <--- */
-                                    }
-                                }
-                            }
-                        }
+        KLockAcquire( p.lock );
+        p.quitting = true;
+        KConditionBroadcast( p.cond );
+        KLockUnlock( p.lock );
+    }
+
+    while ( num_threads > 0 )
+    {
+        rc_t rc_thread = 0;
+        num_threads--;
+        rc2 = KThreadWait( threads[ num_threads ], &rc_thread );
+        if ( rc == 0 )
+            rc = ( rc2 != 0 ) ? rc2 : rc_thread;
+        KThreadRelease( threads[ num_threads ] );
+    }
+
+    KConditionRelease( p.cond );
+    KLockRelease( p.lock );
+    free( threads );
+    return rc;
+}
+
+
+/*************************************************************************************
+    dump_tab_table:
+    * called by "dump_db_table()" and "dump_tab()" as a fkt-pointer
+    * calls "open_row_context()" to open a cursor with the requested columns
+    * calls "dump_rows()" to execute the dump, or "dump_rows_parallel()" if more
+      than one thread is requested
+    * calls "close_row_context()" to destroy the column-definitions and release
+      the cursor
+
+ctx       [IN] ... contains path, tablename, columns, row-range etc.
+my_table  [IN] ... open table needed for vdb-calls
+*************************************************************************************/
+static rc_t vdm_dump_opened_table( const p_dump_context ctx, const VTable *my_table )
+{
+    rc_t rc;
+
+    if ( ctx->format == df_bin )
+    {
+        rc = vdi_dump_opened_table( ctx, my_table ); /* from vdb-dump-bin.c */
+    }
+    else
+    {
+        row_context r_ctx;
+
+        rc = vdm_open_row_context( ctx, my_table, &r_ctx );
+        if ( rc == 0 )
+        {
+            int64_t  first;
+            uint64_t count;
+            rc = VCursorIdRange( r_ctx.cursor, 0, &first, &count );
+            DISP_RC( rc, "VCursorIdRange() failed" );
+            if ( rc == 0 )
+            {
+                if ( ctx->rows == NULL )
+                {
+                    /* if the user did not specify a row-range, take all rows */
+                    rc = num_gen_make_from_range( &ctx->rows, first, count );
+                    DISP_RC( rc, "num_gen_make_from_range() failed" );
+                }
+                else
+                {
+                    /* if the user did specify a row-range, check the boundaries */
+                    if ( count > 0 )
+                    {
+                        /* trim only if the row-range is not zero, otherwise
+                           we will not get data if the user specified only static columns
+                           because they report a row-range of zero! */
+                        rc = num_gen_trim( ctx->rows, first, count );
+                        DISP_RC( rc, "num_gen_trim() failed" );
+                    }
+                }
+
+                if ( rc == 0 )
+                {
+                    if ( num_gen_empty( ctx->rows ) )
+                    {
+                        rc = RC( rcExe, rcDatabase, rcReading, rcRange, rcEmpty );
+                    }
+                    else if ( ctx->format == df_arrow )
+                    {
+                        rc = vda_dump_rows( ctx, my_table, r_ctx.cursor, r_ctx.col_defs ); /* vdb-dump-arrow.c */
+                    }
+                    else if ( ctx->threads > 1 && !ctx->sum_num_elem )
+                    {
+                        rc = vdm_dump_rows_parallel( ctx, my_table ); /* <--- */
+                    }
+                    else
+                    {
+                        rc = vdm_dump_rows( &r_ctx ); /* <--- */
                     }
                 }
-                vdcd_destroy( r_ctx.col_defs );
             }
-            VCursorRelease( r_ctx.cursor );
         }
+        vdm_close_row_context( &r_ctx );
     }
     return rc;
 }
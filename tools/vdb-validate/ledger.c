@@ -0,0 +1,547 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+
+#include "ledger.h"
+
+#include <kapp/main.h> /* KAppVersion */
+
+#include <kfs/directory.h>
+#include <kfs/file.h>
+
+#include <klib/checksum.h> /* MD5State */
+#include <klib/log.h>
+#include <klib/namelist.h>
+#include <klib/printf.h>
+#include <klib/rc.h>
+#include <klib/text.h>
+#include <klib/time.h>
+
+#include <sysalloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LEDGER_HEADER "# vdb-validate ledger 2\n"
+
+typedef struct ledger_entry_t {
+    char *key;
+    uint8_t digest [ LEDGER_DIGEST_SIZE ];
+    uint32_t checks;
+    uint32_t params;
+    char version [ 32 ];
+} ledger_entry_t;
+
+struct ledger_t {
+    KDirectory *wd;
+    char *path;
+    ledger_entry_t *entry; /* sorted by key */
+    size_t count;
+    size_t alloc;
+    char version [ 32 ];
+    bool changed;
+};
+
+static
+int CC entry_cmp ( const void *a, const void *b )
+{
+    return strcmp ( ( ( const ledger_entry_t* ) a ) -> key,
+                    ( ( const ledger_entry_t* ) b ) -> key );
+}
+
+/* index of the entry with 'key' or where it belongs */
+static
+size_t ledger_find ( const ledger_t *self, const char *key, bool *found )
+{
+    size_t lo = 0, hi = self -> count;
+
+    * found = false;
+    while ( lo < hi )
+    {
+        size_t const mid = lo + ( hi - lo ) / 2;
+        int const diff = strcmp ( key, self -> entry [ mid ] . key );
+        if ( diff == 0 )
+        {
+            * found = true;
+            return mid;
+        }
+        if ( diff < 0 )
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+static
+rc_t ledger_grow ( ledger_t *self )
+{
+    if ( self -> count == self -> alloc )
+    {
+        size_t const alloc = self -> alloc ? self -> alloc * 2 : 256;
+        void *tmp = realloc ( self -> entry, alloc * sizeof self -> entry [ 0 ] );
+        if ( tmp == NULL )
+            return RC ( rcExe, rcData, rcAllocating, rcMemory, rcExhausted );
+        self -> entry = tmp;
+        self -> alloc = alloc;
+    }
+    return 0;
+}
+
+static
+int hex_value ( char ch )
+{
+    if ( ch >= '0' && ch <= '9' ) return ch - '0';
+    if ( ch >= 'a' && ch <= 'f' ) return ch - 'a' + 10;
+    if ( ch >= 'A' && ch <= 'F' ) return ch - 'A' + 10;
+    return -1;
+}
+
+/* <digest> <checks> <params> <version> <key>, the key is the rest of the line;
+   lines of the first format, without <params>, do not parse: they are dropped */
+static
+rc_t ledger_parse_line ( ledger_t *self, const char *line, size_t len )
+{
+    ledger_entry_t e;
+    const char *end = line + len;
+    const char *p = line;
+    size_t i;
+    rc_t rc;
+
+    if ( len == 0 || line [ 0 ] == '#' )
+        return 0;
+
+    memset ( & e, 0, sizeof e );
+    for ( i = 0; i < LEDGER_DIGEST_SIZE; ++ i )
+    {
+        int hi, lo;
+        if ( end - p < 2 )
+            return 0;
+        hi = hex_value ( p [ 0 ] );
+        lo = hex_value ( p [ 1 ] );
+        if ( hi < 0 || lo < 0 )
+            return 0;
+        e . digest [ i ] = ( uint8_t ) ( ( hi << 4 ) | lo );
+        p += 2;
+    }
+    if ( p == end || * p ++ != ' ' )
+        return 0;
+    while ( p != end && * p != ' ' )
+    {
+        int const v = hex_value ( * p ++ );
+        if ( v < 0 )
+            return 0;
+        e . checks = ( e . checks << 4 ) | v;
+    }
+    if ( p == end || * p ++ != ' ' )
+        return 0;
+    while ( p != end && * p != ' ' )
+    {
+        int const v = hex_value ( * p ++ );
+        if ( v < 0 )
+            return 0;
+        e . params = ( e . params << 4 ) | v;
+    }
+    if ( p == end || * p ++ != ' ' )
+        return 0;
+    for ( i = 0; p != end && * p != ' '; ++ p )
+    {
+        if ( i + 1 < sizeof e . version )
+            e . version [ i ++ ] = * p;
+    }
+    if ( p == end || * p ++ != ' ' || p == end )
+        return 0;
+
+    e . key = string_dup ( p, end - p );
+    if ( e . key == NULL )
+        return RC ( rcExe, rcData, rcParsing, rcMemory, rcExhausted );
+
+    rc = ledger_grow ( self );
+    if ( rc != 0 )
+        free ( e . key );
+    else
+        self -> entry [ self -> count ++ ] = e;
+    return rc;
+}
+
+static
+rc_t ledger_load ( ledger_t *self )
+{
+    const KFile *f;
+    uint64_t size;
+    rc_t rc;
+
+    if ( ( KDirectoryPathType ( self -> wd, "%s", self -> path ) & ~ kptAlias ) != kptFile )
+        return 0;
+
+    rc = KDirectoryOpenFileRead ( self -> wd, & f, "%s", self -> path );
+    if ( rc == 0 )
+    {
+        rc = KFileSize ( f, & size );
+        if ( rc == 0 && size > 0 )
+        {
+            char *text = malloc ( ( size_t ) size );
+            if ( text == NULL )
+                rc = RC ( rcExe, rcData, rcAllocating, rcMemory, rcExhausted );
+            else
+            {
+                size_t num_read;
+                rc = KFileReadAll ( f, 0, text, ( size_t ) size, & num_read );
+                if ( rc == 0 )
+                {
+                    size_t start = 0, i;
+                    for ( i = 0; rc == 0 && i <= num_read; ++ i )
+                    {
+                        if ( i == num_read || text [ i ] == '\n' )
+                        {
+                            size_t len = i - start;
+                            if ( len > 0 && text [ start + len - 1 ] == '\r' )
+                                -- len;
+                            rc = ledger_parse_line ( self, & text [ start ], len );
+                            start = i + 1;
+                        }
+                    }
+                }
+                free ( text );
+            }
+        }
+        KFileRelease ( f );
+    }
+    if ( rc == 0 && self -> count > 1 )
+    {
+        size_t i, j;
+
+        qsort ( self -> entry, self -> count, sizeof self -> entry [ 0 ], entry_cmp );
+        /* a ledger written by this tool has unique keys,
+           an edited one may not: keep one entry per key */
+        for ( i = j = 1; i < self -> count; ++ i )
+        {
+            if ( strcmp ( self -> entry [ j - 1 ] . key, self -> entry [ i ] . key ) == 0 )
+                free ( self -> entry [ i ] . key );
+            else
+                self -> entry [ j ++ ] = self -> entry [ i ];
+        }
+        self -> count = j;
+    }
+    if ( rc != 0 )
+        PLOGERR ( klogErr, ( klogErr, rc, "Validation ledger '$(path)' could not be read",
+                             "path=%s", self -> path ) );
+    return rc;
+}
+
+rc_t ledger_make ( ledger_t **self, const char *path )
+{
+    rc_t rc;
+    ledger_t *obj = calloc ( 1, sizeof * obj );
+    if ( obj == NULL )
+        return RC ( rcExe, rcData, rcAllocating, rcMemory, rcExhausted );
+
+    obj -> path = string_dup_measure ( path, NULL );
+    if ( obj -> path == NULL )
+        rc = RC ( rcExe, rcData, rcAllocating, rcMemory, rcExhausted );
+    else
+    {
+        size_t num_writ;
+        rc = string_printf ( obj -> version, sizeof obj -> version, & num_writ,
+                             "%V", KAppVersion () );
+        if ( rc == 0 )
+            rc = KDirectoryNativeDir ( & obj -> wd );
+        if ( rc == 0 )
+        {
+            rc = ledger_load ( obj );
+            if ( rc == 0 )
+            {
+                * self = obj;
+                return 0;
+            }
+        }
+    }
+    ledger_release ( obj );
+    return rc;
+}
+
+static
+rc_t ledger_save ( const ledger_t *self )
+{
+    char tmp [ 4096 ];
+    KFile *f;
+    size_t num_writ;
+    rc_t rc = string_printf ( tmp, sizeof tmp, & num_writ, "%s.tmp", self -> path );
+    if ( rc == 0 )
+        rc = KDirectoryCreateFile ( self -> wd, & f, false, 0664,
+                                    kcmInit | kcmParents, "%s", tmp );
+    if ( rc == 0 )
+    {
+        uint64_t pos = 0;
+        size_t i;
+
+        rc = KFileWriteAll ( f, pos, LEDGER_HEADER, sizeof LEDGER_HEADER - 1, & num_writ );
+        pos += num_writ;
+        for ( i = 0; rc == 0 && i < self -> count; ++ i )
+        {
+            const ledger_entry_t *e = & self -> entry [ i ];
+            char line [ 4096 + 128 ];
+            size_t len = 0, j;
+
+            for ( j = 0; j < LEDGER_DIGEST_SIZE; ++ j )
+            {
+                line [ len ++ ] = "0123456789abcdef" [ e -> digest [ j ] >> 4 ];
+                line [ len ++ ] = "0123456789abcdef" [ e -> digest [ j ] & 15 ];
+            }
+            rc = string_printf ( & line [ len ], sizeof line - len, & num_writ,
+                                 " %x %x %s %s\n", e -> checks, e -> params, e -> version, e -> key );
+            if ( rc == 0 )
+                rc = KFileWriteAll ( f, pos, line, len + num_writ, & num_writ );
+            pos += num_writ;
+        }
+        KFileRelease ( f );
+
+        /* replace the ledger only when it was written completely */
+        if ( rc == 0 )
+            rc = KDirectoryRename ( self -> wd, true, tmp, self -> path );
+        else
+            KDirectoryRemove ( self -> wd, false, "%s", tmp );
+    }
+    if ( rc != 0 )
+        PLOGERR ( klogErr, ( klogErr, rc, "Validation ledger '$(path)' could not be written",
+                             "path=%s", self -> path ) );
+    return rc;
+}
+
+rc_t ledger_release ( ledger_t *self )
+{
+    rc_t rc = 0;
+    if ( self != NULL )
+    {
+        size_t i;
+
+        if ( self -> changed )
+            rc = ledger_save ( self );
+        for ( i = 0; i < self -> count; ++ i )
+            free ( self -> entry [ i ] . key );
+        free ( self -> entry );
+        free ( self -> path );
+        KDirectoryRelease ( self -> wd );
+        free ( self );
+    }
+    return rc;
+}
+
+uint32_t ledger_params ( const char *text )
+{
+    /* FNV-1a */
+    uint32_t h = 2166136261u;
+    for ( ; * text != 0; ++ text )
+        h = ( h ^ ( uint8_t ) * text ) * 16777619u;
+    return h;
+}
+
+bool ledger_passed ( const ledger_t *self, const char *key,
+    const uint8_t digest [ LEDGER_DIGEST_SIZE ], uint32_t checks, uint32_t params )
+{
+    bool found;
+    size_t const idx = ledger_find ( self, key, & found );
+    if ( found )
+    {
+        const ledger_entry_t *e = & self -> entry [ idx ];
+        return ( e -> checks & checks ) == checks
+            && ( ( checks & ledger_sdc ) == 0 || e -> params == params )
+            && strcmp ( e -> version, self -> version ) == 0
+            && memcmp ( e -> digest, digest, LEDGER_DIGEST_SIZE ) == 0;
+    }
+    return false;
+}
+
+rc_t ledger_record ( ledger_t *self, const char *key,
+    const uint8_t digest [ LEDGER_DIGEST_SIZE ], uint32_t checks, uint32_t params )
+{
+    bool found;
+    size_t const idx = ledger_find ( self, key, & found );
+    ledger_entry_t *e;
+
+    if ( ! found )
+    {
+        char *dup = string_dup_measure ( key, NULL );
+        rc_t rc = dup == NULL
+            ? RC ( rcExe, rcData, rcAllocating, rcMemory, rcExhausted )
+            : ledger_grow ( self );
+        if ( rc != 0 )
+        {
+            free ( dup );
+            return rc;
+        }
+        memmove ( & self -> entry [ idx + 1 ], & self -> entry [ idx ],
+                  ( self -> count - idx ) * sizeof self -> entry [ 0 ] );
+        ++ self -> count;
+        e = & self -> entry [ idx ];
+        e -> key = dup;
+        e -> checks = 0;
+        e -> params = 0;
+    }
+    else
+        e = & self -> entry [ idx ];
+
+    /* checks passed earlier on the same data and version still count,
+       the ones with parameters only with the same parameters */
+    if ( found && memcmp ( e -> digest, digest, LEDGER_DIGEST_SIZE ) == 0
+               && strcmp ( e -> version, self -> version ) == 0 )
+    {
+        uint32_t earlier = e -> checks;
+        if ( ( checks & ledger_sdc ) != 0 && e -> params != params )
+            earlier &= ~ ( uint32_t ) ledger_sdc;
+        else if ( ( checks & ledger_sdc ) == 0 )
+            params = e -> params;
+        checks |= earlier;
+    }
+
+    memmove ( e -> digest, digest, LEDGER_DIGEST_SIZE );
+    e -> checks = checks;
+    e -> params = ( checks & ledger_sdc ) != 0 ? params : 0;
+    string_copy_measure ( e -> version, sizeof e -> version, self -> version );
+    self -> changed = true;
+    return 0;
+}
+
+/******************************************************************************
+ * fingerprint
+ ******************************************************************************/
+static
+rc_t fingerprint_file ( const KDirectory *dir, const char *path, const char *name,
+    MD5State *md5 )
+{
+    uint64_t size;
+    KTime_t date;
+    rc_t rc = KDirectoryFileSize ( dir, & size, "%s", path );
+    if ( rc == 0 )
+        rc = KDirectoryDate ( dir, & date, "%s", path );
+    if ( rc == 0 )
+    {
+        MD5StateAppend ( md5, & size, sizeof size );
+        MD5StateAppend ( md5, & date, sizeof date );
+
+        /* kdb keeps the md5 of the data files in files named 'md5' */
+        if ( strcmp ( name, "md5" ) == 0 )
+        {
+            const KFile *f;
+            rc = KDirectoryOpenFileRead ( dir, & f, "%s", path );
+            if ( rc == 0 )
+            {
+                char buffer [ 4096 ];
+                uint64_t pos = 0;
+                size_t num_read;
+
+                do
+                {
+                    rc = KFileReadAll ( f, pos, buffer, sizeof buffer, & num_read );
+                    if ( rc == 0 )
+                    {
+                        MD5StateAppend ( md5, buffer, num_read );
+                        pos += num_read;
+                    }
+                } while ( rc == 0 && num_read > 0 );
+                KFileRelease ( f );
+            }
+        }
+    }
+    return rc;
+}
+
+static
+int CC name_cmp ( const void *a, const void *b )
+{
+    return strcmp ( * ( const char* const* ) a, * ( const char* const* ) b );
+}
+
+static
+rc_t fingerprint_dir ( const KDirectory *dir, const char *path, MD5State *md5 )
+{
+    KNamelist *list;
+    rc_t rc = KDirectoryList ( dir, & list, NULL, NULL, "%s", path );
+    if ( rc == 0 )
+    {
+        uint32_t count;
+        rc = KNamelistCount ( list, & count );
+        if ( rc == 0 && count > 0 )
+        {
+            /* the order of a listing is not defined */
+            const char **names = malloc ( count * sizeof names [ 0 ] );
+            if ( names == NULL )
+                rc = RC ( rcExe, rcData, rcAllocating, rcMemory, rcExhausted );
+            else
+            {
+                uint32_t i;
+                for ( i = 0; rc == 0 && i < count; ++ i )
+                    rc = KNamelistGet ( list, i, & names [ i ] );
+                if ( rc == 0 )
+                    qsort ( names, count, sizeof names [ 0 ], name_cmp );
+
+                for ( i = 0; rc == 0 && i < count; ++ i )
+                {
+                    char sub [ 4096 ];
+                    size_t num_writ;
+                    rc = string_printf ( sub, sizeof sub, & num_writ, "%s/%s", path, names [ i ] );
+                    if ( rc == 0 )
+                    {
+                        uint32_t const type = KDirectoryPathType ( dir, "%s", sub ) & ~ kptAlias;
+                        char const tag = type == kptDir ? 'd' : 'f';
+
+                        MD5StateAppend ( md5, names [ i ], strlen ( names [ i ] ) + 1 );
+                        MD5StateAppend ( md5, & tag, 1 );
+                        if ( type == kptDir )
+                        {
+                            rc = fingerprint_dir ( dir, sub, md5 );
+                            MD5StateAppend ( md5, "", 1 );
+                        }
+                        else if ( type == kptFile )
+                            rc = fingerprint_file ( dir, sub, names [ i ], md5 );
+                    }
+                }
+                free ( names );
+            }
+        }
+        KNamelistRelease ( list );
+    }
+    return rc;
+}
+
+rc_t ledger_fingerprint ( const KDirectory *wd, const char *path,
+    bool is_file, uint8_t digest [ LEDGER_DIGEST_SIZE ] )
+{
+    MD5State md5;
+    rc_t rc;
+
+    MD5StateInit ( & md5 );
+    if ( is_file )
+    {
+        /* an archive is not opened: its size and date stand for its contents */
+        const char *name = strrchr ( path, '/' );
+        rc = fingerprint_file ( wd, path, name ? name + 1 : path, & md5 );
+    }
+    else
+        rc = fingerprint_dir ( wd, path, & md5 );
+    MD5StateFinish ( & md5, digest );
+    return rc;
+}
@@ -0,0 +1,92 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+
+#ifndef _h_vdb_validate_ledger_
+#define _h_vdb_validate_ledger_
+
+#include <klib/rc.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct KDirectory;
+
+/* Validation ledger: remembers objects which passed validation, with a
+ * fingerprint of their files and stored checksums, the checks that were
+ * run and the version of vdb-validate. An object which is unchanged since
+ * it passed the same or more checks needs not to be validated again.
+ */
+typedef struct ledger_t ledger_t;
+
+#define LEDGER_DIGEST_SIZE 16
+
+/* the checks an entry covers */
+enum {
+    ledger_md5      = ( 1u << 0 ),
+    ledger_blob_crc = ( 1u << 1 ),
+    ledger_index    = ( 1u << 2 ),
+    ledger_ref_int  = ( 1u << 3 ),
+    ledger_sdc      = ( 1u << 4 ),
+    ledger_consist  = ( 1u << 5 ),
+    ledger_exhaustive = ( 1u << 6 )   /* the checks did not stop at the first error */
+};
+
+/* digest of the text of the parameters of the checks, like the numbers of
+ * rows for the data integrity checks: an entry with other parameters does
+ * not count for the checks they apply to ( ledger_sdc ) */
+uint32_t ledger_params ( const char *text );
+
+/* loads the ledger from 'path', a missing file yields an empty ledger */
+rc_t ledger_make ( ledger_t **self, const char *path );
+
+/* writes the ledger back if it was changed and releases it */
+rc_t ledger_release ( ledger_t *self );
+
+/* fingerprint of the object at 'path': names, sizes and dates of its
+ * files and the contents of the md5 files in which kdb keeps the
+ * checksums of the data, for an archive file its size and date */
+rc_t ledger_fingerprint ( const struct KDirectory *wd, const char *path,
+    bool is_file, uint8_t digest [ LEDGER_DIGEST_SIZE ] );
+
+/* did the object with this fingerprint pass at least these checks
+ * with these parameters and this version of the tool? */
+bool ledger_passed ( const ledger_t *self, const char *key,
+    const uint8_t digest [ LEDGER_DIGEST_SIZE ], uint32_t checks, uint32_t params );
+
+/* records that the object passed these checks with these parameters */
+rc_t ledger_record ( ledger_t *self, const char *key,
+    const uint8_t digest [ LEDGER_DIGEST_SIZE ], uint32_t checks, uint32_t params );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _h_vdb_validate_ledger_ */
@@ -0,0 +1,252 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+
+#include "pair-sort.h"
+
+#include <kproc/lock.h>
+#include <kproc/thread.h>
+
+#include <klib/rc.h>
+
+#include <sysalloc.h>
+
+#include <stdbool.h>
+#include <string.h>
+
+/* in-place MSD radix sort ( american flag sort ) on the key ( first, second ):
+ * no extra memory is needed, so the chunk sizes derived from the memory
+ * budget stay the same; after the first distribution the buckets are
+ * independent and are sorted by worker threads
+ */
+#define PAIR_SORT_CUTOFF 64
+#define PAIR_SORT_SIGN ((uint64_t)1 << 63)
+#define PAIR_SORT_MAX_THREADS 64
+/* below this size threads do not pay off */
+#define PAIR_SORT_PARALLEL_MIN (1u << 16)
+
+static unsigned pair_digit(id_pair_t const *const p, int const shift)
+{
+    uint64_t const hi = (uint64_t)p->first ^ PAIR_SORT_SIGN;
+    uint64_t const lo = (uint64_t)p->second ^ PAIR_SORT_SIGN;
+
+    if (shift >= 64)
+        return (unsigned)(hi >> (shift - 64)) & 0xFF;
+    if (shift > 56)
+        return (unsigned)((hi << (64 - shift)) | (lo >> shift)) & 0xFF;
+    if (shift >= 0)
+        return (unsigned)(lo >> shift) & 0xFF;
+    return (unsigned)(lo << -shift) & 0xFF;
+}
+
+static bool pair_less(id_pair_t const *const a, id_pair_t const *const b)
+{
+    return a->first < b->first || (a->first == b->first && a->second < b->second);
+}
+
+static void pair_insertion_sort(size_t const N, id_pair_t array[/* N */])
+{
+    size_t i;
+
+    for (i = 1; i < N; ++i) {
+        id_pair_t const v = array[i];
+        size_t j = i;
+
+        while (j > 0 && pair_less(&v, &array[j - 1])) {
+            array[j] = array[j - 1];
+            --j;
+        }
+        array[j] = v;
+    }
+}
+
+/* distributes the pairs into 256 buckets by the digit at 'shift',
+ * returns false if all pairs fall into the same bucket */
+static bool pair_distribute(size_t const N, id_pair_t array[/* N */],
+                            int const shift, size_t bucket[/* 257 */])
+{
+    size_t head[256];
+    size_t i;
+    unsigned b;
+
+    memset(bucket, 0, 257 * sizeof(bucket[0]));
+    for (i = 0; i < N; ++i)
+        ++bucket[pair_digit(&array[i], shift) + 1];
+    for (b = 0; b < 256; ++b) {
+        if (bucket[b + 1] == N)
+            return false;
+        bucket[b + 1] += bucket[b];
+        head[b] = bucket[b];
+    }
+    for (b = 0; b < 256; ++b) {
+        while (head[b] < bucket[b + 1]) {
+            id_pair_t v = array[head[b]];
+            unsigned d = pair_digit(&v, shift);
+
+            while (d != b) {
+                id_pair_t const t = array[head[d]];
+
+                array[head[d]++] = v;
+                v = t;
+                d = pair_digit(&v, shift);
+            }
+            array[head[b]++] = v;
+        }
+    }
+    return true;
+}
+
+static void pair_radix_sort(size_t const N, id_pair_t array[/* N */], int shift)
+{
+    size_t bucket[257];
+
+    if (N < PAIR_SORT_CUTOFF) {
+        pair_insertion_sort(N, array);
+        return;
+    }
+    for ( ; shift > -8; shift -= 8) {
+        if (pair_distribute(N, array, shift, bucket)) {
+            unsigned b;
+
+            for (b = 0; b < 256; ++b) {
+                size_t const n = bucket[b + 1] - bucket[b];
+
+                if (n > 1)
+                    pair_radix_sort(n, &array[bucket[b]], shift - 8);
+            }
+            return;
+        }
+    }
+}
+
+/* the highest bit in which any 2 keys differ, the first digit ends there */
+static int pair_sort_first_shift(size_t const N, id_pair_t const array[/* N */])
+{
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+    size_t i;
+    int top = -1;
+
+    for (i = 1; i < N; ++i) {
+        hi |= (uint64_t)(array[i].first ^ array[0].first);
+        lo |= (uint64_t)(array[i].second ^ array[0].second);
+    }
+    if (hi != 0) {
+        for (top = 127; (hi & ((uint64_t)1 << (top - 64))) == 0; --top)
+            ;
+    }
+    else if (lo != 0) {
+        for (top = 63; (lo & ((uint64_t)1 << top)) == 0; --top)
+            ;
+    }
+    return top - 7;
+}
+
+typedef struct pair_sort_pool_s {
+    id_pair_t *array;
+    size_t const *bucket;
+    KLock *lock;
+    int shift;
+    unsigned next;
+} pair_sort_pool_t;
+
+static rc_t CC pair_sort_thread(KThread const *self, void *data)
+{
+    pair_sort_pool_t *const pool = data;
+
+    for ( ; ; ) {
+        unsigned b;
+        size_t n;
+
+        KLockAcquire(pool->lock);
+        b = pool->next++;
+        KLockUnlock(pool->lock);
+        if (b >= 256)
+            break;
+
+        n = pool->bucket[b + 1] - pool->bucket[b];
+        if (n > 1)
+            pair_radix_sort(n, &pool->array[pool->bucket[b]], pool->shift);
+    }
+    return 0;
+}
+
+void sort_key_pairs(size_t const N, id_pair_t array[/* N */],
+                    unsigned const threads)
+{
+    int shift;
+
+    if (N < 2)
+        return;
+    shift = pair_sort_first_shift(N, array);
+    if (shift <= -8)
+        return; /* all keys are equal */
+
+    if (threads > 1 && N >= PAIR_SORT_PARALLEL_MIN) {
+        size_t bucket[257];
+        pair_sort_pool_t pool;
+        KThread *tid[PAIR_SORT_MAX_THREADS];
+        unsigned t, started = 0;
+
+        /* the digits above the first varying bit are all equal: the first
+           distribution always spreads the pairs over more than one bucket */
+        pair_distribute(N, array, shift, bucket);
+
+        memset(&pool, 0, sizeof(pool));
+        pool.array = array;
+        pool.bucket = bucket;
+        pool.shift = shift - 8;
+        if (KLockMake(&pool.lock) == 0) {
+            for (t = 0; t < threads && t < PAIR_SORT_MAX_THREADS; ++t) {
+                if (KThreadMake(&tid[t], pair_sort_thread, &pool) != 0)
+                    break;
+                ++started;
+            }
+        }
+        /* the calling thread helps, and does it all if no thread was started */
+        if (pool.lock != NULL)
+            pair_sort_thread(NULL, &pool);
+        else {
+            unsigned b;
+
+            for (b = 0; b < 256; ++b) {
+                size_t const n = bucket[b + 1] - bucket[b];
+
+                if (n > 1)
+                    pair_radix_sort(n, &array[bucket[b]], shift - 8);
+            }
+        }
+        for (t = 0; t < started; ++t) {
+            rc_t rc_thread;
+
+            KThreadWait(tid[t], &rc_thread);
+            KThreadRelease(tid[t]);
+        }
+        KLockRelease(pool.lock);
+    }
+    else
+        pair_radix_sort(N, array, shift);
+}
@@ -0,0 +1,52 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+
+#ifndef _h_vdb_validate_pair_sort_
+#define _h_vdb_validate_pair_sort_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the key pairs of the referential-integrity checks */
+typedef struct id_pair_s {
+    int64_t first;
+    int64_t second;
+} id_pair_t;
+
+/* sorts the pairs by ( first, second ) in place, with up to 'threads'
+ * worker threads if there are enough of them */
+void sort_key_pairs(size_t N, id_pair_t array[/* N */], unsigned threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _h_vdb_validate_pair_sort_ */
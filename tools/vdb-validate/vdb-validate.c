@@ -36,6 +36,7 @@
 #include <kdb/manager.h>
 #include <kdb/database.h>
 #include <kdb/table.h>
+#include <kdb/column.h>
 #include <kdb/meta.h>
 #include <kdb/namelist.h>
 #include <kdb/consistency-check.h>
@@ -73,6 +74,15 @@
 #include <klib/debug.h>
 #include <klib/data-buffer.h>
 #include <klib/sort.h>
+#include <klib/time.h> /* KTimeMsStamp */
+#include <klib/printf.h> /* string_printf */
+
+#include <kproc/lock.h>
+#include <kproc/thread.h>
+#include <kproc/timeout.h> /* KSleepMs */
+
+#include "ledger.h"
+#include "pair-sort.h"
 
 #include <sysalloc.h>
 
@@ -107,6 +117,12 @@ static bool md5_required;
 static bool ref_int_check;
 static bool s_IndexOnly;
 static size_t memory_suggestion = (2ull * 1024ull * 1024ull * 1024ull);
+static unsigned num_threads = 1;
+static uint64_t max_bytes_per_sec; /* 0: no limit */
+
+#define MAX_THREADS 64
+/* below this size threads do not pay off */
+#define RIC_PARALLEL_MIN (1u << 20)
 
 typedef struct node_s {
     int parent;
@@ -117,6 +133,7 @@ typedef struct node_s {
     unsigned name;
     uint32_t objType;
 } node_t;
+typedef struct blob_cc_s blob_cc_t;
 typedef struct cc_context_s {
     node_t *nodes;
     char *names;
@@ -124,7 +141,13 @@ typedef struct cc_context_s {
     unsigned num_columns;
     unsigned nextNode;
     unsigned nextName;
+    blob_cc_t *blobs; /* blob checksums verified ahead, NULL if not */
+    char cur_table[4096]; /* path of the table visited last, see node_path */
 } cc_context_t;
+
+static rc_t blob_cc_report(blob_cc_t *self, char const table[],
+                           char const column[], cc_context_t *ctx,
+                           bool *checked);
 static
 rc_t report_rtn ( rc_t rc )
 {
@@ -171,9 +194,20 @@ static rc_t report_column(CCReportInfoBlock const *what, cc_context_t *ctx)
                 ctx->rc = what->info.done.rc;
         }
         else {
+            char const *mesg = what->info.done.mesg ? what->info.done.mesg : "checked";
+
+            if (ctx->blobs) {
+                bool checked;
+                rc_t const rc = blob_cc_report(ctx->blobs, ctx->cur_table,
+                                               what->objName, ctx, &checked);
+                if (rc)
+                    return report_rtn (rc);
+                /* the library ran without its blob check: say what it says after it */
+                if (checked)
+                    mesg = "checksums ok";
+            }
             (void)PLOGMSG(klogInfo, (klogInfo, "Column '$(column)': $(mesg)",
-                "column=%s,mesg=%s", what->objName,
-                what->info.done.mesg ? what->info.done.mesg : "checked"));
+                "column=%s,mesg=%s", what->objName, mesg));
             ++ctx->num_columns;
         }
         return report_rtn (what->info.done.rc);
@@ -321,6 +355,34 @@ static rc_t visiting(CCReportInfoBlock const *what, cc_context_t *ctx)
     return 0;
 }
 
+/* the path of a node inside of the database checked, like "sub/SEQUENCE":
+ * the last path components of its ancestors below the database
+ */
+static void node_path(cc_context_t const *ctx, int node,
+                      char path[], size_t size)
+{
+    node_t const *const nd = &ctx->nodes[node];
+    char const *name = &ctx->names[nd->name];
+    char const *const leaf = strrchr(name, '/');
+    size_t len, nlen;
+
+    path[0] = '\0';
+    if (nd->parent < 0 && nd->objType == kptDatabase)
+        return;
+    if (nd->parent >= 0)
+        node_path(ctx, nd->parent, path, size);
+    if (leaf)
+        name = leaf + 1;
+    len = strlen(path);
+    nlen = strlen(name);
+    if (len > 0 && len + 1 < size)
+        path[len++] = '/';
+    if (len + nlen >= size)
+        nlen = len < size ? size - len - 1 : 0;
+    memmove(&path[len], name, nlen);
+    path[len + nlen] = '\0';
+}
+
 static rc_t CC report(CCReportInfoBlock const *what, void *Ctx)
 {
     cc_context_t *ctx = Ctx;
@@ -329,8 +391,13 @@ static rc_t CC report(CCReportInfoBlock const *what, void *Ctx)
     if (rc)
         return rc;
 
-    if (what->type == ccrpt_Visit)
-        return visiting(what, ctx);
+    if (what->type == ccrpt_Visit) {
+        rc = visiting(what, ctx);
+        if (what->objType == kptTable)
+            node_path(ctx, (int)ctx->nextNode - 1,
+                      ctx->cur_table, sizeof(ctx->cur_table));
+        return rc;
+    }
 
     switch (what->objType) {
     case kptDatabase:
@@ -346,6 +413,323 @@ static rc_t CC report(CCReportInfoBlock const *what, void *Ctx)
     }
 }
 
+/* Blob checksums of the columns are verified by worker threads ahead of the
+ * consistency check, which then runs without blob checks ( level 0 ). The
+ * results are kept per column and reported when the consistency check
+ * reports the column, so the output keeps the order of the objects.
+ */
+typedef struct blob_cc_col_s {
+    KTable const *tbl;
+    KColumn const *col;
+    char *table; /* path in the database ( see node_path ), NULL for a standalone table */
+    char *name;
+    int64_t bad_row;
+    uint64_t blobs;
+    rc_t rc;
+    bool reported;
+} blob_cc_col_t;
+
+struct blob_cc_s {
+    blob_cc_col_t *cols;
+    unsigned count;
+    unsigned alloc;
+    unsigned next;
+    KLock *lock;
+
+    /* shared among the workers: the bytes read so far and since when */
+    uint64_t bytes;
+    KTimeMs_t start;
+};
+
+static void blob_cc_whack(blob_cc_t *self)
+{
+    unsigned i;
+
+    for (i = 0; i < self->count; ++i) {
+        KColumnRelease(self->cols[i].col);
+        KTableRelease(self->cols[i].tbl);
+        free(self->cols[i].table);
+        free(self->cols[i].name);
+    }
+    free(self->cols);
+    KLockRelease(self->lock);
+    memset(self, 0, sizeof(*self));
+}
+
+static rc_t blob_cc_add_table(blob_cc_t *self, KTable const *tbl,
+                              char const table[])
+{
+    KNamelist *names;
+    rc_t rc = KTableListCol(tbl, &names);
+
+    if (rc == 0) {
+        uint32_t n, i;
+
+        rc = KNamelistCount(names, &n);
+        for (i = 0; rc == 0 && i < n; ++i) {
+            char const *name;
+            blob_cc_col_t *col;
+
+            rc = KNamelistGet(names, i, &name);
+            if (rc)
+                break;
+            if (self->count == self->alloc) {
+                unsigned const alloc = self->alloc ? self->alloc * 2 : 64;
+                void *const tmp = realloc(self->cols, alloc * sizeof(self->cols[0]));
+
+                if (tmp == NULL) {
+                    rc = RC(rcExe, rcColumn, rcValidating, rcMemory, rcExhausted);
+                    break;
+                }
+                self->cols = tmp;
+                self->alloc = alloc;
+            }
+            col = &self->cols[self->count];
+            memset(col, 0, sizeof(*col));
+            rc = KTableOpenColumnRead(tbl, &col->col, "%s", name);
+            if (rc) {
+                /* the consistency check reports it */
+                rc = 0;
+                continue;
+            }
+            col->name = string_dup_measure(name, NULL);
+            col->table = table ? string_dup_measure(table, NULL) : NULL;
+            if (col->name == NULL || (table && col->table == NULL)) {
+                KColumnRelease(col->col);
+                free(col->name);
+                free(col->table);
+                rc = RC(rcExe, rcColumn, rcValidating, rcMemory, rcExhausted);
+                break;
+            }
+            if (KTableAddRef(tbl) == 0)
+                col->tbl = tbl;
+            ++self->count;
+        }
+        KNamelistRelease(names);
+    }
+    return rc;
+}
+
+/* prefix is the path of the database inside of the one checked, "" for it */
+static rc_t blob_cc_add_db(blob_cc_t *self, KDatabase const *db,
+                           char const prefix[])
+{
+    char path[4096];
+    KNamelist *names;
+    rc_t rc = KDatabaseListTbl(db, &names);
+
+    if (rc == 0) {
+        uint32_t n, i;
+
+        rc = KNamelistCount(names, &n);
+        for (i = 0; rc == 0 && i < n; ++i) {
+            char const *name;
+            KTable const *tbl;
+
+            rc = KNamelistGet(names, i, &name);
+            if (rc == 0)
+                rc = string_printf(path, sizeof(path), NULL, "%s%s%s",
+                                   prefix, prefix[0] ? "/" : "", name);
+            if (rc == 0 && KDatabaseOpenTableRead(db, &tbl, "%s", name) == 0) {
+                rc = blob_cc_add_table(self, tbl, path);
+                KTableRelease(tbl);
+            }
+        }
+        KNamelistRelease(names);
+    }
+    else
+        rc = 0; /* a database without tables */
+
+    if (rc == 0 && KDatabaseListDB(db, &names) == 0) {
+        uint32_t n, i;
+
+        rc = KNamelistCount(names, &n);
+        for (i = 0; rc == 0 && i < n; ++i) {
+            char const *name;
+            KDatabase const *sub;
+
+            rc = KNamelistGet(names, i, &name);
+            if (rc == 0)
+                rc = string_printf(path, sizeof(path), NULL, "%s%s%s",
+                                   prefix, prefix[0] ? "/" : "", name);
+            if (rc == 0 && KDatabaseOpenDBRead(db, &sub, "%s", name) == 0) {
+                rc = blob_cc_add_db(self, sub, path);
+                KDatabaseRelease(sub);
+            }
+        }
+        KNamelistRelease(names);
+    }
+    return rc;
+}
+
+/* sleeps as long as the bytes read so far exceed the rate limit */
+static void blob_cc_throttle(blob_cc_t *self, size_t const bytes)
+{
+    uint64_t due;
+    KTimeMs_t elapsed;
+
+    if (max_bytes_per_sec == 0)
+        return;
+
+    KLockAcquire(self->lock);
+    self->bytes += bytes;
+    due = (self->bytes * 1000) / max_bytes_per_sec;
+    elapsed = KTimeMsStamp() - self->start;
+    KLockUnlock(self->lock);
+
+    if (due > elapsed)
+        KSleepMs((uint32_t)(due - elapsed));
+}
+
+static rc_t blob_cc_column(blob_cc_t *self, blob_cc_col_t *col)
+{
+    int64_t id;
+    uint64_t count;
+    rc_t rc = KColumnIdRange(col->col, &id, &count);
+
+    while (rc == 0) {
+        KColumnBlob const *blob;
+        int64_t first;
+        uint32_t blob_rows;
+
+        rc = Quitting();
+        if (rc)
+            break;
+        rc = KColumnFindFirstRowId(col->col, &id, id);
+        if (rc) {
+            if (GetRCState(rc) == rcNotFound)
+                rc = 0; /* no more blobs */
+            else
+                col->bad_row = id;
+            break;
+        }
+
+        rc = KColumnOpenBlobRead(col->col, &blob, id);
+        if (rc == 0) {
+            rc = KColumnBlobIdRange(blob, &first, &blob_rows);
+            if (rc == 0) {
+                char dummy;
+                size_t num_read;
+                size_t size = 0;
+
+                /* asking for 0 bytes yields the size of the blob */
+                if (KColumnBlobRead(blob, 0, &dummy, 0, &num_read, &size) == 0)
+                    blob_cc_throttle(self, size);
+                rc = KColumnBlobValidate(blob);
+                ++col->blobs;
+            }
+            KColumnBlobRelease(blob);
+        }
+        if (rc) {
+            col->bad_row = id;
+            break;
+        }
+        id = first + (blob_rows ? blob_rows : 1);
+    }
+    return rc;
+}
+
+static rc_t CC blob_cc_thread(KThread const *self, void *data)
+{
+    blob_cc_t *const bcc = data;
+
+    for ( ; ; ) {
+        unsigned i;
+
+        KLockAcquire(bcc->lock);
+        i = bcc->next++;
+        KLockUnlock(bcc->lock);
+        if (i >= bcc->count)
+            break;
+
+        bcc->cols[i].rc = blob_cc_column(bcc, &bcc->cols[i]);
+    }
+    return 0;
+}
+
+static rc_t blob_cc_run(blob_cc_t *self)
+{
+    KThread *tid[MAX_THREADS];
+    unsigned t, started = 0;
+    rc_t rc = KLockMake(&self->lock);
+
+    if (rc)
+        return rc;
+    self->start = KTimeMsStamp();
+    for (t = 0; t < num_threads && t < self->count; ++t) {
+        if (KThreadMake(&tid[t], blob_cc_thread, self) != 0)
+            break;
+        ++started;
+    }
+    /* the calling thread takes part, and does it all if no thread started */
+    blob_cc_thread(NULL, self);
+    for (t = 0; t < started; ++t) {
+        rc_t rc_thread;
+
+        KThreadWait(tid[t], &rc_thread);
+        KThreadRelease(tid[t]);
+    }
+    return 0;
+}
+
+static rc_t blob_cc_report_col(blob_cc_col_t *col, cc_context_t *ctx)
+{
+    col->reported = true;
+    if (col->rc == 0)
+        return 0;
+    if (GetRCState(col->rc) == rcCanceled)
+        return col->rc;
+    (void)PLOGERR(klogErr, (klogErr, col->rc,
+        "Column '$(column)': blob containing row $(row) is corrupt",
+        "column=%s,row=%ld", col->name, col->bad_row));
+    if (ctx->rc == 0)
+        ctx->rc = col->rc;
+    return col->rc;
+}
+
+/* *checked is set if the blobs of the column were verified here;
+ * table is the path of the table in the database ( see node_path )
+ */
+static rc_t blob_cc_report(blob_cc_t *self, char const table[],
+                           char const column[], cc_context_t *ctx,
+                           bool *checked)
+{
+    char const *const leaf = strrchr(column, '/');
+    unsigned i;
+
+    *checked = false;
+    if (leaf)
+        column = leaf + 1;
+    for (i = 0; i < self->count; ++i) {
+        blob_cc_col_t *const col = &self->cols[i];
+
+        if (col->reported || strcmp(col->name, column) != 0)
+            continue;
+        if (col->table && strcmp(col->table, table) != 0)
+            continue;
+        *checked = true;
+        return blob_cc_report_col(col, ctx);
+    }
+    return 0;
+}
+
+/* the columns which the consistency check did not report */
+static rc_t blob_cc_report_rest(blob_cc_t *self, cc_context_t *ctx)
+{
+    rc_t rc = 0;
+    unsigned i;
+
+    for (i = 0; i < self->count && (rc == 0 || exhaustive); ++i) {
+        if (!self->cols[i].reported) {
+            rc_t const rc2 = blob_cc_report_col(&self->cols[i], ctx);
+
+            if (rc == 0)
+                rc = rc2;
+        }
+    }
+    return rc;
+}
+
 static
 rc_t kdbcc ( const KDBManager *mgr, char const name[], uint32_t mode,
     KPathType *pathType, bool is_file, node_t nodes[], char names[],
@@ -353,12 +737,18 @@ rc_t kdbcc ( const KDBManager *mgr, char const name[], uint32_t mode,
 {
     rc_t rc = 0;
     cc_context_t ctx;
+    blob_cc_t bcc;
     char const *objtype;
 
     uint32_t level = ( mode & 4 ) ? 3 : ( mode & 2 ) ? 1 : 0;
+    /* only the blob checksums run in parallel: the index check stays serial */
+    bool const parallel_blobs = level == 1 && !s_IndexOnly
+                             && ( num_threads > 1 || max_bytes_per_sec != 0 );
     if (s_IndexOnly)
         level |= CC_INDEX_ONLY;
 
+    memset(&bcc, 0, sizeof(bcc));
+
 
     memset(&ctx, 0, sizeof(ctx));
     ctx.nodes = &nodes[0];
@@ -384,9 +774,28 @@ rc_t kdbcc ( const KDBManager *mgr, char const name[], uint32_t mode,
 
         objtype = "database";
         rc = KDBManagerOpenDBRead ( mgr, & db, "%s", name );
+        if ( rc == 0 && parallel_blobs )
+        {
+            rc = blob_cc_add_db ( & bcc, db, "" );
+            if ( rc == 0 )
+                rc = blob_cc_run ( & bcc );
+            if ( rc == 0 )
+            {
+                ctx.blobs = & bcc;
+                level = 0;
+            }
+            else
+            {
+                /* fall back to the serial check */
+                blob_cc_whack ( & bcc );
+                rc = 0;
+            }
+        }
         if ( rc == 0 )
         {
             rc = KDatabaseConsistencyCheck ( db, 0, level, report, & ctx );
+            if ( rc == 0 && ctx.blobs != NULL )
+                rc = blob_cc_report_rest ( & bcc, & ctx );
             if ( rc == 0 )
             {
                 rc = ctx.rc;
@@ -403,9 +812,27 @@ rc_t kdbcc ( const KDBManager *mgr, char const name[], uint32_t mode,
 
         objtype = "table";
         rc = KDBManagerOpenTableRead ( mgr, & tbl, "%s", name );
+        if ( rc == 0 && parallel_blobs )
+        {
+            rc = blob_cc_add_table ( & bcc, tbl, NULL );
+            if ( rc == 0 )
+                rc = blob_cc_run ( & bcc );
+            if ( rc == 0 )
+            {
+                ctx.blobs = & bcc;
+                level = 0;
+            }
+            else
+            {
+                blob_cc_whack ( & bcc );
+                rc = 0;
+            }
+        }
         if ( rc == 0 )
         {
             rc = KTableConsistencyCheck ( tbl, 0, level, report, & ctx, platform );
+            if ( rc == 0 && ctx.blobs != NULL )
+                rc = blob_cc_report_rest ( & bcc, & ctx );
             if ( rc == 0 )
                 rc = ctx.rc;
 
@@ -416,6 +843,8 @@ rc_t kdbcc ( const KDBManager *mgr, char const name[], uint32_t mode,
         }
     }
 
+    blob_cc_whack ( & bcc );
+
     if (rc == 0 && ctx.num_columns == 0 && !s_IndexOnly)
     {
         if (is_file)
@@ -772,6 +1201,10 @@ struct vdb_validate_params
     bool consist_check;
     bool exhaustive;
 
+    /* skip objects which passed before, unless 'full' */
+    ledger_t *ledger;
+    bool full;
+
     // data integrity checks parameters
     bool sdc_enabled;
     bool sdc_sec_rows_in_percent;
@@ -1221,14 +1654,10 @@ static rc_t align_dbcc_primary_alignment(VTable const *tbl, char const name[])
 }
 #endif
 
-typedef struct id_pair_s {
-    int64_t first;
-    int64_t second;
-} id_pair_t;
-
-static size_t work_chunk(uint64_t const count)
+/* share: the number of checks running at the same time, they split the memory */
+static size_t work_chunk(uint64_t const count, unsigned const share)
 {
-    size_t const max = memory_suggestion / (sizeof(id_pair_t));
+    size_t const max = memory_suggestion / (sizeof(id_pair_t) * share);
     size_t chunk = (size_t)count;
 
 #if 1
@@ -1243,25 +1672,6 @@ static size_t work_chunk(uint64_t const count)
     return chunk;
 }
 
-static void sort_key_pairs(size_t const N, id_pair_t array[/* N */])
-{
-    id_pair_t a;
-    id_pair_t b;
-    
-#define GET(P, V) ((void)(V = ((id_pair_t const *)(P))[0]))
-#define SET(P, V) ((void)((((id_pair_t *)(P))[0]) = V))
-#define CMP(A, B) (((GET(A, a)),(GET(B, b))), (a.first  < b.first  ? -1 :      \
-                                               b.first  < a.first  ?  1 :      \
-                                               a.second < b.second ? -1 :      \
-                                               b.second < a.second ?  1 : 0))
-#define SWAP(A, B, C, D) do{GET(A, a); GET(B, b); SET(A, b); SET(B, a);}while(0)
-    KSORT(array, N, sizeof(array[0]), 0, 0);
-#undef SWAP
-#undef CMP
-#undef SET
-#undef GET
-}
-
 static void sort_keys(size_t const N, int64_t array[/* N */])
 {
 #define INDEXOF(A) (((int64_t const *)(A)) - ((int64_t const *)(&array[0])))
@@ -1286,7 +1696,8 @@ static size_t load_key_pairs(int64_t const startId,
                              VCursor const *const acurs,
                              ColumnInfo *const aci,
                              int64_t plast[],
-                             rc_t Rc[])
+                             rc_t Rc[],
+                             unsigned const threads)
 {
     int64_t last_fkey = INT64_MIN;
     int64_t row = startId;
@@ -1339,7 +1750,7 @@ static size_t load_key_pairs(int64_t const startId,
         }
     }
     if (!ordered)
-        sort_key_pairs(j, pair);
+        sort_key_pairs(j, pair, threads);
     
     Rc[0] = 0;
     return j;
@@ -1369,7 +1780,8 @@ static rc_t ric_align_generic(int64_t const startId,
                               VCursor const *const acurs,
                               ColumnInfo *const aci,
                               VCursor const *const bcurs,
-                              ColumnInfo *const bci
+                              ColumnInfo *const bci,
+                              unsigned const threads
                               )
 {
     int64_t chunk;
@@ -1380,7 +1792,7 @@ static rc_t ric_align_generic(int64_t const startId,
     for (chunk = startId; chunk < endId; ) {
         rc_t rc = 0;
         int64_t last;
-        size_t const n = load_key_pairs(chunk, endId, pairs, pair, acurs, aci, &last, &rc);
+        size_t const n = load_key_pairs(chunk, endId, pairs, pair, acurs, aci, &last, &rc, threads);
         size_t i;
         int64_t cur_fkey = 0;
         uint32_t elem_count = 0;
@@ -1469,10 +1881,120 @@ static rc_t ric_align_generic(int64_t const startId,
     return 0;
 }
 
+/* one slice of the id-range of the 'a'-table, checked with its own cursors */
+typedef struct ric_slice_s {
+    VTable const *atbl;
+    VTable const *btbl;
+    char const *aname;
+    char const *bname;
+    int64_t startId;
+    uint64_t count;
+    size_t pairs;
+    rc_t rc;
+} ric_slice_t;
+
+static rc_t CC ric_slice_thread(KThread const *self, void *data)
+{
+    ric_slice_t *const slice = data;
+    VCursor const *acurs = NULL;
+    VCursor const *bcurs = NULL;
+    ColumnInfo aci;
+    ColumnInfo bci;
+    rc_t rc;
+
+    aci.name = slice->aname;
+    bci.name = slice->bname;
+
+    rc = VTableCreateCursorRead(slice->atbl, &acurs);
+    if (rc == 0)
+        rc = VCursorAddColumn(acurs, &aci.idx, "%s", aci.name);
+    if (rc == 0)
+        rc = VCursorOpen(acurs);
+    if (rc == 0)
+        rc = VTableCreateCursorRead(slice->btbl, &bcurs);
+    if (rc == 0)
+        rc = VCursorAddColumn(bcurs, &bci.idx, "%s", bci.name);
+    if (rc == 0)
+        rc = VCursorOpen(bcurs);
+    if (rc == 0) {
+        id_pair_t *const pair = malloc(sizeof(id_pair_t) * slice->pairs);
+
+        if (pair) {
+            void *scratch = NULL;
+
+            rc = ric_align_generic(slice->startId, slice->count, slice->pairs,
+                                   pair, &scratch, acurs, &aci, bcurs, &bci, 1);
+            if (scratch)
+                free(scratch);
+            free(pair);
+        }
+        else
+            rc = RC(rcExe, rcDatabase, rcValidating, rcMemory, rcExhausted);
+    }
+    VCursorRelease(acurs);
+    VCursorRelease(bcurs);
+    slice->rc = rc;
+    return rc;
+}
+
+/* splits the id-range into one slice per thread, the pairs of the memory
+   budget are shared between the slices; returns the rc of the first slice
+   that failed, in id-order, like the sequential check would */
+static rc_t ric_align_parallel(int64_t const startId,
+                               uint64_t const count,
+                               size_t const pairs,
+                               VTable const *atbl,
+                               char const aname[],
+                               VTable const *btbl,
+                               char const bname[],
+                               unsigned threads)
+{
+    ric_slice_t slice[MAX_THREADS];
+    KThread *tid[MAX_THREADS];
+    uint64_t per_slice;
+    unsigned i, started = 0;
+    rc_t rc = 0;
+
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    per_slice = (count + threads - 1) / threads;
+    for (i = 0; i < threads; ++i) {
+        uint64_t const first = i * per_slice;
+
+        slice[i].atbl = atbl;
+        slice[i].btbl = btbl;
+        slice[i].aname = aname;
+        slice[i].bname = bname;
+        slice[i].startId = startId + first;
+        slice[i].count = first >= count ? 0
+                       : count - first < per_slice ? count - first : per_slice;
+        slice[i].pairs = pairs / threads > 0 ? pairs / threads : 1;
+        slice[i].rc = 0;
+    }
+    for (i = 0; i < threads && rc == 0; ++i) {
+        if (slice[i].count == 0)
+            break;
+        rc = KThreadMake(&tid[i], ric_slice_thread, &slice[i]);
+        if (rc == 0)
+            ++started;
+    }
+    for (i = 0; i < started; ++i) {
+        rc_t rc_thread;
+
+        KThreadWait(tid[i], &rc_thread);
+        KThreadRelease(tid[i]);
+    }
+    for (i = 0; i < started && rc == 0; ++i)
+        rc = slice[i].rc;
+    return rc;
+}
+
 static rc_t ric_align_ref_and_align(char const dbname[],
                                     VTable const *ref,
                                     VTable const *align,
-                                    int which)
+                                    int which,
+                                    unsigned share,
+                                    unsigned threads)
 {
     char const *const id_col_name = which == 0 ? "PRIMARY_ALIGNMENT_IDS"
                                   : which == 1 ? "SECONDARY_ALIGNMENT_IDS"
@@ -1511,16 +2033,22 @@ static rc_t ric_align_ref_and_align(char const dbname[],
                 "reference table can not be read", "name=%s", dbname));
     }
     if (rc == 0) {
-        size_t const chunk = work_chunk(count);
-        id_pair_t *const pair = malloc(sizeof(id_pair_t) * chunk);
+        size_t const chunk = work_chunk(count, share);
+        bool const parallel = threads > 1 && count >= RIC_PARALLEL_MIN;
+        id_pair_t *const pair = parallel ? NULL : malloc(sizeof(id_pair_t) * chunk);
+
+        if (pair || parallel) {
+            if (parallel)
+                rc = ric_align_parallel(startId, count, chunk, align, aci.name,
+                                        ref, bci.name, threads);
+            else {
+                void *scratch = NULL;
 
-        if (pair) {
-            void *scratch = NULL;
-            
-            rc = ric_align_generic(startId, count, chunk, pair, &scratch,
-                                   acurs, &aci, bcurs, &bci);
-            if (scratch)
-                free(scratch);
+                rc = ric_align_generic(startId, count, chunk, pair, &scratch,
+                                       acurs, &aci, bcurs, &bci, threads);
+                if (scratch)
+                    free(scratch);
+            }
 
             if (GetRCObject(rc) == (enum RCObject)rcData && GetRCState(rc) == rcUnexpected)
                 (void)PLOGERR(klogErr, (klogErr, rc,
@@ -1559,7 +2087,9 @@ static rc_t ric_align_ref_and_align(char const dbname[],
 
 static rc_t ric_align_seq_and_pri(char const dbname[],
                                   VTable const *seq,
-                                  VTable const *pri)
+                                  VTable const *pri,
+                                  unsigned share,
+                                  unsigned threads)
 {
     rc_t rc;
     VCursor const *acurs = NULL;
@@ -1593,16 +2123,23 @@ static rc_t ric_align_seq_and_pri(char const dbname[],
                 "sequence table can not be read", "name=%s", dbname));
     }
     if (rc == 0) {
-        size_t const chunk = work_chunk(count);
-        id_pair_t *const pair = malloc((sizeof(id_pair_t)+sizeof(int64_t)) * chunk);
+        size_t const chunk = work_chunk(count, share);
+        bool const parallel = threads > 1 && count >= RIC_PARALLEL_MIN;
+        id_pair_t *const pair = parallel ? NULL
+                              : malloc((sizeof(id_pair_t)+sizeof(int64_t)) * chunk);
+
+        if (pair || parallel) {
+            if (parallel)
+                rc = ric_align_parallel(startId, count, chunk, pri, aci.name,
+                                        seq, bci.name, threads);
+            else {
+                void *scratch = NULL;
 
-        if (pair) {
-            void *scratch = NULL;
-            
-            rc = ric_align_generic(startId, count, chunk, pair, &scratch,
-                                   acurs, &aci, bcurs, &bci);
-            if (scratch)
-                free(scratch);
+                rc = ric_align_generic(startId, count, chunk, pair, &scratch,
+                                       acurs, &aci, bcurs, &bci, threads);
+                if (scratch)
+                    free(scratch);
+            }
             
             if (GetRCObject(rc) == (enum RCObject)rcData && GetRCState(rc) == rcUnexpected)
                 (void)PLOGERR(klogErr, (klogErr, rc,
@@ -1876,7 +2413,7 @@ static rc_t ridc_align_seq_pri_sec(const vdb_validate_params *pb,
 
             if (!ordered)
             {
-                sort_key_pairs(i_count, seq_spot_id_pairs);
+                sort_key_pairs(i_count, seq_spot_id_pairs, num_threads);
             }
 
             // Load chunk of PRIMARY_ALIGNMENT_ID (and some other fields) and sort ids for faster data retrieval
@@ -1956,7 +2493,7 @@ static rc_t ridc_align_seq_pri_sec(const vdb_validate_params *pb,
 
             if (!ordered)
             {
-                sort_key_pairs(i_count, pri_id_pairs);
+                sort_key_pairs(i_count, pri_id_pairs, num_threads);
             }
 
             for ( i = 0; i < i_count; ++i )
@@ -2181,6 +2718,48 @@ static rc_t ridc_align_seq_pri_sec(const vdb_validate_params *pb,
 }
 
 /* database referential integrity check for alignment database */
+typedef struct ric_job_t {
+    char const *dbname;
+    VTable const *a;
+    VTable const *b;
+    unsigned share;
+    unsigned threads;
+    rc_t rc;
+} ric_job_t;
+
+static rc_t CC ric_seq_and_pri_thread(const KThread *self, void *data)
+{
+    ric_job_t *const job = data;
+
+    job->rc = ric_align_seq_and_pri(job->dbname, job->a, job->b,
+                                    job->share, job->threads);
+    return 0;
+}
+
+static void ric_report_seq_and_pri(char const dbname[], rc_t rc2, rc_t *rc)
+{
+    if (rc2 == 0) {
+        (void)PLOGMSG(klogInfo, (klogInfo, "Database '$(dbname)': "
+           "SEQUENCE.PRIMARY_ALIGNMENT_ID <-> PRIMARY_ALIGNMENT.SEQ_SPOT_ID"
+           " referential integrity ok", "dbname=%s", dbname));
+    }
+    if (*rc == 0) {
+        *rc = rc2;
+    }
+}
+
+static void ric_report_ref_and_align(char const dbname[], rc_t rc2, rc_t *rc)
+{
+    if (rc2 == 0) {
+        (void)PLOGMSG(klogInfo, (klogInfo, "Database '$(dbname)': "
+            "REFERENCE.PRIMARY_ALIGNMENT_IDS <-> PRIMARY_ALIGNMENT.REF_ID "
+            "referential integrity ok", "dbname=%s", dbname));
+    }
+    if (*rc == 0) {
+        *rc = rc2;
+    }
+}
+
 static rc_t dbric_align(const vdb_validate_params *pb,
                         char const dbname[],
                         VTable const *pri,
@@ -2190,29 +2769,39 @@ static rc_t dbric_align(const vdb_validate_params *pb,
 {
     rc_t rc = 0;
 
-    if ((rc == 0 || exhaustive) && (pri != NULL && seq != NULL)) {
-        rc_t rc2 = ric_align_seq_and_pri(dbname, seq, pri);
-
-        if (rc2 == 0) {
-            (void)PLOGMSG(klogInfo, (klogInfo, "Database '$(dbname)': "
-               "SEQUENCE.PRIMARY_ALIGNMENT_ID <-> PRIMARY_ALIGNMENT.SEQ_SPOT_ID"
-               " referential integrity ok", "dbname=%s", dbname));
+    if (num_threads > 1 && pri != NULL && seq != NULL && ref != NULL) {
+        /* both table pairs are independent: check them side by side,
+         * each with half of the memory budget and half of the threads */
+        unsigned const half = num_threads / 2;
+        ric_job_t job = { dbname, seq, pri, 2, half, 0 };
+        KThread *thread = NULL;
+        rc_t rc2;
+
+        if (KThreadMake(&thread, ric_seq_and_pri_thread, &job) != 0) {
+            thread = NULL;
+            job.share = 1;
+            job.threads = num_threads;
+            ric_seq_and_pri_thread(NULL, &job);
         }
-        if (rc == 0) {
-            rc = rc2;
+        rc2 = ric_align_ref_and_align(dbname, ref, pri, 0,
+                                      thread ? 2 : 1,
+                                      thread ? num_threads - half : num_threads);
+        if (thread) {
+            KThreadWait(thread, NULL);
+            KThreadRelease(thread);
         }
+        /* both ran: both report, as with --exhaustive; the rc is that of
+         * the first failing check in the serial order */
+        ric_report_seq_and_pri(dbname, job.rc, &rc);
+        ric_report_ref_and_align(dbname, rc2, &rc);
     }
-    if ((rc == 0 || exhaustive) && (pri != NULL && ref != NULL)) {
-        rc_t rc2 = ric_align_ref_and_align(dbname, ref, pri, 0);
-
-        if (rc2 == 0) {
-            (void)PLOGMSG(klogInfo, (klogInfo, "Database '$(dbname)': "
-                "REFERENCE.PRIMARY_ALIGNMENT_IDS <-> PRIMARY_ALIGNMENT.REF_ID "
-                "referential integrity ok", "dbname=%s", dbname));
-        }
-        if (rc == 0) {
-            rc = rc2;
-        }
+    else {
+        if ((rc == 0 || exhaustive) && (pri != NULL && seq != NULL))
+            ric_report_seq_and_pri(dbname,
+                ric_align_seq_and_pri(dbname, seq, pri, 1, num_threads), &rc);
+        if ((rc == 0 || exhaustive) && (pri != NULL && ref != NULL))
+            ric_report_ref_and_align(dbname,
+                ric_align_ref_and_align(dbname, ref, pri, 0, 1, num_threads), &rc);
     }
     if (pb->sdc_enabled && (rc == 0 || exhaustive) && (pri != NULL && sec != NULL && seq != NULL)) {
         rc_t rc2 = ridc_align_seq_pri_sec(pb, dbname, seq, pri, sec);
@@ -2448,6 +3037,74 @@ rc_t get_platform(const VDBManager *mgr,
     return rc;
 }
 
+/* a percentage as given on the command line, or a number of rows */
+static
+uint64_t ledger_sdc_value ( bool in_percent, double percent, uint64_t number )
+{
+    return in_percent ? ( uint64_t ) ( percent * 100 + 0.5 ) : number;
+}
+
+static
+uint32_t ledger_checks ( const vdb_validate_params *pb )
+{
+    if ( s_IndexOnly )
+        return ledger_index;
+    return ( pb -> md5_chk ? ledger_md5 : 0 )
+         | ( pb -> blob_crc ? ledger_blob_crc : 0 )
+         | ( pb -> index_chk ? ledger_index : 0 )
+         | ( ref_int_check ? ledger_ref_int : 0 )
+         | ( pb -> sdc_enabled ? ledger_sdc : 0 )
+         | ( pb -> consist_check ? ledger_consist : 0 )
+         | ( pb -> exhaustive ? ledger_exhaustive : 0 )
+         ;
+}
+
+/* the parameters of the data integrity checks, as a digest */
+static
+uint32_t ledger_sdc_params ( const vdb_validate_params *pb )
+{
+    char text [ 256 ];
+    size_t num_writ;
+
+    if ( ! pb -> sdc_enabled )
+        return 0;
+    if ( string_printf ( text, sizeof text, & num_writ,
+                         "sdc:rows=%lu%s,sdc:seq-rows=%lu%s,sdc:plen_thold=%lu%s",
+                         ledger_sdc_value ( pb -> sdc_sec_rows_in_percent,
+                                            pb -> sdc_sec_rows.percent,
+                                            pb -> sdc_sec_rows.number ),
+                         pb -> sdc_sec_rows_in_percent ? "%" : "",
+                         ledger_sdc_value ( pb -> sdc_seq_rows_in_percent,
+                                            pb -> sdc_seq_rows.percent,
+                                            pb -> sdc_seq_rows.number ),
+                         pb -> sdc_seq_rows_in_percent ? "%" : "",
+                         ledger_sdc_value ( pb -> sdc_pa_len_thold_in_percent,
+                                            pb -> sdc_pa_len_thold.percent,
+                                            pb -> sdc_pa_len_thold.number ),
+                         pb -> sdc_pa_len_thold_in_percent ? "%" : "" ) != 0 )
+        return 0;
+    return ledger_params ( text );
+}
+
+/* true if the ledger says the object is unchanged since it passed */
+static
+bool ledger_lookup ( const vdb_validate_params *pb, const char *path, bool is_file,
+    char *key, size_t key_size, uint8_t digest [ LEDGER_DIGEST_SIZE ], bool *have_digest )
+{
+    * have_digest = false;
+    if ( pb -> ledger == NULL )
+        return false;
+
+    if ( KDirectoryResolvePath ( pb -> wd, true, key, key_size, "%s", path ) != 0 )
+        return false;
+    if ( ledger_fingerprint ( pb -> wd, path, is_file, digest ) != 0 )
+        return false;
+
+    * have_digest = true;
+    return ! pb -> full && ledger_passed ( pb -> ledger, key, digest,
+                                              ledger_checks ( pb ), ledger_sdc_params ( pb ) );
+}
+
 static
 rc_t dbcc ( const vdb_validate_params *pb, const char *path, bool is_file )
 {
@@ -2455,8 +3112,20 @@ rc_t dbcc ( const vdb_validate_params *pb, const char *path, bool is_file )
     KPathType pathType = kptNotFound;
     node_t *nodes = NULL;
     const char *obj_type, *obj_name;
+    char key [ 4096 ];
+    uint8_t digest [ LEDGER_DIGEST_SIZE ];
+    bool have_digest;
+    rc_t rc;
 
-    rc_t rc = init_dbcc ( pb -> wd, path, is_file, & nodes, & names, & pathType );
+    if ( ledger_lookup ( pb, path, is_file, key, sizeof key, digest, & have_digest ) )
+    {
+        PLOGMSG ( klogInfo, ( klogInfo,
+                              "'$(path)' is unchanged since it was validated, skipped"
+                             , "path=%s", path ) );
+        return 0;
+    }
+
+    rc = init_dbcc ( pb -> wd, path, is_file, & nodes, & names, & pathType );
     if ( rc == 0 )
     {
         /* construct mode */
@@ -2495,6 +3164,9 @@ rc_t dbcc ( const vdb_validate_params *pb, const char *path, bool is_file )
                               "$(objType) '$(objName)' is consistent"
                              , "objType=%s,objName=%s"
                              , obj_type, obj_name ) );
+        if ( have_digest )
+            ledger_record ( pb -> ledger, key, digest,
+                            ledger_checks ( pb ), ledger_sdc_params ( pb ) );
     }
 
     free ( nodes );
@@ -2878,6 +3550,27 @@ static const char *USAGE_SDC_SEQ_ROWS[] =
   "Specifying 0 will iterate the whole table. Can be in percent (e.g. 5%)",
   NULL };
 
+#define ALIAS_THREADS  "j"
+#define OPTION_THREADS "threads"
+static const char *USAGE_THREADS[] =
+{ "Number of threads for referential integrity and blob checksum checks "
+  "(default: 1)", NULL };
+
+#define OPTION_LEDGER "ledger"
+static const char *USAGE_LEDGER[] =
+{ "Validation ledger file: objects which passed the same checks before and "
+  "did not change since are skipped, the ledger is updated with the objects "
+  "which pass", NULL };
+
+#define OPTION_FULL "full"
+static const char *USAGE_FULL[] =
+{ "Validate all objects even if the ledger has them as unchanged", NULL };
+
+#define OPTION_MAX_RATE "max-rate"
+static const char *USAGE_MAX_RATE[] =
+{ "Limit reading for blob checksum checks to this many bytes per second, "
+  "can have a suffix K, M or G (default: no limit)", NULL };
+
 #define OPTION_SDC_PLEN_THOLD "sdc:plen_thold"
 static const char *USAGE_SDC_PLEN_THOLD[] =
 { "Specify a threshold for amount of secondary alignment which are shorter (hard-clipped) than corresponding primaries, default 1%.", NULL };
@@ -2902,6 +3595,10 @@ static OptDef options [] =
   , { OPTION_CNS_CHK , ALIAS_CNS_CHK , NULL, USAGE_CNS_CHK , 1, true , false }
 
     /* secondary alignment table data check options */
+  , { OPTION_THREADS , ALIAS_THREADS , NULL, USAGE_THREADS , 1, true , false }
+  , { OPTION_MAX_RATE, NULL          , NULL, USAGE_MAX_RATE, 1, true , false }
+  , { OPTION_LEDGER  , NULL          , NULL, USAGE_LEDGER  , 1, true , false }
+  , { OPTION_FULL    , NULL          , NULL, USAGE_FULL    , 1, false, false }
   , { OPTION_SDC_SEC_ROWS, NULL      , NULL, USAGE_SDC_SEC_ROWS, 1, true , false }
   , { OPTION_SDC_SEQ_ROWS, NULL      , NULL, USAGE_SDC_SEQ_ROWS, 1, true , false }
   , { OPTION_SDC_PLEN_THOLD, NULL    , NULL, USAGE_SDC_PLEN_THOLD, 1, true , false }
@@ -2958,6 +3655,10 @@ rc_t CC Usage ( const Args * args )
     HelpOptionLine(ALIAS_REF_INT , OPTION_REF_INT , "yes | no", USAGE_REF_INT);
     HelpOptionLine(ALIAS_CNS_CHK , OPTION_CNS_CHK , "yes | no", USAGE_CNS_CHK);
     HelpOptionLine(ALIAS_EXHAUSTIVE, OPTION_EXHAUSTIVE, NULL, USAGE_EXHAUSTIVE);
+    HelpOptionLine(ALIAS_THREADS , OPTION_THREADS , "count"   , USAGE_THREADS);
+    HelpOptionLine(NULL          , OPTION_MAX_RATE, "bytes"   , USAGE_MAX_RATE);
+    HelpOptionLine(NULL          , OPTION_LEDGER  , "path"    , USAGE_LEDGER);
+    HelpOptionLine(NULL          , OPTION_FULL    , NULL      , USAGE_FULL);
     HelpOptionLine(NULL          , OPTION_SDC_SEC_ROWS, "rows"    , USAGE_SDC_SEC_ROWS);
     HelpOptionLine(NULL          , OPTION_SDC_SEQ_ROWS, "rows"    , USAGE_SDC_SEQ_ROWS);
     HelpOptionLine(NULL          , OPTION_SDC_PLEN_THOLD, "threshold", USAGE_SDC_PLEN_THOLD);
@@ -3261,6 +3962,107 @@ rc_t parse_args ( vdb_validate_params *pb, Args *args )
         }
     }
 
+    {
+        rc = ArgsOptionCount ( args, OPTION_THREADS, &cnt );
+        if (rc)
+        {
+            LOGERR (klogInt, rc, "ArgsOptionCount() failed for " OPTION_THREADS);
+            return rc;
+        }
+
+        if (cnt > 0)
+        {
+            uint64_t value;
+            rc = ArgsOptionValue ( args, OPTION_THREADS, 0, (const void **) &dummy );
+            if (rc)
+            {
+                LOGERR (klogInt, rc, "ArgsOptionValue() failed for " OPTION_THREADS);
+                return rc;
+            }
+
+            value = string_to_U64 ( dummy, string_size ( dummy ), &rc );
+            if (rc)
+            {
+                LOGERR (klogInt, rc, "string_to_U64() failed for " OPTION_THREADS);
+                return rc;
+            }
+            if (value == 0)
+                value = 1;
+            num_threads = value > MAX_THREADS ? MAX_THREADS : (unsigned)value;
+        }
+    }
+    {
+        rc = ArgsOptionCount ( args, OPTION_MAX_RATE, &cnt );
+        if (rc)
+        {
+            LOGERR (klogInt, rc, "ArgsOptionCount() failed for " OPTION_MAX_RATE);
+            return rc;
+        }
+
+        if (cnt > 0)
+        {
+            uint64_t value;
+            uint64_t unit = 1;
+            size_t value_size;
+            rc = ArgsOptionValue ( args, OPTION_MAX_RATE, 0, (const void **) &dummy );
+            if (rc)
+            {
+                LOGERR (klogInt, rc, "ArgsOptionValue() failed for " OPTION_MAX_RATE);
+                return rc;
+            }
+
+            value_size = string_size ( dummy );
+            if ( value_size >= 1 )
+            {
+                switch ( dummy[value_size - 1] )
+                {
+                case 'k': case 'K': unit = 1024; break;
+                case 'm': case 'M': unit = 1024 * 1024; break;
+                case 'g': case 'G': unit = 1024 * 1024 * 1024; break;
+                }
+                if ( unit != 1 )
+                    --value_size;
+            }
+            value = string_to_U64 ( dummy, value_size, &rc );
+            if (rc)
+            {
+                LOGERR (klogInt, rc, "string_to_U64() failed for " OPTION_MAX_RATE);
+                return rc;
+            }
+            max_bytes_per_sec = value * unit;
+        }
+    }
+
+    {
+        rc = ArgsOptionCount ( args, OPTION_FULL, &cnt );
+        if (rc)
+        {
+            LOGERR (klogInt, rc, "ArgsOptionCount() failed for " OPTION_FULL);
+            return rc;
+        }
+        pb->full = cnt != 0;
+
+        rc = ArgsOptionCount ( args, OPTION_LEDGER, &cnt );
+        if (rc)
+        {
+            LOGERR (klogInt, rc, "ArgsOptionCount() failed for " OPTION_LEDGER);
+            return rc;
+        }
+
+        if (cnt > 0)
+        {
+            rc = ArgsOptionValue ( args, OPTION_LEDGER, 0, (const void **) &dummy );
+            if (rc)
+            {
+                LOGERR (klogInt, rc, "ArgsOptionValue() failed for " OPTION_LEDGER);
+                return rc;
+            }
+            rc = ledger_make ( &pb->ledger, dummy );
+            if (rc)
+                return rc;
+        }
+    }
+
     if ( pb -> blob_crc || pb -> index_chk )
         pb -> md5_chk = pb -> md5_chk_explicit;
 
@@ -3272,6 +4074,7 @@ rc_t parse_args ( vdb_validate_params *pb, Args *args )
 static
 void vdb_validate_params_whack ( vdb_validate_params *pb )
 {
+    ledger_release ( pb -> ledger );
     VDBManagerRelease ( pb -> vmgr );
     KDBManagerRelease ( pb -> kmgr );
     KDirectoryRelease ( pb -> wd );
@@ -3369,6 +4172,14 @@ static rc_t main_with_args(Args *const args)
                             if ( rc == 0 )
                                 rc = rc2;
                         }
+                        if ( pb.ledger != NULL )
+                        {
+                            /* writes the ledger back */
+                            rc_t rc2 = ledger_release ( pb.ledger );
+                            pb.ledger = NULL;
+                            if ( rc == 0 )
+                                rc = rc2;
+                        }
                     }
                 }
 
@@ -28,6 +28,7 @@
 #include <vector>
 #include <array>
 #include <map>
+#include <queue>
 #include <string>
 #include <stdexcept>
 #include <cstdint>
@@ -104,6 +105,14 @@ struct IndexRow {
         }
         return false;
     }
+    /// key order, with ties broken by row, so that the first row of a key is its smallest
+    static bool keyRowLess(IndexRow const &a, IndexRow const &b) {
+        for (auto i = 0; i < 8; ++i) {
+            if (a.key[i] < b.key[i]) return true;
+            if (a.key[i] > b.key[i]) return false;
+        }
+        return a.row < b.row;
+    }
     static bool rowLess(IndexRow const &a, IndexRow const &b) {
         return a.row < b.row;
     }
@@ -226,7 +235,7 @@ struct Context {
                     newWork.clear();
                     if (unit.size() <= smallSize) {
                         // sort in one shot
-                        std::sort(unit.beg, unit.end, IndexRow::keyLess);
+                        std::sort(unit.beg, unit.end, IndexRow::keyRowLess);
                         if (unit.beg >= src && unit.end <= srcEnd)
                             std::copy(unit.beg, unit.end, out + (unit.beg - src));
                     }
@@ -326,6 +335,26 @@ static size_t getSmallSize(int const workers)
 }
 #endif
 
+/// sorts N index rows from src into out; the contents of src are destroyed
+static void sortRows(uint64_t const N, IndexRow *const src, IndexRow *const out)
+{
+    auto const workers = getWorkerCount();
+    auto const smallSize = getSmallSize(workers);
+    auto context = Context(src, out, N, smallSize);
+    auto tids = std::vector<pthread_t>();
+    
+    for (auto i = 1; i < workers; ++i) {
+        pthread_t tid = 0;
+        
+        if (pthread_create(&tid, nullptr, worker, &context) == 0)
+            tids.push_back(tid);
+    }
+    worker(&context);
+    // the context is on this stack, so wait for the others to let go of it
+    for (auto && tid : tids)
+        pthread_join(tid, nullptr);
+}
+
 static void sortIndex(uint64_t const N, IndexRow *const index)
 {
     auto const scratch = reinterpret_cast<IndexRow *>(malloc(N * sizeof(IndexRow)));
@@ -333,19 +362,7 @@ static void sortIndex(uint64_t const N, IndexRow *const index)
         perror("error: insufficient memory to create temporary index");
         exit(1);
     }
-    {
-        auto const workers = getWorkerCount();
-        auto const smallSize = getSmallSize(workers);
-        auto context = Context(index, scratch, N, smallSize);
-        
-        for (auto i = 1; i < workers; ++i) {
-            pthread_t tid = 0;
-            
-            pthread_create(&tid, nullptr, worker, &context);
-            pthread_detach(tid);
-        }
-        worker(&context);
-    }
+    sortRows(N, index, scratch);
     uint64_t keys = 1;
     {
         auto last = scratch->key64();
@@ -391,19 +408,292 @@ static void sortIndex(uint64_t const N, IndexRow *const index)
     free(scratch);
 }
 
-static std::pair<IndexRow *, size_t> makeIndex(VDB::Database const &run)
+static std::string tmpDir;
+static size_t memLimit = 0; ///< when not 0, the index is sorted out-of-core using at most this many bytes of memory
+
+static FILE *tempFile()
+{
+    auto path = tmpDir + "/reorder-ir.XXXXXX";
+    auto name = std::vector<char>(path.begin(), path.end());
+    name.push_back('\0');
+    
+    auto const fd = mkstemp(name.data());
+    if (fd < 0) {
+        std::cerr << "error: failed to create temporary file in " << tmpDir << std::endl;
+        exit(1);
+    }
+    unlink(name.data()); ///< it goes away when it is closed
+    auto const fp = fdopen(fd, "w+b");
+    if (fp == NULL) {
+        std::cerr << "error: failed to open temporary file in " << tmpDir << std::endl;
+        exit(1);
+    }
+    return fp;
+}
+
+static void writeRows(FILE *const fp, IndexRow const *const rows, size_t const count)
+{
+    if (fwrite(rows, sizeof(IndexRow), count, fp) != count) {
+        std::cerr << "error: failed to write temporary file in " << tmpDir << std::endl;
+        exit(1);
+    }
+}
+
+/// a sorted chunk of index rows, spilled to a temporary file
+struct IndexRun {
+    std::vector<IndexRow> buffer;
+    size_t cur;
+    size_t blockSize; ///< rows read at once
+    FILE *fp;
+    
+    IndexRun(FILE *fp) : cur(0), blockSize(1024), fp(fp) {}
+    IndexRun(IndexRun &&other) noexcept : buffer(std::move(other.buffer)), cur(other.cur), blockSize(other.blockSize), fp(other.fp) { other.fp = nullptr; }
+    ~IndexRun() { if (fp) fclose(fp); }
+    
+    bool next(IndexRow &result) {
+        if (cur == buffer.size()) {
+            if (fp == nullptr) return false;
+            buffer.resize(blockSize);
+            auto const n = fread(buffer.data(), sizeof(IndexRow), blockSize, fp);
+            buffer.resize(n);
+            cur = 0;
+            if (n == 0) {
+                fclose(fp);
+                fp = nullptr;
+                buffer.shrink_to_fit();
+                return false;
+            }
+        }
+        result = buffer[cur++];
+        return true;
+    }
+};
+
+/// sorts index rows, by key and then row, in a bounded amount of memory;
+/// the rows are collected in chunks, each chunk is sorted by the worker pool
+/// and spilled to a temporary file, and the spilled chunks are merged
+class IndexSorter {
+    struct HeadOrder {
+        bool operator ()(std::pair<IndexRow, unsigned> const &a, std::pair<IndexRow, unsigned> const &b) const {
+            return IndexRow::keyRowLess(b.first, a.first);
+        }
+    };
+    size_t const memLimit;
+    size_t const capacity; ///< rows in a chunk; a chunk and its scratch space are the memory limit
+    size_t used;
+    IndexRow *chunk;
+    IndexRow *scratch;
+    std::vector<IndexRun> runs;
+    std::priority_queue<std::pair<IndexRow, unsigned>, std::vector<std::pair<IndexRow, unsigned>>, HeadOrder> heads;
+    
+    void spill() {
+        if (used == 0) return;
+        
+        sortRows(used, chunk, scratch);
+        auto const fp = tempFile();
+        writeRows(fp, scratch, used);
+        if (fflush(fp) != 0) {
+            std::cerr << "error: failed to write temporary file in " << tmpDir << std::endl;
+            exit(1);
+        }
+        rewind(fp);
+        runs.emplace_back(fp);
+        used = 0;
+    }
+public:
+    IndexSorter(IndexSorter const &) = delete;
+    IndexSorter(size_t memLimit)
+    : memLimit(memLimit)
+    , capacity(std::max(size_t(1024), memLimit / (2 * sizeof(IndexRow))))
+    , used(0)
+    , chunk(nullptr)
+    , scratch(nullptr)
+    {}
+    ~IndexSorter() {
+        free(chunk);
+        free(scratch);
+    }
+    
+    void add(IndexRow const &row) {
+        if (chunk == nullptr) {
+            // allocated on first use, so that a sorter can wait for memory held by another one
+            chunk = reinterpret_cast<IndexRow *>(malloc(capacity * sizeof(IndexRow)));
+            scratch = reinterpret_cast<IndexRow *>(malloc(capacity * sizeof(IndexRow)));
+            if (chunk == NULL || scratch == NULL) {
+                perror("error: insufficient memory to create temporary index");
+                exit(1);
+            }
+        }
+        chunk[used++] = row;
+        if (used == capacity)
+            spill();
+    }
+    
+    /// no more rows: the chunk memory is freed and the merge can begin;
+    /// the read buffers of the merge use half of the memory limit
+    void finish() {
+        spill();
+        free(chunk);
+        free(scratch);
+        chunk = scratch = nullptr;
+        
+        auto const blockSize = std::max(size_t(1024), memLimit / (2 * sizeof(IndexRow) * std::max(size_t(1), runs.size())));
+        for (auto i = 0u; i < runs.size(); ++i) {
+            auto head = IndexRow();
+            runs[i].blockSize = blockSize;
+            if (runs[i].next(head))
+                heads.emplace(head, i);
+        }
+    }
+    
+    /// the next row in sorted order; false at the end
+    bool next(IndexRow &result) {
+        if (heads.empty()) return false;
+        
+        auto const top = heads.top();
+        heads.pop();
+        result = top.first;
+        auto head = IndexRow();
+        if (runs[top.second].next(head))
+            heads.emplace(head, top.second);
+        return true;
+    }
+    
+    size_t chunks() const { return runs.size(); }
+};
+
+/// an index row keyed by the offset of the first row of its group, instead of by hash;
+/// the offset is stored big-endian and shifted up, so that the radix sort sees its top bits first
+static IndexRow makeGroupRow(uint64_t const offset, int const shift, VDB::Cursor::RowID const row)
+{
+    IndexRow y;
+    auto const value = offset << shift;
+    
+    for (auto i = 0; i < 8; ++i)
+        y.key[i] = uint8_t(value >> (56 - 8 * i));
+    y.row = row;
+    return y;
+}
+
+/// the clustering index; it is in memory or it is mapped from a temporary file
+struct Index {
+    IndexRow *rows;
+    size_t count;
+    bool mapped;
+    
+    Index() : rows(nullptr), count(0), mapped(false) {}
+    void release() {
+        if (mapped)
+            munmap(rows, count * sizeof(IndexRow));
+        else
+            delete [] rows;
+        rows = nullptr;
+        count = 0;
+    }
+};
+
+/* Produces the same clustering as sortIndex, using at most about memLimit bytes:
+ * 1. the keyed rows are sorted by key and row in chunks, and merged;
+ * 2. in one streaming pass over the merge, each row is re-keyed by the first row of its key;
+ * 3. the re-keyed rows are sorted the same way and merged into a temporary file, which is mapped.
+ */
+static Index makeIndexOutOfCore(VDB::Cursor const &in, std::pair<VDB::Cursor::RowID, VDB::Cursor::RowID> const &range)
+{
+    auto const N = size_t(range.second - range.first);
+    auto const freq = N / 10.0;
+    auto const shift = __builtin_clzll(uint64_t(N));
+    auto nextReport = 1;
+    uint64_t keys = 0;
+    IndexSorter grouped(memLimit / 2);
+    {
+        IndexSorter keyed(memLimit);
+        
+        in.foreachParallel(VDB::Cursor::defaultThreads(), [&](VDB::Cursor::RowID row, std::vector<VDB::Cursor::RawData> const &data) {
+            auto const i = row - range.first;
+            keyed.add(makeIndexRow(row, data[0], data[1]));
+            while (nextReport * freq <= i) {
+                std::cerr << "progress: generating keys " << nextReport << "0%" << std::endl;;
+                ++nextReport;
+            }
+        });
+        std::cerr << "status: processed " << N << " records" << std::endl;
+        std::cerr << "status: indexing" << std::endl;
+        
+        keyed.finish();
+        std::cerr << "info: merging " << keyed.chunks() << " sorted chunks" << std::endl;
+        
+        auto row = IndexRow();
+        auto lastKey = uint64_t(0);
+        auto groupRow = VDB::Cursor::RowID(0);
+        while (keyed.next(row)) {
+            auto const key = row.key64();
+            if (keys == 0 || key != lastKey) {
+                lastKey = key;
+                groupRow = row.row;
+                ++keys;
+            }
+            grouped.add(makeGroupRow(uint64_t(groupRow - range.first), shift, row.row));
+        }
+    }
+    grouped.finish();
+    std::cerr << "info: Number of keys " << keys << std::endl;
+    
+    auto const fp = tempFile();
+    {
+        auto block = std::vector<IndexRow>();
+        auto row = IndexRow();
+        auto written = size_t(0);
+        
+        block.reserve(64 * 1024);
+        while (grouped.next(row)) {
+            block.push_back(row);
+            if (block.size() == block.capacity()) {
+                writeRows(fp, block.data(), block.size());
+                written += block.size();
+                block.clear();
+            }
+        }
+        writeRows(fp, block.data(), block.size());
+        written += block.size();
+        assert(written == N);
+    }
+    if (fflush(fp) != 0) {
+        std::cerr << "error: failed to write temporary file in " << tmpDir << std::endl;
+        exit(1);
+    }
+    auto const map = mmap(nullptr, N * sizeof(IndexRow), PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    fclose(fp); ///< the mapping keeps the file
+    if (map == MAP_FAILED) {
+        perror("error: failed to map index");
+        exit(1);
+    }
+    
+    auto result = Index();
+    result.rows = reinterpret_cast<IndexRow *>(map);
+    result.count = N;
+    result.mapped = true;
+    return result;
+}
+
+static Index makeIndex(VDB::Database const &run)
 {
     static char const *const FLDS[] = { "READ_GROUP", "NAME" };
     auto const in = run["RAW"].read(2, FLDS);
     auto const range = in.rowRange();
     auto const N = size_t(range.second - range.first);
-    if (N == 0) return std::make_pair(nullptr, N);
+    auto result = Index();
+    if (N == 0) return result;
+    
+    if (memLimit > 0 && N > memLimit / (2 * sizeof(IndexRow))) {
+        std::cerr << "status: index is larger than memory limit, sorting in chunks in " << tmpDir << std::endl;
+        return makeIndexOutOfCore(in, range);
+    }
     
     auto const index = new IndexRow[N];
     auto const freq = N / 10.0;
     auto nextReport = 1;
     
-    in.foreach([&](VDB::Cursor::RowID row, std::vector<VDB::Cursor::RawData> const &data) {
+    in.foreachParallel(VDB::Cursor::defaultThreads(), [&](VDB::Cursor::RowID row, std::vector<VDB::Cursor::RawData> const &data) {
         auto const i = row - range.first;
         index[i] = makeIndexRow(row, data[0], data[1]);
         while (nextReport * freq <= i) {
@@ -416,7 +706,9 @@ static std::pair<IndexRow *, size_t> makeIndex(VDB::Database const &run)
     
     sortIndex(N, index);
 
-    return std::make_pair(index, N);
+    result.rows = index;
+    result.count = N;
+    return result;
 }
 
 struct RawRecord : public VDB::IndexedCursorBase::Record {
@@ -546,14 +838,10 @@ static int process(std::string const &irdb, FILE *out)
     });
     writer.beginWriting();
 
-    RawRecord::IndexT *index;
-    size_t rows;
-    {
-        std::cerr << "status: creating clustering index" << std::endl;
-        auto const p = makeIndex(inDb);
-        index = static_cast<RawRecord::IndexT *>(p.first);
-        rows = p.second;
-    }
+    std::cerr << "status: creating clustering index" << std::endl;
+    auto clustering = makeIndex(inDb);
+    auto const index = static_cast<RawRecord::IndexT const *>(clustering.rows);
+    auto const rows = clustering.count;
     
     auto const in = inDb["RAW"].read(RawRecord::columns());
 
@@ -562,7 +850,7 @@ static int process(std::string const &irdb, FILE *out)
     std::cerr << "status: done" << std::endl;
 
     writer.endWriting();
-    delete [] index;
+    clustering.release();
     return result;
 }
 
@@ -571,7 +859,7 @@ using namespace utility;
 namespace reorderIR {
     static void usage(CommandLine const &commandLine, bool error) {
         (error ? std::cerr : std::cout)
-        << "usage: " << commandLine.program[0] << " [-stable] [-out=<path>] <ir db>"
+        << "usage: " << commandLine.program[0] << " [-stable] [-out=<path>] [-mem=<MB>] [-tmp=<dir>] <ir db>"
         << std::endl;
         exit(error ? 3 : 0);
     }
@@ -596,6 +884,19 @@ namespace reorderIR {
                 out = arg.substr(5);
                 continue;
             }
+            if (arg.substr(0, 5) == "-mem=") {
+                auto const value = arg.substr(5);
+                char *endp = nullptr;
+                auto const mb = strtoul(value.c_str(), &endp, 10);
+                if (value.empty() || *endp != '\0' || mb == 0)
+                    usage(commandLine, true);
+                memLimit = size_t(mb) * 1024 * 1024;
+                continue;
+            }
+            if (arg.substr(0, 5) == "-tmp=") {
+                tmpDir = arg.substr(5);
+                continue;
+            }
             if (db.empty()) {
                 db = arg;
                 continue;
@@ -605,6 +906,11 @@ namespace reorderIR {
         if (db.empty())
             usage(commandLine, true);
         
+        if (tmpDir.empty()) {
+            auto const env = getenv("TMPDIR");
+            tmpDir = env ? env : "/tmp";
+        }
+        
         if (out.empty())
             return process(db, stdout);
         
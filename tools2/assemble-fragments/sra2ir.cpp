@@ -170,7 +170,7 @@ static void processAligned(VDB::Writer const &out, VDB::Database const &inDb, bo
     };
 
     std::cerr << "processing " << (range.second - range.first) << " records from " << tblName << std::endl;
-    in.foreach(filter.empty() ? keepAll : applyFilter,
+    in.foreachParallel(VDB::Cursor::defaultThreads(), filter.empty() ? keepAll : applyFilter,
                [&](int64_t row, bool keep, std::vector<VDB::Cursor::RawData> const &data)
                {
                    if (keep) {
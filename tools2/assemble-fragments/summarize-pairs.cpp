@@ -36,6 +36,10 @@
 #include <cstdio>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
+#include <queue>
+#include <functional>
+#include <pthread.h>
 #include "utility.hpp"
 #include "vdb.hpp"
 #include "writer.hpp"
@@ -346,7 +350,265 @@ struct ContigPair { ///< a pair of contigs that are *known* to be joined, e.g. t
     }
 };
 
-static int process(VDB::Writer const &out, LineBuffer &ifs)
+static ContigPair readPair(LineBuffer &source)
+{
+    return ContigPair(source);
+}
+
+/// the order of `sort -k1,1 -k2n,2n -k3n,3n -k4,4 -k5n,5n -k6n,6n` on the text form;
+/// names are compared by rank, which is cheaper than comparing the strings
+struct PairOrder {
+    std::vector<unsigned> refRank;
+    std::vector<unsigned> groupRank;
+    
+    PairOrder() {
+        rank(refRank, references);
+        rank(groupRank, groups);
+    }
+    bool operator ()(ContigPair const &a, ContigPair const &b) const {
+        if (a.first.ref != b.first.ref) return refRank[a.first.ref] < refRank[b.first.ref];
+        if (a.first.start != b.first.start) return a.first.start < b.first.start;
+        if (a.first.end != b.first.end) return a.first.end < b.first.end;
+        if (a.second.ref != b.second.ref) return refRank[a.second.ref] < refRank[b.second.ref];
+        if (a.second.start != b.second.start) return a.second.start < b.second.start;
+        if (a.second.end != b.second.end) return a.second.end < b.second.end;
+        return groupRank[a.group] < groupRank[b.group];
+    }
+private:
+    /// names added later keep the relative order of the earlier ones,
+    /// so runs sorted before all names were known still merge correctly
+    static void rank(std::vector<unsigned> &result, strings_map const &names) {
+        auto const n = names.count();
+        auto byName = std::vector<unsigned>(n);
+        auto name = std::vector<std::string>(n);
+        for (auto i = decltype(n)(0); i < n; ++i) {
+            byName[i] = i;
+            name[i] = names[i];
+        }
+        std::sort(byName.begin(), byName.end(), [&](unsigned a, unsigned b) { return name[a] < name[b]; });
+        result.resize(n);
+        for (auto i = decltype(n)(0); i < n; ++i)
+            result[byName[i]] = i;
+    }
+};
+
+/// a sorted run of contig pairs, in memory or spilled to a temporary file
+struct PairRun {
+    std::vector<ContigPair> buffer;
+    size_t cur;
+    size_t blockSize; ///< records read at once from a spilled run
+    FILE *fp;
+    
+    PairRun() : cur(0), blockSize(1024), fp(nullptr) {}
+    PairRun(PairRun &&other) noexcept : buffer(std::move(other.buffer)), cur(other.cur), blockSize(other.blockSize), fp(other.fp) { other.fp = nullptr; }
+    ~PairRun() { if (fp) fclose(fp); }
+    
+    bool next(ContigPair &result) {
+        if (cur == buffer.size()) {
+            if (fp == nullptr) {
+                buffer.clear();
+                buffer.shrink_to_fit();
+                return false;
+            }
+            buffer.resize(blockSize);
+            auto const n = fread(buffer.data(), sizeof(ContigPair), blockSize, fp);
+            buffer.resize(n);
+            cur = 0;
+            if (n == 0) {
+                fclose(fp);
+                fp = nullptr;
+                buffer.shrink_to_fit();
+                return false;
+            }
+        }
+        result = buffer[cur++];
+        return true;
+    }
+};
+
+/// collects contig pairs; sorts them (by several threads) into one run, spills the run
+/// to a temporary file when the memory limit is reached, and merges the runs in order
+class PairSorter {
+    std::vector<ContigPair> buffer;
+    std::vector<PairRun> runs;
+    std::priority_queue<std::pair<ContigPair, unsigned>, std::vector<std::pair<ContigPair, unsigned>>, std::function<bool (std::pair<ContigPair, unsigned> const &, std::pair<ContigPair, unsigned> const &)>> heads;
+    PairOrder order;
+    std::string tmpDir;
+    size_t memLimit;
+    size_t capacity;
+    unsigned threads;
+    unsigned long long added;
+    unsigned long long merged;
+    
+    /// sorts [beg, end), or merges the sorted [beg, mid) and [mid, end) when mid is set
+    struct SortJob {
+        ContigPair *beg, *mid, *end;
+        PairOrder const *order;
+        pthread_t tid;
+    };
+    static void *sortJob(void *vp) {
+        auto const job = reinterpret_cast<SortJob *>(vp);
+        if (job->mid)
+            std::inplace_merge(job->beg, job->mid, job->end, *job->order);
+        else
+            std::sort(job->beg, job->end, *job->order);
+        return nullptr;
+    }
+    static void runJobs(std::vector<SortJob> &jobs) {
+        for (auto i = 1u; i < jobs.size(); ++i) {
+            if (pthread_create(&jobs[i].tid, nullptr, sortJob, &jobs[i]) != 0)
+                jobs[i].tid = 0;
+        }
+        sortJob(&jobs[0]);
+        for (auto i = 1u; i < jobs.size(); ++i) {
+            if (jobs[i].tid)
+                pthread_join(jobs[i].tid, nullptr);
+            else
+                sortJob(&jobs[i]);
+        }
+    }
+    
+    /// sorts the buffer in place: parts are sorted one per thread, and then
+    /// merged pairwise, also in parallel, until the buffer is one run
+    void sortBuffer() {
+        order = PairOrder();
+        auto const parts = std::max(1u, std::min(threads, unsigned(buffer.size() / 4096 + 1)));
+        auto const per = (buffer.size() + parts - 1) / parts;
+        auto bounds = std::vector<ContigPair *>();
+        auto jobs = std::vector<SortJob>();
+        
+        for (auto i = 0u; i < parts; ++i) {
+            auto const beg = std::min(buffer.size(), i * per);
+            auto const end = std::min(buffer.size(), beg + per);
+            if (beg < end || i == 0)
+                bounds.push_back(buffer.data() + beg);
+        }
+        bounds.push_back(buffer.data() + buffer.size());
+        
+        for (auto i = 0u; i + 1 < bounds.size(); ++i)
+            jobs.push_back({bounds[i], nullptr, bounds[i + 1], &order, 0});
+        runJobs(jobs);
+        
+        while (bounds.size() > 2) {
+            auto merged = std::vector<ContigPair *>();
+            jobs.clear();
+            for (auto i = 0u; i + 1 < bounds.size(); i += 2) {
+                merged.push_back(bounds[i]);
+                if (i + 2 < bounds.size())
+                    jobs.push_back({bounds[i], bounds[i + 1], bounds[i + 2], &order, 0});
+            }
+            merged.push_back(bounds.back());
+            runJobs(jobs);
+            bounds.swap(merged);
+        }
+    }
+    
+    FILE *tempFile() const {
+        auto path = tmpDir + "/summarize-pairs.XXXXXX";
+        auto name = std::vector<char>(path.begin(), path.end());
+        name.push_back('\0');
+        
+        auto const fd = mkstemp(name.data());
+        if (fd < 0) {
+            std::cerr << "failed to create temporary file in " << tmpDir << std::endl;
+            exit(3);
+        }
+        POSIX::unlink(name.data()); ///< it goes away when it is closed
+        auto const fp = fdopen(fd, "w+b");
+        if (fp == nullptr) {
+            std::cerr << "failed to open temporary file in " << tmpDir << std::endl;
+            exit(3);
+        }
+        return fp;
+    }
+    
+    void spill() {
+        auto run = PairRun();
+        
+        sortBuffer();
+        run.fp = tempFile();
+        if (fwrite(buffer.data(), sizeof(ContigPair), buffer.size(), run.fp) != buffer.size() || fflush(run.fp) != 0) {
+            std::cerr << "failed to write temporary file in " << tmpDir << std::endl;
+            exit(3);
+        }
+        rewind(run.fp);
+        runs.emplace_back(std::move(run));
+        buffer.clear();
+    }
+    
+public:
+    PairSorter(PairSorter const &) = delete; ///< the merge-heap refers to this object
+    PairSorter(std::string const &tmpDir, size_t memLimit, unsigned threads)
+    : heads([this](std::pair<ContigPair, unsigned> const &a, std::pair<ContigPair, unsigned> const &b) { return order(b.first, a.first); })
+    , tmpDir(tmpDir)
+    , memLimit(memLimit)
+    , capacity(std::max(size_t(1), memLimit / sizeof(ContigPair)))
+    , threads(std::max(1u, threads))
+    , added(0)
+    , merged(0)
+    {
+        buffer.reserve(capacity);
+    }
+    
+    void add(ContigPair const &pair) {
+        buffer.push_back(pair);
+        ++added;
+        if (buffer.size() >= capacity)
+            spill();
+    }
+    
+    /// no more pairs: the last run stays in memory, the merge can begin;
+    /// the read buffers of the spilled runs use half of the memory limit
+    void finish() {
+        auto const spilled = runs.size();
+        auto const blockSize = std::max(size_t(1024), memLimit / (2 * sizeof(ContigPair) * std::max(size_t(1), spilled)));
+        
+        for (auto && run : runs)
+            run.blockSize = blockSize;
+        if (!buffer.empty()) {
+            auto run = PairRun();
+            sortBuffer();
+            run.buffer = std::move(buffer);
+            runs.emplace_back(std::move(run));
+        }
+        buffer = std::vector<ContigPair>();
+        
+        order = PairOrder();
+        for (auto i = 0u; i < runs.size(); ++i) {
+            auto head = ContigPair();
+            if (runs[i].next(head))
+                heads.emplace(head, i);
+        }
+    }
+    
+    /// the next pair in sorted order; count == 0 at the end
+    ContigPair next() {
+        auto result = ContigPair();
+        result.count = 0;
+        if (!heads.empty()) {
+            auto const top = heads.top();
+            heads.pop();
+            result = top.first;
+            auto head = ContigPair();
+            if (runs[top.second].next(head))
+                heads.emplace(head, top.second);
+            ++merged;
+        }
+        return result;
+    }
+    
+    double position() const {
+        return added > 0 ? double(merged) / added : 1.0;
+    }
+};
+
+static ContigPair readPair(PairSorter &source)
+{
+    return source.next();
+}
+
+template <typename Source>
+static int process(VDB::Writer const &out, Source &ifs)
 {
     auto active = std::vector<ContigPair>();
     
@@ -361,7 +623,7 @@ static int process(VDB::Writer const &out, LineBuffer &ifs)
     auto report = freq;
 
     for ( ; ; ) {
-        auto pair = ContigPair(ifs);
+        auto pair = readPair(ifs);
         auto const isEOF = pair.count == 0;
         
         if ((!active.empty() && (pair.first.ref != ref || pair.first.start >= end)) || isEOF) {
@@ -541,7 +803,8 @@ static int reduce(FILE *out, std::string const &source)
     return result;
 }
 
-static int map(FILE *out, std::string const &run)
+template <typename F>
+static void forEachPair(std::string const &run, F &&func)
 {
     auto const mgr = VDB::Manager();
     auto const inDb = mgr[run];
@@ -557,16 +820,47 @@ static int map(FILE *out, std::string const &run)
             for (auto && two : fragment.detail) {
                 if (two.readNo != 2 || !two.aligned) continue;
                 
-                ContigPair(one, two, fragment.group).write(out);
+                func(ContigPair(one, two, fragment.group));
             }
         }
     }
+}
+
+static int map(FILE *out, std::string const &run)
+{
+    forEachPair(run, [&](ContigPair const &pair) { pair.write(out); });
     return 0;
 }
 
+static std::string tmpDir;
+static size_t memLimit = size_t(1024) * 1024 * 1024;
+static unsigned threads = 1;
+
+/// map and reduce without the text round-trip through sort
+static int mapReduce(FILE *out, std::string const &run)
+{
+    PairSorter sorter(tmpDir, memLimit, threads);
+    forEachPair(run, [&](ContigPair const &pair) { sorter.add(pair); });
+    sorter.finish();
+    
+    auto const writer = VDB::Writer(out);
+    
+    writer.destination("IR.vdb");
+    writer.schema("aligned-ir.schema.text", "NCBI:db:IR:raw");
+    writer.info("summarize-pairs", "1.0.0");
+    
+    ContigPair::setup(writer);
+
+    writer.beginWriting();
+    auto const result = process(writer, sorter);
+    writer.endWriting();
+    
+    return result;
+}
+
 namespace pairsStatistics {
     static void usage(CommandLine const &commandLine, bool error) {
-        (error ? std::cerr : std::cout) << "usage: " << commandLine.program[0] << " [-out=<path>] (map <sra run> | reduce <pairs>)" << std::endl;
+        (error ? std::cerr : std::cout) << "usage: " << commandLine.program[0] << " [-out=<path>] [-tmp=<dir>] [-mem=<MB>] [-threads=<n>] (map <sra run> | reduce <pairs> | map-reduce <sra run>)" << std::endl;
         exit(error ? 3 : 0);
     }
     
@@ -584,11 +878,31 @@ namespace pairsStatistics {
                 outPath = arg.substr(5);
                 continue;
             }
+            if (arg.substr(0, 5) == "-tmp=") {
+                tmpDir = arg.substr(5);
+                continue;
+            }
+            if (arg.substr(0, 5) == "-mem=") {
+                auto const value = arg.substr(5);
+                auto mb = size_t(0);
+                if (!string_to_u(mb, value.data(), value.data() + value.size(), 10) || mb == 0)
+                    usage(commandLine, true);
+                memLimit = mb * 1024 * 1024;
+                continue;
+            }
+            if (arg.substr(0, 9) == "-threads=") {
+                auto const value = arg.substr(9);
+                if (!string_to_u(threads, value.data(), value.data() + value.size(), 10) || threads == 0)
+                    usage(commandLine, true);
+                continue;
+            }
             if (verb == nullptr) {
                 if (arg == "map")
                     verb = &map;
                 else if (arg == "reduce")
                     verb = &reduce;
+                else if (arg == "map-reduce")
+                    verb = &mapReduce;
                 else
                     usage(commandLine, true);
                 continue;
@@ -603,6 +917,11 @@ namespace pairsStatistics {
         if (source.empty())
             usage(commandLine, true);
         
+        if (tmpDir.empty()) {
+            auto const env = getenv("TMPDIR");
+            tmpDir = env ? env : "/tmp";
+        }
+        
         FILE *ofs = nullptr;
         if (!outPath.empty()) {
             ofs = fopen(outPath.c_str(), "w");
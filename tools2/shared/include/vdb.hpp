@@ -31,7 +31,12 @@
 #include <iostream>
 #include <fstream>
 #include <utility>
+#include <vector>
 #include <map>
+#include <algorithm>
+#include <cassert>
+#include <thread>
+#include <pthread.h>
 
 namespace VDB {
     namespace C {
@@ -92,8 +97,26 @@ namespace VDB {
         C::VCursor *const o;
     protected:
         unsigned const N;
+        std::vector<std::string> fields; ///< the column names, for opening more cursors like this one
         
-        Cursor(C::VCursor *const o_, unsigned columns_) :o(o_), N(columns_) {}
+        Cursor(C::VCursor *const o_, std::vector<std::string> const &fields_) :o(o_), N(unsigned(fields_.size())), fields(fields_) {}
+        
+        static C::VCursor *open(C::VTable const *const tbl, std::vector<std::string> const &fields)
+        {
+            C::VCursor const *curs = 0;
+            auto rc = C::VTableCreateCursorRead(tbl, &curs);
+            if (rc) throw Error(rc, __FILE__, __LINE__);
+            
+            for (auto && field : fields) {
+                uint32_t cid = 0;
+                
+                rc = C::VCursorAddColumn(curs, &cid, "%s", field.c_str());
+                if (rc) { C::VCursorRelease(curs); throw Error(rc, __FILE__, __LINE__); }
+            }
+            rc = C::VCursorOpen(curs);
+            if (rc) { C::VCursorRelease(curs); throw Error(rc, __FILE__, __LINE__); }
+            return const_cast<C::VCursor *>(curs);
+        }
     public:
         using RowID = int64_t;
         struct Data {
@@ -183,10 +206,27 @@ namespace VDB {
                     throw std::logic_error("bad cast");
             }
         };
-        Cursor(Cursor const &other) :o(other.o), N(other.N) { C::VCursorAddRef(o); }
+        Cursor(Cursor const &other) :o(other.o), N(other.N), fields(other.fields) { C::VCursorAddRef(o); }
         ~Cursor() { C::VCursorRelease(o); }
         unsigned columns() const { return N; }
         
+        /// a new cursor on the same table and columns; cursors are not shared between threads, clones can be
+        Cursor clone() const
+        {
+            C::VTable const *tbl = 0;
+            auto const rc = C::VCursorOpenParentRead(o, &tbl);
+            if (rc) throw Error(rc, __FILE__, __LINE__);
+            try {
+                auto const curs = open(tbl, fields);
+                C::VTableRelease(tbl);
+                return Cursor(curs, fields);
+            }
+            catch (...) {
+                C::VTableRelease(tbl);
+                throw;
+            }
+        }
+        
         std::pair<RowID, RowID> rowRange() const
         {
             uint64_t count = 0;
@@ -265,6 +305,261 @@ namespace VDB {
             }
             return out;
         }
+        
+        /*
+         * A block of consecutive rows, copied out of the cursor so that it can be
+         * read on one thread and used on another. Each row that was kept is stored
+         * as N consecutive DataList records, as in IndexedCursorBase.
+         */
+        class Batch {
+            friend class Cursor;
+            std::vector<uint32_t> buffer;
+            std::vector<size_t> offset; ///< where each row starts in buffer
+            std::vector<bool> keep; ///< rows that were not kept were not read
+            RowID first;
+            unsigned N;
+            bool complete; ///< false if a read failed; the batch ends before the failed row
+            
+            Batch(RowID first_, unsigned columns_) : first(first_), N(columns_), complete(true) {}
+            
+            bool append(Cursor const &in, RowID const row, bool const keepRow) {
+                auto const start = buffer.size();
+                if (keepRow) {
+                    try {
+                        for (auto i = 0u; i < N; ++i) {
+                            auto const data = in.read(row, i + 1);
+                            auto const at = buffer.size();
+                            buffer.resize(at + data.storedSize() / 4);
+                            data.copy(buffer.data() + at, buffer.data() + buffer.size());
+                        }
+                    }
+                    catch (...) {
+                        buffer.resize(start);
+                        complete = false;
+                        return false;
+                    }
+                }
+                offset.push_back(start);
+                keep.push_back(keepRow);
+                return true;
+            }
+        public:
+            RowID firstRow() const { return first; }
+            RowID endRow() const { return first + RowID(offset.size()); }
+            size_t size() const { return offset.size(); }
+            bool kept(RowID const row) const { return keep[row - first]; }
+            
+            /// the first column of a kept row; the other columns follow, see DataList::next
+            DataList const *operator [](RowID const row) const {
+                return reinterpret_cast<DataList const *>(buffer.data() + offset[row - first]);
+            }
+            void read(RowID const row, std::vector<RawData> &out) const {
+                auto data = (*this)[row];
+                out.resize(N);
+                for (auto i = 0u; i < N; ++i) {
+                    out[i].data = data->data();
+                    out[i].elem_bits = data->elem_bits;
+                    out[i].elements = data->elements;
+                    data = data->next();
+                }
+            }
+        };
+        
+        /// a small number, decoding is cpu bound but the callback is single threaded
+        static unsigned defaultThreads() {
+            auto const cpus = std::thread::hardware_concurrency();
+            return cpus < 1 ? 1 : cpus > 4 ? 4 : cpus;
+        }
+        
+    private:
+        static size_t const batchRows = 4096;
+        
+        template <typename FILT>
+        Batch readBatch(Cursor const &in, FILT const &filt, RowID const first, RowID const end) const {
+            auto batch = Batch(first, N);
+            for (auto row = first; row < end; ++row) {
+                if (!batch.append(in, row, filt(in, row)))
+                    break;
+            }
+            return batch;
+        }
+        
+        /*
+         * The batches are claimed in order by the workers, each with its own cursor,
+         * and are handed back in order. A worker doesn't get more than 'window' batches
+         * ahead of the batch being used.
+         */
+        template <typename FILT>
+        struct BatchPool {
+            Cursor const &source;
+            FILT const &filt;
+            std::vector<Cursor> cursors;
+            RowID const first;
+            RowID const end;
+            uint64_t const count;
+            unsigned const window;
+            
+            pthread_mutex_t mutex;
+            pthread_cond_t cond;
+            std::vector<Batch> slot;
+            std::vector<bool> ready;
+            uint64_t next; ///< next batch to be claimed by a worker
+            uint64_t used; ///< batches handed back so far
+            unsigned started; ///< workers that have taken their cursor
+            bool quit;
+            
+            BatchPool(Cursor const &source, FILT const &filt, std::vector<Cursor> const &cursors, std::pair<RowID, RowID> const &range)
+            : source(source)
+            , filt(filt)
+            , cursors(cursors)
+            , first(range.first)
+            , end(range.second)
+            , count((range.second - range.first + batchRows - 1) / batchRows)
+            , window(2 * unsigned(cursors.size()))
+            , mutex(PTHREAD_MUTEX_INITIALIZER)
+            , cond(PTHREAD_COND_INITIALIZER)
+            , slot(window, Batch(0, 0))
+            , ready(window, false)
+            , next(0)
+            , used(0)
+            , started(0)
+            , quit(false)
+            {}
+            
+            void run() {
+                pthread_mutex_lock(&mutex);
+                auto const &curs = cursors[started++];
+                for ( ;; ) {
+                    while (!quit && next < count && next >= used + window)
+                        pthread_cond_wait(&cond, &mutex);
+                    if (quit || next >= count)
+                        break;
+                    
+                    auto const b = next++;
+                    pthread_mutex_unlock(&mutex);
+                    auto const beg = first + RowID(b * batchRows);
+                    auto batch = source.readBatch(curs, filt, beg, std::min(end, beg + RowID(batchRows)));
+                    pthread_mutex_lock(&mutex);
+                    
+                    slot[b % window] = std::move(batch);
+                    ready[b % window] = true;
+                    pthread_cond_broadcast(&cond);
+                }
+                pthread_mutex_unlock(&mutex);
+            }
+            static void *worker(void *vp) {
+                static_cast<BatchPool *>(vp)->run();
+                return nullptr;
+            }
+            
+            /// the next batch, in order
+            Batch take() {
+                pthread_mutex_lock(&mutex);
+                auto const i = used % window;
+                while (!ready[i])
+                    pthread_cond_wait(&cond, &mutex);
+                auto result = std::move(slot[i]);
+                ready[i] = false;
+                ++used;
+                pthread_cond_broadcast(&cond);
+                pthread_mutex_unlock(&mutex);
+                return result;
+            }
+            void stop() {
+                pthread_mutex_lock(&mutex);
+                quit = true;
+                pthread_cond_broadcast(&cond);
+                pthread_mutex_unlock(&mutex);
+            }
+        };
+        
+    public:
+        /*
+         * Reads the rows in batches, using 'threads' threads, each with its own cursor,
+         * and calls f(Batch const &) with each batch, in row order, on the calling thread.
+         * Rows for which filt(Cursor const &, RowID) is false are not read.
+         * Like foreach, it stops at the first row that can't be read.
+         */
+        template <typename FILT, typename F>
+        uint64_t foreachBatch(unsigned const threads, FILT filt, F f) const {
+            auto const range = rowRange();
+            auto cursors = std::vector<Cursor>();
+            uint64_t rows = 0;
+            
+            for (auto i = 0u; i < threads && threads > 1; ++i) {
+                try { cursors.push_back(clone()); }
+                catch (...) { break; }
+            }
+            if (cursors.size() < 2) {
+                for (auto beg = range.first; beg < range.second; beg += batchRows) {
+                    auto const batch = readBatch(*this, filt, beg, std::min(range.second, beg + RowID(batchRows)));
+                    f(batch);
+                    rows += batch.size();
+                    if (!batch.complete) break;
+                }
+                return rows;
+            }
+            
+            auto pool = BatchPool<FILT>(*this, filt, cursors, range);
+            auto tids = std::vector<pthread_t>();
+            for (auto i = 0u; i < cursors.size(); ++i) {
+                pthread_t tid = 0;
+                if (pthread_create(&tid, nullptr, BatchPool<FILT>::worker, &pool) == 0)
+                    tids.push_back(tid);
+            }
+            if (tids.empty()) {
+                // no threads, so read on this one; the pool won't be used
+                pool.quit = true;
+                cursors.clear();
+                return foreachBatch(1, filt, f);
+            }
+            try {
+                for (auto b = uint64_t(0); b < pool.count; ++b) {
+                    auto const batch = pool.take();
+                    f(batch);
+                    rows += batch.size();
+                    if (!batch.complete) break;
+                }
+            }
+            catch (...) {
+                pool.stop();
+                for (auto && tid : tids)
+                    pthread_join(tid, nullptr);
+                throw;
+            }
+            pool.stop();
+            for (auto && tid : tids)
+                pthread_join(tid, nullptr);
+            return rows;
+        }
+        template <typename F>
+        uint64_t foreachBatch(unsigned const threads, F f) const {
+            return foreachBatch(threads, [](Cursor const &, RowID) { return true; }, f);
+        }
+        
+        /// same as foreach, but the rows are read by several threads
+        template <typename F>
+        uint64_t foreachParallel(unsigned const threads, F f) const {
+            auto data = std::vector<RawData>();
+            return foreachBatch(threads, [&](Batch const &batch) {
+                for (auto row = batch.firstRow(); row < batch.endRow(); ++row) {
+                    batch.read(row, data);
+                    f(row, data);
+                }
+            });
+        }
+        template <typename FILT, typename FUNC>
+        uint64_t foreachParallel(unsigned const threads, FILT filt, FUNC func) const {
+            auto data = std::vector<RawData>(N);
+            return foreachBatch(threads, filt, [&](Batch const &batch) {
+                for (auto row = batch.firstRow(); row < batch.endRow(); ++row) {
+                    auto const keep = batch.kept(row);
+                    if (keep)
+                        batch.read(row, data);
+                    func(row, keep, data);
+                }
+            });
+        }
     };
     class IndexedCursorBase : public Cursor {
     protected:
@@ -501,40 +796,14 @@ namespace VDB {
         
         Cursor read(unsigned const N, char const *const fields[]) const
         {
-            unsigned n = 0;
-            C::VCursor const *curs = 0;
-            auto rc = C::VTableCreateCursorRead(o, &curs);
-            if (rc) throw Error(rc, __FILE__, __LINE__);
-            
-            for (unsigned i = 0; i < N; ++i) {
-                uint32_t cid = 0;
-                
-                rc = C::VCursorAddColumn(curs, &cid, "%s", fields[i]);
-                if (rc) throw Error(rc, __FILE__, __LINE__);
-                ++n;
-            }
-            rc = C::VCursorOpen(curs);
-            if (rc) throw Error(rc, __FILE__, __LINE__);
-            return Cursor(const_cast<C::VCursor *>(curs), n);
+            auto const names = std::vector<std::string>(fields, fields + N);
+            return Cursor(Cursor::open(o, names), names);
         }
         
         Cursor read(std::initializer_list<char const *> const &fields) const
         {
-            unsigned n = 0;
-            C::VCursor const *curs = 0;
-            auto rc = C::VTableCreateCursorRead(o, &curs);
-            if (rc) throw Error(rc, __FILE__, __LINE__);
-            
-            for (auto && field : fields) {
-                uint32_t cid = 0;
-                
-                rc = C::VCursorAddColumn(curs, &cid, "%s", field);
-                if (rc) throw Error(rc, __FILE__, __LINE__);
-                ++n;
-            }
-            rc = C::VCursorOpen(curs);
-            if (rc) throw Error(rc, __FILE__, __LINE__);
-            return Cursor(const_cast<C::VCursor *>(curs), n);
+            auto const names = std::vector<std::string>(fields.begin(), fields.end());
+            return Cursor(Cursor::open(o, names), names);
         }
     };
     class Database {
@@ -32,7 +32,12 @@
 #include <utility>
 #include <cstdint>
 #include <algorithm>
+#include <memory>
+#include <map>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
 
 #include "vdb.hpp"
 
@@ -67,11 +72,183 @@ namespace VDB {
             tableMeta,
             columnMeta
         };
-        FILE *stream;
+        
+        /*
+         * Events are encoded in place into a large buffer. A full buffer is handed
+         * to a background thread, which writes it to the stream while the other
+         * buffer is being filled. A failed write is reported by the calls after it.
+         */
+        class Output {
+            FILE *const stream;
+            char *buffer; ///< being filled
+            size_t used;
+            size_t capacity;
+            char *spare; ///< being written by the background thread
+            size_t spareUsed;
+            size_t spareCapacity;
+            
+            pthread_mutex_t mutex;
+            pthread_cond_t cond;
+            pthread_t tid;
+            bool threaded;
+            bool pending; ///< spare is waiting to be written
+            bool quit;
+            bool failed;
+            
+            bool coalesce;
+            std::map<unsigned, std::string> defaults; ///< the last default of each column, if coalescing
+            
+            static size_t const bufferSize = 4 * 1024 * 1024;
+            
+            void run() {
+                pthread_mutex_lock(&mutex);
+                for ( ;; ) {
+                    while (!pending && !quit)
+                        pthread_cond_wait(&cond, &mutex);
+                    if (!pending)
+                        break;
+                    
+                    pthread_mutex_unlock(&mutex);
+                    auto const ok = fwrite(spare, 1, spareUsed, stream) == spareUsed;
+                    pthread_mutex_lock(&mutex);
+                    
+                    if (!ok) failed = true;
+                    spareUsed = 0;
+                    pending = false;
+                    pthread_cond_broadcast(&cond);
+                }
+                pthread_mutex_unlock(&mutex);
+            }
+            static void *writer(void *vp) {
+                static_cast<Output *>(vp)->run();
+                return nullptr;
+            }
+            
+            /// waits for the spare buffer, then swaps it with the one being filled
+            void handOff() {
+                if (!threaded) {
+                    if (fwrite(buffer, 1, used, stream) != used)
+                        failed = true;
+                    used = 0;
+                    return;
+                }
+                pthread_mutex_lock(&mutex);
+                while (pending)
+                    pthread_cond_wait(&cond, &mutex);
+                std::swap(buffer, spare);
+                std::swap(capacity, spareCapacity);
+                spareUsed = used;
+                used = 0;
+                pending = true;
+                pthread_cond_broadcast(&cond);
+                pthread_mutex_unlock(&mutex);
+            }
+            void wait() {
+                if (!threaded) return;
+                pthread_mutex_lock(&mutex);
+                while (pending)
+                    pthread_cond_wait(&cond, &mutex);
+                pthread_mutex_unlock(&mutex);
+            }
+        public:
+            Output(Output const &) = delete;
+            Output(FILE *const stream_)
+            : stream(stream_)
+            , buffer((char *)malloc(bufferSize))
+            , used(0)
+            , capacity(bufferSize)
+            , spare((char *)malloc(bufferSize))
+            , spareUsed(0)
+            , spareCapacity(bufferSize)
+            , mutex(PTHREAD_MUTEX_INITIALIZER)
+            , cond(PTHREAD_COND_INITIALIZER)
+            , tid(0)
+            , threaded(false)
+            , pending(false)
+            , quit(false)
+            , failed(false)
+            , coalesce(false)
+            {
+                if (buffer == nullptr || spare == nullptr) {
+                    free(buffer);
+                    free(spare);
+                    throw std::bad_alloc();
+                }
+                threaded = pthread_create(&tid, nullptr, writer, this) == 0;
+            }
+            ~Output() {
+                flush();
+                if (threaded) {
+                    pthread_mutex_lock(&mutex);
+                    quit = true;
+                    pthread_cond_broadcast(&cond);
+                    pthread_mutex_unlock(&mutex);
+                    pthread_join(tid, nullptr);
+                }
+                free(buffer);
+                free(spare);
+            }
+            
+            /// room for an event of 'bytes' bytes, at the end of the buffer
+            char *reserve(size_t const bytes) {
+                if (used + bytes > capacity) {
+                    if (used > 0)
+                        handOff();
+                    if (bytes > capacity) {
+                        auto const tmp = (char *)realloc(buffer, bytes);
+                        if (tmp == nullptr) throw std::bad_alloc();
+                        buffer = tmp;
+                        capacity = bytes;
+                    }
+                }
+                auto const result = buffer + used;
+                used += bytes;
+                return result;
+            }
+            bool good() const { return !failed; }
+            
+            /// false if this default value is the same as the last one for the column
+            bool changedDefault(unsigned const cid, size_t const size, void const *const data) {
+                if (!coalesce) return true;
+                auto const value = std::string((char const *)data, size);
+                auto const i = defaults.find(cid);
+                if (i != defaults.end() && i->second == value)
+                    return false;
+                defaults[cid] = value;
+                return true;
+            }
+            void coalesceDefaults(bool const value) {
+                coalesce = value;
+                defaults.clear();
+            }
+            
+            /// writes everything that has been buffered
+            int flush() {
+                if (used > 0)
+                    handOff();
+                wait();
+                return fflush(stream) == 0 && !failed ? 0 : EOF;
+            }
+        };
+        std::unique_ptr<Output> out;
+        
+        static char *put(char *const dst, void const *const src, size_t const size) {
+            memcpy(dst, src, size);
+            return dst + size;
+        }
+        static char *put(char *const dst, uint32_t const value) {
+            return put(dst, &value, sizeof(value));
+        }
+        static void pad(char *const dst, size_t const padding) {
+            memset(dst, 0, padding);
+        }
+        static size_t padding(size_t const size) {
+            return (4 - (size & 3)) & 3;
+        }
         
         class StreamHeader {
             friend Writer;
-            bool write(FILE *const stream) const
+            bool write(Output &out) const
             {
                 struct h {
                     char sig[8];
@@ -80,7 +257,8 @@ namespace VDB {
                     uint32_t size;
                     uint32_t packing;
                 } const h = { { 'N', 'C', 'B', 'I', 'g', 'n', 'l', 'd' }, 1, 2, sizeof(struct h), 0 };
-                return fwrite(&h, sizeof(h), 1, stream) == 1;
+                put(out.reserve(sizeof(h)), &h, sizeof(h));
+                return out.good();
             }
         public:
             StreamHeader() {};
@@ -90,9 +268,10 @@ namespace VDB {
             friend Writer;
             uint32_t eid;
 
-            bool write(FILE *const stream) const
+            bool write(Output &out) const
             {
-                return fwrite(&eid, sizeof(eid), 1, stream) == 1;
+                put(out.reserve(sizeof(eid)), eid);
+                return out.good();
             }
         public:
             SimpleEvent(EventCode const code, unsigned const id) : eid((code << 24) + id) {}
@@ -103,14 +282,15 @@ namespace VDB {
             uint32_t eid;
             std::string const &str;
 
-            bool write(FILE *const stream) const {
-                uint32_t const zero = 0;
+            bool write(Output &out) const {
                 auto const size = (uint32_t)str.size();
-                auto const padding = (4 - (size & 3)) & 3;
-                return fwrite(&eid, sizeof(eid), 1, stream) == 1
-                    && fwrite(&size, sizeof(size), 1, stream) == 1
-                    && fwrite(str.data(), 1, size, stream) == size
-                    && fwrite(&zero, 1, padding, stream) == padding;
+                auto const pads = padding(size);
+                auto p = out.reserve(8 + size + pads);
+                p = put(p, eid);
+                p = put(p, size);
+                p = put(p, str.data(), size);
+                pad(p, pads);
+                return out.good();
             }
         public:
             String1Event(EventCode const code, unsigned const id, std::string const &str_)
@@ -125,18 +305,18 @@ namespace VDB {
             std::string const &str1;
             std::string const &str2;
 
-            bool write(FILE *const stream) const {
-                uint32_t const zero = 0;
+            bool write(Output &out) const {
                 auto const size1 = (uint32_t)str1.size();
                 auto const size2 = (uint32_t)str2.size();
-                auto const size = size1 + size2;
-                auto const padding = (4 - (size & 3)) & 3;
-                return fwrite(&eid, sizeof(eid), 1, stream) == 1
-                    && fwrite(&size1, sizeof(size1), 1, stream) == 1
-                    && fwrite(&size2, sizeof(size2), 1, stream) == 1
-                    && fwrite(str1.data(), 1, size1, stream) == size1
-                    && fwrite(str2.data(), 1, size2, stream) == size2
-                    && fwrite(&zero, 1, padding, stream) == padding;
+                auto const pads = padding(size1 + size2);
+                auto p = out.reserve(12 + size1 + size2 + pads);
+                p = put(p, eid);
+                p = put(p, size1);
+                p = put(p, size2);
+                p = put(p, str1.data(), size1);
+                p = put(p, str2.data(), size2);
+                pad(p, pads);
+                return out.good();
             }
         public:
             String2Event(EventCode const code, unsigned const id, std::string const &str_1, std::string const &str_2)
@@ -153,16 +333,17 @@ namespace VDB {
             uint32_t bits;
             std::string const &name;
             
-            bool write(FILE *const stream) const {
-                uint32_t const zero = 0;
+            bool write(Output &out) const {
                 auto const size = (uint32_t)name.size();
-                auto const padding = (4 - (size & 3)) & 3;
-                return fwrite(&eid, sizeof(eid), 1, stream) == 1
-                    && fwrite(&tid, sizeof(tid), 1, stream) == 1
-                    && fwrite(&bits, sizeof(bits), 1, stream) == 1
-                    && fwrite(&size, sizeof(size), 1, stream) == 1
-                    && fwrite(name.data(), 1, size, stream) == size
-                    && fwrite(&zero, 1, padding, stream) == padding;
+                auto const pads = padding(size);
+                auto p = out.reserve(16 + size + pads);
+                p = put(p, eid);
+                p = put(p, tid);
+                p = put(p, bits);
+                p = put(p, size);
+                p = put(p, name.data(), size);
+                pad(p, pads);
+                return out.good();
             }
         public:
             ColumnEvent(EventCode const code, unsigned const cid, unsigned const tid_, unsigned const elemBits, std::string const &str)
@@ -175,31 +356,37 @@ namespace VDB {
 
         bool write(EventCode const code, unsigned const cid, uint32_t const count, uint32_t const elsize, void const *data) const
         {
-            uint32_t const eid = (code << 24) + cid;
-            uint32_t const zero = 0;
             auto const size = elsize * count;
-            auto const padding = (4 - (size & 3)) & 3;
-            return fwrite(&eid, sizeof(eid), 1, stream) == 1
-                && fwrite(&count, sizeof(count), 1, stream) == 1
-                && fwrite(data, elsize, count, stream) == count
-                && fwrite(&zero, 1, padding, stream) == padding;
+            if (code == cellDefault && !out->changedDefault(cid, size, data))
+                return out->good();
+            
+            auto const pads = padding(size);
+            auto p = out->reserve(8 + size + pads);
+            p = put(p, (code << 24) + cid);
+            p = put(p, count);
+            p = put(p, data, size);
+            pad(p, pads);
+            return out->good();
         }
         template <typename T>
         bool write(EventCode const code, unsigned const cid, uint32_t const count, T const *data) const
         {
-            uint32_t const eid = (code << 24) + cid;
-            uint32_t const zero = 0;
-            auto const size = sizeof(T) * count;
-            auto const padding = (4 - (size & 3)) & 3;
-            return fwrite(&eid, sizeof(eid), 1, stream) == 1
-                && fwrite(&count, sizeof(count), 1, stream) == 1
-                && fwrite(data, sizeof(T), count, stream) == count
-                && fwrite(&zero, 1, padding, stream) == padding;
+            return write(code, cid, count, (uint32_t)sizeof(T), data);
         }
+        /// one value of a fixed size: the size of the event is known at compile time
         template <typename T>
         bool write(EventCode const code, unsigned const cid, T const &data) const
         {
-            return write(code, cid, 1, &data);
+            if (code == cellDefault && !out->changedDefault(cid, sizeof(T), &data))
+                return out->good();
+            
+            auto const pads = padding(sizeof(T));
+            auto p = out->reserve(8 + sizeof(T) + pads);
+            p = put(p, (code << 24) + cid);
+            p = put(p, 1);
+            p = put(p, &data, sizeof(T));
+            pad(p, pads);
+            return out->good();
         }
         bool write(EventCode const code, unsigned const cid, std::string const &data) const
         {
@@ -207,44 +394,51 @@ namespace VDB {
         }
     public:
         Writer(FILE *const stream_)
-        : stream(stream_)
+        : out(new Output(stream_))
+        {
+            StreamHeader().write(*out);
+        }
+        Writer(Writer &&) = default;
+
+        /// don't write a default value that is the same as the last one for its column
+        void coalesceDefaults(bool const value = true) const
         {
-            StreamHeader().write(stream);
+            out->coalesceDefaults(value);
         }
 
         bool errorMessage(std::string const &message) const
         {
-            return String1Event(errMessage, 0, message).write(stream);
+            return String1Event(errMessage, 0, message).write(*out);
         }
         
         bool destination(std::string const &remoteDb) const
         {
-            return String1Event(remotePath, 0, remoteDb).write(stream);
+            return String1Event(remotePath, 0, remoteDb).write(*out);
         }
         
         bool schema(std::string const &file, std::string const &dbSpec) const
         {
-            return String2Event(useSchema, 0, file, dbSpec).write(stream);
+            return String2Event(useSchema, 0, file, dbSpec).write(*out);
         }
         
         bool info(std::string const &name, std::string const &version) const
         {
-            return String2Event(writerName, 0, name, version).write(stream);
+            return String2Event(writerName, 0, name, version).write(*out);
         }
         
         bool openTable(unsigned const tid, std::string const &name) const
         {
-            return String1Event(newTable, tid, name).write(stream);
+            return String1Event(newTable, tid, name).write(*out);
         }
         
         bool openColumn(unsigned const cid, unsigned const tid, unsigned const elemBits, std::string const &colSpec) const
         {
-            return ColumnEvent(newColumn, cid, tid, elemBits, colSpec).write(stream);
+            return ColumnEvent(newColumn, cid, tid, elemBits, colSpec).write(*out);
         }
         
         bool beginWriting() const
         {
-            return SimpleEvent(openStream, 0).write(stream);
+            return SimpleEvent(openStream, 0).write(*out);
         }
         
         template <typename T>
@@ -255,7 +449,7 @@ namespace VDB {
         template <typename T>
         bool defaultValue(unsigned const cid, T const &data) const
         {
-            return write(cellDefault, cid, 1, &data);
+            return write(cellDefault, cid, data);
         }
         bool defaultValue(unsigned const cid, std::string const &data) const
         {
@@ -274,7 +468,7 @@ namespace VDB {
         template <typename T>
         bool value(unsigned const cid, T const &data) const
         {
-            return write(cellData, cid, 1, &data);
+            return write(cellData, cid, data);
         }
         bool value(unsigned const cid, std::string const &data) const
         {
@@ -283,7 +477,7 @@ namespace VDB {
         
         bool closeRow(unsigned const tid) const
         {
-            return SimpleEvent(nextRow, tid).write(stream);
+            return SimpleEvent(nextRow, tid).write(*out);
         }
         
         enum MetaNodeRoot {
@@ -295,16 +489,17 @@ namespace VDB {
                             : root == table    ? tableMeta
                             : root == column   ? columnMeta
                             : badEvent;
-            return String2Event(code, oid, name, value).write(stream);
+            return String2Event(code, oid, name, value).write(*out);
         }
         
+        /// the end of the stream; everything buffered is written
         bool endWriting() const
         {
-            return SimpleEvent(endStream, 0).write(stream);
+            return SimpleEvent(endStream, 0).write(*out) && out->flush() == 0;
         }
         
-        auto flush() const -> decltype(fflush(stream)) {
-            return fflush(stream);
+        int flush() const {
+            return out->flush();
         }
     };
 }